@@ -0,0 +1,494 @@
+#include "adb_client.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "util/buffer_util.h"
+#include "util/log.h"
+#include "util/str_util.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+// old adb servers reject longer requests
+#define MAX_REQUEST_LENGTH 4096
+// max length of a sync path (including the ",mode" suffix for SEND)
+#define SYNC_MAX_PATH_LENGTH 1024
+#define SYNC_DATA_MAX (64 * 1024)
+
+static uint16_t
+get_server_port(void) {
+    const char *s = getenv("ANDROID_ADB_SERVER_PORT");
+    if (s) {
+        long value;
+        if (parse_integer(s, &value) && value > 0 && value <= 0xFFFF) {
+            return (uint16_t) value;
+        }
+        LOGW("Invalid ANDROID_ADB_SERVER_PORT: %s", s);
+    }
+    return SC_ADB_DEFAULT_SERVER_PORT;
+}
+
+static enum sc_adb_result
+send_request(socket_t socket, const char *request) {
+    size_t len = strlen(request);
+    if (len > MAX_REQUEST_LENGTH) {
+        LOGE("adb request too long: %u", (unsigned) len);
+        return SC_ADB_ERROR;
+    }
+
+    char buf[4 + MAX_REQUEST_LENGTH + 1];
+    sprintf(buf, "%04x", (unsigned) len);
+    memcpy(&buf[4], request, len);
+
+    if (net_send_all(socket, buf, 4 + len) != (ssize_t) (4 + len)) {
+        return SC_ADB_UNAVAILABLE;
+    }
+    return SC_ADB_OK;
+}
+
+// Read a string prefixed by its length (4 hexadecimal digits)
+static enum sc_adb_result
+read_string(socket_t socket, char **out) {
+    char hex[5];
+    if (net_recv_all(socket, hex, 4) != 4) {
+        return SC_ADB_UNAVAILABLE;
+    }
+    hex[4] = '\0';
+
+    char *endptr;
+    unsigned long len = strtoul(hex, &endptr, 16);
+    if (*endptr) {
+        LOGE("Unexpected adb length: %s", hex);
+        return SC_ADB_ERROR;
+    }
+
+    char *s = malloc(len + 1);
+    if (!s) {
+        LOGC("Could not allocate adb string");
+        return SC_ADB_ERROR;
+    }
+
+    if (len && net_recv_all(socket, s, len) != (ssize_t) len) {
+        free(s);
+        return SC_ADB_UNAVAILABLE;
+    }
+    s[len] = '\0';
+
+    *out = s;
+    return SC_ADB_OK;
+}
+
+static enum sc_adb_result
+read_status(socket_t socket) {
+    char status[4];
+    if (net_recv_all(socket, status, 4) != 4) {
+        return SC_ADB_UNAVAILABLE;
+    }
+
+    if (!memcmp(status, "OKAY", 4)) {
+        return SC_ADB_OK;
+    }
+
+    if (memcmp(status, "FAIL", 4)) {
+        LOGE("Unexpected adb status: %.4s", status);
+        return SC_ADB_ERROR;
+    }
+
+    char *msg;
+    enum sc_adb_result r = read_string(socket, &msg);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    LOGE("adb: %s", msg);
+    free(msg);
+    return SC_ADB_ERROR;
+}
+
+static enum sc_adb_result
+connect_server(socket_t *socket) {
+    *socket = net_connect(IPV4_LOCALHOST, get_server_port());
+    if (*socket == INVALID_SOCKET) {
+        LOGD("adb server not reachable");
+        return SC_ADB_UNAVAILABLE;
+    }
+    return SC_ADB_OK;
+}
+
+// Connect to the adb server and send a request
+static enum sc_adb_result
+connect_request(const char *request, socket_t *socket) {
+    enum sc_adb_result r = connect_server(socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    r = send_request(*socket, request);
+    if (r == SC_ADB_OK) {
+        r = read_status(*socket);
+    }
+    if (r != SC_ADB_OK) {
+        net_close(*socket);
+    }
+    return r;
+}
+
+// Open a connection to a service on the device (e.g. "shell:ls")
+static enum sc_adb_result
+open_service(const char *serial, const char *service, socket_t *socket) {
+    char transport[64 + 256];
+    if (serial) {
+        int w = snprintf(transport, sizeof(transport), "host:transport:%s",
+                         serial);
+        if (w < 0 || (size_t) w >= sizeof(transport)) {
+            LOGE("adb serial too long: %s", serial);
+            return SC_ADB_ERROR;
+        }
+    } else {
+        strcpy(transport, "host:transport-any");
+    }
+
+    // the connection is switched to the device transport
+    enum sc_adb_result r = connect_request(transport, socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    r = send_request(*socket, service);
+    if (r == SC_ADB_OK) {
+        r = read_status(*socket);
+    }
+    if (r != SC_ADB_OK) {
+        net_close(*socket);
+    }
+    return r;
+}
+
+enum sc_adb_result
+sc_adb_host_query(const char *request, char **reply) {
+    socket_t socket;
+    enum sc_adb_result r = connect_request(request, &socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    char *s;
+    r = read_string(socket, &s);
+    net_close(socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    if (reply) {
+        *reply = s;
+    } else {
+        free(s);
+    }
+    return SC_ADB_OK;
+}
+
+// For forward and reverse requests, the first status acknowledges the
+// connection to the target, the second one reports the result
+static enum sc_adb_result
+read_command_result(socket_t socket) {
+    enum sc_adb_result r = read_status(socket);
+    net_close(socket);
+    return r;
+}
+
+static enum sc_adb_result
+host_command(const char *serial, const char *command) {
+    char request[64 + 256 + 128];
+    int w;
+    if (serial) {
+        w = snprintf(request, sizeof(request), "host-serial:%s:%s", serial,
+                     command);
+    } else {
+        w = snprintf(request, sizeof(request), "host:%s", command);
+    }
+    if (w < 0 || (size_t) w >= sizeof(request)) {
+        LOGE("adb request too long: %s", command);
+        return SC_ADB_ERROR;
+    }
+
+    socket_t socket;
+    enum sc_adb_result r = connect_request(request, &socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    return read_command_result(socket);
+}
+
+static enum sc_adb_result
+device_command(const char *serial, const char *command) {
+    socket_t socket;
+    enum sc_adb_result r = open_service(serial, command, &socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    return read_command_result(socket);
+}
+
+enum sc_adb_result
+sc_adb_forward(const char *serial, uint16_t local_port,
+               const char *device_socket_name) {
+    char command[128 + 108];
+    snprintf(command, sizeof(command),
+             "forward:tcp:%" PRIu16 ";localabstract:%s", local_port,
+             device_socket_name);
+    return host_command(serial, command);
+}
+
+enum sc_adb_result
+sc_adb_forward_remove(const char *serial, uint16_t local_port) {
+    char command[32];
+    sprintf(command, "killforward:tcp:%" PRIu16, local_port);
+    return host_command(serial, command);
+}
+
+enum sc_adb_result
+sc_adb_reverse(const char *serial, const char *device_socket_name,
+               uint16_t local_port) {
+    char command[128 + 108];
+    snprintf(command, sizeof(command),
+             "reverse:forward:localabstract:%s;tcp:%" PRIu16,
+             device_socket_name, local_port);
+    return device_command(serial, command);
+}
+
+enum sc_adb_result
+sc_adb_reverse_remove(const char *serial, const char *device_socket_name) {
+    char command[128 + 108];
+    snprintf(command, sizeof(command), "reverse:killforward:localabstract:%s",
+             device_socket_name);
+    return device_command(serial, command);
+}
+
+// Send a sync request: a 4-byte id and a 32-bit value (little-endian),
+// which is the length of the data if any
+static enum sc_adb_result
+sync_send(socket_t socket, const char *id, uint32_t value, const void *data) {
+    uint8_t header[8];
+    memcpy(header, id, 4);
+    buffer_write32le(&header[4], value);
+    if (net_send_all(socket, header, 8) != 8) {
+        return SC_ADB_UNAVAILABLE;
+    }
+    if (data && value && net_send_all(socket, data, value) != (ssize_t) value) {
+        return SC_ADB_UNAVAILABLE;
+    }
+    return SC_ADB_OK;
+}
+
+static enum sc_adb_result
+sync_stat(socket_t socket, const char *path, struct sc_adb_file_stat *st) {
+    enum sc_adb_result r = sync_send(socket, "STAT", strlen(path), path);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    // "STAT" mode size mtime
+    uint8_t resp[16];
+    if (net_recv_all(socket, resp, sizeof(resp)) != sizeof(resp)) {
+        return SC_ADB_UNAVAILABLE;
+    }
+    if (memcmp(resp, "STAT", 4)) {
+        LOGE("Unexpected adb sync response: %.4s", (char *) resp);
+        return SC_ADB_ERROR;
+    }
+
+    st->mode = buffer_read32le(&resp[4]);
+    st->size = buffer_read32le(&resp[8]);
+    st->mtime = buffer_read32le(&resp[12]);
+    return SC_ADB_OK;
+}
+
+static const char *
+get_basename(const char *path) {
+    const char *name = path;
+    for (const char *p = path; *p; ++p) {
+#ifdef _WIN32
+        if (*p == '/' || *p == '\\') {
+#else
+        if (*p == '/') {
+#endif
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+static enum sc_adb_result
+sync_push(socket_t socket, FILE *file, const struct stat *st,
+          const char *local, const char *remote) {
+    struct sc_adb_file_stat remote_st;
+    enum sc_adb_result r = sync_stat(socket, remote, &remote_st);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+    bool is_dir = SC_ADB_S_ISDIR(remote_st.mode);
+
+    // path,mode
+    char path[SYNC_MAX_PATH_LENGTH + 1];
+    int w;
+    unsigned mode = 0100000 | (st->st_mode & 0777); // regular file
+    if (is_dir) {
+        size_t len = strlen(remote);
+        const char *sep = len && remote[len - 1] == '/' ? "" : "/";
+        w = snprintf(path, sizeof(path), "%s%s%s,%u", remote, sep,
+                     get_basename(local), mode);
+    } else {
+        w = snprintf(path, sizeof(path), "%s,%u", remote, mode);
+    }
+    if (w < 0 || (size_t) w >= sizeof(path)) {
+        LOGE("adb push: remote path too long: %s", remote);
+        return SC_ADB_ERROR;
+    }
+
+    r = sync_send(socket, "SEND", w, path);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    uint8_t *buf = malloc(8 + SYNC_DATA_MAX);
+    if (!buf) {
+        LOGC("Could not allocate adb push buffer");
+        return SC_ADB_ERROR;
+    }
+
+    // the data chunks are not acknowledged, send them without waiting
+    size_t n;
+    while ((n = fread(&buf[8], 1, SYNC_DATA_MAX, file)) > 0) {
+        memcpy(buf, "DATA", 4);
+        buffer_write32le(&buf[4], n);
+        if (net_send_all(socket, buf, 8 + n) != (ssize_t) (8 + n)) {
+            free(buf);
+            return SC_ADB_UNAVAILABLE;
+        }
+    }
+    free(buf);
+
+    if (ferror(file)) {
+        LOGE("Could not read %s", local);
+        return SC_ADB_ERROR;
+    }
+
+    r = sync_send(socket, "DONE", (uint32_t) st->st_mtime, NULL);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    // "OKAY" 0 or "FAIL" len msg
+    uint8_t resp[8];
+    if (net_recv_all(socket, resp, sizeof(resp)) != sizeof(resp)) {
+        return SC_ADB_UNAVAILABLE;
+    }
+    if (!memcmp(resp, "OKAY", 4)) {
+        return SC_ADB_OK;
+    }
+
+    if (!memcmp(resp, "FAIL", 4)) {
+        uint32_t len = buffer_read32le(&resp[4]);
+        char msg[256];
+        len = len < sizeof(msg) - 1 ? len : sizeof(msg) - 1;
+        if (net_recv_all(socket, msg, len) == (ssize_t) len) {
+            msg[len] = '\0';
+            LOGE("adb push: %s", msg);
+        }
+    } else {
+        LOGE("Unexpected adb sync response: %.4s", (char *) resp);
+    }
+    return SC_ADB_ERROR;
+}
+
+enum sc_adb_result
+sc_adb_stat(const char *serial, const char *path,
+            struct sc_adb_file_stat *st) {
+    socket_t socket;
+    enum sc_adb_result r = open_service(serial, "sync:", &socket);
+    if (r != SC_ADB_OK) {
+        return r;
+    }
+
+    r = sync_stat(socket, path, st);
+    if (r == SC_ADB_OK) {
+        sync_send(socket, "QUIT", 0, NULL); // ignore failure
+    }
+
+    net_close(socket);
+    return r;
+}
+
+enum sc_adb_result
+sc_adb_push(const char *serial, const char *local, const char *remote) {
+    FILE *file = fopen(local, "rb");
+    if (!file) {
+        LOGE("Could not open %s: %s", local, strerror(errno));
+        return SC_ADB_ERROR;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st)) {
+        LOGE("Could not stat %s: %s", local, strerror(errno));
+        fclose(file);
+        return SC_ADB_ERROR;
+    }
+
+    socket_t socket;
+    enum sc_adb_result r = open_service(serial, "sync:", &socket);
+    if (r != SC_ADB_OK) {
+        fclose(file);
+        return r;
+    }
+
+    r = sync_push(socket, file, &st, local, remote);
+    if (r == SC_ADB_OK) {
+        sync_send(socket, "QUIT", 0, NULL); // ignore failure
+    }
+
+    net_close(socket);
+    fclose(file);
+    return r;
+}
+
+enum sc_adb_result
+sc_adb_shell(const char *serial, const char *const argv[], size_t len,
+             socket_t *socket) {
+    char service[MAX_REQUEST_LENGTH + 1];
+    size_t n = xstrncpy(service, "shell:", sizeof(service));
+    for (size_t i = 0; i < len; ++i) {
+        if (i) {
+            if (n + 1 >= sizeof(service)) {
+                goto error_too_long;
+            }
+            service[n++] = ' ';
+        }
+        size_t w = xstrncpy(&service[n], argv[i], sizeof(service) - n);
+        if (w >= sizeof(service) - n) {
+            goto error_too_long;
+        }
+        n += w;
+    }
+
+    return open_service(serial, service, socket);
+
+error_too_long:
+    LOGE("adb shell command too long");
+    return SC_ADB_ERROR;
+}
+
+enum sc_adb_result
+sc_adb_track_devices(socket_t *socket) {
+    return connect_request("host:track-devices", socket);
+}
+
+enum sc_adb_result
+sc_adb_read_devices(socket_t socket, char **devices) {
+    return read_string(socket, devices);
+}
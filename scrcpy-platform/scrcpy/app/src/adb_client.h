@@ -0,0 +1,98 @@
+#ifndef SC_ADB_CLIENT_H
+#define SC_ADB_CLIENT_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/net.h"
+
+#define SC_ADB_DEFAULT_SERVER_PORT 5037
+
+// In-process client for the adb server "smart socket" protocol, to avoid
+// spawning an adb process for each command.
+//
+// Each request is sent to the adb server on localhost (on the port defined by
+// ANDROID_ADB_SERVER_PORT, 5037 by default) as a 4-digit hexadecimal length
+// followed by the request, and is answered by "OKAY" or by "FAIL" followed by
+// an error message (with the same length prefix).
+//
+// The adb server is never started by this client: if it is not running,
+// SC_ADB_UNAVAILABLE is returned, and the caller is expected to fall back to
+// the adb binary (see adb.h), which starts it.
+
+enum sc_adb_result {
+    SC_ADB_OK,
+    SC_ADB_ERROR, // the adb server or the device reported an error
+    SC_ADB_UNAVAILABLE, // the adb server could not be reached
+};
+
+// Execute a host request (e.g. "host:version") and read the reply payload
+//
+// If reply is not NULL, it is set to a new allocated nul-terminated string, to
+// be freed by the caller.
+enum sc_adb_result
+sc_adb_host_query(const char *request, char **reply);
+
+// File information on the device (mode is 0 if the file does not exist)
+struct sc_adb_file_stat {
+    uint32_t mode;
+    uint32_t size;
+    uint32_t mtime;
+};
+
+// The device modes are Linux modes, whatever the host platform
+#define SC_ADB_S_ISREG(mode) (((mode) & 0170000) == 0100000)
+#define SC_ADB_S_ISDIR(mode) (((mode) & 0170000) == 0040000)
+
+enum sc_adb_result
+sc_adb_forward(const char *serial, uint16_t local_port,
+               const char *device_socket_name);
+
+enum sc_adb_result
+sc_adb_forward_remove(const char *serial, uint16_t local_port);
+
+enum sc_adb_result
+sc_adb_reverse(const char *serial, const char *device_socket_name,
+               uint16_t local_port);
+
+enum sc_adb_result
+sc_adb_reverse_remove(const char *serial, const char *device_socket_name);
+
+enum sc_adb_result
+sc_adb_stat(const char *serial, const char *path,
+            struct sc_adb_file_stat *st);
+
+// Push a local file using the sync protocol
+//
+// If remote is an existing directory on the device, the file is pushed into
+// it (like "adb push").
+enum sc_adb_result
+sc_adb_push(const char *serial, const char *local, const char *remote);
+
+// Execute a shell command (the arguments are joined by spaces, like "adb
+// shell")
+//
+// On success, the socket is set to the connection streaming the command
+// output, until the command terminates. Closing it terminates the command.
+enum sc_adb_result
+sc_adb_shell(const char *serial, const char *const argv[], size_t len,
+             socket_t *socket);
+
+// Subscribe to the device list updates ("adb track-devices")
+//
+// On success, the socket is set to the connection on which the adb server
+// sends the current device list, then a new list on every change.
+enum sc_adb_result
+sc_adb_track_devices(socket_t *socket);
+
+// Read the next device list from a track-devices connection (blocking)
+//
+// The list is set to a new allocated string, to be freed by the caller, of
+// one "serial\tstate\n" line per device.
+enum sc_adb_result
+sc_adb_read_devices(socket_t socket, char **devices);
+
+#endif
@@ -28,6 +28,13 @@ scrcpy_print_usage(const char *arg0) {
         "        Unit suffixes are supported: 'K' (x1000) and 'M' (x1000000).\n"
         "        Default is " STR(DEFAULT_BIT_RATE) ".\n"
         "\n"
+        "    --coalesce-moves\n"
+        "        Merge consecutive mouse/touch move events for the same\n"
+        "        pointer, queued while the previous ones were being sent,\n"
+        "        into the latest one.\n"
+        "        This reduces the number of events injected during drags,\n"
+        "        at the cost of skipping intermediate positions.\n"
+        "\n"
         "    --codec-options key[:type]=value[,...]\n"
         "        Set a list of comma-separated key:type=value options for the\n"
         "        device encoder.\n"
@@ -105,6 +112,11 @@ scrcpy_print_usage(const char *arg0) {
         "        is preserved.\n"
         "        Default is 0 (unlimited).\n"
         "\n"
+        "    --metrics-listen port|unix:path\n"
+        "        Serve the metrics of the session (bytes, frames, queue\n"
+        "        depths, decode time...) in the Prometheus text format over\n"
+        "        HTTP, on a local TCP port or on a UNIX socket.\n"
+        "\n"
         "    -n, --no-control\n"
         "        Disable device control (mirror the device in read-only).\n"
         "\n"
@@ -122,6 +134,7 @@ scrcpy_print_usage(const char *arg0) {
         "\n"
         "    -p, --port port[:port]\n"
         "        Set the TCP port (range) used by the client to listen.\n"
+        "        Use 0 for any free port.\n"
         "        Default is " STR(DEFAULT_LOCAL_PORT_RANGE_FIRST) ":"
                               STR(DEFAULT_LOCAL_PORT_RANGE_LAST) ".\n"
         "\n"
@@ -141,26 +154,89 @@ scrcpy_print_usage(const char *arg0) {
         "        Record screen to file.\n"
         "        The format is determined by the --record-format option if\n"
         "        set, or by the file extension (.mp4 or .mkv).\n"
+        "        This option may be repeated to record simultaneously to up\n"
+        "        to " STR(SC_MAX_EXTRA_RECORDS) " additional files.\n"
         "\n"
         "    --record-format format\n"
-        "        Force recording format (either mp4 or mkv).\n"
-        "\n"
-        "    --render-driver name\n"
+        "        Force recording format (either mp4, mkv or fmp4).\n"
+        "        The format fmp4 is a fragmented MP4, which is readable\n"
+        "        while it is being written.\n"
+        "        If several recordings are requested, it applies to the\n"
+        "        preceding -r/--record (or to the first one if none\n"
+        "        precedes).\n"
+        "\n"
+        "    --record-input file\n"
+        "        Record the input events sent to the device (with their\n"
+        "        timestamps, in microseconds) to a binary trace file, to be\n"
+        "        replayed later by --replay-input.\n"
+        "\n"
+        "    --record-raw file.h264\n"
+        "        Dump the raw H.264 stream to file, without parsing nor\n"
+        "        muxing. This is the cheapest way to archive a session.\n"
+        "        It requires -N/--no-display, and can not be combined with\n"
+        "        screen recording or another sink.\n"
+        "\n"
+        "    --record-raw-pts file\n"
+        "        Along with --record-raw, write the PTS and the size of each\n"
+        "        packet to file (12 bytes per packet, big-endian).\n"
+        "\n"
+        "    --reconnect attempts\n"
+    "        When the device is disconnected, try to reconnect (with an\n"
+    "        increasing delay between the attempts) without closing the\n"
+    "        window, the recordings nor the other video outputs. The\n"
+    "        recordings continue in the same files.\n"
+    "        Default is 0 (stop on disconnection).\n"
+    "\n"
+    "    --render-driver name\n"
         "        Request SDL to use the given render driver (this is just a\n"
         "        hint).\n"
         "        Supported names are currently \"direct3d\", \"opengl\",\n"
         "        \"opengles2\", \"opengles\", \"metal\" and \"software\".\n"
         "        <https://wiki.libsdl.org/SDL_HINT_RENDER_DRIVER>\n"
         "\n"
+        "    --replay-input file\n"
+        "        Replay the input events from a trace file recorded by\n"
+        "        --record-input, with the original timings (relative to the\n"
+        "        start of the session).\n"
+        "        The scheduling lateness is reported at the end.\n"
+        "\n"
+        "    --restream url\n"
+        "        Remux the video stream (without decoding it) and send it to\n"
+        "        a local target, either \"udp://host:port\",\n"
+        "        \"rtp://host:port\", \"unix:/path/to/socket\" (datagram) or\n"
+        "        the path to a FIFO.\n"
+        "        If the consumer does not keep up, packets are dropped until\n"
+        "        the next keyframe.\n"
+        "\n"
+        "    --restream-format format\n"
+        "        Force restream format (either mpegts or rtp).\n"
+        "        By default, it is rtp for \"rtp://\" urls, mpegts otherwise.\n"
+        "\n"
         "    --rotation value\n"
         "        Set the initial display rotation.\n"
         "        Possibles values are 0, 1, 2 and 3. Each increment adds a 90\n"
         "        degrees rotation counterclockwise.\n"
         "\n"
+        "    --rtt-probe ms\n"
+        "        Measure the round-trip time of the control channel by\n"
+        "        sending a ping whenever no event has been sent for the given\n"
+        "        delay (in milliseconds).\n"
+        "        The round-trip times are reported at the end.\n"
+        "        This requires a server echoing the pings.\n"
+        "        Default is 0 (disabled).\n"
+        "\n"
         "    -s, --serial serial\n"
         "        The device serial number. Mandatory only if several devices\n"
         "        are connected to adb.\n"
         "\n"
+#ifdef HAVE_SHM_SINK
+        "    --shm-sink name\n"
+        "        Publish the decoded frames (YUV420P) into a POSIX shared\n"
+        "        memory ring named name (e.g. \"/scrcpy\"), so that other\n"
+        "        local processes can read the latest frame without any\n"
+        "        copy through a socket. See shm_ring.h for the layout.\n"
+        "\n"
+#endif
         "    --shortcut-mod key[+...]][,...]\n"
         "        Specify the modifiers to use for scrcpy shortcuts.\n"
         "        Possible keys are \"lctrl\", \"rctrl\", \"lalt\", \"ralt\",\n"
@@ -182,12 +258,30 @@ scrcpy_print_usage(const char *arg0) {
         "        on exit.\n"
         "        It only shows physical touches (not clicks from scrcpy).\n"
         "\n"
+        "    --thread-config role:attr=value[:...][;...]\n"
+        "        Configure the threads of each role (stream, controller,\n"
+        "        receiver, buffering, recorder, v4l2, pool...), with the\n"
+        "        attributes:\n"
+        "            cpus=0-3,8   CPU affinity\n"
+        "            nice=n       nice value (-20 to 19)\n"
+        "            fifo=n       SCHED_FIFO priority (1 to 99)\n"
+        "            name=str     thread name\n"
+        "        For example: \"stream:cpus=0-3:fifo=10;recorder:nice=10\".\n"
+        "        Only supported on Linux.\n"
+        "        Default is the value of the environment variable\n"
+        "        SCRCPY_THREAD_CONFIG, if set.\n"
+        "\n"
 #ifdef HAVE_V4L2
         "    --v4l2-sink /dev/videoN\n"
         "        Output to v4l2loopback device.\n"
         "        It requires to lock the video orientation (see\n"
         "        --lock-video-orientation).\n"
         "\n"
+        "    --v4l2-format format\n"
+        "        Pixel format of the frames sent to the v4l2loopback device:\n"
+        "        yuv420, nv12 or yuyv.\n"
+        "        Default is yuv420.\n"
+        "\n"
         "    --v4l2-buffer ms\n"
         "        Add a buffering delay (in milliseconds) before pushing\n"
         "        frames. This increases latency to compensate for jitter.\n"
@@ -407,6 +501,19 @@ parse_max_fps(const char *s, uint16_t *max_fps) {
     return true;
 }
 
+static bool
+parse_reconnect_attempts(const char *s, uint16_t *attempts) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF,
+                                "reconnect attempts");
+    if (!ok) {
+        return false;
+    }
+
+    *attempts = (uint16_t) value;
+    return true;
+}
+
 static bool
 parse_buffering_time(const char *s, sc_tick *tick) {
     long value;
@@ -669,7 +776,11 @@ parse_record_format(const char *optarg, enum sc_record_format *format) {
         *format = SC_RECORD_FORMAT_MKV;
         return true;
     }
-    LOGE("Unsupported format: %s (expected mp4 or mkv)", optarg);
+    if (!strcmp(optarg, "fmp4")) {
+        *format = SC_RECORD_FORMAT_FMP4;
+        return true;
+    }
+    LOGE("Unsupported format: %s (expected mp4, mkv or fmp4)", optarg);
     return false;
 }
 
@@ -689,6 +800,41 @@ guess_record_format(const char *filename) {
     return 0;
 }
 
+static bool
+parse_restream_format(const char *optarg, enum sc_restream_format *format) {
+    if (!strcmp(optarg, "mpegts")) {
+        *format = SC_RESTREAM_FORMAT_MPEGTS;
+        return true;
+    }
+    if (!strcmp(optarg, "rtp")) {
+        *format = SC_RESTREAM_FORMAT_RTP;
+        return true;
+    }
+    LOGE("Unsupported restream format: %s (expected mpegts or rtp)", optarg);
+    return false;
+}
+
+#ifdef HAVE_V4L2
+static bool
+parse_v4l2_format(const char *optarg, enum sc_v4l2_format *format) {
+    if (!strcmp(optarg, "yuv420")) {
+        *format = SC_V4L2_FORMAT_YUV420;
+        return true;
+    }
+    if (!strcmp(optarg, "nv12")) {
+        *format = SC_V4L2_FORMAT_NV12;
+        return true;
+    }
+    if (!strcmp(optarg, "yuyv")) {
+        *format = SC_V4L2_FORMAT_YUYV;
+        return true;
+    }
+    LOGE("Unsupported v4l2 format: %s (expected yuv420, nv12 or yuyv)",
+         optarg);
+    return false;
+}
+#endif
+
 #define OPT_RENDER_EXPIRED_FRAMES  1000
 #define OPT_WINDOW_TITLE           1001
 #define OPT_PUSH_TARGET            1002
@@ -719,12 +865,26 @@ guess_record_format(const char *filename) {
 #define OPT_V4L2_SINK              1027
 #define OPT_DISPLAY_BUFFER         1028
 #define OPT_V4L2_BUFFER            1029
+#define OPT_RECORD_RAW             1030
+#define OPT_RECORD_RAW_PTS         1031
+#define OPT_RESTREAM               1032
+#define OPT_RESTREAM_FORMAT        1033
+#define OPT_V4L2_FORMAT            1034
+#define OPT_SHM_SINK               1035
+#define OPT_COALESCE_MOVES         1036
+#define OPT_RECORD_INPUT           1037
+#define OPT_REPLAY_INPUT           1038
+#define OPT_RTT_PROBE              1039
+#define OPT_RECONNECT              1040
+#define OPT_THREAD_CONFIG          1041
+#define OPT_METRICS_LISTEN         1042
 
 bool
 scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
     static const struct option long_options[] = {
         {"always-on-top",          no_argument,       NULL, OPT_ALWAYS_ON_TOP},
         {"bit-rate",               required_argument, NULL, 'b'},
+        {"coalesce-moves",         no_argument,       NULL, OPT_COALESCE_MOVES},
         {"codec-options",          required_argument, NULL, OPT_CODEC_OPTIONS},
         {"crop",                   required_argument, NULL, OPT_CROP},
         {"disable-screensaver",    no_argument,       NULL,
@@ -743,6 +903,8 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
                                                   OPT_LOCK_VIDEO_ORIENTATION},
         {"max-fps",                required_argument, NULL, OPT_MAX_FPS},
         {"max-size",               required_argument, NULL, 'm'},
+        {"metrics-listen",         required_argument, NULL,
+                                                  OPT_METRICS_LISTEN},
         {"no-control",             no_argument,       NULL, 'n'},
         {"no-display",             no_argument,       NULL, 'N'},
         {"no-key-repeat",          no_argument,       NULL, OPT_NO_KEY_REPEAT},
@@ -752,18 +914,32 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         {"push-target",            required_argument, NULL, OPT_PUSH_TARGET},
         {"record",                 required_argument, NULL, 'r'},
         {"record-format",          required_argument, NULL, OPT_RECORD_FORMAT},
+        {"record-input",           required_argument, NULL, OPT_RECORD_INPUT},
+        {"record-raw",             required_argument, NULL, OPT_RECORD_RAW},
+        {"record-raw-pts",         required_argument, NULL, OPT_RECORD_RAW_PTS},
+        {"reconnect",              required_argument, NULL, OPT_RECONNECT},
         {"render-driver",          required_argument, NULL, OPT_RENDER_DRIVER},
         {"render-expired-frames",  no_argument,       NULL,
                                                   OPT_RENDER_EXPIRED_FRAMES},
+        {"replay-input",           required_argument, NULL, OPT_REPLAY_INPUT},
+        {"restream",               required_argument, NULL, OPT_RESTREAM},
+        {"restream-format",        required_argument, NULL,
+                                                  OPT_RESTREAM_FORMAT},
         {"rotation",               required_argument, NULL, OPT_ROTATION},
+        {"rtt-probe",              required_argument, NULL, OPT_RTT_PROBE},
         {"serial",                 required_argument, NULL, 's'},
         {"shortcut-mod",           required_argument, NULL, OPT_SHORTCUT_MOD},
         {"show-touches",           no_argument,       NULL, 't'},
         {"stay-awake",             no_argument,       NULL, 'w'},
+        {"thread-config",          required_argument, NULL, OPT_THREAD_CONFIG},
         {"turn-screen-off",        no_argument,       NULL, 'S'},
 #ifdef HAVE_V4L2
         {"v4l2-sink",              required_argument, NULL, OPT_V4L2_SINK},
         {"v4l2-buffer",            required_argument, NULL, OPT_V4L2_BUFFER},
+        {"v4l2-format",            required_argument, NULL, OPT_V4L2_FORMAT},
+#endif
+#ifdef HAVE_SHM_SINK
+        {"shm-sink",               required_argument, NULL, OPT_SHM_SINK},
 #endif
         {"verbosity",              required_argument, NULL, 'V'},
         {"version",                no_argument,       NULL, 'v'},
@@ -781,6 +957,9 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
 
     struct scrcpy_options *opts = &args->opts;
 
+    // --record-format applies to the preceding --record (or to the first one)
+    enum sc_record_format *record_format = &opts->record_format;
+
     optind = 0; // reset to start from the first argument in tests
 
     int c;
@@ -810,7 +989,7 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
                 LOGW("Deprecated option -F. Use --record-format instead.");
                 // fall through
             case OPT_RECORD_FORMAT:
-                if (!parse_record_format(optarg, &opts->record_format)) {
+                if (!parse_record_format(optarg, record_format)) {
                     return false;
                 }
                 break;
@@ -845,7 +1024,35 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
                 }
                 break;
             case 'r':
-                opts->record_filename = optarg;
+                if (!opts->record_filename) {
+                    opts->record_filename = optarg;
+                    record_format = &opts->record_format;
+                    break;
+                }
+                if (opts->extra_record_count == SC_MAX_EXTRA_RECORDS) {
+                    LOGE("Too many recordings (max %d)",
+                         1 + SC_MAX_EXTRA_RECORDS);
+                    return false;
+                }
+                struct sc_record *extra =
+                    &opts->extra_records[opts->extra_record_count++];
+                extra->filename = optarg;
+                extra->format = SC_RECORD_FORMAT_AUTO;
+                record_format = &extra->format;
+                break;
+            case OPT_RECORD_RAW:
+                opts->record_raw_filename = optarg;
+                break;
+            case OPT_RECORD_RAW_PTS:
+                opts->record_raw_pts_filename = optarg;
+                break;
+            case OPT_RESTREAM:
+                opts->restream_url = optarg;
+                break;
+            case OPT_RESTREAM_FORMAT:
+                if (!parse_restream_format(optarg, &opts->restream_format)) {
+                    return false;
+                }
                 break;
             case 's':
                 opts->serial = optarg;
@@ -949,6 +1156,33 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
             case OPT_POWER_OFF_ON_CLOSE:
                 opts->power_off_on_close = true;
                 break;
+            case OPT_COALESCE_MOVES:
+                opts->coalesce_moves = true;
+                break;
+            case OPT_RECORD_INPUT:
+                opts->record_input_filename = optarg;
+                break;
+            case OPT_REPLAY_INPUT:
+                opts->replay_input_filename = optarg;
+                break;
+            case OPT_RECONNECT:
+                if (!parse_reconnect_attempts(optarg,
+                                              &opts->reconnect_attempts)) {
+                    return false;
+                }
+                break;
+            case OPT_THREAD_CONFIG:
+                // parsed on start
+                opts->thread_config = optarg;
+                break;
+            case OPT_METRICS_LISTEN:
+                opts->metrics_listen = optarg;
+                break;
+            case OPT_RTT_PROBE:
+                if (!parse_buffering_time(optarg, &opts->rtt_probe_interval)) {
+                    return false;
+                }
+                break;
             case OPT_DISPLAY_BUFFER:
                 if (!parse_buffering_time(optarg, &opts->display_buffer)) {
                     return false;
@@ -963,6 +1197,16 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
                     return false;
                 }
                 break;
+            case OPT_V4L2_FORMAT:
+                if (!parse_v4l2_format(optarg, &opts->v4l2_format)) {
+                    return false;
+                }
+                break;
+#endif
+#ifdef HAVE_SHM_SINK
+            case OPT_SHM_SINK:
+                opts->shm_name = optarg;
+                break;
 #endif
             default:
                 // getopt prints the error message on stderr
@@ -970,10 +1214,39 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         }
     }
 
+    if (opts->record_raw_pts_filename && !opts->record_raw_filename) {
+        LOGE("Raw stream PTS file specified without raw stream dump");
+        return false;
+    }
+
+    if (opts->record_raw_filename) {
+        // The raw stream dump consumes the video socket directly, so no other
+        // video output may be enabled
+        bool other_output = opts->display || opts->record_filename
+                         || opts->restream_url || opts->shm_name;
 #ifdef HAVE_V4L2
-    if (!opts->display && !opts->record_filename && !opts->v4l2_device) {
-        LOGE("-N/--no-display requires either screen recording (-r/--record)"
-             " or sink to v4l2loopback device (--v4l2-sink)");
+        other_output |= !!opts->v4l2_device;
+#endif
+        if (other_output) {
+            LOGE("Raw stream dump (--record-raw) requires -N/--no-display, "
+                 "and is incompatible with any other video output");
+            return false;
+        }
+
+        if (opts->reconnect_attempts) {
+            LOGE("Raw stream dump (--record-raw) does not support "
+                 "--reconnect");
+            return false;
+        }
+    }
+
+#ifdef HAVE_V4L2
+    if (!opts->display && !opts->record_filename && !opts->v4l2_device
+            && !opts->record_raw_filename && !opts->restream_url
+            && !opts->shm_name) {
+        LOGE("-N/--no-display requires either screen recording (-r/--record),"
+             " restreaming (--restream), shared memory sink (--shm-sink) or"
+             " sink to v4l2loopback device (--v4l2-sink)");
         return false;
     }
 
@@ -988,9 +1261,17 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         LOGE("V4L2 buffer value without V4L2 sink\n");
         return false;
     }
+
+    if (opts->v4l2_format != SC_V4L2_FORMAT_YUV420 && !opts->v4l2_device) {
+        LOGE("V4L2 format without V4L2 sink");
+        return false;
+    }
 #else
-    if (!opts->display && !opts->record_filename) {
-        LOGE("-N/--no-display requires screen recording (-r/--record)");
+    if (!opts->display && !opts->record_filename
+            && !opts->record_raw_filename && !opts->restream_url
+            && !opts->shm_name) {
+        LOGE("-N/--no-display requires either screen recording (-r/--record)"
+             " or restreaming (--restream)");
         return false;
     }
 #endif
@@ -1001,6 +1282,11 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         return false;
     }
 
+    if (opts->restream_format && !opts->restream_url) {
+        LOGE("Restream format specified without restreaming");
+        return false;
+    }
+
     if (opts->record_format && !opts->record_filename) {
         LOGE("Record format specified without recording");
         return false;
@@ -1016,6 +1302,18 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         }
     }
 
+    for (unsigned i = 0; i < opts->extra_record_count; ++i) {
+        struct sc_record *extra = &opts->extra_records[i];
+        if (!extra->format) {
+            extra->format = guess_record_format(extra->filename);
+            if (!extra->format) {
+                LOGE("No format specified for \"%s\" "
+                     "(try with --record-format=mkv)", extra->filename);
+                return false;
+            }
+        }
+    }
+
     if (!opts->control && opts->turn_screen_off) {
         LOGE("Could not request to turn screen off if control is disabled");
         return false;
@@ -1026,5 +1324,20 @@ scrcpy_parse_args(struct scrcpy_cli_args *args, int argc, char *argv[]) {
         return false;
     }
 
+    if (!opts->control && opts->record_input_filename) {
+        LOGE("Could not record input events if control is disabled");
+        return false;
+    }
+
+    if (!opts->control && opts->replay_input_filename) {
+        LOGE("Could not replay input events if control is disabled");
+        return false;
+    }
+
+    if (!opts->control && opts->rtt_probe_interval) {
+        LOGE("Could not probe the round-trip time if control is disabled");
+        return false;
+    }
+
     return true;
 }
@@ -7,10 +7,16 @@
 
 #define DEFAULT_BIT_RATE 8000000
 
+#define DEFAULT_GESTURE_RATE 120
+
 #define DEFAULT_LOCAL_PORT_RANGE_FIRST 27183
 
 #define DEFAULT_LOCAL_PORT_RANGE_LAST 27199
 
+#define HAVE_SHM_SINK
+
+#define HAVE_SPLICE
+
 #define HAVE_STRDUP
 
 #define HAVE_V4L2
@@ -82,6 +82,134 @@ to_fixed_point_16(float f) {
     return (uint16_t) u;
 }
 
+static void
+read_position(const uint8_t *buf, struct position *position) {
+    position->point.x = buffer_read32be(&buf[0]);
+    position->point.y = buffer_read32be(&buf[4]);
+    position->screen_size.width = buffer_read16be(&buf[8]);
+    position->screen_size.height = buffer_read16be(&buf[10]);
+}
+
+static float
+from_fixed_point_16(uint16_t u) {
+    // 0xffff is the serialized value of 1.0f
+    return u == 0xffff ? 1.0f : u / 0x1p16f;
+}
+
+// read length (4 bytes) + string (non nul-terminated) into an allocated string
+//
+// return the number of bytes consumed (0 for no string available, -1 on error)
+static ssize_t
+read_string(const unsigned char *buf, size_t len, size_t max_len,
+            char **out) {
+    if (len < 4) {
+        return 0;
+    }
+    size_t str_len = buffer_read32be(buf);
+    if (str_len > max_len) {
+        LOGW("Invalid string length: %" PRIu32, (uint32_t) str_len);
+        return -1;
+    }
+    if (str_len > len - 4) {
+        return 0;
+    }
+    char *str = malloc(str_len + 1);
+    if (!str) {
+        LOGW("Could not allocate string");
+        return -1;
+    }
+    memcpy(str, &buf[4], str_len);
+    str[str_len] = '\0';
+    *out = str;
+    return 4 + str_len;
+}
+
+ssize_t
+control_msg_deserialize(const unsigned char *buf, size_t len,
+                        struct control_msg *msg) {
+    if (!len) {
+        return 0;
+    }
+
+    msg->type = buf[0];
+    switch (msg->type) {
+        case CONTROL_MSG_TYPE_INJECT_KEYCODE:
+            if (len < 14) {
+                return 0;
+            }
+            msg->inject_keycode.action = buf[1];
+            msg->inject_keycode.keycode = buffer_read32be(&buf[2]);
+            msg->inject_keycode.repeat = buffer_read32be(&buf[6]);
+            msg->inject_keycode.metastate = buffer_read32be(&buf[10]);
+            return 14;
+        case CONTROL_MSG_TYPE_INJECT_TEXT: {
+            ssize_t r = read_string(&buf[1], len - 1,
+                                    CONTROL_MSG_INJECT_TEXT_MAX_LENGTH,
+                                    &msg->inject_text.text);
+            return r <= 0 ? r : 1 + r;
+        }
+        case CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            if (len < 28) {
+                return 0;
+            }
+            msg->inject_touch_event.action = buf[1];
+            msg->inject_touch_event.pointer_id = buffer_read64be(&buf[2]);
+            read_position(&buf[10], &msg->inject_touch_event.position);
+            msg->inject_touch_event.pressure =
+                from_fixed_point_16(buffer_read16be(&buf[22]));
+            msg->inject_touch_event.buttons = buffer_read32be(&buf[24]);
+            return 28;
+        case CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+            if (len < 21) {
+                return 0;
+            }
+            read_position(&buf[1], &msg->inject_scroll_event.position);
+            msg->inject_scroll_event.hscroll =
+                (int32_t) buffer_read32be(&buf[13]);
+            msg->inject_scroll_event.vscroll =
+                (int32_t) buffer_read32be(&buf[17]);
+            return 21;
+        case CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
+            if (len < 2) {
+                return 0;
+            }
+            msg->back_or_screen_on.action = buf[1];
+            return 2;
+        case CONTROL_MSG_TYPE_SET_CLIPBOARD: {
+            if (len < 2) {
+                return 0;
+            }
+            msg->set_clipboard.paste = !!buf[1];
+            ssize_t r = read_string(&buf[2], len - 2,
+                                    CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH,
+                                    &msg->set_clipboard.text);
+            return r <= 0 ? r : 2 + r;
+        }
+        case CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
+            if (len < 2) {
+                return 0;
+            }
+            msg->set_screen_power_mode.mode = buf[1];
+            return 2;
+        case CONTROL_MSG_TYPE_PING:
+            if (len < 9) {
+                return 0;
+            }
+            msg->ping.timestamp = buffer_read64be(&buf[1]);
+            return 9;
+        case CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
+        case CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
+        case CONTROL_MSG_TYPE_COLLAPSE_PANELS:
+        case CONTROL_MSG_TYPE_GET_CLIPBOARD:
+        case CONTROL_MSG_TYPE_ROTATE_DEVICE:
+            // no additional data
+            return 1;
+        default:
+            LOGW("Unknown message type: %u", (unsigned) msg->type);
+            return -1; // error, we cannot recover
+    }
+}
+
 size_t
 control_msg_serialize(const struct control_msg *msg, unsigned char *buf) {
     buf[0] = msg->type;
@@ -127,6 +255,9 @@ control_msg_serialize(const struct control_msg *msg, unsigned char *buf) {
         case CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
             buf[1] = msg->set_screen_power_mode.mode;
             return 2;
+        case CONTROL_MSG_TYPE_PING:
+            buffer_write64be(&buf[1], msg->ping.timestamp);
+            return 9;
         case CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
         case CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
         case CONTROL_MSG_TYPE_COLLAPSE_PANELS:
@@ -222,6 +353,9 @@ control_msg_log(const struct control_msg *msg) {
         case CONTROL_MSG_TYPE_ROTATE_DEVICE:
             LOG_CMSG("rotate device");
             break;
+        case CONTROL_MSG_TYPE_PING:
+            LOG_CMSG("ping %" PRIu64_, msg->ping.timestamp);
+            break;
         default:
             LOG_CMSG("unknown type: %u", (unsigned) msg->type);
             break;
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "android/input.h"
 #include "android/keycodes.h"
@@ -19,6 +20,8 @@
 
 #define POINTER_ID_MOUSE UINT64_C(-1)
 #define POINTER_ID_VIRTUAL_FINGER UINT64_C(-2)
+// Fingers of the gestures generated natively (see gesture.h), i >= 0
+#define POINTER_ID_GESTURE(i) (UINT64_C(-3) - (i))
 
 enum control_msg_type {
     CONTROL_MSG_TYPE_INJECT_KEYCODE,
@@ -33,6 +36,8 @@ enum control_msg_type {
     CONTROL_MSG_TYPE_SET_CLIPBOARD,
     CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE,
     CONTROL_MSG_TYPE_ROTATE_DEVICE,
+    // echoed back by the server as DEVICE_MSG_TYPE_PONG
+    CONTROL_MSG_TYPE_PING,
 };
 
 enum screen_power_mode {
@@ -76,6 +81,9 @@ struct control_msg {
         struct {
             enum screen_power_mode mode;
         } set_screen_power_mode;
+        struct {
+            uint64_t timestamp; // opaque for the device
+        } ping;
     };
 };
 
@@ -84,6 +92,14 @@ struct control_msg {
 size_t
 control_msg_serialize(const struct control_msg *msg, unsigned char *buf);
 
+// Parse a message serialized by control_msg_serialize() (used to replay input
+// traces)
+//
+// return the number of bytes consumed (0 for no msg available, -1 on error)
+ssize_t
+control_msg_deserialize(const unsigned char *buf, size_t len,
+                        struct control_msg *msg);
+
 void
 control_msg_log(const struct control_msg *msg);
 
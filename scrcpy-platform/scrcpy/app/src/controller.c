@@ -1,46 +1,70 @@
 #include "controller.h"
 
-#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "util/log.h"
 
 bool
-controller_init(struct controller *controller, socket_t control_socket) {
-    cbuf_init(&controller->queue);
-
-    bool ok = receiver_init(&controller->receiver, control_socket);
-    if (!ok) {
+controller_init(struct controller *controller, socket_t control_socket,
+                bool coalesce_moves,
+                const struct receiver_callbacks *receiver_cbs,
+                void *receiver_cbs_userdata) {
+    // a message may be serialized as long as the batch is not full
+    controller->batch = malloc(CONTROLLER_BATCH_SIZE + CONTROL_MSG_MAX_SIZE);
+    if (!controller->batch) {
+        LOGC("Could not allocate control batch");
         return false;
     }
 
-    ok = sc_mutex_init(&controller->mutex);
+    bool ok = receiver_init(&controller->receiver, control_socket,
+                            receiver_cbs, receiver_cbs_userdata);
     if (!ok) {
-        receiver_destroy(&controller->receiver);
-        return false;
+        goto error_free_batch;
     }
 
-    ok = sc_cond_init(&controller->msg_cond);
+    // If the device does not keep up, fail immediately rather than blocking
+    // the input thread
+    ok = sc_mpsc_init(&controller->queue, sizeof(struct control_msg),
+                      CONTROLLER_QUEUE_SIZE, SC_MPSC_OVERFLOW_FAIL);
     if (!ok) {
-        receiver_destroy(&controller->receiver);
-        sc_mutex_destroy(&controller->mutex);
-        return false;
+        goto error_destroy_receiver;
     }
 
     controller->control_socket = control_socket;
-    controller->stopped = false;
+    controller->coalesce_moves = coalesce_moves;
+    controller->trace = NULL;
+    controller->rtt_probe_interval = 0;
+    controller->batch_len = 0;
+
+    memset(&controller->last_stats, 0, sizeof(controller->last_stats));
+    controller->last_stats_tick = sc_tick_now();
+    controller->last_send_tick = controller->last_stats_tick;
+    atomic_init(&controller->stats.msgs, 0);
+    atomic_init(&controller->stats.coalesced, 0);
+    atomic_init(&controller->stats.bytes, 0);
+    atomic_init(&controller->stats.flushes, 0);
 
     return true;
+
+error_destroy_receiver:
+    receiver_destroy(&controller->receiver);
+error_free_batch:
+    free(controller->batch);
+
+    return false;
 }
 
 void
 controller_destroy(struct controller *controller) {
-    sc_cond_destroy(&controller->msg_cond);
-    sc_mutex_destroy(&controller->mutex);
+    free(controller->batch);
 
     struct control_msg msg;
-    while (cbuf_take(&controller->queue, &msg)) {
+    while (sc_mpsc_take(&controller->queue, &msg)) {
         control_msg_destroy(&msg);
     }
+    sc_mpsc_destroy(&controller->queue);
 
     receiver_destroy(&controller->receiver);
 }
@@ -52,26 +76,201 @@ controller_push_msg(struct controller *controller,
         control_msg_log(msg);
     }
 
-    sc_mutex_lock(&controller->mutex);
-    bool was_empty = cbuf_is_empty(&controller->queue);
-    bool res = cbuf_push(&controller->queue, *msg);
-    if (was_empty) {
-        sc_cond_signal(&controller->msg_cond);
+    if (!controller->trace) {
+        return sc_mpsc_push(&controller->queue, msg);
+    }
+
+    // Serialize the message before the push (the controller thread may free
+    // its text), but record it only if the push succeeds
+    sc_input_trace_writer_lock(controller->trace);
+    sc_input_trace_writer_add(controller->trace, msg);
+    bool ok = sc_mpsc_push(&controller->queue, msg);
+    sc_input_trace_writer_unlock(controller->trace, ok);
+
+    return ok;
+}
+
+bool
+controller_push_msgs(struct controller *controller,
+                     const struct control_msg *msgs, size_t count) {
+    if (sc_get_log_level() <= SC_LOG_LEVEL_VERBOSE) {
+        for (size_t i = 0; i < count; ++i) {
+            control_msg_log(&msgs[i]);
+        }
+    }
+
+    if (!controller->trace) {
+        return sc_mpsc_push_n(&controller->queue, msgs, count);
+    }
+
+    sc_input_trace_writer_lock(controller->trace);
+    for (size_t i = 0; i < count; ++i) {
+        sc_input_trace_writer_add(controller->trace, &msgs[i]);
     }
-    sc_mutex_unlock(&controller->mutex);
-    return res;
+    bool ok = sc_mpsc_push_n(&controller->queue, msgs, count);
+    sc_input_trace_writer_unlock(controller->trace, ok);
+
+    return ok;
+}
+
+bool
+controller_ping(struct controller *controller) {
+    struct control_msg msg;
+    msg.type = CONTROL_MSG_TYPE_PING;
+    // the timestamp is set on serialization, so that the time spent in the
+    // queue is not measured
+    msg.ping.timestamp = 0;
+
+    return controller_push_msg(controller, &msg);
+}
+
+void
+controller_get_rtt(struct controller *controller,
+                   struct sc_histogram_snapshot *rtt) {
+    sc_histogram_snapshot(&controller->receiver.rtt, rtt);
+}
+
+void
+controller_get_stats(struct controller *controller,
+                     struct controller_stats *stats) {
+    stats->msgs = atomic_load_explicit(&controller->stats.msgs,
+                                       memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&controller->stats.coalesced,
+                                            memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&controller->stats.bytes,
+                                        memory_order_relaxed);
+    stats->flushes = atomic_load_explicit(&controller->stats.flushes,
+                                          memory_order_relaxed);
+}
+
+static inline void
+add_stat(atomic_uint_least64_t *stat, uint64_t value) {
+    atomic_fetch_add_explicit(stat, value, memory_order_relaxed);
+}
+
+static void
+log_rates(struct controller *controller) {
+    sc_tick now = sc_tick_now();
+    sc_tick elapsed = now - controller->last_stats_tick;
+    if (elapsed < SC_TICK_FROM_SEC(1)) {
+        return;
+    }
+
+    struct controller_stats stats;
+    controller_get_stats(controller, &stats);
+    struct controller_stats *last = &controller->last_stats;
+
+    float sec = (float) elapsed / SC_TICK_FREQ;
+    LOGV("Control: %.1f msg/s, %.1f bytes/s, %.1f flushes/s "
+         "(%" PRIu64 " moves coalesced)",
+         (stats.msgs - last->msgs) / sec, (stats.bytes - last->bytes) / sec,
+         (stats.flushes - last->flushes) / sec,
+         stats.coalesced - last->coalesced);
+
+    *last = stats;
+    controller->last_stats_tick = now;
+}
+
+static inline bool
+is_move(const struct control_msg *msg) {
+    return msg->type == CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT
+        && msg->inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE;
 }
 
 static bool
-process_msg(struct controller *controller,
-              const struct control_msg *msg) {
-    static unsigned char serialized_msg[CONTROL_MSG_MAX_SIZE];
-    size_t length = control_msg_serialize(msg, serialized_msg);
-    if (!length) {
-        return false;
+can_coalesce(const struct control_msg *prev, const struct control_msg *msg) {
+    return is_move(prev) && is_move(msg)
+        && prev->inject_touch_event.pointer_id
+            == msg->inject_touch_event.pointer_id
+        && prev->inject_touch_event.buttons
+            == msg->inject_touch_event.buttons;
+}
+
+// Merge consecutive MOVE events for the same pointer into the latest one
+//
+// Return the new number of messages.
+static size_t
+coalesce_moves(struct control_msg *msgs, size_t count) {
+    size_t j = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (j && can_coalesce(&msgs[j - 1], &msgs[i])) {
+            // a touch event owns no resources, it may just be replaced
+            msgs[j - 1] = msgs[i];
+        } else {
+            msgs[j++] = msgs[i];
+        }
+    }
+    return j;
+}
+
+static bool
+flush_batch(struct controller *controller) {
+    size_t len = controller->batch_len;
+    if (!len) {
+        return true;
+    }
+
+    controller->batch_len = 0;
+    controller->last_send_tick = sc_tick_now();
+
+    ssize_t w = net_send_all(controller->control_socket, controller->batch,
+                             len);
+    add_stat(&controller->stats.flushes, 1);
+    if (w > 0) {
+        add_stat(&controller->stats.bytes, w);
+    }
+    return (size_t) w == len;
+}
+
+static bool
+process_msgs(struct controller *controller, struct control_msg *msgs,
+             size_t count) {
+    if (controller->coalesce_moves) {
+        size_t new_count = coalesce_moves(msgs, count);
+        add_stat(&controller->stats.coalesced, count - new_count);
+        count = new_count;
+    }
+
+    bool ok = true;
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        if (controller->batch_len >= CONTROLLER_BATCH_SIZE) {
+            ok = flush_batch(controller);
+            if (!ok) {
+                break;
+            }
+        }
+
+        if (msgs[i].type == CONTROL_MSG_TYPE_PING) {
+            msgs[i].ping.timestamp = sc_tick_now();
+        }
+
+        // the batch buffer has always room for CONTROL_MSG_MAX_SIZE bytes
+        unsigned char *buf = controller->batch + controller->batch_len;
+        size_t length = control_msg_serialize(&msgs[i], buf);
+        if (!length) {
+            ok = false;
+            break;
+        }
+        controller->batch_len += length;
+        control_msg_destroy(&msgs[i]);
+    }
+
+    if (ok) {
+        add_stat(&controller->stats.msgs, count);
+        ok = flush_batch(controller);
+    } else {
+        // destroy the remaining messages
+        for (; i < count; ++i) {
+            control_msg_destroy(&msgs[i]);
+        }
     }
-    ssize_t w = net_send_all(controller->control_socket, serialized_msg, length);
-    return (size_t) w == length;
+
+    if (sc_get_log_level() <= SC_LOG_LEVEL_VERBOSE) {
+        log_rates(controller);
+    }
+
+    return ok;
 }
 
 static int
@@ -79,23 +278,35 @@ run_controller(void *data) {
     struct controller *controller = data;
 
     for (;;) {
-        sc_mutex_lock(&controller->mutex);
-        while (!controller->stopped && cbuf_is_empty(&controller->queue)) {
-            sc_cond_wait(&controller->msg_cond, &controller->mutex);
+        struct control_msg msgs[CONTROLLER_BATCH_MSGS];
+        sc_tick deadline = controller->rtt_probe_interval
+                         ? controller->last_send_tick
+                                + controller->rtt_probe_interval
+                         : SC_MPSC_NO_DEADLINE;
+        if (!sc_mpsc_take_timedwait(&controller->queue, &msgs[0],
+                                    deadline)) {
+            if (sc_mpsc_is_interrupted(&controller->queue)) {
+                // stopped, do not process further msgs
+                break;
+            }
+
+            // idle, probe the round-trip time
+            msgs[0].type = CONTROL_MSG_TYPE_PING;
+            if (!process_msgs(controller, msgs, 1)) {
+                LOGD("Could not write msg to socket");
+                break;
+            }
+            continue;
         }
-        if (controller->stopped) {
-            // stop immediately, do not process further msgs
-            sc_mutex_unlock(&controller->mutex);
-            break;
+
+        // take all the other queued messages, to send them at once
+        size_t count = 1;
+        while (count < CONTROLLER_BATCH_MSGS
+                && sc_mpsc_take(&controller->queue, &msgs[count])) {
+            ++count;
         }
-        struct control_msg msg;
-        bool non_empty = cbuf_take(&controller->queue, &msg);
-        assert(non_empty);
-        (void) non_empty;
-        sc_mutex_unlock(&controller->mutex);
 
-        bool ok = process_msg(controller, &msg);
-        control_msg_destroy(&msg);
+        bool ok = process_msgs(controller, msgs, count);
         if (!ok) {
             LOGD("Could not write msg to socket");
             break;
@@ -126,10 +337,7 @@ controller_start(struct controller *controller) {
 
 void
 controller_stop(struct controller *controller) {
-    sc_mutex_lock(&controller->mutex);
-    controller->stopped = true;
-    sc_cond_signal(&controller->msg_cond);
-    sc_mutex_unlock(&controller->mutex);
+    sc_mpsc_interrupt(&controller->queue);
 }
 
 void
@@ -137,3 +345,19 @@ controller_join(struct controller *controller) {
     sc_thread_join(&controller->thread, NULL);
     receiver_join(&controller->receiver);
 }
+
+bool
+controller_restart(struct controller *controller, socket_t control_socket) {
+    struct control_msg msg;
+    while (sc_mpsc_take(&controller->queue, &msg)) {
+        control_msg_destroy(&msg);
+    }
+    sc_mpsc_resume(&controller->queue);
+
+    controller->control_socket = control_socket;
+    controller->batch_len = 0;
+    controller->last_send_tick = sc_tick_now();
+    receiver_reset(&controller->receiver, control_socket);
+
+    return controller_start(controller);
+}
@@ -3,28 +3,75 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "control_msg.h"
+#include "input_trace.h"
 #include "receiver.h"
-#include "util/cbuf.h"
+#include "util/mpsc.h"
 #include "util/net.h"
 #include "util/thread.h"
+#include "util/tick.h"
 
-struct control_msg_queue CBUF(struct control_msg, 64);
+#define CONTROLLER_QUEUE_SIZE 256
+
+// Maximum number of messages taken from the queue at once
+#define CONTROLLER_BATCH_MSGS 64
+
+// Serialized messages are accumulated until this size is reached, then sent
+// at once
+#define CONTROLLER_BATCH_SIZE 4096
+
+struct controller_stats {
+    uint64_t msgs; // messages sent (after coalescing)
+    uint64_t coalesced; // MOVE events merged into a later one
+    uint64_t bytes;
+    // batches flushed (each is sent by at least one send() call, more on
+    // partial writes)
+    uint64_t flushes;
+};
 
 struct controller {
     socket_t control_socket;
     sc_thread thread;
-    sc_mutex mutex;
-    sc_cond msg_cond;
-    bool stopped;
-    struct control_msg_queue queue;
+    bool coalesce_moves;
+    // if set (before controller_start()), every pushed message is recorded
+    struct sc_input_trace_writer *trace;
+    // if set (before controller_start()), send a ping whenever nothing has
+    // been sent for this duration
+    sc_tick rtt_probe_interval;
+    // lock-free: messages may be pushed from any thread without contention
+    struct sc_mpsc queue;
     struct receiver receiver;
+
+    // accessed only from the controller thread
+    unsigned char *batch; // CONTROLLER_BATCH_SIZE + CONTROL_MSG_MAX_SIZE
+    size_t batch_len;
+    sc_tick last_send_tick;
+    struct controller_stats last_stats; // at the last rates log
+    sc_tick last_stats_tick;
+
+    // written by the controller thread, may be read from any thread
+    struct {
+        atomic_uint_least64_t msgs;
+        atomic_uint_least64_t coalesced;
+        atomic_uint_least64_t bytes;
+        atomic_uint_least64_t flushes;
+    } stats;
 };
 
+// If coalesce_moves is set, consecutive AMOTION_EVENT_ACTION_MOVE touch events
+// for the same pointer, queued while the previous batch was being sent, are
+// merged into the latest one
+//
+// The device messages are forwarded to receiver_cbs.
 bool
-controller_init(struct controller *controller, socket_t control_socket);
+controller_init(struct controller *controller, socket_t control_socket,
+                bool coalesce_moves,
+                const struct receiver_callbacks *receiver_cbs,
+                void *receiver_cbs_userdata);
 
 void
 controller_destroy(struct controller *controller);
@@ -38,8 +85,39 @@ controller_stop(struct controller *controller);
 void
 controller_join(struct controller *controller);
 
+// Restart the controller on a new connection, after controller_stop() and
+// controller_join()
+//
+// The messages queued before the interruption are discarded (they are
+// obsolete), the statistics and round-trip times are kept.
+bool
+controller_restart(struct controller *controller, socket_t control_socket);
+
 bool
 controller_push_msg(struct controller *controller,
                     const struct control_msg *msg);
 
+// Push count messages atomically (all or none, never interleaved with
+// messages from other threads), with a single wakeup of the controller thread
+//
+// count must not exceed CONTROLLER_QUEUE_SIZE.
+bool
+controller_push_msgs(struct controller *controller,
+                     const struct control_msg *msgs, size_t count);
+
+// Request a round-trip time measurement (the server echoes the ping)
+bool
+controller_ping(struct controller *controller);
+
+// Get the round-trip times measured so far, in microseconds (may be called
+// from any thread)
+void
+controller_get_rtt(struct controller *controller,
+                   struct sc_histogram_snapshot *rtt);
+
+// Get the cumulative statistics (may be called from any thread)
+void
+controller_get_stats(struct controller *controller,
+                     struct controller_stats *stats);
+
 #endif
@@ -18,37 +18,89 @@ decoder_close_first_sinks(struct decoder *decoder, unsigned count) {
     }
 }
 
-static inline void
+static void
 decoder_close_sinks(struct decoder *decoder) {
+    sc_mutex_lock(&decoder->mutex);
     decoder_close_first_sinks(decoder, decoder->sink_count);
+    decoder->sinks_opened = false;
+    sc_mutex_unlock(&decoder->mutex);
 }
 
 static bool
 decoder_open_sinks(struct decoder *decoder) {
+    sc_mutex_lock(&decoder->mutex);
     for (unsigned i = 0; i < decoder->sink_count; ++i) {
         struct sc_frame_sink *sink = decoder->sinks[i];
         if (!sink->ops->open(sink)) {
             LOGE("Could not open frame sink %d", i);
             decoder_close_first_sinks(decoder, i);
+            sc_mutex_unlock(&decoder->mutex);
             return false;
         }
     }
+    decoder->sinks_opened = true;
+    sc_mutex_unlock(&decoder->mutex);
 
     return true;
 }
 
-static bool
-decoder_open(struct decoder *decoder, const AVCodec *codec) {
-    decoder->codec_ctx = avcodec_alloc_context3(codec);
-    if (!decoder->codec_ctx) {
+static AVCodecContext *
+open_codec(const AVCodec *codec) {
+    AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+    if (!codec_ctx) {
         LOGC("Could not allocate decoder context");
-        return false;
+        return NULL;
     }
 
-    if (avcodec_open2(decoder->codec_ctx, codec, NULL) < 0) {
+    if (avcodec_open2(codec_ctx, codec, NULL) < 0) {
         LOGE("Could not open codec");
-        avcodec_free_context(&decoder->codec_ctx);
-        return false;
+        avcodec_free_context(&codec_ctx);
+        return NULL;
+    }
+
+    return codec_ctx;
+}
+
+static int
+run_preopen(void *data) {
+    struct decoder *decoder = data;
+
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    if (codec) {
+        decoder->preopened_ctx = open_codec(codec);
+    }
+
+    return 0;
+}
+
+void
+decoder_preopen(struct decoder *decoder) {
+    assert(!decoder->preopen_started);
+    decoder->preopen_started =
+        sc_thread_create(&decoder->preopen_thread, run_preopen,
+                         "decoder-open", decoder);
+}
+
+static void
+decoder_join_preopen(struct decoder *decoder) {
+    if (decoder->preopen_started) {
+        sc_thread_join(&decoder->preopen_thread, NULL);
+        decoder->preopen_started = false;
+    }
+}
+
+static bool
+decoder_open(struct decoder *decoder, const AVCodec *codec) {
+    decoder_join_preopen(decoder);
+    if (decoder->preopened_ctx) {
+        // the stream always uses the H.264 decoder
+        decoder->codec_ctx = decoder->preopened_ctx;
+        decoder->preopened_ctx = NULL;
+    } else {
+        decoder->codec_ctx = open_codec(codec);
+        if (!decoder->codec_ctx) {
+            return false;
+        }
     }
 
     decoder->frame = av_frame_alloc();
@@ -80,13 +132,18 @@ decoder_close(struct decoder *decoder) {
 
 static bool
 push_frame_to_sinks(struct decoder *decoder, const AVFrame *frame) {
+    sc_mutex_lock(&decoder->mutex);
     for (unsigned i = 0; i < decoder->sink_count; ++i) {
         struct sc_frame_sink *sink = decoder->sinks[i];
         if (!sink->ops->push(sink, frame)) {
-            LOGE("Could not send frame to sink %d", i);
+            sc_mutex_unlock(&decoder->mutex);
+            LOG_RATELIMITED(LOGE, SC_TICK_FROM_SEC(1),
+                            "Could not send frame to sink %d", i);
             return false;
         }
+        sc_metrics_add_sink_frame(decoder->metrics, i);
     }
+    sc_mutex_unlock(&decoder->mutex);
 
     return true;
 }
@@ -99,14 +156,25 @@ decoder_push(struct decoder *decoder, const AVPacket *packet) {
         return true;
     }
 
+    sc_tick start = sc_tick_now();
     int ret = avcodec_send_packet(decoder->codec_ctx, packet);
     if (ret < 0 && ret != AVERROR(EAGAIN)) {
         LOGE("Could not send video packet: %d", ret);
         return false;
     }
     ret = avcodec_receive_frame(decoder->codec_ctx, decoder->frame);
+    if (decoder->metrics) {
+        sc_histogram_record(&decoder->metrics->decode_time,
+                            sc_tick_now() - start);
+    }
     if (!ret) {
         // a frame was received
+        sc_metrics_add(decoder->metrics, SC_METRIC_DECODED_FRAMES, 1);
+        if (!decoder_get_first_frame_tick(decoder)) {
+            atomic_store_explicit(&decoder->first_frame_tick, sc_tick_now(),
+                                  memory_order_relaxed);
+        }
+
         bool ok = push_frame_to_sinks(decoder, decoder->frame);
         // A frame lost should not make the whole pipeline fail. The error, if
         // any, is already logged.
@@ -138,9 +206,18 @@ decoder_packet_sink_push(struct sc_packet_sink *sink, const AVPacket *packet) {
     return decoder_push(decoder, packet);
 }
 
-void
+bool
 decoder_init(struct decoder *decoder) {
+    if (!sc_mutex_init(&decoder->mutex)) {
+        return false;
+    }
+
     decoder->sink_count = 0;
+    decoder->sinks_opened = false;
+    decoder->preopen_started = false;
+    decoder->preopened_ctx = NULL;
+    atomic_init(&decoder->first_frame_tick, 0);
+    decoder->metrics = NULL;
 
     static const struct sc_packet_sink_ops ops = {
         .open = decoder_packet_sink_open,
@@ -149,12 +226,43 @@ decoder_init(struct decoder *decoder) {
     };
 
     decoder->packet_sink.ops = &ops;
+
+    return true;
 }
 
-void
+bool
 decoder_add_sink(struct decoder *decoder, struct sc_frame_sink *sink) {
-    assert(decoder->sink_count < DECODER_MAX_SINKS);
     assert(sink);
     assert(sink->ops);
-    decoder->sinks[decoder->sink_count++] = sink;
+
+    sc_mutex_lock(&decoder->mutex);
+    unsigned i = decoder->sink_count;
+    if (i == DECODER_MAX_SINKS) {
+        sc_mutex_unlock(&decoder->mutex);
+        LOGE("Too many frame sinks");
+        return false;
+    }
+
+    if (decoder->sinks_opened && !sink->ops->open(sink)) {
+        sc_mutex_unlock(&decoder->mutex);
+        LOGE("Could not open frame sink %u", i);
+        return false;
+    }
+
+    decoder->sinks[i] = sink;
+    decoder->sink_count = i + 1;
+    sc_mutex_unlock(&decoder->mutex);
+
+    return true;
+}
+
+void
+decoder_destroy(struct decoder *decoder) {
+    decoder_join_preopen(decoder);
+    if (decoder->preopened_ctx) {
+        // the stream never started
+        avcodec_close(decoder->preopened_ctx);
+        avcodec_free_context(&decoder->preopened_ctx);
+    }
+    sc_mutex_destroy(&decoder->mutex);
 }
@@ -5,25 +5,64 @@
 
 #include "trait/packet_sink.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <libavformat/avformat.h>
 
+#include "metrics.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
 #define DECODER_MAX_SINKS 5
 
 struct decoder {
     struct sc_packet_sink packet_sink; // packet sink trait
 
+    // the sinks may be added while the decoder thread pushes frames to them
+    sc_mutex mutex;
     struct sc_frame_sink *sinks[DECODER_MAX_SINKS];
     unsigned sink_count;
+    bool sinks_opened;
 
     AVCodecContext *codec_ctx;
     AVFrame *frame;
+
+    // the codec may be opened in advance, see decoder_preopen()
+    sc_thread preopen_thread;
+    bool preopen_started;
+    AVCodecContext *preopened_ctx;
+
+    atomic_int_least64_t first_frame_tick; // 0 until the first frame
+
+    struct sc_metrics *metrics; // optional, set before the stream starts
 };
 
-void
+bool
 decoder_init(struct decoder *decoder);
 
+// Open the H.264 codec from a separate thread, to be used once the stream
+// starts (so that the codec is opened while waiting for the device)
+//
+// Failures are not fatal: the codec is then opened on stream start.
 void
+decoder_preopen(struct decoder *decoder);
+
+void
+decoder_destroy(struct decoder *decoder);
+
+// Return the time of the first decoded frame, or 0 if none
+static inline sc_tick
+decoder_get_first_frame_tick(struct decoder *decoder) {
+    return atomic_load_explicit(&decoder->first_frame_tick,
+                                memory_order_relaxed);
+}
+
+// Add a frame sink, possibly while the stream is running (it is then opened
+// immediately)
+//
+// Return false if there are already DECODER_MAX_SINKS sinks, or if the sink
+// could not be opened.
+bool
 decoder_add_sink(struct decoder *decoder, struct sc_frame_sink *sink);
 
 #endif
@@ -1,48 +1,43 @@
 #include "device_msg.h"
 
-#include <stdlib.h>
-#include <string.h>
-
 #include "util/buffer_util.h"
 #include "util/log.h"
 
 ssize_t
 device_msg_deserialize(const unsigned char *buf, size_t len,
                        struct device_msg *msg) {
-    if (len < 5) {
-        // at least type + empty string length
+    if (!len) {
         return 0; // not available
     }
 
     msg->type = buf[0];
     switch (msg->type) {
         case DEVICE_MSG_TYPE_CLIPBOARD: {
-            size_t clipboard_len = buffer_read32be(&buf[1]);
-            if (clipboard_len > len - 5) {
+            if (len < 5) {
+                // at least type + empty string length
                 return 0; // not available
             }
-            char *text = malloc(clipboard_len + 1);
-            if (!text) {
-                LOGW("Could not allocate text for clipboard");
+            size_t clipboard_len = buffer_read32be(&buf[1]);
+            if (clipboard_len > DEVICE_MSG_TEXT_MAX_LENGTH) {
+                // it could never be received entirely
+                LOGW("Device clipboard text too large: %zu", clipboard_len);
                 return -1;
             }
-            if (clipboard_len) {
-                memcpy(text, &buf[5], clipboard_len);
+            if (clipboard_len > len - 5) {
+                return 0; // not available
             }
-            text[clipboard_len] = '\0';
-
-            msg->clipboard.text = text;
+            msg->clipboard.text = (const char *) &buf[5];
+            msg->clipboard.length = clipboard_len;
             return 5 + clipboard_len;
         }
+        case DEVICE_MSG_TYPE_PONG:
+            if (len < 9) {
+                return 0; // not available
+            }
+            msg->pong.timestamp = buffer_read64be(&buf[1]);
+            return 9;
         default:
             LOGW("Unknown device message type: %d", (int) msg->type);
             return -1; // error, we cannot recover
     }
 }
-
-void
-device_msg_destroy(struct device_msg *msg) {
-    if (msg->type == DEVICE_MSG_TYPE_CLIPBOARD) {
-        free(msg->clipboard.text);
-    }
-}
@@ -13,23 +13,30 @@
 
 enum device_msg_type {
     DEVICE_MSG_TYPE_CLIPBOARD,
+    // reply to CONTROL_MSG_TYPE_PING
+    DEVICE_MSG_TYPE_PONG,
 };
 
+// A device message is parsed in place: it does not own any data, its
+// payloads point directly into the buffer passed to device_msg_deserialize()
 struct device_msg {
     enum device_msg_type type;
     union {
         struct {
-            char *text; // owned, to be freed by free()
+            const char *text; // not NUL-terminated
+            size_t length;
         } clipboard;
+        struct {
+            uint64_t timestamp; // echoed from the ping
+        } pong;
     };
 };
 
 // return the number of bytes consumed (0 for no msg available, -1 on error)
+//
+// The message is valid as long as buf is not modified.
 ssize_t
 device_msg_deserialize(const unsigned char *buf, size_t len,
                        struct device_msg *msg);
 
-void
-device_msg_destroy(struct device_msg *msg);
-
 #endif
@@ -0,0 +1,312 @@
+#include "es_dump.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/buffer_util.h"
+#include "util/log.h"
+
+#define HEADER_SIZE 12
+
+// buffer size for the read()/write() fallback
+#define BUFSIZE 0x10000
+
+#ifdef HAVE_SPLICE
+// The pipe is only an intermediate kernel buffer: the larger it is, the fewer
+// splice() calls are necessary per packet
+# define PIPE_SIZE 0x100000
+#endif
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+static bool
+write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        ssize_t w = write(fd, buf, len);
+        if (w == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += w;
+        len -= w;
+    }
+    return true;
+}
+
+// Copy len bytes from the socket to the file through user space
+static bool
+copy_read_write(struct sc_es_dump *dump, uint8_t *buf, uint32_t len) {
+    while (len) {
+        ssize_t r = net_recv(dump->socket, buf, MIN(len, BUFSIZE));
+        if (r <= 0) {
+            // end of stream
+            return false;
+        }
+
+        if (!write_all(dump->fd, buf, r)) {
+            LOGE("Could not write to %s", dump->filename);
+            return false;
+        }
+
+        len -= r;
+    }
+
+    return true;
+}
+
+#ifdef HAVE_SPLICE
+// Move len bytes from the pipe to the file
+static bool
+drain_pipe(struct sc_es_dump *dump, int pipe_fd, size_t len, uint8_t *buf,
+           bool *use_splice) {
+    while (len) {
+        if (*use_splice) {
+            ssize_t w = splice(pipe_fd, NULL, dump->fd, NULL, len,
+                               SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (w > 0) {
+                len -= w;
+                continue;
+            }
+            if (w == -1 && errno == EINTR) {
+                continue;
+            }
+            if (w == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                // The target does not support splice(), the remaining bytes
+                // in the pipe must be copied manually
+                LOGW("Could not splice to %s, fallback to read()/write()",
+                     dump->filename);
+                *use_splice = false;
+                continue;
+            }
+            LOGE("Could not write to %s", dump->filename);
+            return false;
+        }
+
+        ssize_t r = read(pipe_fd, buf, MIN(len, BUFSIZE));
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            LOGE("Could not read from pipe");
+            return false;
+        }
+
+        if (!write_all(dump->fd, buf, r)) {
+            LOGE("Could not write to %s", dump->filename);
+            return false;
+        }
+
+        len -= r;
+    }
+
+    return true;
+}
+
+// Move len bytes from the socket to the file, without copying them to user
+// space
+static bool
+copy_splice(struct sc_es_dump *dump, int pipefd[2], uint32_t len,
+            uint8_t *buf, bool *use_splice) {
+    while (len) {
+        ssize_t r = splice(dump->socket, NULL, pipefd[1], NULL,
+                           MIN(len, PIPE_SIZE), SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+        if (r == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            // The socket does not support splice(), the pipe is empty: the
+            // remaining bytes must be copied manually
+            LOGW("Could not splice from the video socket, fallback to "
+                 "read()/write()");
+            *use_splice = false;
+            return copy_read_write(dump, buf, len);
+        }
+        if (r <= 0) {
+            // end of stream or I/O error
+            return false;
+        }
+
+        if (!drain_pipe(dump, pipefd[0], r, buf, use_splice)) {
+            return false;
+        }
+
+        len -= r;
+    }
+
+    return true;
+}
+#endif
+
+static int
+run_es_dump(void *data) {
+    struct sc_es_dump *dump = data;
+
+    uint8_t *buf = malloc(BUFSIZE);
+    if (!buf) {
+        LOGC("Could not allocate buffer");
+        goto end;
+    }
+
+#ifdef HAVE_SPLICE
+    int pipefd[2];
+    bool has_pipe = !pipe(pipefd);
+    if (has_pipe) {
+        if (fcntl(pipefd[1], F_SETPIPE_SZ, PIPE_SIZE) == -1) {
+            // not fatal, the default pipe size will be used
+            LOGD("Could not resize pipe");
+        }
+    } else {
+        LOGW("Could not create pipe, fallback to read()/write()");
+    }
+    bool use_splice = has_pipe;
+#endif
+
+    for (;;) {
+        // Only the header is read in user space (see stream_recv_packet())
+        uint8_t header[HEADER_SIZE];
+        ssize_t r = net_recv_all(dump->socket, header, HEADER_SIZE);
+        if (r < HEADER_SIZE) {
+            // end of stream
+            break;
+        }
+
+        uint32_t len = buffer_read32be(&header[8]);
+        assert(len);
+
+        if (dump->pts_file
+                && fwrite(header, HEADER_SIZE, 1, dump->pts_file) != 1) {
+            LOGE("Could not write to %s", dump->pts_filename);
+            break;
+        }
+
+        bool ok;
+#ifdef HAVE_SPLICE
+        if (use_splice) {
+            ok = copy_splice(dump, pipefd, len, buf, &use_splice);
+        } else
+#endif
+        {
+            ok = copy_read_write(dump, buf, len);
+        }
+
+        if (!ok) {
+            break;
+        }
+
+        dump->bytes_written += len;
+        ++dump->packets;
+    }
+
+    LOGD("End of raw stream (%llu packets, %llu bytes)",
+         (unsigned long long) dump->packets,
+         (unsigned long long) dump->bytes_written);
+
+#ifdef HAVE_SPLICE
+    if (has_pipe) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+    }
+#endif
+
+    free(buf);
+end:
+    dump->cbs->on_eos(dump, dump->cbs_userdata);
+
+    return 0;
+}
+
+bool
+sc_es_dump_init(struct sc_es_dump *dump, socket_t socket,
+                const char *filename, const char *pts_filename,
+                const struct sc_es_dump_callbacks *cbs, void *cbs_userdata) {
+    assert(filename);
+    assert(cbs && cbs->on_eos);
+
+    dump->filename = strdup(filename);
+    if (!dump->filename) {
+        LOGE("Could not strdup filename");
+        return false;
+    }
+
+    dump->pts_filename = NULL;
+    if (pts_filename) {
+        dump->pts_filename = strdup(pts_filename);
+        if (!dump->pts_filename) {
+            LOGE("Could not strdup filename");
+            goto error_free_filename;
+        }
+    }
+
+    dump->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (dump->fd == -1) {
+        LOGE("Could not open file: %s", filename);
+        goto error_free_pts_filename;
+    }
+
+    dump->pts_file = NULL;
+    if (pts_filename) {
+        dump->pts_file = fopen(pts_filename, "wb");
+        if (!dump->pts_file) {
+            LOGE("Could not open file: %s", pts_filename);
+            goto error_close_fd;
+        }
+    }
+
+    dump->socket = socket;
+    dump->bytes_written = 0;
+    dump->packets = 0;
+    dump->cbs = cbs;
+    dump->cbs_userdata = cbs_userdata;
+
+    LOGI("Raw stream dump started to file: %s", filename);
+
+    return true;
+
+error_close_fd:
+    close(dump->fd);
+error_free_pts_filename:
+    free(dump->pts_filename);
+error_free_filename:
+    free(dump->filename);
+
+    return false;
+}
+
+bool
+sc_es_dump_start(struct sc_es_dump *dump) {
+    LOGD("Starting raw stream dump thread");
+
+    bool ok = sc_thread_create(&dump->thread, run_es_dump, "es_dump", dump);
+    if (!ok) {
+        LOGC("Could not start raw stream dump thread");
+        return false;
+    }
+    return true;
+}
+
+void
+sc_es_dump_join(struct sc_es_dump *dump) {
+    sc_thread_join(&dump->thread, NULL);
+}
+
+void
+sc_es_dump_destroy(struct sc_es_dump *dump) {
+    if (dump->pts_file && fclose(dump->pts_file)) {
+        LOGE("Could not close file: %s", dump->pts_filename);
+    }
+    if (close(dump->fd)) {
+        LOGE("Could not close file: %s", dump->filename);
+    } else {
+        LOGI("Raw stream dump complete to file: %s", dump->filename);
+    }
+    free(dump->pts_filename);
+    free(dump->filename);
+}
@@ -0,0 +1,60 @@
+#ifndef SC_ES_DUMP_H
+#define SC_ES_DUMP_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "util/net.h"
+#include "util/thread.h"
+
+// Write the raw H.264 stream (Annex-B) received from the video socket to a
+// file, without parsing, decoding or muxing it.
+//
+// Only the 12-byte packet headers are read in user space. On Linux, the packet
+// payloads are moved from the socket to the file by splice() through a pipe.
+//
+// If pts_filename is set, the packet headers (8-byte PTS, 4-byte size, both
+// big-endian) are written as-is to this side file, so that timestamps can be
+// restored later (the payloads being concatenated, the offset of each packet
+// is the sum of the previous sizes).
+struct sc_es_dump {
+    socket_t socket;
+    sc_thread thread;
+
+    char *filename;
+    char *pts_filename;
+    int fd;
+    FILE *pts_file; // NULL if no PTS side file
+
+    // only accessed from the dump thread
+    uint64_t bytes_written;
+    uint64_t packets;
+
+    const struct sc_es_dump_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_es_dump_callbacks {
+    void (*on_eos)(struct sc_es_dump *dump, void *userdata);
+};
+
+// open the output files
+bool
+sc_es_dump_init(struct sc_es_dump *dump, socket_t socket,
+                const char *filename, const char *pts_filename,
+                const struct sc_es_dump_callbacks *cbs, void *cbs_userdata);
+
+bool
+sc_es_dump_start(struct sc_es_dump *dump);
+
+void
+sc_es_dump_join(struct sc_es_dump *dump);
+
+// close the output files
+void
+sc_es_dump_destroy(struct sc_es_dump *dump);
+
+#endif
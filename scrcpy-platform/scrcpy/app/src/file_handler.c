@@ -1,6 +1,5 @@
 #include "file_handler.h"
 
-#include <assert.h>
 #include <string.h>
 
 #include "adb.h"
@@ -17,16 +16,16 @@ bool
 file_handler_init(struct file_handler *file_handler, const char *serial,
                   const char *push_target) {
 
-    cbuf_init(&file_handler->queue);
-
-    bool ok = sc_mutex_init(&file_handler->mutex);
+    bool ok = sc_mpsc_init(&file_handler->queue,
+                           sizeof(struct file_handler_request),
+                           FILE_HANDLER_QUEUE_SIZE, SC_MPSC_OVERFLOW_FAIL);
     if (!ok) {
         return false;
     }
 
-    ok = sc_cond_init(&file_handler->event_cond);
+    ok = sc_mutex_init(&file_handler->mutex);
     if (!ok) {
-        sc_mutex_destroy(&file_handler->mutex);
+        sc_mpsc_destroy(&file_handler->queue);
         return false;
     }
 
@@ -34,8 +33,8 @@ file_handler_init(struct file_handler *file_handler, const char *serial,
         file_handler->serial = strdup(serial);
         if (!file_handler->serial) {
             LOGW("Could not strdup serial");
-            sc_cond_destroy(&file_handler->event_cond);
             sc_mutex_destroy(&file_handler->mutex);
+            sc_mpsc_destroy(&file_handler->queue);
             return false;
         }
     } else {
@@ -55,14 +54,14 @@ file_handler_init(struct file_handler *file_handler, const char *serial,
 
 void
 file_handler_destroy(struct file_handler *file_handler) {
-    sc_cond_destroy(&file_handler->event_cond);
     sc_mutex_destroy(&file_handler->mutex);
     free(file_handler->serial);
 
     struct file_handler_request req;
-    while (cbuf_take(&file_handler->queue, &req)) {
+    while (sc_mpsc_take(&file_handler->queue, &req)) {
         file_handler_request_destroy(&req);
     }
+    sc_mpsc_destroy(&file_handler->queue);
 }
 
 static process_t
@@ -93,14 +92,7 @@ file_handler_request(struct file_handler *file_handler,
         .file = file,
     };
 
-    sc_mutex_lock(&file_handler->mutex);
-    bool was_empty = cbuf_is_empty(&file_handler->queue);
-    bool res = cbuf_push(&file_handler->queue, req);
-    if (was_empty) {
-        sc_cond_signal(&file_handler->event_cond);
-    }
-    sc_mutex_unlock(&file_handler->mutex);
-    return res;
+    return sc_mpsc_push(&file_handler->queue, &req);
 }
 
 static int
@@ -108,20 +100,19 @@ run_file_handler(void *data) {
     struct file_handler *file_handler = data;
 
     for (;;) {
-        sc_mutex_lock(&file_handler->mutex);
-        file_handler->current_process = PROCESS_NONE;
-        while (!file_handler->stopped && cbuf_is_empty(&file_handler->queue)) {
-            sc_cond_wait(&file_handler->event_cond, &file_handler->mutex);
+        struct file_handler_request req;
+        if (!sc_mpsc_take_wait(&file_handler->queue, &req)) {
+            // stopped
+            break;
         }
+
+        sc_mutex_lock(&file_handler->mutex);
         if (file_handler->stopped) {
             // stop immediately, do not process further events
             sc_mutex_unlock(&file_handler->mutex);
+            file_handler_request_destroy(&req);
             break;
         }
-        struct file_handler_request req;
-        bool non_empty = cbuf_take(&file_handler->queue, &req);
-        assert(non_empty);
-        (void) non_empty;
 
         process_t process;
         if (req.action == ACTION_INSTALL_APK) {
@@ -182,13 +173,14 @@ void
 file_handler_stop(struct file_handler *file_handler) {
     sc_mutex_lock(&file_handler->mutex);
     file_handler->stopped = true;
-    sc_cond_signal(&file_handler->event_cond);
     if (file_handler->current_process != PROCESS_NONE) {
         if (!process_terminate(file_handler->current_process)) {
             LOGW("Could not terminate push/install process");
         }
     }
     sc_mutex_unlock(&file_handler->mutex);
+
+    sc_mpsc_interrupt(&file_handler->queue);
 }
 
 void
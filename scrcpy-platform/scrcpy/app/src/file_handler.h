@@ -6,7 +6,7 @@
 #include <stdbool.h>
 
 #include "adb.h"
-#include "util/cbuf.h"
+#include "util/mpsc.h"
 #include "util/thread.h"
 
 typedef enum {
@@ -19,18 +19,17 @@ struct file_handler_request {
     char *file;
 };
 
-struct file_handler_request_queue CBUF(struct file_handler_request, 16);
+#define FILE_HANDLER_QUEUE_SIZE 16
 
 struct file_handler {
     char *serial;
     const char *push_target;
     sc_thread thread;
-    sc_mutex mutex;
-    sc_cond event_cond;
+    sc_mutex mutex; // protects stopped and current_process
     bool stopped;
     bool initialized;
     process_t current_process;
-    struct file_handler_request_queue queue;
+    struct sc_mpsc queue;
 };
 
 bool
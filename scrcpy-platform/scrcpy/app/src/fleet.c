@@ -0,0 +1,492 @@
+#include "fleet.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adb.h"
+#include "adb_client.h"
+#include "util/log.h"
+#include "util/net.h"
+#include "util/thread.h"
+
+// delay before tracking the devices again if the adb server is not available
+#define TRACK_RETRY_DELAY SC_TICK_FROM_SEC(1)
+
+#define RECORD_COUNT (1 + SC_MAX_EXTRA_RECORDS)
+
+struct sc_fleet_session {
+    struct scrcpy_fleet *fleet;
+    char *serial;
+    char *record_filenames[RECORD_COUNT];
+    // the options of the fleet, with the serial and recording filenames of
+    // this session
+    struct scrcpy_options options;
+
+    // Each session is started from its own thread, so that a device which is
+    // slow to start does not delay the others
+    sc_thread start_thread;
+    bool start_thread_running; // not joined yet
+
+    // protected by the fleet mutex until the start thread is joined
+    bool start_done;
+    // NULL if the session could not be started (it is started again on the
+    // next device list update)
+    struct scrcpy_process *process;
+
+    bool present; // in the last device list
+    struct sc_fleet_session *next;
+};
+
+struct scrcpy_fleet {
+    // the options of all the sessions, except the serial and the recording
+    // filenames
+    struct scrcpy_options options;
+    void (*on_session)(void *userdata, const char *serial,
+                       struct scrcpy_process *p, bool started);
+    void *userdata;
+
+    // shared by the recorders of all the sessions
+    struct sc_thread_pool pool;
+
+    sc_thread thread;
+    sc_mutex mutex; // also protects the state of the session start threads
+    sc_cond cond; // signaled on stop
+    bool stopped;
+    socket_t track_socket; // shut down on stop to interrupt the tracking
+
+    // only accessed from the fleet thread
+    struct sc_fleet_session *sessions;
+};
+
+// Replace "%s" by the serial, with the characters which could be invalid in a
+// filename (e.g. ':' in "192.168.1.2:5555") replaced by '_'
+static char *
+format_filename(const char *pattern, const char *serial) {
+    const char *placeholder = strstr(pattern, "%s");
+    assert(placeholder);
+
+    size_t prefix_len = placeholder - pattern;
+    size_t serial_len = strlen(serial);
+    size_t len = strlen(pattern) - 2 + serial_len;
+    char *filename = malloc(len + 1);
+    if (!filename) {
+        LOGC("Could not allocate filename");
+        return NULL;
+    }
+
+    memcpy(filename, pattern, prefix_len);
+    for (size_t i = 0; i < serial_len; ++i) {
+        char c = serial[i];
+        bool valid = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')
+                  || (c >= 'A' && c <= 'Z') || c == '-' || c == '.';
+        filename[prefix_len + i] = valid ? c : '_';
+    }
+    strcpy(&filename[prefix_len + serial_len], placeholder + 2);
+    return filename;
+}
+
+static void
+session_destroy(struct sc_fleet_session *session) {
+    assert(!session->start_thread_running);
+    for (unsigned i = 0; i < RECORD_COUNT; ++i) {
+        free(session->record_filenames[i]);
+    }
+    free(session->serial);
+    free(session);
+}
+
+static int
+run_start_session(void *data) {
+    struct sc_fleet_session *session = data;
+    struct scrcpy_fleet *fleet = session->fleet;
+
+    struct scrcpy_process *process =
+        scrcpy_start_pooled(&session->options, &fleet->pool);
+    if (!process) {
+        LOGE("Could not start session for device %s", session->serial);
+    } else if (fleet->on_session) {
+        fleet->on_session(fleet->userdata, session->serial, process, true);
+    }
+
+    sc_mutex_lock(&fleet->mutex);
+    session->process = process;
+    session->start_done = true;
+    sc_mutex_unlock(&fleet->mutex);
+
+    return 0;
+}
+
+static void
+start_session(struct sc_fleet_session *session) {
+    assert(!session->start_thread_running);
+    session->process = NULL;
+    session->start_done = false;
+
+    LOGI("Starting session for device %s", session->serial);
+    bool ok = sc_thread_create(&session->start_thread, run_start_session,
+                               "fleet_start", session);
+    if (!ok) {
+        LOGC("Could not start session thread");
+        // retried on the next device list update
+        session->start_done = true;
+        return;
+    }
+
+    session->start_thread_running = true;
+}
+
+// Wait for the session to be started (the process is then accessed only from
+// the fleet thread)
+static void
+join_start_session(struct sc_fleet_session *session) {
+    if (session->start_thread_running) {
+        sc_thread_join(&session->start_thread, NULL);
+        session->start_thread_running = false;
+    }
+}
+
+static void
+stop_session(struct scrcpy_fleet *fleet, struct sc_fleet_session *session) {
+    join_start_session(session);
+    if (session->process) {
+        LOGI("Stopping session for device %s", session->serial);
+        if (fleet->on_session) {
+            fleet->on_session(fleet->userdata, session->serial,
+                              session->process, false);
+        }
+        scrcpy_stop(session->process);
+        session->process = NULL;
+    }
+}
+
+// Indicate whether a session could not be started, or its device was
+// disconnected (without being removed from the device list, e.g. if the
+// server died)
+static bool
+is_session_dead(struct scrcpy_fleet *fleet,
+                struct sc_fleet_session *session) {
+    sc_mutex_lock(&fleet->mutex);
+    bool start_done = session->start_done;
+    sc_mutex_unlock(&fleet->mutex);
+
+    if (!start_done) {
+        // still starting
+        return false;
+    }
+
+    join_start_session(session);
+    return !session->process || scrcpy_is_stream_ended(session->process);
+}
+
+static void
+add_session(struct scrcpy_fleet *fleet, const char *serial) {
+    // zero-initialize, so that the filenames are NULL
+    struct sc_fleet_session *session = calloc(1, sizeof(*session));
+    if (!session) {
+        LOGC("Could not allocate session");
+        return;
+    }
+
+    session->fleet = fleet;
+    session->serial = strdup(serial);
+    if (!session->serial) {
+        LOGC("Could not allocate serial");
+        free(session);
+        return;
+    }
+
+    struct scrcpy_options *options = &session->options;
+    *options = fleet->options;
+    options->serial = session->serial;
+    if (options->record_filename) {
+        session->record_filenames[0] =
+            format_filename(options->record_filename, serial);
+        if (!session->record_filenames[0]) {
+            session_destroy(session);
+            return;
+        }
+        options->record_filename = session->record_filenames[0];
+    }
+    for (unsigned i = 0; i < options->extra_record_count; ++i) {
+        char *filename =
+            format_filename(options->extra_records[i].filename, serial);
+        if (!filename) {
+            session_destroy(session);
+            return;
+        }
+        session->record_filenames[1 + i] = filename;
+        options->extra_records[i].filename = filename;
+    }
+
+    LOGI("Device %s connected", serial);
+    start_session(session);
+
+    session->present = true;
+    session->next = fleet->sessions;
+    fleet->sessions = session;
+}
+
+static struct sc_fleet_session *
+find_session(struct scrcpy_fleet *fleet, const char *serial) {
+    for (struct sc_fleet_session *session = fleet->sessions; session;
+            session = session->next) {
+        if (!strcmp(session->serial, serial)) {
+            return session;
+        }
+    }
+    return NULL;
+}
+
+// Start a session for each new device, restart the dead sessions, and stop
+// the sessions of the devices not connected anymore
+static void
+update_sessions(struct scrcpy_fleet *fleet, char *devices) {
+    for (struct sc_fleet_session *session = fleet->sessions; session;
+            session = session->next) {
+        session->present = false;
+    }
+
+    // one "serial\tstate\n" line per device
+    char *line = devices;
+    while (*line) {
+        char *end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+
+        char *tab = strchr(line, '\t');
+        // ignore the devices not ready (e.g. "offline" or "unauthorized")
+        if (tab && !strcmp(tab + 1, "device")) {
+            *tab = '\0';
+            struct sc_fleet_session *session = find_session(fleet, line);
+            if (!session) {
+                add_session(fleet, line);
+            } else {
+                session->present = true;
+                if (is_session_dead(fleet, session)) {
+                    LOGW("Session for device %s is dead, restarting",
+                         session->serial);
+                    stop_session(fleet, session);
+                    start_session(session);
+                }
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        line = end + 1;
+    }
+
+    struct sc_fleet_session **pnext = &fleet->sessions;
+    while (*pnext) {
+        struct sc_fleet_session *session = *pnext;
+        if (session->present) {
+            pnext = &session->next;
+        } else {
+            *pnext = session->next;
+            stop_session(fleet, session);
+            session_destroy(session);
+        }
+    }
+}
+
+static bool
+start_adb_server(void) {
+    const char *const adb_cmd[] = {"start-server"};
+    process_t process = adb_execute(NULL, adb_cmd, ARRAY_LEN(adb_cmd));
+    return process_check_success(process, "adb start-server", true);
+}
+
+// Track the devices until the connection to the adb server is lost (or the
+// fleet is stopped)
+static void
+track_devices(struct scrcpy_fleet *fleet) {
+    socket_t socket;
+    enum sc_adb_result r = sc_adb_track_devices(&socket);
+    if (r == SC_ADB_UNAVAILABLE && start_adb_server()) {
+        r = sc_adb_track_devices(&socket);
+    }
+    if (r != SC_ADB_OK) {
+        LOGW("Could not track devices");
+        return;
+    }
+
+    sc_mutex_lock(&fleet->mutex);
+    bool stopped = fleet->stopped;
+    if (!stopped) {
+        fleet->track_socket = socket;
+    }
+    sc_mutex_unlock(&fleet->mutex);
+
+    if (!stopped) {
+        char *devices;
+        while (sc_adb_read_devices(socket, &devices) == SC_ADB_OK) {
+            update_sessions(fleet, devices);
+            free(devices);
+        }
+
+        sc_mutex_lock(&fleet->mutex);
+        fleet->track_socket = INVALID_SOCKET;
+        sc_mutex_unlock(&fleet->mutex);
+    }
+
+    net_close(socket);
+}
+
+static int
+run_fleet(void *data) {
+    struct scrcpy_fleet *fleet = data;
+
+    for (;;) {
+        track_devices(fleet);
+
+        sc_mutex_lock(&fleet->mutex);
+        sc_tick deadline = sc_tick_now() + TRACK_RETRY_DELAY;
+        bool timed_out = false;
+        while (!fleet->stopped && !timed_out) {
+            timed_out = !sc_cond_timedwait(&fleet->cond, &fleet->mutex,
+                                           deadline);
+        }
+        bool stopped = fleet->stopped;
+        sc_mutex_unlock(&fleet->mutex);
+
+        if (stopped) {
+            break;
+        }
+    }
+
+    while (fleet->sessions) {
+        struct sc_fleet_session *session = fleet->sessions;
+        fleet->sessions = session->next;
+        stop_session(fleet, session);
+        session_destroy(session);
+    }
+
+    return 0;
+}
+
+static bool
+check_options(const struct scrcpy_options *options) {
+    if (options->serial) {
+        LOGE("The serial is set for each device of the fleet");
+        return false;
+    }
+
+    if (options->record_filename && !strstr(options->record_filename, "%s")) {
+        LOGE("The record filename must contain \"%%s\" (replaced by the "
+             "serial of each device)");
+        return false;
+    }
+
+    for (unsigned i = 0; i < options->extra_record_count; ++i) {
+        if (!strstr(options->extra_records[i].filename, "%s")) {
+            LOGE("The record filename must contain \"%%s\" (replaced by the "
+                 "serial of each device)");
+            return false;
+        }
+    }
+
+    // the sessions are started from threads without event loop
+    if (options->display) {
+        LOGE("Display is not supported for a fleet");
+        return false;
+    }
+
+    // these outputs can not be shared between several devices
+    if (options->record_raw_filename || options->v4l2_device
+            || options->restream_url || options->shm_name
+            || options->record_input_filename) {
+        LOGE("Raw recording, v4l2, restream, shared memory and input "
+             "recording are not supported for a fleet");
+        return false;
+    }
+
+    return true;
+}
+
+struct scrcpy_fleet *
+scrcpy_fleet_start(const struct scrcpy_options *options,
+                   void (*on_session)(void *userdata, const char *serial,
+                                      struct scrcpy_process *p, bool started),
+                   void *userdata) {
+    if (!check_options(options)) {
+        return NULL;
+    }
+
+    // before starting the pool workers, so that they are configured too
+    if (!sc_thread_config_init(options->thread_config)) {
+        return NULL;
+    }
+
+    // once, before the sessions are started concurrently
+    if (!scrcpy_init_pooled(options)) {
+        return NULL;
+    }
+
+    struct scrcpy_fleet *fleet = malloc(sizeof(*fleet));
+    if (!fleet) {
+        LOGC("Could not allocate fleet");
+        return NULL;
+    }
+
+    fleet->options = *options;
+    fleet->on_session = on_session;
+    fleet->userdata = userdata;
+    fleet->stopped = false;
+    fleet->track_socket = INVALID_SOCKET;
+    fleet->sessions = NULL;
+
+    // one worker per CPU core, whatever the number of devices
+    if (!sc_thread_pool_init(&fleet->pool, 0)) {
+        goto error_free_fleet;
+    }
+
+    if (!sc_mutex_init(&fleet->mutex)) {
+        goto error_destroy_pool;
+    }
+
+    if (!sc_cond_init(&fleet->cond)) {
+        goto error_destroy_mutex;
+    }
+
+    LOGD("Starting fleet thread");
+    if (!sc_thread_create(&fleet->thread, run_fleet, "fleet", fleet)) {
+        LOGC("Could not start fleet thread");
+        goto error_destroy_cond;
+    }
+
+    return fleet;
+
+error_destroy_cond:
+    sc_cond_destroy(&fleet->cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&fleet->mutex);
+error_destroy_pool:
+    sc_thread_pool_destroy(&fleet->pool);
+error_free_fleet:
+    free(fleet);
+
+    return NULL;
+}
+
+void
+scrcpy_fleet_stop(struct scrcpy_fleet *fleet) {
+    sc_mutex_lock(&fleet->mutex);
+    fleet->stopped = true;
+    sc_cond_signal(&fleet->cond);
+    if (fleet->track_socket != INVALID_SOCKET) {
+        // interrupt the blocking read
+        net_shutdown(fleet->track_socket, SHUT_RDWR);
+    }
+    sc_mutex_unlock(&fleet->mutex);
+
+    sc_thread_join(&fleet->thread, NULL);
+
+    // all the recorders are closed
+    sc_thread_pool_destroy(&fleet->pool);
+    sc_cond_destroy(&fleet->cond);
+    sc_mutex_destroy(&fleet->mutex);
+    free(fleet);
+}
@@ -0,0 +1,29 @@
+#ifndef SC_FLEET_H
+#define SC_FLEET_H
+
+#include "common.h"
+
+#include "scrcpy.h"
+#include "util/thread_pool.h"
+
+// The public API (scrcpy_fleet_start() and scrcpy_fleet_stop()) is declared in
+// scrcpy.h.
+
+// Initialize SDL for all the sessions started by scrcpy_start_pooled() with a
+// pool (which do not initialize it), once before starting them (implemented in
+// scrcpy.c)
+bool
+scrcpy_init_pooled(const struct scrcpy_options *options);
+
+// Start a session whose recorders run on a shared pool (implemented in
+// scrcpy.c). If pool is NULL, this is equivalent to scrcpy_start().
+struct scrcpy_process *
+scrcpy_start_pooled(const struct scrcpy_options *options,
+                    struct sc_thread_pool *pool);
+
+// Indicate whether the stream of a session has ended (the device was
+// disconnected, and could not be reconnected)
+bool
+scrcpy_is_stream_ended(struct scrcpy_process *p);
+
+#endif
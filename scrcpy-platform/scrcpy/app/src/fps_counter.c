@@ -1,182 +1,181 @@
 #include "fps_counter.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
 
 #include "util/log.h"
 
 #define FPS_COUNTER_INTERVAL SC_TICK_FROM_SEC(1)
 
-bool
+void
 fps_counter_init(struct fps_counter *counter) {
-    bool ok = sc_mutex_init(&counter->mutex);
-    if (!ok) {
-        return false;
-    }
-
-    ok = sc_cond_init(&counter->state_cond);
-    if (!ok) {
-        sc_mutex_destroy(&counter->mutex);
-        return false;
+    atomic_init(&counter->started, false);
+    atomic_init(&counter->next_log_tick, 0);
+    atomic_init(&counter->nr_rendered, 0);
+    atomic_init(&counter->nr_skipped, 0);
+    for (unsigned i = 0; i < FPS_COUNTER_HISTORY; ++i) {
+        atomic_init(&counter->history[i], 0);
     }
-
-    counter->thread_started = false;
-    atomic_init(&counter->started, 0);
-    // no need to initialize the other fields, they are unused until started
-
-    return true;
+    counter->logged_rendered = 0;
+    counter->logged_skipped = 0;
 }
 
 void
-fps_counter_destroy(struct fps_counter *counter) {
-    sc_cond_destroy(&counter->state_cond);
-    sc_mutex_destroy(&counter->mutex);
-}
-
-static inline bool
-is_started(struct fps_counter *counter) {
-    return atomic_load_explicit(&counter->started, memory_order_acquire);
+fps_counter_start(struct fps_counter *counter) {
+    // the interval is restarted by the next rendered frame
+    atomic_store_explicit(&counter->next_log_tick, 0, memory_order_relaxed);
+    atomic_store_explicit(&counter->started, true, memory_order_relaxed);
 }
 
-static inline void
-set_started(struct fps_counter *counter, bool started) {
-    atomic_store_explicit(&counter->started, started, memory_order_release);
+void
+fps_counter_stop(struct fps_counter *counter) {
+    atomic_store_explicit(&counter->started, false, memory_order_relaxed);
 }
 
-// must be called with mutex locked
-static void
-display_fps(struct fps_counter *counter) {
-    unsigned rendered_per_second =
-        counter->nr_rendered * SC_TICK_FREQ / FPS_COUNTER_INTERVAL;
-    if (counter->nr_skipped) {
-        LOGI("%u fps (+%u frames skipped)", rendered_per_second,
-                                            counter->nr_skipped);
-    } else {
-        LOGI("%u fps", rendered_per_second);
-    }
+bool
+fps_counter_is_started(struct fps_counter *counter) {
+    return atomic_load_explicit(&counter->started, memory_order_relaxed);
 }
 
-// must be called with mutex locked
+// Called from the rendering thread, once nr_rendered includes the new frame
 static void
-check_interval_expired(struct fps_counter *counter, uint32_t now) {
-    if (now < counter->next_timestamp) {
+check_interval_expired(struct fps_counter *counter, uint64_t rendered,
+                       sc_tick now) {
+    sc_tick next = atomic_load_explicit(&counter->next_log_tick,
+                                        memory_order_relaxed);
+    uint64_t skipped = atomic_load_explicit(&counter->nr_skipped,
+                                            memory_order_relaxed);
+    if (next && now < next) {
         return;
     }
 
-    display_fps(counter);
-    counter->nr_rendered = 0;
-    counter->nr_skipped = 0;
-    // add a multiple of the interval
-    uint32_t elapsed_slices =
-        (now - counter->next_timestamp) / FPS_COUNTER_INTERVAL + 1;
-    counter->next_timestamp += FPS_COUNTER_INTERVAL * elapsed_slices;
-}
-
-static int
-run_fps_counter(void *data) {
-    struct fps_counter *counter = data;
-
-    sc_mutex_lock(&counter->mutex);
-    while (!counter->interrupted) {
-        while (!counter->interrupted && !is_started(counter)) {
-            sc_cond_wait(&counter->state_cond, &counter->mutex);
-        }
-        while (!counter->interrupted && is_started(counter)) {
-            sc_tick now = sc_tick_now();
-            check_interval_expired(counter, now);
-
-            // ignore the reason (timeout or signaled), we just loop anyway
-            sc_cond_timedwait(&counter->state_cond, &counter->mutex,
-                              counter->next_timestamp);
+    if (next) {
+        // the interval may be longer than expected if no frame has been
+        // rendered meanwhile
+        sc_tick elapsed = now - (next - FPS_COUNTER_INTERVAL);
+        // the current frame belongs to the next interval
+        uint64_t nr_rendered = rendered - 1 - counter->logged_rendered;
+        uint64_t nr_skipped = skipped - counter->logged_skipped;
+        unsigned fps = nr_rendered * SC_TICK_FREQ / elapsed;
+        if (nr_skipped) {
+            LOGI("%u fps (+%" PRIu64 " frames skipped)", fps, nr_skipped);
+        } else {
+            LOGI("%u fps", fps);
         }
     }
-    sc_mutex_unlock(&counter->mutex);
-    return 0;
-}
 
-bool
-fps_counter_start(struct fps_counter *counter) {
-    sc_mutex_lock(&counter->mutex);
-    counter->next_timestamp = sc_tick_now() + FPS_COUNTER_INTERVAL;
-    counter->nr_rendered = 0;
-    counter->nr_skipped = 0;
-    sc_mutex_unlock(&counter->mutex);
-
-    set_started(counter, true);
-    sc_cond_signal(&counter->state_cond);
-
-    // counter->thread_started and counter->thread are always accessed from the
-    // same thread, no need to lock
-    if (!counter->thread_started) {
-        bool ok = sc_thread_create(&counter->thread, run_fps_counter,
-                                   "fps counter", counter);
-        if (!ok) {
-            LOGE("Could not start FPS counter thread");
-            return false;
-        }
+    counter->logged_rendered = rendered - 1;
+    counter->logged_skipped = skipped;
+    atomic_store_explicit(&counter->next_log_tick, now + FPS_COUNTER_INTERVAL,
+                          memory_order_relaxed);
+}
 
-        counter->thread_started = true;
+void
+fps_counter_add_rendered_frame(struct fps_counter *counter, sc_tick now) {
+    // only this thread writes nr_rendered
+    uint64_t n = atomic_load_explicit(&counter->nr_rendered,
+                                      memory_order_relaxed);
+    atomic_store_explicit(&counter->history[n % FPS_COUNTER_HISTORY], now,
+                          memory_order_relaxed);
+    // publish the timestamp with the count
+    atomic_store_explicit(&counter->nr_rendered, n + 1, memory_order_release);
+
+    if (fps_counter_is_started(counter)) {
+        check_interval_expired(counter, n + 1, now);
     }
-
-    return true;
 }
 
 void
-fps_counter_stop(struct fps_counter *counter) {
-    set_started(counter, false);
-    sc_cond_signal(&counter->state_cond);
+fps_counter_add_skipped_frame(struct fps_counter *counter) {
+    atomic_fetch_add_explicit(&counter->nr_skipped, 1, memory_order_relaxed);
 }
 
-bool
-fps_counter_is_started(struct fps_counter *counter) {
-    return is_started(counter);
+static int
+compare_ticks(const void *a, const void *b) {
+    sc_tick ta = *(const sc_tick *) a;
+    sc_tick tb = *(const sc_tick *) b;
+    return (ta > tb) - (ta < tb);
+}
+
+// Nearest-rank percentile of sorted values
+static sc_tick
+percentile(const sc_tick *sorted, unsigned count, unsigned percent) {
+    assert(count);
+    unsigned rank = (count * percent + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
 }
 
 void
-fps_counter_interrupt(struct fps_counter *counter) {
-    if (!counter->thread_started) {
-        return;
+fps_counter_get_stats(struct fps_counter *counter, sc_tick now,
+                      sc_tick window, struct fps_counter_stats *stats) {
+    assert(window > 0);
+
+    uint64_t n = atomic_load_explicit(&counter->nr_rendered,
+                                      memory_order_acquire);
+    stats->rendered = n;
+    stats->skipped = atomic_load_explicit(&counter->nr_skipped,
+                                          memory_order_relaxed);
+
+    // the ticks of the frames in the window, from the most recent
+    sc_tick ticks[FPS_COUNTER_HISTORY];
+    unsigned count = 0;
+    unsigned max = n < FPS_COUNTER_HISTORY ? n : FPS_COUNTER_HISTORY;
+    while (count < max) {
+        sc_tick tick = atomic_load_explicit(
+                &counter->history[(n - 1 - count) % FPS_COUNTER_HISTORY],
+                memory_order_relaxed);
+        if (tick <= now - window) {
+            break;
+        }
+        if (count && tick > ticks[count - 1]) {
+            // overwritten by a frame rendered concurrently
+            break;
+        }
+        ticks[count++] = tick;
     }
 
-    sc_mutex_lock(&counter->mutex);
-    counter->interrupted = true;
-    sc_mutex_unlock(&counter->mutex);
-    // wake up blocking wait
-    sc_cond_signal(&counter->state_cond);
-}
+    stats->fps = 0;
+    stats->interval_p50 = 0;
+    stats->interval_p90 = 0;
+    stats->interval_p99 = 0;
+    stats->interval_max = 0;
+    stats->jitter = 0;
 
-void
-fps_counter_join(struct fps_counter *counter) {
-    if (counter->thread_started) {
-        // interrupted must be set by the thread calling join(), so no need to
-        // lock for the assertion
-        assert(counter->interrupted);
+    if (!count) {
+        return;
+    }
 
-        sc_thread_join(&counter->thread, NULL);
+    sc_tick span = window;
+    if (count == FPS_COUNTER_HISTORY) {
+        // the history does not cover the whole window
+        span = now - ticks[count - 1];
     }
-}
+    stats->fps = span ? (double) count * SC_TICK_FREQ / span : 0;
 
-void
-fps_counter_add_rendered_frame(struct fps_counter *counter) {
-    if (!is_started(counter)) {
+    if (count < 2) {
         return;
     }
 
-    sc_mutex_lock(&counter->mutex);
-    sc_tick now = sc_tick_now();
-    check_interval_expired(counter, now);
-    ++counter->nr_rendered;
-    sc_mutex_unlock(&counter->mutex);
-}
+    // the intervals, from the most recent
+    sc_tick intervals[FPS_COUNTER_HISTORY - 1];
+    unsigned nr_intervals = count - 1;
+    for (unsigned i = 0; i < nr_intervals; ++i) {
+        intervals[i] = ticks[i] - ticks[i + 1];
+    }
 
-void
-fps_counter_add_skipped_frame(struct fps_counter *counter) {
-    if (!is_started(counter)) {
-        return;
+    sc_tick jitter = 0;
+    for (unsigned i = 1; i < nr_intervals; ++i) {
+        sc_tick diff = intervals[i - 1] - intervals[i];
+        jitter += diff < 0 ? -diff : diff;
+    }
+    if (nr_intervals > 1) {
+        stats->jitter = jitter / (nr_intervals - 1);
     }
 
-    sc_mutex_lock(&counter->mutex);
-    sc_tick now = sc_tick_now();
-    check_interval_expired(counter, now);
-    ++counter->nr_skipped;
-    sc_mutex_unlock(&counter->mutex);
+    qsort(intervals, nr_intervals, sizeof(intervals[0]), compare_ticks);
+    stats->interval_p50 = percentile(intervals, nr_intervals, 50);
+    stats->interval_p90 = percentile(intervals, nr_intervals, 90);
+    stats->interval_p99 = percentile(intervals, nr_intervals, 99);
+    stats->interval_max = intervals[nr_intervals - 1];
 }
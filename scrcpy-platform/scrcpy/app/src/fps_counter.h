@@ -7,33 +7,53 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#include "util/thread.h"
-
+#include "util/tick.h"
+
+// Number of rendered frame timestamps kept for the sliding window statistics
+// (it bounds the number of frames in a window)
+#define FPS_COUNTER_HISTORY 256
+
+// Frames are accounted with relaxed atomic operations only: there is no lock
+// and no thread. The statistics (and the periodic log, if started) are
+// computed lazily from the history of rendered frames.
+//
+// Frames are rendered from a single thread, skipped frames may be added from
+// any thread, and the statistics may be read from any thread.
 struct fps_counter {
-    sc_thread thread;
-    sc_mutex mutex;
-    sc_cond state_cond;
+    // set if the FPS must be logged every second
+    atomic_bool started;
+    // the tick of the next log, 0 to restart the logging interval
+    atomic_int_least64_t next_log_tick;
 
-    bool thread_started;
+    atomic_uint_least64_t nr_rendered; // cumulative
+    atomic_uint_least64_t nr_skipped; // cumulative
+    // ticks of the last rendered frames (the last one at nr_rendered - 1)
+    atomic_int_least64_t history[FPS_COUNTER_HISTORY];
 
-    // atomic so that we can check without locking the mutex
-    // if the FPS counter is disabled, we don't want to lock unnecessarily
-    atomic_bool started;
+    // accessed only from the rendering thread, for the log
+    uint64_t logged_rendered;
+    uint64_t logged_skipped;
+};
 
-    // the following fields are protected by the mutex
-    bool interrupted;
-    unsigned nr_rendered;
-    unsigned nr_skipped;
-    sc_tick next_timestamp;
+// Statistics of the frames rendered during the window preceding now (the
+// intervals are in microseconds)
+struct fps_counter_stats {
+    uint64_t rendered; // since the start (not only in the window)
+    uint64_t skipped; // since the start (not only in the window)
+    double fps;
+    sc_tick interval_p50;
+    sc_tick interval_p90;
+    sc_tick interval_p99;
+    sc_tick interval_max;
+    // mean absolute difference between consecutive frame intervals
+    sc_tick jitter;
 };
 
-bool
+void
 fps_counter_init(struct fps_counter *counter);
 
+// Start logging the FPS every second
 void
-fps_counter_destroy(struct fps_counter *counter);
-
-bool
 fps_counter_start(struct fps_counter *counter);
 
 void
@@ -42,18 +62,16 @@ fps_counter_stop(struct fps_counter *counter);
 bool
 fps_counter_is_started(struct fps_counter *counter);
 
-// request to stop the thread (on quit)
-// must be called before fps_counter_join()
-void
-fps_counter_interrupt(struct fps_counter *counter);
-
+// Must always be called from the same thread, with the current tick
 void
-fps_counter_join(struct fps_counter *counter);
+fps_counter_add_rendered_frame(struct fps_counter *counter, sc_tick now);
 
 void
-fps_counter_add_rendered_frame(struct fps_counter *counter);
+fps_counter_add_skipped_frame(struct fps_counter *counter);
 
+// The window is limited by FPS_COUNTER_HISTORY frames
 void
-fps_counter_add_skipped_frame(struct fps_counter *counter);
+fps_counter_get_stats(struct fps_counter *counter, sc_tick now,
+                      sc_tick window, struct fps_counter_stats *stats);
 
 #endif
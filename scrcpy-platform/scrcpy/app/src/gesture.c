@@ -0,0 +1,215 @@
+#include "gesture.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+// Compute the position of each finger at progress u (in [0, 1])
+typedef void (*sc_gesture_path_fn)(const void *params, float u,
+                                   struct point points[]);
+
+static inline float
+lerp(float a, float b, float u) {
+    return a + (b - a) * u;
+}
+
+static struct point
+clamp_point(struct point point, struct size screen_size) {
+    if (point.x < 0) {
+        point.x = 0;
+    } else if (point.x >= screen_size.width) {
+        point.x = screen_size.width - 1;
+    }
+    if (point.y < 0) {
+        point.y = 0;
+    } else if (point.y >= screen_size.height) {
+        point.y = screen_size.height - 1;
+    }
+    return point;
+}
+
+static void
+init_touch(struct control_msg *msg, enum android_motionevent_action action,
+           unsigned finger, struct point point, struct size screen_size) {
+    bool up = action == AMOTION_EVENT_ACTION_UP;
+
+    msg->type = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT;
+    msg->inject_touch_event.action = action;
+    msg->inject_touch_event.pointer_id = POINTER_ID_GESTURE(finger);
+    msg->inject_touch_event.position.screen_size = screen_size;
+    msg->inject_touch_event.position.point = clamp_point(point, screen_size);
+    msg->inject_touch_event.pressure = up ? 0.0f : 1.0f;
+    msg->inject_touch_event.buttons = 0;
+}
+
+static bool
+generate(sc_gesture_path_fn path, const void *params, unsigned fingers,
+         sc_tick duration, struct size screen_size, unsigned rate,
+         struct sc_timed_msg **out_msgs, size_t *out_count) {
+    assert(fingers && fingers <= SC_GESTURE_MAX_FINGERS);
+
+    if (!screen_size.width || !screen_size.height) {
+        LOGE("Gesture: unknown screen size");
+        return false;
+    }
+
+    if (!rate || rate > SC_GESTURE_MAX_RATE) {
+        LOGE("Gesture: invalid event rate: %u", rate);
+        return false;
+    }
+
+    if (duration <= 0 || duration > SC_GESTURE_MAX_DURATION) {
+        LOGE("Gesture: invalid duration");
+        return false;
+    }
+
+    // number of moves, the last one at the end of the gesture
+    size_t steps = (duration * rate + SC_TICK_FREQ / 2) / SC_TICK_FREQ;
+    if (!steps) {
+        steps = 1;
+    }
+
+    // down, moves and up for each finger
+    size_t count = (steps + 2) * fingers;
+    struct sc_timed_msg *msgs = malloc(count * sizeof(*msgs));
+    if (!msgs) {
+        LOGC("Could not allocate gesture events");
+        return false;
+    }
+
+    struct point points[SC_GESTURE_MAX_FINGERS];
+    size_t i = 0;
+
+    path(params, 0, points);
+    for (unsigned f = 0; f < fingers; ++f) {
+        msgs[i].offset = 0;
+        init_touch(&msgs[i].msg, AMOTION_EVENT_ACTION_DOWN, f, points[f],
+                   screen_size);
+        ++i;
+    }
+
+    for (size_t step = 1; step <= steps; ++step) {
+        sc_tick offset = duration * step / steps;
+        path(params, (float) step / steps, points);
+        for (unsigned f = 0; f < fingers; ++f) {
+            msgs[i].offset = offset;
+            init_touch(&msgs[i].msg, AMOTION_EVENT_ACTION_MOVE, f, points[f],
+                       screen_size);
+            ++i;
+        }
+    }
+
+    // release the fingers in reverse order, at the last position
+    for (unsigned f = fingers; f-- > 0;) {
+        msgs[i].offset = duration;
+        init_touch(&msgs[i].msg, AMOTION_EVENT_ACTION_UP, f, points[f],
+                   screen_size);
+        ++i;
+    }
+
+    assert(i == count);
+
+    *out_msgs = msgs;
+    *out_count = count;
+    return true;
+}
+
+static void
+swipe_path(const void *params, float u, struct point points[]) {
+    const struct sc_swipe *swipe = params;
+    const struct point *p0 = &swipe->from;
+    const struct point *p1 = &swipe->to;
+
+    if (!swipe->bezier) {
+        points[0].x = lroundf(lerp(p0->x, p1->x, u));
+        points[0].y = lroundf(lerp(p0->y, p1->y, u));
+        return;
+    }
+
+    const struct point *c1 = &swipe->control1;
+    const struct point *c2 = &swipe->control2;
+    float v = 1 - u;
+    float b0 = v * v * v;
+    float b1 = 3 * v * v * u;
+    float b2 = 3 * v * u * u;
+    float b3 = u * u * u;
+    points[0].x = lroundf(b0 * p0->x + b1 * c1->x + b2 * c2->x + b3 * p1->x);
+    points[0].y = lroundf(b0 * p0->y + b1 * c1->y + b2 * c2->y + b3 * p1->y);
+}
+
+bool
+sc_gesture_swipe(const struct sc_swipe *swipe, struct size screen_size,
+                 unsigned rate, struct sc_timed_msg **out_msgs,
+                 size_t *out_count) {
+    return generate(swipe_path, swipe, 1, swipe->duration, screen_size, rate,
+                    out_msgs, out_count);
+}
+
+static void
+pinch_path(const void *params, float u, struct point points[]) {
+    const struct sc_pinch *pinch = params;
+    float radius = lerp(pinch->start_span, pinch->end_span, u) / 2;
+    float angle = lerp(pinch->start_angle, pinch->end_angle, u) * M_PI / 180;
+    // the y axis points down on the screen
+    float dx = radius * cosf(angle);
+    float dy = -radius * sinf(angle);
+
+    points[0].x = lroundf(pinch->center.x + dx);
+    points[0].y = lroundf(pinch->center.y + dy);
+    points[1].x = lroundf(pinch->center.x - dx);
+    points[1].y = lroundf(pinch->center.y - dy);
+}
+
+bool
+sc_gesture_pinch(const struct sc_pinch *pinch, struct size screen_size,
+                 unsigned rate, struct sc_timed_msg **out_msgs,
+                 size_t *out_count) {
+    return generate(pinch_path, pinch, 2, pinch->duration, screen_size, rate,
+                    out_msgs, out_count);
+}
+
+static void
+fling_path(const void *params, float u, struct point points[]) {
+    const struct sc_fling *fling = params;
+    // constant acceleration: the distance is proportional to t^2
+    float s = u * u;
+    points[0].x = lroundf(lerp(fling->from.x, fling->to.x, s));
+    points[0].y = lroundf(lerp(fling->from.y, fling->to.y, s));
+}
+
+bool
+sc_gesture_fling(const struct sc_fling *fling, struct size screen_size,
+                 unsigned rate, struct sc_timed_msg **out_msgs,
+                 size_t *out_count) {
+    if (!(fling->velocity > 0)) {
+        LOGE("Gesture: invalid fling velocity");
+        return false;
+    }
+
+    float dx = fling->to.x - fling->from.x;
+    float dy = fling->to.y - fling->from.y;
+    float distance = sqrtf(dx * dx + dy * dy);
+
+    // from rest, the final velocity is twice the average velocity
+    float seconds = 2 * distance / fling->velocity;
+    // reject before the conversion, which would overflow for a tiny velocity
+    if (!(seconds * SC_TICK_FREQ <= SC_GESTURE_MAX_DURATION)) {
+        LOGE("Gesture: fling too slow");
+        return false;
+    }
+
+    sc_tick duration = SC_TICK_FREQ * seconds;
+    if (!duration) {
+        // the finger does not move
+        duration = SC_TICK_FROM_MS(1);
+    }
+
+    return generate(fling_path, fling, 1, duration, screen_size, rate,
+                    out_msgs, out_count);
+}
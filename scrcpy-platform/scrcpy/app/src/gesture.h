@@ -0,0 +1,77 @@
+#ifndef SC_GESTURE_H
+#define SC_GESTURE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "coords.h"
+#include "input_trace.h"
+#include "util/tick.h"
+
+// Synthesize touch gestures as sequences of timed messages, to be injected
+// by an input replay (see input_replay.h).
+//
+// A gesture starts with an ACTION_DOWN for each finger at offset 0, then
+// moves all the fingers at the requested event rate, and ends with an
+// ACTION_UP for each finger at the end of the duration. Finger i uses
+// POINTER_ID_GESTURE(i), like the virtual finger used for pinch-to-zoom in
+// input_manager.c.
+
+#define SC_GESTURE_MAX_RATE 1000
+#define SC_GESTURE_MAX_DURATION SC_TICK_FROM_SEC(60)
+#define SC_GESTURE_MAX_FINGERS 2
+
+struct sc_swipe {
+    struct point from;
+    struct point to;
+    // if set, follow a cubic Bézier curve through the control points
+    bool bezier;
+    struct point control1;
+    struct point control2;
+    sc_tick duration;
+};
+
+// Two fingers, symmetric around the center: the distance between them
+// (span) and their angle (in degrees, counterclockwise from the x axis) are
+// interpolated linearly, so that the same gesture may zoom and rotate.
+struct sc_pinch {
+    struct point center;
+    uint16_t start_span;
+    uint16_t end_span;
+    float start_angle;
+    float end_angle;
+    sc_tick duration;
+};
+
+// A swipe with a constant acceleration from rest, so that the finger is
+// released at the given velocity (in pixels per second), as a real fling.
+struct sc_fling {
+    struct point from;
+    struct point to;
+    float velocity;
+};
+
+// For all the functions below, the generated messages must be released by
+// sc_timed_msgs_destroy(). The positions are clamped to the screen size.
+//
+// rate is the number of events per second (per finger), at most
+// SC_GESTURE_MAX_RATE. A gesture lasts at most SC_GESTURE_MAX_DURATION.
+
+bool
+sc_gesture_swipe(const struct sc_swipe *swipe, struct size screen_size,
+                 unsigned rate, struct sc_timed_msg **out_msgs,
+                 size_t *out_count);
+
+bool
+sc_gesture_pinch(const struct sc_pinch *pinch, struct size screen_size,
+                 unsigned rate, struct sc_timed_msg **out_msgs,
+                 size_t *out_count);
+
+bool
+sc_gesture_fling(const struct sc_fling *fling, struct size screen_size,
+                 unsigned rate, struct sc_timed_msg **out_msgs,
+                 size_t *out_count);
+
+#endif
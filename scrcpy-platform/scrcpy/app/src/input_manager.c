@@ -257,11 +257,8 @@ switch_fps_counter_state(struct fps_counter *fps_counter) {
         fps_counter_stop(fps_counter);
         LOGI("FPS counter stopped");
     } else {
-        if (fps_counter_start(fps_counter)) {
-            LOGI("FPS counter started");
-        } else {
-            LOGE("FPS counter starting failed");
-        }
+        fps_counter_start(fps_counter);
+        LOGI("FPS counter started");
     }
 }
 
@@ -613,7 +610,8 @@ input_manager_process_mouse_motion(struct input_manager *im,
     }
 
     if (!controller_push_msg(im->controller, &msg)) {
-        LOGW("Could not request 'inject mouse motion event'");
+        LOG_RATELIMITED(LOGW, SC_TICK_FROM_SEC(1),
+                        "Could not request 'inject mouse motion event'");
     }
 
     if (im->vfinger_down) {
@@ -656,7 +654,8 @@ input_manager_process_touch(struct input_manager *im,
     struct control_msg msg;
     if (convert_touch(event, im->screen, &msg)) {
         if (!controller_push_msg(im->controller, &msg)) {
-            LOGW("Could not request 'inject touch event'");
+            LOG_RATELIMITED(LOGW, SC_TICK_FROM_SEC(1),
+                            "Could not request 'inject touch event'");
         }
     }
 }
@@ -803,7 +802,8 @@ input_manager_process_mouse_wheel(struct input_manager *im,
     struct control_msg msg;
     if (convert_mouse_wheel(event, im->screen, &msg)) {
         if (!controller_push_msg(im->controller, &msg)) {
-            LOGW("Could not request 'inject mouse wheel event'");
+            LOG_RATELIMITED(LOGW, SC_TICK_FROM_SEC(1),
+                            "Could not request 'inject mouse wheel event'");
         }
     }
 }
@@ -0,0 +1,192 @@
+#include "input_replay.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+bool
+sc_input_replay_init(struct sc_input_replay *replay,
+                     struct controller *controller,
+                     struct sc_timed_msg *msgs, size_t count) {
+    replay->msgs = msgs;
+    replay->count = count;
+
+    replay->lateness = malloc((count ? count : 1) * sizeof(*replay->lateness));
+    if (!replay->lateness) {
+        LOGC("Could not allocate replay stats");
+        goto error_free_msgs;
+    }
+
+    bool ok = sc_mutex_init(&replay->mutex);
+    if (!ok) {
+        goto error_free_lateness;
+    }
+
+    ok = sc_cond_init(&replay->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    replay->controller = controller;
+    replay->stopped = false;
+    replay->pushed = 0;
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&replay->mutex);
+error_free_lateness:
+    free(replay->lateness);
+error_free_msgs:
+    sc_timed_msgs_destroy(msgs, count);
+
+    return false;
+}
+
+void
+sc_input_replay_destroy(struct sc_input_replay *replay) {
+    sc_cond_destroy(&replay->cond);
+    sc_mutex_destroy(&replay->mutex);
+    free(replay->lateness);
+    sc_timed_msgs_destroy(replay->msgs, replay->count);
+}
+
+// Wait until the deadline, return false if the replay has been stopped
+static bool
+wait_deadline(struct sc_input_replay *replay, sc_tick deadline) {
+    sc_mutex_lock(&replay->mutex);
+    // sleep until shortly before the deadline (the wait may be interrupted)
+    while (!replay->stopped
+            && sc_tick_now() < deadline - SC_INPUT_REPLAY_SPIN) {
+        sc_cond_timedwait(&replay->cond, &replay->mutex,
+                          deadline - SC_INPUT_REPLAY_SPIN);
+    }
+    bool stopped = replay->stopped;
+    sc_mutex_unlock(&replay->mutex);
+
+    if (stopped) {
+        return false;
+    }
+
+    // then spin for the remaining time
+    while (sc_tick_now() < deadline) {
+        // busy wait
+    }
+
+    return true;
+}
+
+// The controller takes ownership of the message, so the owned strings must
+// be copied (the sequence keeps its own)
+static bool
+copy_msg(const struct control_msg *src, struct control_msg *dst) {
+    *dst = *src;
+    switch (src->type) {
+        case CONTROL_MSG_TYPE_INJECT_TEXT:
+            dst->inject_text.text = strdup(src->inject_text.text);
+            return dst->inject_text.text;
+        case CONTROL_MSG_TYPE_SET_CLIPBOARD:
+            dst->set_clipboard.text = strdup(src->set_clipboard.text);
+            return dst->set_clipboard.text;
+        default:
+            return true;
+    }
+}
+
+static int
+compare_ticks(const void *a, const void *b) {
+    sc_tick ta = *(const sc_tick *) a;
+    sc_tick tb = *(const sc_tick *) b;
+    return (ta > tb) - (ta < tb);
+}
+
+static int
+run_replay(void *data) {
+    struct sc_input_replay *replay = data;
+
+    sc_tick start = sc_tick_now();
+    for (size_t i = 0; i < replay->count; ++i) {
+        const struct sc_timed_msg *tm = &replay->msgs[i];
+        sc_tick deadline = start + tm->offset;
+        if (!wait_deadline(replay, deadline)) {
+            LOGD("Input replay interrupted");
+            break;
+        }
+
+        struct control_msg msg;
+        if (!copy_msg(&tm->msg, &msg)) {
+            LOGC("Could not copy input event");
+            break;
+        }
+
+        if (!controller_push_msg(replay->controller, &msg)) {
+            LOGW("Could not replay input event");
+            control_msg_destroy(&msg);
+            continue;
+        }
+
+        replay->lateness[replay->pushed++] = sc_tick_now() - deadline;
+    }
+
+    struct sc_input_replay_stats stats;
+    sc_input_replay_get_stats(replay, &stats);
+    LOGD("Input replay: %" PRIu64 "/%" PRIu64 " events, lateness (us): "
+         "p50=%" PRItick " p90=%" PRItick " p99=%" PRItick " max=%" PRItick,
+         (uint64_t) stats.count, (uint64_t) replay->count,
+         stats.p50, stats.p90, stats.p99, stats.max);
+
+    return 0;
+}
+
+bool
+sc_input_replay_start(struct sc_input_replay *replay) {
+    LOGD("Starting input replay thread");
+
+    bool ok = sc_thread_create(&replay->thread, run_replay, "input_replay",
+                               replay);
+    if (!ok) {
+        LOGC("Could not start input replay thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_input_replay_stop(struct sc_input_replay *replay) {
+    sc_mutex_lock(&replay->mutex);
+    replay->stopped = true;
+    sc_cond_signal(&replay->cond);
+    sc_mutex_unlock(&replay->mutex);
+}
+
+void
+sc_input_replay_join(struct sc_input_replay *replay) {
+    sc_thread_join(&replay->thread, NULL);
+}
+
+static sc_tick
+get_percentile(const sc_tick *sorted, size_t count, unsigned percent) {
+    // nearest-rank
+    size_t rank = (count * percent + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+void
+sc_input_replay_get_stats(struct sc_input_replay *replay,
+                          struct sc_input_replay_stats *stats) {
+    size_t n = replay->pushed;
+    stats->count = n;
+    if (!n) {
+        stats->p50 = stats->p90 = stats->p99 = stats->max = 0;
+        return;
+    }
+
+    qsort(replay->lateness, n, sizeof(*replay->lateness), compare_ticks);
+    stats->p50 = get_percentile(replay->lateness, n, 50);
+    stats->p90 = get_percentile(replay->lateness, n, 90);
+    stats->p99 = get_percentile(replay->lateness, n, 99);
+    stats->max = replay->lateness[n - 1];
+}
@@ -0,0 +1,73 @@
+#ifndef SC_INPUT_REPLAY_H
+#define SC_INPUT_REPLAY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "controller.h"
+#include "input_trace.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Below this delay before a deadline, the replay thread spins instead of
+// waiting on the condition (whose resolution is in milliseconds)
+#define SC_INPUT_REPLAY_SPIN SC_TICK_FROM_MS(2)
+
+// Scheduling lateness (the delay between the deadline and the push to the
+// controller), in microseconds
+struct sc_input_replay_stats {
+    size_t count; // events pushed
+    sc_tick p50;
+    sc_tick p90;
+    sc_tick p99;
+    sc_tick max;
+};
+
+// Push a sequence of timed messages to the controller from a dedicated
+// thread, each at its absolute deadline (start + offset) on the monotonic
+// clock
+struct sc_input_replay {
+    struct controller *controller;
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+
+    struct sc_timed_msg *msgs; // owned
+    size_t count;
+
+    // only accessed from the replay thread until it terminates
+    sc_tick *lateness; // one value per pushed event
+    size_t pushed;
+};
+
+// Take ownership of msgs (even on failure), to be freed by
+// sc_input_replay_destroy()
+//
+// The messages offsets must be ordered.
+bool
+sc_input_replay_init(struct sc_input_replay *replay,
+                     struct controller *controller,
+                     struct sc_timed_msg *msgs, size_t count);
+
+bool
+sc_input_replay_start(struct sc_input_replay *replay);
+
+// Interrupt the replay (the remaining events are dropped)
+void
+sc_input_replay_stop(struct sc_input_replay *replay);
+
+void
+sc_input_replay_join(struct sc_input_replay *replay);
+
+void
+sc_input_replay_destroy(struct sc_input_replay *replay);
+
+// Must be called after sc_input_replay_join()
+void
+sc_input_replay_get_stats(struct sc_input_replay *replay,
+                          struct sc_input_replay_stats *stats);
+
+#endif
@@ -0,0 +1,364 @@
+#include "input_trace.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/buffer_util.h"
+#include "util/log.h"
+
+static int
+run_input_trace_writer(void *data) {
+    struct sc_input_trace_writer *writer = data;
+
+    // the buffer being written, exchanged with the pending one
+    struct sc_input_trace_buffer buf = {
+        .data = NULL,
+        .len = 0,
+        .cap = 0,
+    };
+
+    sc_mutex_lock(&writer->mutex);
+    for (;;) {
+        while (!writer->stopped && !writer->committed) {
+            sc_cond_wait(&writer->cond, &writer->mutex);
+        }
+
+        if (!writer->committed) {
+            // stopped, and all the events are written
+            break;
+        }
+
+        // Nothing is staged while the mutex is held, so all the pending
+        // records are committed
+        assert(writer->pending.len == writer->committed);
+        struct sc_input_trace_buffer tmp = writer->pending;
+        writer->pending = buf;
+        writer->committed = 0;
+        buf = tmp;
+
+        sc_mutex_unlock(&writer->mutex);
+        // the writes are buffered by stdio
+        bool ok = fwrite(buf.data, buf.len, 1, writer->file) == 1;
+        buf.len = 0;
+        sc_mutex_lock(&writer->mutex);
+
+        if (!ok) {
+            LOGE("Could not write input trace, recording stopped");
+            writer->failed = true;
+            break;
+        }
+    }
+    sc_mutex_unlock(&writer->mutex);
+
+    free(buf.data);
+
+    return 0;
+}
+
+bool
+sc_input_trace_writer_init(struct sc_input_trace_writer *writer,
+                           const char *filename) {
+    writer->buf = malloc(CONTROL_MSG_MAX_SIZE);
+    if (!writer->buf) {
+        LOGC("Could not allocate input trace buffer");
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&writer->mutex);
+    if (!ok) {
+        goto error_free_buf;
+    }
+
+    ok = sc_cond_init(&writer->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    writer->file = fopen(filename, "wb");
+    if (!writer->file) {
+        LOGE("Could not open input trace file: %s", filename);
+        goto error_destroy_cond;
+    }
+
+    unsigned char header[SC_INPUT_TRACE_HEADER_SIZE];
+    memcpy(header, SC_INPUT_TRACE_MAGIC, 4);
+    buffer_write32be(&header[4], SC_INPUT_TRACE_VERSION);
+    if (fwrite(header, sizeof(header), 1, writer->file) != 1) {
+        LOGE("Could not write input trace header");
+        goto error_close;
+    }
+
+    writer->pending.data = NULL;
+    writer->pending.len = 0;
+    writer->pending.cap = 0;
+    writer->committed = 0;
+    writer->stopped = false;
+    writer->started = false;
+    writer->failed = false;
+
+    ok = sc_thread_create(&writer->thread, run_input_trace_writer,
+                          "input_trace", writer);
+    if (!ok) {
+        LOGC("Could not start input trace thread");
+        goto error_close;
+    }
+
+    LOGI("Recording input events to %s", filename);
+
+    return true;
+
+error_close:
+    fclose(writer->file);
+error_destroy_cond:
+    sc_cond_destroy(&writer->cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&writer->mutex);
+error_free_buf:
+    free(writer->buf);
+
+    return false;
+}
+
+void
+sc_input_trace_writer_destroy(struct sc_input_trace_writer *writer) {
+    sc_mutex_lock(&writer->mutex);
+    writer->stopped = true;
+    sc_cond_signal(&writer->cond);
+    sc_mutex_unlock(&writer->mutex);
+
+    sc_thread_join(&writer->thread, NULL);
+
+    if (fclose(writer->file)) {
+        LOGE("Could not close input trace file");
+    }
+    free(writer->pending.data);
+    sc_cond_destroy(&writer->cond);
+    sc_mutex_destroy(&writer->mutex);
+    free(writer->buf);
+}
+
+void
+sc_input_trace_writer_lock(struct sc_input_trace_writer *writer) {
+    sc_mutex_lock(&writer->mutex);
+    assert(writer->pending.len == writer->committed);
+}
+
+static bool
+reserve(struct sc_input_trace_buffer *buf, size_t size) {
+    size_t needed = buf->len + size;
+    if (needed <= buf->cap) {
+        return true;
+    }
+
+    if (needed > SC_INPUT_TRACE_MAX_PENDING) {
+        LOGE("Input trace file does not keep up, recording stopped");
+        return false;
+    }
+
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < needed) {
+        cap *= 2;
+    }
+    if (cap > SC_INPUT_TRACE_MAX_PENDING) {
+        cap = SC_INPUT_TRACE_MAX_PENDING;
+    }
+
+    unsigned char *data = realloc(buf->data, cap);
+    if (!data) {
+        LOGC("Could not allocate input trace buffer");
+        return false;
+    }
+
+    buf->data = data;
+    buf->cap = cap;
+    return true;
+}
+
+bool
+sc_input_trace_writer_add(struct sc_input_trace_writer *writer,
+                          const struct control_msg *msg) {
+    sc_mutex_assert(&writer->mutex);
+
+    if (writer->failed) {
+        return false;
+    }
+
+    size_t len = control_msg_serialize(msg, writer->buf);
+    if (!len) {
+        return false;
+    }
+
+    sc_tick now = sc_tick_now();
+    if (!writer->started) {
+        writer->start = now;
+        writer->started = true;
+    }
+
+    struct sc_input_trace_buffer *pending = &writer->pending;
+    if (!reserve(pending, SC_INPUT_TRACE_RECORD_HEADER_SIZE + len)) {
+        writer->failed = true;
+        return false;
+    }
+
+    unsigned char *record = &pending->data[pending->len];
+    buffer_write64be(&record[0], now - writer->start);
+    buffer_write32be(&record[8], len);
+    memcpy(&record[SC_INPUT_TRACE_RECORD_HEADER_SIZE], writer->buf, len);
+    pending->len += SC_INPUT_TRACE_RECORD_HEADER_SIZE + len;
+
+    return true;
+}
+
+void
+sc_input_trace_writer_unlock(struct sc_input_trace_writer *writer,
+                             bool commit) {
+    sc_mutex_assert(&writer->mutex);
+
+    if (commit && !writer->failed) {
+        if (writer->pending.len != writer->committed) {
+            writer->committed = writer->pending.len;
+            sc_cond_signal(&writer->cond);
+        }
+    } else {
+        // discard the staged records
+        writer->pending.len = writer->committed;
+    }
+
+    sc_mutex_unlock(&writer->mutex);
+}
+
+bool
+sc_input_trace_writer_write(struct sc_input_trace_writer *writer,
+                            const struct control_msg *msg) {
+    sc_input_trace_writer_lock(writer);
+    bool ok = sc_input_trace_writer_add(writer, msg);
+    sc_input_trace_writer_unlock(writer, ok);
+    return ok;
+}
+
+void
+sc_timed_msgs_destroy(struct sc_timed_msg *msgs, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        control_msg_destroy(&msgs[i].msg);
+    }
+    free(msgs);
+}
+
+static bool
+read_record(FILE *file, unsigned char *buf, struct sc_timed_msg *tm,
+            bool *eof) {
+    unsigned char header[SC_INPUT_TRACE_RECORD_HEADER_SIZE];
+    size_t r = fread(header, 1, sizeof(header), file);
+    if (!r && feof(file)) {
+        *eof = true;
+        return true;
+    }
+    if (r != sizeof(header)) {
+        LOGE("Truncated input trace record header");
+        return false;
+    }
+
+    tm->offset = buffer_read64be(&header[0]);
+    uint32_t len = buffer_read32be(&header[8]);
+    if (tm->offset < 0 || !len || len > CONTROL_MSG_MAX_SIZE) {
+        LOGE("Invalid input trace record");
+        return false;
+    }
+
+    if (fread(buf, len, 1, file) != 1) {
+        LOGE("Truncated input trace record");
+        return false;
+    }
+
+    ssize_t consumed = control_msg_deserialize(buf, len, &tm->msg);
+    if (consumed <= 0) {
+        LOGE("Invalid message in input trace");
+        return false;
+    }
+    if ((size_t) consumed != len) {
+        LOGE("Unexpected message length in input trace");
+        control_msg_destroy(&tm->msg);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sc_input_trace_load(const char *filename, struct sc_timed_msg **out_msgs,
+                    size_t *out_count) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        LOGE("Could not open input trace file: %s", filename);
+        return false;
+    }
+
+    struct sc_timed_msg *msgs = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+
+    unsigned char *buf = malloc(CONTROL_MSG_MAX_SIZE);
+    if (!buf) {
+        LOGC("Could not allocate input trace buffer");
+        goto error_close;
+    }
+
+    unsigned char header[SC_INPUT_TRACE_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, file) != 1
+            || memcmp(header, SC_INPUT_TRACE_MAGIC, 4)) {
+        LOGE("Not an input trace file: %s", filename);
+        goto error_free;
+    }
+
+    uint32_t version = buffer_read32be(&header[4]);
+    if (version != SC_INPUT_TRACE_VERSION) {
+        LOGE("Unsupported input trace version: %" PRIu32, version);
+        goto error_free;
+    }
+
+    for (;;) {
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 256;
+            struct sc_timed_msg *new_msgs =
+                realloc(msgs, new_cap * sizeof(*msgs));
+            if (!new_msgs) {
+                LOGC("Could not allocate input trace events");
+                goto error_free;
+            }
+            msgs = new_msgs;
+            cap = new_cap;
+        }
+
+        bool eof = false;
+        if (!read_record(file, buf, &msgs[count], &eof)) {
+            goto error_free;
+        }
+        if (eof) {
+            break;
+        }
+
+        if (count && msgs[count].offset < msgs[count - 1].offset) {
+            LOGE("Input trace events are not ordered");
+            control_msg_destroy(&msgs[count].msg);
+            goto error_free;
+        }
+        ++count;
+    }
+
+    free(buf);
+    fclose(file);
+
+    *out_msgs = msgs;
+    *out_count = count;
+    return true;
+
+error_free:
+    sc_timed_msgs_destroy(msgs, count);
+    free(buf);
+error_close:
+    fclose(file);
+
+    return false;
+}
@@ -0,0 +1,106 @@
+#ifndef SC_INPUT_TRACE_H
+#define SC_INPUT_TRACE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "control_msg.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Input trace file format (all values are big-endian):
+//
+//     header: "SCIT" (4 bytes), version (4 bytes)
+//     then, for each event:
+//         offset from the first event, in microseconds (8 bytes)
+//         length of the message (4 bytes)
+//         the message, as serialized by control_msg_serialize()
+//
+// The messages are stored in the wire format, so that a trace contains
+// exactly what was sent to the device.
+#define SC_INPUT_TRACE_MAGIC "SCIT"
+#define SC_INPUT_TRACE_VERSION 1
+#define SC_INPUT_TRACE_HEADER_SIZE 8
+#define SC_INPUT_TRACE_RECORD_HEADER_SIZE 12
+
+// A message to inject at a given offset from the start of the sequence
+struct sc_timed_msg {
+    sc_tick offset;
+    struct control_msg msg;
+};
+
+// Maximum size of the records waiting to be written: if the file does not
+// keep up, the recording is stopped rather than using unbounded memory
+#define SC_INPUT_TRACE_MAX_PENDING (1 << 22) // 4M
+
+struct sc_input_trace_buffer {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+};
+
+// Record the input events into a trace file
+//
+// The events may be added from any thread. They are only serialized into a
+// memory buffer, and written to the file by a separate thread.
+struct sc_input_trace_writer {
+    FILE *file;
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped; // set on destroy, once all the events are added
+    bool started; // set once the first event is added
+    sc_tick start;
+    unsigned char *buf; // CONTROL_MSG_MAX_SIZE, to serialize a message
+    // the records waiting to be written, of which the first committed bytes
+    // can be written (the next ones are staged until unlocked)
+    struct sc_input_trace_buffer pending;
+    size_t committed;
+    bool failed; // set on the first error, the recording is stopped
+};
+
+bool
+sc_input_trace_writer_init(struct sc_input_trace_writer *writer,
+                           const char *filename);
+
+// Write the remaining events and close the file
+void
+sc_input_trace_writer_destroy(struct sc_input_trace_writer *writer);
+
+// Lock the writer to add events, which are recorded only if committed by
+// sc_input_trace_writer_unlock()
+//
+// This allows to serialize a message before pushing it (it may not be
+// accessed after), but to record it only if the push succeeds.
+void
+sc_input_trace_writer_lock(struct sc_input_trace_writer *writer);
+
+// Timestamp msg with the current time and stage it (the writer must be
+// locked)
+bool
+sc_input_trace_writer_add(struct sc_input_trace_writer *writer,
+                          const struct control_msg *msg);
+
+// Commit (or discard) the events staged since the lock, and unlock
+void
+sc_input_trace_writer_unlock(struct sc_input_trace_writer *writer,
+                             bool commit);
+
+// Timestamp msg with the current time and append it to the trace
+bool
+sc_input_trace_writer_write(struct sc_input_trace_writer *writer,
+                            const struct control_msg *msg);
+
+// Load all the messages of a trace file into an allocated array, to be freed
+// by sc_timed_msgs_destroy()
+bool
+sc_input_trace_load(const char *filename, struct sc_timed_msg **out_msgs,
+                    size_t *out_count);
+
+void
+sc_timed_msgs_destroy(struct sc_timed_msg *msgs, size_t count);
+
+#endif
@@ -0,0 +1,178 @@
+#include "latest_frame.h"
+
+#include <assert.h>
+#include <libavutil/frame.h>
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_latest_frame */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_latest_frame, frame_sink)
+
+static void
+sc_latest_frame_wake_up(struct sc_latest_frame *lf) {
+    sc_mutex_lock(&lf->mutex);
+    sc_cond_broadcast(&lf->cond);
+    sc_mutex_unlock(&lf->mutex);
+}
+
+static bool
+sc_latest_frame_frame_sink_open(struct sc_frame_sink *sink) {
+    struct sc_latest_frame *lf = DOWNCAST(sink);
+    sc_mutex_lock(&lf->mutex);
+    lf->stopped = false;
+    sc_mutex_unlock(&lf->mutex);
+    return true;
+}
+
+static void
+sc_latest_frame_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_latest_frame *lf = DOWNCAST(sink);
+    sc_mutex_lock(&lf->mutex);
+    lf->stopped = true;
+    sc_cond_broadcast(&lf->cond);
+    sc_mutex_unlock(&lf->mutex);
+}
+
+static bool
+sc_latest_frame_frame_sink_push(struct sc_frame_sink *sink,
+                                const AVFrame *frame) {
+    struct sc_latest_frame *lf = DOWNCAST(sink);
+
+    if (atomic_load_explicit(&lf->interrupted, memory_order_relaxed)) {
+        // nobody will acquire it
+        return true;
+    }
+
+    // the back frame belongs to this thread
+    AVFrame *back = lf->frames[sc_triple_buffer_back(&lf->tb)];
+    av_frame_unref(back);
+    int r = av_frame_ref(back, frame);
+    if (r) {
+        LOGE("Could not ref frame: %d", r);
+        return false;
+    }
+
+    sc_triple_buffer_publish(&lf->tb);
+
+    // Publishing and reading waiters are sequentially consistent: either the
+    // consumer sees the new frame, or it is seen waiting here
+    if (atomic_load(&lf->waiters)) {
+        sc_latest_frame_wake_up(lf);
+    }
+
+    return true;
+}
+
+bool
+sc_latest_frame_init(struct sc_latest_frame *lf) {
+    unsigned i;
+    for (i = 0; i < 3; ++i) {
+        lf->frames[i] = av_frame_alloc();
+        if (!lf->frames[i]) {
+            LOGE("Could not allocate frame");
+            goto error_free_frames;
+        }
+    }
+
+    if (!sc_mutex_init(&lf->mutex)) {
+        goto error_free_frames;
+    }
+
+    if (!sc_cond_init(&lf->cond)) {
+        goto error_destroy_mutex;
+    }
+
+    sc_triple_buffer_init(&lf->tb);
+    lf->acquired = false;
+    atomic_init(&lf->waiters, 0);
+    lf->stopped = false;
+    atomic_init(&lf->interrupted, false);
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_latest_frame_frame_sink_open,
+        .close = sc_latest_frame_frame_sink_close,
+        .push = sc_latest_frame_frame_sink_push,
+    };
+
+    lf->frame_sink.ops = &ops;
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&lf->mutex);
+error_free_frames:
+    while (i--) {
+        av_frame_free(&lf->frames[i]);
+    }
+
+    return false;
+}
+
+void
+sc_latest_frame_destroy(struct sc_latest_frame *lf) {
+    sc_cond_destroy(&lf->cond);
+    sc_mutex_destroy(&lf->mutex);
+    for (unsigned i = 0; i < 3; ++i) {
+        av_frame_free(&lf->frames[i]);
+    }
+}
+
+// Wait until a frame is published, the stream is closed or the deadline
+// (0 for no deadline) is reached
+static void
+sc_latest_frame_wait(struct sc_latest_frame *lf, sc_tick deadline) {
+    sc_mutex_lock(&lf->mutex);
+    atomic_fetch_add(&lf->waiters, 1);
+    while (!sc_triple_buffer_has_new(&lf->tb) && !lf->stopped
+            && !atomic_load(&lf->interrupted)) {
+        if (!deadline) {
+            sc_cond_wait(&lf->cond, &lf->mutex);
+        } else if (!sc_cond_timedwait(&lf->cond, &lf->mutex, deadline)) {
+            // timeout
+            break;
+        }
+    }
+    atomic_fetch_sub(&lf->waiters, 1);
+    sc_mutex_unlock(&lf->mutex);
+}
+
+const AVFrame *
+sc_latest_frame_acquire(struct sc_latest_frame *lf, sc_tick timeout,
+                        uint64_t *seq) {
+    assert(!lf->acquired);
+
+    if (atomic_load(&lf->interrupted)) {
+        return NULL;
+    }
+
+    if (timeout && !sc_triple_buffer_has_new(&lf->tb)) {
+        sc_tick deadline = timeout > 0 ? sc_tick_now() + timeout : 0;
+        sc_latest_frame_wait(lf, deadline);
+    }
+
+    unsigned index;
+    if (!sc_triple_buffer_acquire(&lf->tb, &index, seq)) {
+        return NULL;
+    }
+
+    lf->acquired = true;
+    return lf->frames[index];
+}
+
+void
+sc_latest_frame_release(struct sc_latest_frame *lf) {
+    assert(lf->acquired);
+    lf->acquired = false;
+
+    // The front frame belongs to the consumer until the next acquire, but
+    // give its buffers back to the decoder now
+    av_frame_unref(lf->frames[sc_triple_buffer_front(&lf->tb)]);
+}
+
+void
+sc_latest_frame_interrupt(struct sc_latest_frame *lf) {
+    sc_mutex_lock(&lf->mutex);
+    atomic_store(&lf->interrupted, true);
+    sc_cond_broadcast(&lf->cond);
+    sc_mutex_unlock(&lf->mutex);
+}
@@ -0,0 +1,66 @@
+#ifndef SC_LATEST_FRAME_H
+#define SC_LATEST_FRAME_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trait/frame_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/triple_buffer.h"
+
+// Keep the latest decoded frame (by reference, without copy) for a consumer
+// polling at its own rate, instead of calling it for every frame.
+//
+// The decoder never waits for the consumer: the frames are exchanged through
+// a triple buffer.
+struct sc_latest_frame {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    AVFrame *frames[3];
+    struct sc_triple_buffer tb;
+
+    // accessed only by the consumer
+    bool acquired;
+
+    // to wait for a new frame
+    sc_mutex mutex;
+    sc_cond cond;
+    atomic_uint waiters;
+    bool stopped; // protected by mutex
+    // set by sc_latest_frame_interrupt(), never reset
+    atomic_bool interrupted;
+};
+
+bool
+sc_latest_frame_init(struct sc_latest_frame *lf);
+
+void
+sc_latest_frame_destroy(struct sc_latest_frame *lf);
+
+// Return the latest frame if it has not been acquired yet, or NULL
+//
+// If there is no new frame, wait at most timeout (0 to return immediately,
+// negative to wait until a frame is received or the stream is closed).
+//
+// The frame is valid until sc_latest_frame_release(), which must be called
+// before acquiring another frame. Must always be called from the same thread
+// (or with external synchronization).
+const AVFrame *
+sc_latest_frame_acquire(struct sc_latest_frame *lf, sc_tick timeout,
+                        uint64_t *seq);
+
+void
+sc_latest_frame_release(struct sc_latest_frame *lf);
+
+// Wake up the consumer waiting in sc_latest_frame_acquire() (if any), and make
+// the next calls return NULL immediately. The next frames are not kept.
+//
+// May be called from any thread.
+void
+sc_latest_frame_interrupt(struct sc_latest_frame *lf);
+
+#endif
@@ -0,0 +1,493 @@
+#include "metrics.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+#include "util/log.h"
+#include "util/net.h"
+#include "util/str_util.h"
+#include "util/thread.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+#define UNIX_PREFIX "unix:"
+#define REQUEST_TIMEOUT SC_TICK_FROM_SEC(5)
+
+struct sc_metric_desc {
+    const char *name;
+    const char *help;
+    bool gauge;
+};
+
+static const struct sc_metric_desc descs[SC_METRIC_COUNT] = {
+    [SC_METRIC_RECEIVED_BYTES] = {
+        "scrcpy_received_bytes_total",
+        "Video bytes received from the device", false,
+    },
+    [SC_METRIC_PACKETS] = {
+        "scrcpy_packets_total",
+        "Video packets received from the device", false,
+    },
+    [SC_METRIC_KEYFRAMES] = {
+        "scrcpy_keyframes_total",
+        "Video key frames received from the device", false,
+    },
+    [SC_METRIC_DECODED_FRAMES] = {
+        "scrcpy_decoded_frames_total",
+        "Frames decoded", false,
+    },
+    [SC_METRIC_RENDERED_FRAMES] = {
+        "scrcpy_rendered_frames_total",
+        "Frames rendered on the screen", false,
+    },
+    [SC_METRIC_SKIPPED_FRAMES] = {
+        "scrcpy_skipped_frames_total",
+        "Decoded frames replaced before being rendered", false,
+    },
+    [SC_METRIC_CONTROL_MSGS] = {
+        "scrcpy_control_messages_total",
+        "Control messages sent to the device", false,
+    },
+    [SC_METRIC_CONTROL_BYTES] = {
+        "scrcpy_control_bytes_total",
+        "Control bytes sent to the device", false,
+    },
+    [SC_METRIC_RECORDED_BYTES] = {
+        "scrcpy_recorded_bytes_total",
+        "Packet bytes written by the recorder", false,
+    },
+    [SC_METRIC_RECONNECTIONS] = {
+        "scrcpy_reconnections_total",
+        "Reconnections after a disconnection of the device", false,
+    },
+    [SC_METRIC_RECONNECT_DOWNTIME] = {
+        "scrcpy_reconnect_downtime_microseconds_total",
+        "Time spent reconnecting to the device", false,
+    },
+    [SC_METRIC_CONTROL_QUEUE] = {
+        "scrcpy_control_queue_depth",
+        "Control messages waiting to be sent", true,
+    },
+    [SC_METRIC_RECORDER_QUEUE] = {
+        "scrcpy_recorder_queue_depth",
+        "Packets waiting to be recorded", true,
+    },
+};
+
+// the registered metrics, protected by the lock
+static struct sc_metrics *registry;
+static sc_static_mutex registry_lock = SC_STATIC_MUTEX_INIT;
+
+void
+sc_metrics_init(struct sc_metrics *metrics, const char *serial) {
+    if (serial) {
+        xstrncpy(metrics->serial, serial, sizeof(metrics->serial));
+    } else {
+        metrics->serial[0] = '\0';
+    }
+
+    for (unsigned i = 0; i < SC_METRIC_COUNT; ++i) {
+        atomic_init(&metrics->values[i], 0);
+        metrics->sample[i] = NULL;
+        metrics->sample_userdata[i] = NULL;
+    }
+    for (unsigned i = 0; i < SC_METRICS_MAX_SINKS; ++i) {
+        atomic_init(&metrics->sink_frames[i], 0);
+    }
+    sc_histogram_init(&metrics->decode_time);
+    metrics->next = NULL;
+}
+
+void
+sc_metrics_set_sample(struct sc_metrics *metrics, enum sc_metric_id id,
+                      int64_t (*sample)(void *userdata), void *userdata) {
+    metrics->sample[id] = sample;
+    metrics->sample_userdata[id] = userdata;
+}
+
+int64_t
+sc_metrics_get(struct sc_metrics *metrics, enum sc_metric_id id) {
+    if (metrics->sample[id]) {
+        return metrics->sample[id](metrics->sample_userdata[id]);
+    }
+    return atomic_load_explicit(&metrics->values[id], memory_order_relaxed);
+}
+
+void
+sc_metrics_register(struct sc_metrics *metrics) {
+    sc_static_mutex_lock(&registry_lock);
+    metrics->next = registry;
+    registry = metrics;
+    sc_static_mutex_unlock(&registry_lock);
+}
+
+void
+sc_metrics_unregister(struct sc_metrics *metrics) {
+    sc_static_mutex_lock(&registry_lock);
+    struct sc_metrics **p = &registry;
+    while (*p && *p != metrics) {
+        p = &(*p)->next;
+    }
+    if (*p) {
+        *p = metrics->next;
+    }
+    sc_static_mutex_unlock(&registry_lock);
+    metrics->next = NULL;
+}
+
+// Append formatted text, counting the length even once the buffer is full
+struct sc_text {
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+static void
+text_append(struct sc_text *text, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    size_t remaining = text->len < text->size ? text->size - text->len : 0;
+    int r = vsnprintf(remaining ? text->buf + text->len : NULL, remaining,
+                      fmt, ap);
+    va_end(ap);
+    if (r > 0) {
+        text->len += r;
+    }
+}
+
+// Append the serial as a label value, escaped as required by the format
+static void
+text_append_label(struct sc_text *text, const char *value) {
+    for (const char *c = value; *c; ++c) {
+        if (*c == '\\' || *c == '"') {
+            text_append(text, "\\%c", *c);
+        } else if (*c == '\n') {
+            text_append(text, "\\n");
+        } else {
+            text_append(text, "%c", *c);
+        }
+    }
+}
+
+static void
+text_append_labels(struct sc_text *text, const char *serial) {
+    text_append(text, "{serial=\"");
+    text_append_label(text, serial);
+    text_append(text, "\"");
+}
+
+static void
+format_histogram(struct sc_text *text, const char *name,
+                 struct sc_metrics *metrics) {
+    struct sc_histogram_snapshot snapshot;
+    sc_histogram_snapshot(&metrics->decode_time, &snapshot);
+
+    unsigned last = 0;
+    for (unsigned i = 0; i < SC_HISTOGRAM_BUCKETS; ++i) {
+        if (snapshot.buckets[i]) {
+            last = i;
+        }
+    }
+
+    // the upper bound of bucket i is 2^(i+1) (exclusive, but the values are
+    // integers)
+    uint64_t cumulative = 0;
+    for (unsigned i = 0; i <= last; ++i) {
+        cumulative += snapshot.buckets[i];
+        text_append(text, "%s_bucket", name);
+        text_append_labels(text, metrics->serial);
+        text_append(text, ",le=\"%" PRIu64 "\"} %" PRIu64 "\n",
+                    (UINT64_C(1) << (i + 1)) - 1, cumulative);
+    }
+
+    text_append(text, "%s_bucket", name);
+    text_append_labels(text, metrics->serial);
+    text_append(text, ",le=\"+Inf\"} %" PRIu64 "\n", snapshot.count);
+
+    text_append(text, "%s_sum", name);
+    text_append_labels(text, metrics->serial);
+    text_append(text, "} %" PRIu64 "\n", snapshot.sum);
+
+    text_append(text, "%s_count", name);
+    text_append_labels(text, metrics->serial);
+    text_append(text, "} %" PRIu64 "\n", snapshot.count);
+}
+
+size_t
+sc_metrics_format_prometheus(char *buf, size_t size) {
+    struct sc_text text = {
+        .buf = buf,
+        .size = size,
+        .len = 0,
+    };
+    if (size) {
+        buf[0] = '\0';
+    }
+
+    sc_static_mutex_lock(&registry_lock);
+
+    for (unsigned id = 0; id < SC_METRIC_COUNT; ++id) {
+        const struct sc_metric_desc *desc = &descs[id];
+        text_append(&text, "# HELP %s %s\n", desc->name, desc->help);
+        text_append(&text, "# TYPE %s %s\n", desc->name,
+                    desc->gauge ? "gauge" : "counter");
+        for (struct sc_metrics *m = registry; m; m = m->next) {
+            text_append(&text, "%s", desc->name);
+            text_append_labels(&text, m->serial);
+            text_append(&text, "} %" PRId64 "\n", sc_metrics_get(m, id));
+        }
+    }
+
+    const char *name = "scrcpy_sink_frames_total";
+    text_append(&text, "# HELP %s Frames pushed to each frame sink\n", name);
+    text_append(&text, "# TYPE %s counter\n", name);
+    for (struct sc_metrics *m = registry; m; m = m->next) {
+        for (unsigned i = 0; i < SC_METRICS_MAX_SINKS; ++i) {
+            uint64_t frames = atomic_load_explicit(&m->sink_frames[i],
+                                                   memory_order_relaxed);
+            // the unused sinks are not exported
+            if (frames) {
+                text_append(&text, "%s", name);
+                text_append_labels(&text, m->serial);
+                text_append(&text, ",sink=\"%u\"} %" PRIu64 "\n", i, frames);
+            }
+        }
+    }
+
+    name = "scrcpy_decode_duration_microseconds";
+    text_append(&text, "# HELP %s Time to decode a packet\n", name);
+    text_append(&text, "# TYPE %s histogram\n", name);
+    for (struct sc_metrics *m = registry; m; m = m->next) {
+        format_histogram(&text, name, m);
+    }
+
+    sc_static_mutex_unlock(&registry_lock);
+
+    return text.len;
+}
+
+// Return an allocated string, to be freed by the caller
+static char *
+format_all(size_t *len) {
+    size_t size = 4096;
+    for (;;) {
+        char *buf = malloc(size);
+        if (!buf) {
+            LOGC("Could not allocate metrics buffer");
+            return NULL;
+        }
+
+        size_t r = sc_metrics_format_prometheus(buf, size);
+        if (r < size) {
+            *len = r;
+            return buf;
+        }
+
+        // a session may have been registered meanwhile, retry with margin
+        free(buf);
+        size = r + 1024;
+    }
+}
+
+// held during the whole start or stop of the server, which may be requested
+// by several sessions concurrently
+static sc_static_mutex server_lock = SC_STATIC_MUTEX_INIT;
+
+static struct {
+    unsigned refs;
+    socket_t socket;
+    sc_thread thread;
+    char unix_path[256]; // empty for a TCP port
+
+    // the client being served, shut down on stop
+    sc_mutex client_mutex;
+    socket_t client;
+    bool stopped;
+} server;
+
+static void
+serve(socket_t socket) {
+    // a client which does not send its request must not block the others
+    if (!net_wait_readable(socket, sc_tick_now() + REQUEST_TIMEOUT)) {
+        LOGW("Metrics request timeout");
+        return;
+    }
+
+    // the request is ignored, whatever the path
+    char request[1024];
+    ssize_t r = net_recv(socket, request, sizeof(request));
+    if (r <= 0) {
+        return;
+    }
+
+    size_t len;
+    char *body = format_all(&len);
+    if (!body) {
+        return;
+    }
+
+    char header[128];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\n"
+                     "\r\n", len);
+    assert(n > 0 && (size_t) n < sizeof(header));
+
+    if (net_send_all(socket, header, n) == n) {
+        net_send_all(socket, body, len);
+    }
+    free(body);
+}
+
+static int
+run_metrics_server(void *data) {
+    socket_t server_socket = *(socket_t *) data;
+    for (;;) {
+        socket_t socket = net_accept(server_socket);
+        if (socket == INVALID_SOCKET) {
+            // the server socket is shut down on stop
+            break;
+        }
+
+        sc_mutex_lock(&server.client_mutex);
+        bool stopped = server.stopped;
+        if (!stopped) {
+            server.client = socket;
+        }
+        sc_mutex_unlock(&server.client_mutex);
+
+        if (stopped) {
+            net_close(socket);
+            break;
+        }
+
+        serve(socket);
+
+        sc_mutex_lock(&server.client_mutex);
+        server.client = INVALID_SOCKET;
+        sc_mutex_unlock(&server.client_mutex);
+
+        net_close(socket);
+    }
+
+    return 0;
+}
+
+static socket_t
+listen_on(const char *address, char *unix_path, size_t unix_path_size) {
+    unix_path[0] = '\0';
+
+    size_t prefix_len = strlen(UNIX_PREFIX);
+    if (!strncmp(address, UNIX_PREFIX, prefix_len)) {
+#ifdef _WIN32
+        (void) unix_path_size;
+        LOGE("UNIX sockets are not supported on this platform");
+        return INVALID_SOCKET;
+#else
+        const char *path = address + prefix_len;
+        if (strlen(path) >= unix_path_size) {
+            LOGE("Metrics socket path too long: %s", path);
+            return INVALID_SOCKET;
+        }
+        socket_t socket = net_listen_unix(path, 4);
+        if (socket != INVALID_SOCKET) {
+            xstrncpy(unix_path, path, unix_path_size);
+        }
+        return socket;
+#endif
+    }
+
+    long value;
+    if (!parse_integer(address, &value) || value <= 0
+            || value > 0xFFFF) {
+        LOGE("Invalid metrics address: %s (expected a port or unix:<path>)",
+             address);
+        return INVALID_SOCKET;
+    }
+
+    return net_listen(IPV4_LOCALHOST, (uint16_t) value, 4);
+}
+
+bool
+sc_metrics_server_start(const char *address) {
+    sc_static_mutex_lock(&server_lock);
+
+    if (server.refs) {
+        ++server.refs;
+        sc_static_mutex_unlock(&server_lock);
+        LOGD("Metrics server already running");
+        return true;
+    }
+
+    server.socket = listen_on(address, server.unix_path,
+                              sizeof(server.unix_path));
+    if (server.socket == INVALID_SOCKET) {
+        LOGE("Could not start the metrics server");
+        goto error;
+    }
+
+    if (!sc_mutex_init(&server.client_mutex)) {
+        net_close(server.socket);
+        goto error;
+    }
+
+    server.client = INVALID_SOCKET;
+    server.stopped = false;
+
+    if (!sc_thread_create(&server.thread, run_metrics_server, "metrics",
+                          &server.socket)) {
+        LOGE("Could not start metrics server thread");
+        sc_mutex_destroy(&server.client_mutex);
+        net_close(server.socket);
+        goto error;
+    }
+
+    server.refs = 1;
+    sc_static_mutex_unlock(&server_lock);
+
+    LOGI("Metrics served on %s", address);
+    return true;
+
+error:
+    sc_static_mutex_unlock(&server_lock);
+    return false;
+}
+
+void
+sc_metrics_server_stop(void) {
+    sc_static_mutex_lock(&server_lock);
+
+    assert(server.refs);
+    if (--server.refs) {
+        sc_static_mutex_unlock(&server_lock);
+        return;
+    }
+
+    sc_mutex_lock(&server.client_mutex);
+    server.stopped = true;
+    if (server.client != INVALID_SOCKET) {
+        // interrupt the request in progress
+        net_shutdown(server.client, SHUT_RDWR);
+    }
+    sc_mutex_unlock(&server.client_mutex);
+
+    net_shutdown(server.socket, SHUT_RDWR);
+    sc_thread_join(&server.thread, NULL);
+    net_close(server.socket);
+    sc_mutex_destroy(&server.client_mutex);
+
+#ifndef _WIN32
+    if (server.unix_path[0]) {
+        unlink(server.unix_path);
+    }
+#endif
+
+    sc_static_mutex_unlock(&server_lock);
+}
@@ -0,0 +1,115 @@
+#ifndef SC_METRICS_H
+#define SC_METRICS_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/histogram.h"
+
+// Metrics of a session (counters, gauges and histograms), labeled by the
+// serial of the device.
+//
+// Updating a metric is a relaxed atomic operation, so it may be done from any
+// thread without lock. The metrics of all the running sessions are
+// registered, to be exported together (see sc_metrics_format_prometheus()).
+
+enum sc_metric_id {
+    // counters
+    SC_METRIC_RECEIVED_BYTES,
+    SC_METRIC_PACKETS,
+    SC_METRIC_KEYFRAMES,
+    SC_METRIC_DECODED_FRAMES,
+    SC_METRIC_RENDERED_FRAMES,
+    SC_METRIC_SKIPPED_FRAMES,
+    SC_METRIC_CONTROL_MSGS,
+    SC_METRIC_CONTROL_BYTES,
+    SC_METRIC_RECORDED_BYTES,
+    SC_METRIC_RECONNECTIONS,
+    SC_METRIC_RECONNECT_DOWNTIME, // in microseconds
+    // gauges
+    SC_METRIC_CONTROL_QUEUE,
+    SC_METRIC_RECORDER_QUEUE,
+
+    SC_METRIC_COUNT,
+};
+
+#define SC_METRICS_MAX_SINKS 8
+
+struct sc_metrics {
+    char serial[64]; // the label value
+
+    atomic_int_least64_t values[SC_METRIC_COUNT];
+    // if set, the value is read on export instead (e.g. for a queue depth,
+    // or for a counter already maintained elsewhere)
+    int64_t (*sample[SC_METRIC_COUNT])(void *userdata);
+    void *sample_userdata[SC_METRIC_COUNT];
+
+    // frames pushed to each frame sink of the decoder
+    atomic_uint_least64_t sink_frames[SC_METRICS_MAX_SINKS];
+    struct sc_histogram decode_time; // in microseconds
+
+    struct sc_metrics *next; // in the registry
+};
+
+void
+sc_metrics_init(struct sc_metrics *metrics, const char *serial);
+
+// Set the function to read the value of the metric on export
+void
+sc_metrics_set_sample(struct sc_metrics *metrics, enum sc_metric_id id,
+                      int64_t (*sample)(void *userdata), void *userdata);
+
+static inline void
+sc_metrics_add(struct sc_metrics *metrics, enum sc_metric_id id,
+               int64_t delta) {
+    // the metrics are optional
+    if (metrics) {
+        atomic_fetch_add_explicit(&metrics->values[id], delta,
+                                  memory_order_relaxed);
+    }
+}
+
+static inline void
+sc_metrics_add_sink_frame(struct sc_metrics *metrics, unsigned sink) {
+    if (metrics && sink < SC_METRICS_MAX_SINKS) {
+        atomic_fetch_add_explicit(&metrics->sink_frames[sink], 1,
+                                  memory_order_relaxed);
+    }
+}
+
+int64_t
+sc_metrics_get(struct sc_metrics *metrics, enum sc_metric_id id);
+
+// Add the metrics to the registry, until sc_metrics_unregister() (the sample
+// functions must remain callable meanwhile)
+void
+sc_metrics_register(struct sc_metrics *metrics);
+
+void
+sc_metrics_unregister(struct sc_metrics *metrics);
+
+// Format the metrics of all the registered sessions in the Prometheus text
+// format
+//
+// Return the length of the text (like snprintf(): if it is greater or equal
+// to size, the text has been truncated).
+size_t
+sc_metrics_format_prometheus(char *buf, size_t size);
+
+// Serve the Prometheus text over HTTP on a local port, or on a UNIX socket if
+// the address starts with "unix:" (e.g. "unix:/tmp/scrcpy.sock"), for the
+// whole process
+//
+// The server is shared: it is stopped once sc_metrics_server_stop() has been
+// called as many times as sc_metrics_server_start().
+bool
+sc_metrics_server_start(const char *address);
+
+void
+sc_metrics_server_stop(void);
+
+#endif
@@ -0,0 +1,107 @@
+#include "port_lease.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+#include "util/log.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+// the system may return a port leased for "adb forward" but not bound yet
+#define ANY_PORT_ATTEMPTS 16
+
+// one bit per port, set while the port is leased
+static atomic_uint_least32_t leased[0x10000 / 32];
+// where to start the next search in a range, so that concurrent sessions do
+// not all try the same ports first
+static atomic_uint next_offset;
+
+static bool
+try_lease(uint16_t port) {
+    uint32_t mask = UINT32_C(1) << (port % 32);
+    uint32_t old = atomic_fetch_or(&leased[port / 32], mask);
+    return !(old & mask);
+}
+
+void
+sc_port_lease_release(uint16_t port) {
+    uint32_t mask = UINT32_C(1) << (port % 32);
+    uint32_t old = atomic_fetch_and(&leased[port / 32], ~mask);
+    assert(old & mask);
+    (void) old;
+}
+
+static socket_t
+listen_on_any_port(uint16_t *port) {
+    for (unsigned i = 0; i < ANY_PORT_ATTEMPTS; ++i) {
+        socket_t socket = net_listen(IPV4_LOCALHOST, 0, 1);
+        if (socket == INVALID_SOCKET) {
+            LOGE("Could not listen on any port");
+            return INVALID_SOCKET;
+        }
+
+        uint16_t p;
+        if (!net_get_local_port(socket, &p)) {
+            net_close(socket);
+            return INVALID_SOCKET;
+        }
+
+        if (try_lease(p)) {
+            *port = p;
+            return socket;
+        }
+
+        net_close(socket);
+    }
+
+    LOGE("Could not lease any port");
+    return INVALID_SOCKET;
+}
+
+socket_t
+sc_port_lease_listen(struct sc_port_range range, uint16_t *port) {
+    if (!range.first) {
+        return listen_on_any_port(port);
+    }
+
+    assert(range.first <= range.last);
+    unsigned count = range.last - range.first + 1;
+    unsigned offset = atomic_fetch_add(&next_offset, 1);
+    for (unsigned i = 0; i < count; ++i) {
+        uint16_t p = range.first + (offset + i) % count;
+        if (!try_lease(p)) {
+            // used by another session
+            continue;
+        }
+
+        socket_t socket = net_listen(IPV4_LOCALHOST, p, 1);
+        if (socket != INVALID_SOCKET) {
+            *port = p;
+            return socket;
+        }
+
+        // used by another process
+        sc_port_lease_release(p);
+    }
+
+    if (range.first == range.last) {
+        LOGE("Could not listen on port %" PRIu16, range.first);
+    } else {
+        LOGE("Could not listen on any port in range %" PRIu16 ":%" PRIu16,
+             range.first, range.last);
+    }
+    return INVALID_SOCKET;
+}
+
+bool
+sc_port_lease_reserve(struct sc_port_range range, uint16_t *port) {
+    socket_t socket = sc_port_lease_listen(range, port);
+    if (socket == INVALID_SOCKET) {
+        return false;
+    }
+
+    // the port is free, and stays leased once closed
+    net_close(socket);
+    return true;
+}
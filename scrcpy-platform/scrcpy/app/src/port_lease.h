@@ -0,0 +1,34 @@
+#ifndef SC_PORT_LEASE_H
+#define SC_PORT_LEASE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scrcpy.h"
+#include "util/net.h"
+
+// Allocate the local ports of the adb tunnels, for all the sessions of the
+// process.
+//
+// A port is leased to a single session at a time, so that concurrent sessions
+// never compete for the same port. A port is only leased once it has been
+// bound locally: the adb tunnel is then enabled once, without retrying on the
+// next ports.
+//
+// If range.first is 0, any free port is used (chosen by the system).
+
+// Lease a port and return a socket listening on it (for "adb reverse")
+socket_t
+sc_port_lease_listen(struct sc_port_range range, uint16_t *port);
+
+// Lease a port which is currently free, to be bound by the adb server (for
+// "adb forward")
+bool
+sc_port_lease_reserve(struct sc_port_range range, uint16_t *port);
+
+void
+sc_port_lease_release(uint16_t port);
+
+#endif
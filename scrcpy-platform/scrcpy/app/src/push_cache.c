@@ -0,0 +1,189 @@
+#include "push_cache.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <direct.h>
+#endif
+
+#include "util/log.h"
+
+#define FNV1A_64_OFFSET UINT64_C(0xcbf29ce484222325)
+#define FNV1A_64_PRIME UINT64_C(0x100000001b3)
+
+bool
+sc_push_cache_entry_from_file(const char *path,
+                              struct sc_push_cache_entry *entry) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        LOGE("Could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st)) {
+        LOGE("Could not stat %s: %s", path, strerror(errno));
+        fclose(file);
+        return false;
+    }
+
+    // not a cryptographic hash: it only detects a local file change
+    uint64_t hash = FNV1A_64_OFFSET;
+    unsigned char buf[4096];
+    size_t r;
+    while ((r = fread(buf, 1, sizeof(buf), file)) > 0) {
+        for (size_t i = 0; i < r; ++i) {
+            hash = (hash ^ buf[i]) * FNV1A_64_PRIME;
+        }
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok) {
+        LOGE("Could not read %s", path);
+        return false;
+    }
+
+    entry->hash = hash;
+    entry->size = (uint32_t) st.st_size;
+    entry->mtime = (uint32_t) st.st_mtime;
+    return true;
+}
+
+static bool
+make_dir(const char *path) {
+#ifdef _WIN32
+    int r = _mkdir(path);
+#else
+    int r = mkdir(path, 0755);
+#endif
+    return !r || errno == EEXIST;
+}
+
+// Return the path of the cache file for the device, creating the cache
+// directory if necessary (to be freed by the caller)
+static char *
+get_cache_path(const char *serial, bool create) {
+    const char *base;
+    const char *sub;
+#ifdef _WIN32
+    base = getenv("LOCALAPPDATA");
+    sub = NULL;
+#else
+    base = getenv("XDG_CACHE_HOME");
+    sub = NULL;
+    if (!base || !*base) {
+        base = getenv("HOME");
+        sub = ".cache";
+    }
+#endif
+    if (!base || !*base) {
+        return NULL;
+    }
+
+    if (!serial) {
+        // the device is not known in advance, the cache still works if the
+        // same device is used
+        serial = "any";
+    }
+
+    size_t len = strlen(base) + strlen(serial) + 64;
+    char *path = malloc(len);
+    if (!path) {
+        LOGC("Could not allocate push cache path");
+        return NULL;
+    }
+
+    int w;
+    if (sub) {
+        w = snprintf(path, len, "%s/%s", base, sub);
+        if (create && !make_dir(path)) {
+            goto error;
+        }
+        w = snprintf(path, len, "%s/%s/scrcpy", base, sub);
+    } else {
+        w = snprintf(path, len, "%s/scrcpy", base);
+    }
+    if (create && !make_dir(path)) {
+        goto error;
+    }
+
+    char *name = &path[w];
+    snprintf(name, len - w, "/push-%s", serial);
+    // the serial may be "ip:port", which is not a valid Windows filename
+    for (char *c = name + 1; *c; ++c) {
+        if (*c == ':' || *c == '/' || *c == '\\') {
+            *c = '_';
+        }
+    }
+
+    return path;
+
+error:
+    LOGD("Could not create push cache directory %s: %s", path,
+         strerror(errno));
+    free(path);
+    return NULL;
+}
+
+bool
+sc_push_cache_check(const char *serial,
+                    const struct sc_push_cache_entry *entry,
+                    const struct sc_adb_file_stat *remote) {
+    if (!SC_ADB_S_ISREG(remote->mode)) {
+        // the file does not exist on the device
+        return false;
+    }
+
+    char *path = get_cache_path(serial, false);
+    if (!path) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "r");
+    free(path);
+    if (!file) {
+        // nothing pushed yet
+        return false;
+    }
+
+    struct sc_push_cache_entry cached;
+    int r = fscanf(file, "%" SCNx64 " %" SCNu32 " %" SCNu32, &cached.hash,
+                   &cached.size, &cached.mtime);
+    fclose(file);
+    if (r != 3) {
+        LOGW("Invalid push cache entry");
+        return false;
+    }
+
+    return cached.hash == entry->hash
+        && cached.size == entry->size
+        && cached.mtime == entry->mtime
+        && remote->size == entry->size
+        && remote->mtime == entry->mtime;
+}
+
+void
+sc_push_cache_store(const char *serial,
+                    const struct sc_push_cache_entry *entry) {
+    char *path = get_cache_path(serial, true);
+    if (!path) {
+        return;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        LOGD("Could not write push cache %s: %s", path, strerror(errno));
+        free(path);
+        return;
+    }
+    free(path);
+
+    fprintf(file, "%" PRIx64 " %" PRIu32 " %" PRIu32 "\n", entry->hash,
+            entry->size, entry->mtime);
+    fclose(file);
+}
@@ -0,0 +1,42 @@
+#ifndef SC_PUSH_CACHE_H
+#define SC_PUSH_CACHE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "adb_client.h"
+
+// Remember, for each device, which file has been pushed, to avoid pushing the
+// same server again on every launch.
+//
+// An entry is stored per device serial in the user cache directory
+// ($XDG_CACHE_HOME/scrcpy or ~/.cache/scrcpy, %LOCALAPPDATA%\scrcpy on
+// Windows). The device copy is considered up-to-date if its size and mtime
+// (which "adb push" sets to the local mtime) match the entry, and the hash of
+// the local file has not changed since it was pushed.
+struct sc_push_cache_entry {
+    uint64_t hash;
+    uint32_t size;
+    uint32_t mtime;
+};
+
+// Compute the entry for a local file
+bool
+sc_push_cache_entry_from_file(const char *path,
+                              struct sc_push_cache_entry *entry);
+
+// Return true if the device file (stat'ed on the device) is the local file
+// described by entry
+bool
+sc_push_cache_check(const char *serial,
+                    const struct sc_push_cache_entry *entry,
+                    const struct sc_adb_file_stat *remote);
+
+// Store the entry after a successful push (failures are ignored)
+void
+sc_push_cache_store(const char *serial,
+                    const struct sc_push_cache_entry *entry);
+
+#endif
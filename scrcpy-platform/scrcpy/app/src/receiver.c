@@ -1,97 +1,142 @@
 #include "receiver.h"
 
 #include <assert.h>
-#include <SDL2/SDL_clipboard.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "device_msg.h"
 #include "util/log.h"
+#include "util/tick.h"
 
 bool
-receiver_init(struct receiver *receiver, socket_t control_socket) {
+receiver_init(struct receiver *receiver, socket_t control_socket,
+              const struct receiver_callbacks *cbs, void *cbs_userdata) {
+    assert(cbs && cbs->on_device_msg);
+
+    // one more byte to NUL-terminate a text payload in place
+    receiver->buf = malloc(DEVICE_MSG_MAX_SIZE + 1);
+    if (!receiver->buf) {
+        LOGC("Could not allocate receiver buffer");
+        return false;
+    }
+
     bool ok = sc_mutex_init(&receiver->mutex);
     if (!ok) {
+        free(receiver->buf);
         return false;
     }
+
     receiver->control_socket = control_socket;
+    receiver->head = 0;
+    receiver->tail = 0;
+    receiver->cbs = cbs;
+    receiver->cbs_userdata = cbs_userdata;
+    sc_histogram_init(&receiver->rtt);
     return true;
 }
 
 void
 receiver_destroy(struct receiver *receiver) {
     sc_mutex_destroy(&receiver->mutex);
+    free(receiver->buf);
 }
 
 static void
-process_msg(struct device_msg *msg) {
-    switch (msg->type) {
-        case DEVICE_MSG_TYPE_CLIPBOARD: {
-            char *current = SDL_GetClipboardText();
-            bool same = current && !strcmp(current, msg->clipboard.text);
-            SDL_free(current);
-            if (same) {
-                LOGD("Computer clipboard unchanged");
-                return;
-            }
-
-            LOGI("Device clipboard copied");
-            SDL_SetClipboardText(msg->clipboard.text);
-            break;
-        }
+process_pong(struct receiver *receiver, const struct device_msg *msg) {
+    // the device echoes the timestamp written by the controller
+    sc_tick timestamp = (sc_tick) msg->pong.timestamp;
+    sc_tick now = sc_tick_now();
+    if (timestamp <= 0 || timestamp > now) {
+        LOGW("Unexpected pong: %" PRIu64, msg->pong.timestamp);
+        return;
     }
+
+    sc_tick rtt = now - timestamp;
+    LOGV("Control round-trip time: %" PRItick " us", rtt);
+    sc_histogram_record(&receiver->rtt, rtt);
 }
 
-static ssize_t
-process_msgs(const unsigned char *buf, size_t len) {
-    size_t head = 0;
-    for (;;) {
+static void
+process_msg(struct receiver *receiver, const struct device_msg *msg,
+            size_t end) {
+    if (msg->type == DEVICE_MSG_TYPE_PONG) {
+        process_pong(receiver, msg);
+        return;
+    }
+
+    if (msg->type == DEVICE_MSG_TYPE_CLIPBOARD) {
+        // The text is followed either by the next message or by the spare
+        // byte at the end of the buffer: NUL-terminate it temporarily, so
+        // that it can be used as a string without any copy
+        unsigned char saved = receiver->buf[end];
+        receiver->buf[end] = '\0';
+        receiver->cbs->on_device_msg(receiver, msg, receiver->cbs_userdata);
+        receiver->buf[end] = saved;
+        return;
+    }
+
+    receiver->cbs->on_device_msg(receiver, msg, receiver->cbs_userdata);
+}
+
+// Return false on error
+static bool
+process_msgs(struct receiver *receiver) {
+    while (receiver->head < receiver->tail) {
         struct device_msg msg;
-        ssize_t r = device_msg_deserialize(&buf[head], len - head, &msg);
+        ssize_t r = device_msg_deserialize(&receiver->buf[receiver->head],
+                                           receiver->tail - receiver->head,
+                                           &msg);
         if (r == -1) {
-            return -1;
+            return false;
         }
         if (r == 0) {
-            return head;
+            // incomplete message
+            break;
         }
 
-        process_msg(&msg);
-        device_msg_destroy(&msg);
+        receiver->head += r;
+        assert(receiver->head <= receiver->tail);
+        process_msg(receiver, &msg, receiver->head);
+    }
 
-        head += r;
-        assert(head <= len);
-        if (head == len) {
-            return head;
-        }
+    if (receiver->head == receiver->tail) {
+        // everything is consumed, restart from the beginning (no copy)
+        receiver->head = 0;
+        receiver->tail = 0;
     }
+
+    return true;
 }
 
 static int
 run_receiver(void *data) {
     struct receiver *receiver = data;
 
-    static unsigned char buf[DEVICE_MSG_MAX_SIZE];
-    size_t head = 0;
-
     for (;;) {
-        assert(head < DEVICE_MSG_MAX_SIZE);
-        ssize_t r = net_recv(receiver->control_socket, buf + head,
-                             DEVICE_MSG_MAX_SIZE - head);
+        if (receiver->tail == DEVICE_MSG_MAX_SIZE) {
+            // The end of the buffer is reached in the middle of a message:
+            // move it to the beginning (a message never exceeds the buffer
+            // size, so there is necessarily some unconsumed data before)
+            assert(receiver->head);
+            size_t len = receiver->tail - receiver->head;
+            memmove(receiver->buf, &receiver->buf[receiver->head], len);
+            receiver->head = 0;
+            receiver->tail = len;
+        }
+
+        ssize_t r = net_recv(receiver->control_socket,
+                             &receiver->buf[receiver->tail],
+                             DEVICE_MSG_MAX_SIZE - receiver->tail);
         if (r <= 0) {
             LOGD("Receiver stopped");
             break;
         }
 
-        head += r;
-        ssize_t consumed = process_msgs(buf, head);
-        if (consumed == -1) {
+        receiver->tail += r;
+        if (!process_msgs(receiver)) {
             // an error occurred
             break;
         }
-
-        if (consumed) {
-            head -= consumed;
-            // shift the remaining data in the buffer
-            memmove(buf, &buf[consumed], head);
-        }
     }
 
     return 0;
@@ -115,3 +160,11 @@ void
 receiver_join(struct receiver *receiver) {
     sc_thread_join(&receiver->thread, NULL);
 }
+
+void
+receiver_reset(struct receiver *receiver, socket_t control_socket) {
+    // a partial message from the previous connection is useless
+    receiver->control_socket = control_socket;
+    receiver->head = 0;
+    receiver->tail = 0;
+}
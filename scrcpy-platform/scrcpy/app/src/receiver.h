@@ -4,20 +4,49 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 
+#include "device_msg.h"
+#include "util/histogram.h"
 #include "util/net.h"
 #include "util/thread.h"
 
 // receive events from the device
 // managed by the controller
+//
+// The messages are received in a buffer owned by the receiver, and parsed in
+// place: the data is moved only when a message is split at the end of the
+// buffer, and payloads are never copied.
 struct receiver {
     socket_t control_socket;
     sc_thread thread;
     sc_mutex mutex;
+
+    // only accessed from the receiver thread
+    unsigned char *buf; // DEVICE_MSG_MAX_SIZE + 1 (for a NUL terminator)
+    size_t head; // start of the unconsumed data
+    size_t tail; // end of the received data
+
+    // round-trip times of the pings (in microseconds), from the pongs
+    struct sc_histogram rtt;
+
+    const struct receiver_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct receiver_callbacks {
+    // Called from the receiver thread for each device message (except
+    // DEVICE_MSG_TYPE_PONG, handled by the receiver)
+    //
+    // The message (and its payload) is valid only during the call. The
+    // clipboard text is NUL-terminated.
+    void (*on_device_msg)(struct receiver *receiver,
+                          const struct device_msg *msg, void *userdata);
 };
 
 bool
-receiver_init(struct receiver *receiver, socket_t control_socket);
+receiver_init(struct receiver *receiver, socket_t control_socket,
+              const struct receiver_callbacks *cbs, void *cbs_userdata);
 
 void
 receiver_destroy(struct receiver *receiver);
@@ -27,6 +56,11 @@ receiver_start(struct receiver *receiver);
 
 // no receiver_stop(), it will automatically stop on control_socket shutdown
 
+// Receive from a new connection, after receiver_join() (the round-trip times
+// are kept)
+void
+receiver_reset(struct receiver *receiver, socket_t control_socket);
+
 void
 receiver_join(struct receiver *receiver);
 
@@ -9,6 +9,9 @@
 /** Downcast packet_sink to recorder */
 #define DOWNCAST(SINK) container_of(SINK, struct recorder, packet_sink)
 
+// maximum number of packets written by a task before yielding to other tasks
+#define RECORDER_TASK_PACKETS 16
+
 static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
 
 static const AVOutputFormat *
@@ -55,19 +58,24 @@ record_packet_delete(struct record_packet *rec) {
     free(rec);
 }
 
-static void
+// Return the number of packets discarded
+static unsigned
 recorder_queue_clear(struct recorder_queue *queue) {
+    unsigned count = 0;
     while (!sc_queue_is_empty(queue)) {
         struct record_packet *rec;
         sc_queue_take(queue, next, &rec);
         record_packet_delete(rec);
+        ++count;
     }
+    return count;
 }
 
 static const char *
 recorder_get_format_name(enum sc_record_format format) {
     switch (format) {
-        case SC_RECORD_FORMAT_MP4: return "mp4";
+        case SC_RECORD_FORMAT_MP4:
+        case SC_RECORD_FORMAT_FMP4: return "mp4";
         case SC_RECORD_FORMAT_MKV: return "matroska";
         default: return NULL;
     }
@@ -89,7 +97,16 @@ recorder_write_header(struct recorder *recorder, const AVPacket *packet) {
     ostream->codecpar->extradata = extradata;
     ostream->codecpar->extradata_size = packet->size;
 
-    int ret = avformat_write_header(recorder->ctx, NULL);
+    AVDictionary *opts = NULL;
+    if (recorder->format == SC_RECORD_FORMAT_FMP4) {
+        // Write an empty moov, then a fragment starting on each keyframe, so
+        // that the file is readable while it is being written
+        av_dict_set(&opts, "movflags",
+                    "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+
+    int ret = avformat_write_header(recorder->ctx, &opts);
+    av_dict_free(&opts);
     if (ret < 0) {
         LOGE("Failed to write header to %s", recorder->filename);
         return false;
@@ -125,7 +142,92 @@ recorder_write(struct recorder *recorder, AVPacket *packet) {
     }
 
     recorder_rescale_packet(recorder, packet);
-    return av_write_frame(recorder->ctx, packet) >= 0;
+    if (av_write_frame(recorder->ctx, packet) < 0) {
+        return false;
+    }
+
+    sc_metrics_add(recorder->metrics, SC_METRIC_RECORDED_BYTES, packet->size);
+    return true;
+}
+
+static void
+recorder_write_last(struct recorder *recorder) {
+    struct record_packet *last = recorder->previous;
+    if (last) {
+        // assign an arbitrary duration to the last packet
+        last->packet->duration = 100000;
+        bool ok = recorder_write(recorder, last->packet);
+        if (!ok) {
+            // failing to write the last frame is not very serious, no future
+            // frame may depend on it, so the resulting file will still be
+            // valid
+            LOGW("Could not record last packet");
+        }
+        record_packet_delete(last);
+    }
+}
+
+// Return false on failure (the recording must be finished)
+static bool
+recorder_process(struct recorder *recorder, struct record_packet *rec) {
+    // recorder->previous is only written from the recording thread (or task),
+    // no need to lock
+    struct record_packet *previous = recorder->previous;
+    recorder->previous = rec;
+
+    if (!previous) {
+        // we just received the first packet
+        return true;
+    }
+
+    // config packets have no PTS, we must ignore them
+    if (rec->packet->pts != AV_NOPTS_VALUE
+        && previous->packet->pts != AV_NOPTS_VALUE) {
+        // we now know the duration of the previous packet
+        previous->packet->duration = rec->packet->pts - previous->packet->pts;
+    }
+
+    bool ok = recorder_write(recorder, previous->packet);
+    record_packet_delete(previous);
+    if (!ok) {
+        LOGE("Could not record packet");
+
+        sc_mutex_lock(&recorder->mutex);
+        recorder->failed = true;
+        // discard pending packets
+        unsigned count = recorder_queue_clear(&recorder->queue);
+        sc_metrics_add(recorder->metrics, SC_METRIC_RECORDER_QUEUE,
+                       -(int64_t) count);
+        sc_mutex_unlock(&recorder->mutex);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+recorder_finish(struct recorder *recorder) {
+    if (!recorder->failed) {
+        if (recorder->header_written) {
+            int ret = av_write_trailer(recorder->ctx);
+            if (ret < 0) {
+                LOGE("Failed to write trailer to %s", recorder->filename);
+                recorder->failed = true;
+            }
+        } else {
+            // the recorded file is empty
+            recorder->failed = true;
+        }
+    }
+
+    if (recorder->failed) {
+        LOGE("Recording failed to %s", recorder->filename);
+    } else {
+        const char *format_name = recorder_get_format_name(recorder->format);
+        LOGI("Recording complete to %s file: %s", format_name,
+                                                  recorder->filename);
+    }
+
 }
 
 static int
@@ -144,82 +246,70 @@ run_recorder(void *data) {
 
         if (recorder->stopped && sc_queue_is_empty(&recorder->queue)) {
             sc_mutex_unlock(&recorder->mutex);
-            struct record_packet *last = recorder->previous;
-            if (last) {
-                // assign an arbitrary duration to the last packet
-                last->packet->duration = 100000;
-                bool ok = recorder_write(recorder, last->packet);
-                if (!ok) {
-                    // failing to write the last frame is not very serious, no
-                    // future frame may depend on it, so the resulting file
-                    // will still be valid
-                    LOGW("Could not record last packet");
-                }
-                record_packet_delete(last);
-            }
+            recorder_write_last(recorder);
             break;
         }
 
         struct record_packet *rec;
         sc_queue_take(&recorder->queue, next, &rec);
+        sc_metrics_add(recorder->metrics, SC_METRIC_RECORDER_QUEUE, -1);
 
         sc_mutex_unlock(&recorder->mutex);
 
-        // recorder->previous is only written from this thread, no need to lock
-        struct record_packet *previous = recorder->previous;
-        recorder->previous = rec;
-
-        if (!previous) {
-            // we just received the first packet
-            continue;
+        if (!recorder_process(recorder, rec)) {
+            break;
         }
+    }
 
-        // config packets have no PTS, we must ignore them
-        if (rec->packet->pts != AV_NOPTS_VALUE
-            && previous->packet->pts != AV_NOPTS_VALUE) {
-            // we now know the duration of the previous packet
-            previous->packet->duration =
-                rec->packet->pts - previous->packet->pts;
-        }
+    recorder_finish(recorder);
 
-        bool ok = recorder_write(recorder, previous->packet);
-        record_packet_delete(previous);
-        if (!ok) {
-            LOGE("Could not record packet");
+    LOGD("Recorder thread ended");
+
+    return 0;
+}
+
+static void
+run_recorder_task(struct sc_pool_task *task) {
+    struct recorder *recorder = container_of(task, struct recorder, task);
+
+    // process a bounded number of packets, so that a recorder can not
+    // monopolize a worker
+    for (unsigned i = 0; i < RECORDER_TASK_PACKETS; ++i) {
+        sc_mutex_lock(&recorder->mutex);
+        if (sc_queue_is_empty(&recorder->queue)) {
+            if (!recorder->stopped) {
+                // the next push will schedule the task again
+                recorder->scheduled = false;
+                sc_mutex_unlock(&recorder->mutex);
+                return;
+            }
 
-            sc_mutex_lock(&recorder->mutex);
-            recorder->failed = true;
-            // discard pending packets
-            recorder_queue_clear(&recorder->queue);
             sc_mutex_unlock(&recorder->mutex);
-            break;
+            recorder_write_last(recorder);
+            goto finish;
         }
-    }
 
-    if (!recorder->failed) {
-        if (recorder->header_written) {
-            int ret = av_write_trailer(recorder->ctx);
-            if (ret < 0) {
-                LOGE("Failed to write trailer to %s", recorder->filename);
-                recorder->failed = true;
-            }
-        } else {
-            // the recorded file is empty
-            recorder->failed = true;
+        struct record_packet *rec;
+        sc_queue_take(&recorder->queue, next, &rec);
+        sc_metrics_add(recorder->metrics, SC_METRIC_RECORDER_QUEUE, -1);
+        sc_mutex_unlock(&recorder->mutex);
+
+        if (!recorder_process(recorder, rec)) {
+            goto finish;
         }
     }
 
-    if (recorder->failed) {
-        LOGE("Recording failed to %s", recorder->filename);
-    } else {
-        const char *format_name = recorder_get_format_name(recorder->format);
-        LOGI("Recording complete to %s file: %s", format_name,
-                                                  recorder->filename);
-    }
+    // there may be more packets, let the other tasks run first
+    sc_thread_pool_submit(recorder->pool, task);
+    return;
 
-    LOGD("Recorder thread ended");
+finish:
+    recorder_finish(recorder);
 
-    return 0;
+    sc_mutex_lock(&recorder->mutex);
+    recorder->finished = true;
+    sc_cond_signal(&recorder->queue_cond);
+    sc_mutex_unlock(&recorder->mutex);
 }
 
 static bool
@@ -239,6 +329,8 @@ recorder_open(struct recorder *recorder, const AVCodec *input_codec) {
     sc_queue_init(&recorder->queue);
     recorder->stopped = false;
     recorder->failed = false;
+    recorder->scheduled = false;
+    recorder->finished = false;
     recorder->header_written = false;
     recorder->previous = NULL;
 
@@ -284,12 +376,17 @@ recorder_open(struct recorder *recorder, const AVCodec *input_codec) {
         goto error_avformat_free_context;
     }
 
-    LOGD("Starting recorder thread");
-    ok = sc_thread_create(&recorder->thread, run_recorder, "recorder",
-                               recorder);
-    if (!ok) {
-        LOGC("Could not start recorder thread");
-        goto error_avio_close;
+    if (recorder->pool) {
+        // the packets are written by tasks of the pool
+        recorder->task.run = run_recorder_task;
+    } else {
+        LOGD("Starting recorder thread");
+        ok = sc_thread_create(&recorder->thread, run_recorder, "recorder",
+                              recorder);
+        if (!ok) {
+            LOGC("Could not start recorder thread");
+            goto error_avio_close;
+        }
     }
 
     LOGI("Recording started to %s file: %s", format_name, recorder->filename);
@@ -312,10 +409,23 @@ static void
 recorder_close(struct recorder *recorder) {
     sc_mutex_lock(&recorder->mutex);
     recorder->stopped = true;
-    sc_cond_signal(&recorder->queue_cond);
+    if (recorder->pool) {
+        if (!recorder->scheduled && !recorder->finished) {
+            // finish the recording from the pool
+            recorder->scheduled = true;
+            sc_thread_pool_submit(recorder->pool, &recorder->task);
+        }
+        while (!recorder->finished) {
+            sc_cond_wait(&recorder->queue_cond, &recorder->mutex);
+        }
+    } else {
+        sc_cond_signal(&recorder->queue_cond);
+    }
     sc_mutex_unlock(&recorder->mutex);
 
-    sc_thread_join(&recorder->thread, NULL);
+    if (!recorder->pool) {
+        sc_thread_join(&recorder->thread, NULL);
+    }
 
     avio_close(recorder->ctx->pb);
     avformat_free_context(recorder->ctx);
@@ -329,9 +439,10 @@ recorder_push(struct recorder *recorder, const AVPacket *packet) {
     assert(!recorder->stopped);
 
     if (recorder->failed) {
-        // reject any new packet (this will stop the stream)
         sc_mutex_unlock(&recorder->mutex);
-        return false;
+        // if the failure is isolated, discard the packet, otherwise reject it
+        // (this will stop the stream)
+        return recorder->isolate_failure;
     }
 
     struct record_packet *rec = record_packet_new(packet);
@@ -342,27 +453,52 @@ recorder_push(struct recorder *recorder, const AVPacket *packet) {
     }
 
     sc_queue_push(&recorder->queue, next, rec);
-    sc_cond_signal(&recorder->queue_cond);
+    sc_metrics_add(recorder->metrics, SC_METRIC_RECORDER_QUEUE, 1);
+
+    bool schedule = false;
+    if (recorder->pool) {
+        schedule = !recorder->scheduled;
+        recorder->scheduled = true;
+    } else {
+        sc_cond_signal(&recorder->queue_cond);
+    }
 
     sc_mutex_unlock(&recorder->mutex);
+
+    if (schedule) {
+        sc_thread_pool_submit(recorder->pool, &recorder->task);
+    }
     return true;
 }
 
 static bool
 recorder_packet_sink_open(struct sc_packet_sink *sink, const AVCodec *codec) {
     struct recorder *recorder = DOWNCAST(sink);
-    return recorder_open(recorder, codec);
+    bool ok = recorder_open(recorder, codec);
+    if (!ok && recorder->isolate_failure) {
+        // do not prevent the other sinks from running
+        LOGW("Recording disabled for %s", recorder->filename);
+        recorder->disabled = true;
+        return true;
+    }
+    return ok;
 }
 
 static void
 recorder_packet_sink_close(struct sc_packet_sink *sink) {
     struct recorder *recorder = DOWNCAST(sink);
-    recorder_close(recorder);
+    if (!recorder->disabled) {
+        recorder_close(recorder);
+    }
 }
 
 static bool
 recorder_packet_sink_push(struct sc_packet_sink *sink, const AVPacket *packet) {
     struct recorder *recorder = DOWNCAST(sink);
+    if (recorder->disabled) {
+        // discard the packet
+        return true;
+    }
     return recorder_push(recorder, packet);
 }
 
@@ -370,7 +506,8 @@ bool
 recorder_init(struct recorder *recorder,
               const char *filename,
               enum sc_record_format format,
-              struct size declared_frame_size) {
+              struct size declared_frame_size,
+              bool isolate_failure, struct sc_thread_pool *pool) {
     recorder->filename = strdup(filename);
     if (!recorder->filename) {
         LOGE("Could not strdup filename");
@@ -379,6 +516,10 @@ recorder_init(struct recorder *recorder,
 
     recorder->format = format;
     recorder->declared_frame_size = declared_frame_size;
+    recorder->isolate_failure = isolate_failure;
+    recorder->disabled = false;
+    recorder->pool = pool;
+    recorder->metrics = NULL;
 
     static const struct sc_packet_sink_ops ops = {
         .open = recorder_packet_sink_open,
@@ -9,8 +9,10 @@
 #include "coords.h"
 #include "scrcpy.h"
 #include "trait/packet_sink.h"
+#include "metrics.h"
 #include "util/queue.h"
 #include "util/thread.h"
+#include "util/thread_pool.h"
 
 struct record_packet {
     AVPacket *packet;
@@ -28,11 +30,21 @@ struct recorder {
     struct size declared_frame_size;
     bool header_written;
 
+    // if pool is set, the packets are written by a task of the pool instead of
+    // a dedicated thread
+    struct sc_thread_pool *pool;
+    struct sc_pool_task task;
+    bool scheduled; // the task is submitted or running
+    bool finished; // the task has finished the recording (on close)
+
     sc_thread thread;
     sc_mutex mutex;
     sc_cond queue_cond;
     bool stopped; // set on recorder_close()
     bool failed; // set on packet write failure
+    // if set, a failure discards the packets instead of stopping the stream
+    bool isolate_failure;
+    bool disabled; // set if the recorder could not be opened (isolated only)
     struct recorder_queue queue;
 
     // we can write a packet only once we received the next one so that we can
@@ -40,11 +52,19 @@ struct recorder {
     // "previous" is only accessed from the recorder thread, so it does not
     // need to be protected by the mutex
     struct record_packet *previous;
+
+    struct sc_metrics *metrics; // optional, set before the stream starts
 };
 
+// If isolate_failure is set, a recording failure does not stop the stream (so
+// that the other sinks continue to receive packets)
+//
+// If pool is not NULL, the recording runs on the pool (shared with other
+// sessions) instead of a dedicated thread.
 bool
 recorder_init(struct recorder *recorder, const char *filename,
-              enum sc_record_format format, struct size declared_frame_size);
+              enum sc_record_format format, struct size declared_frame_size,
+              bool isolate_failure, struct sc_thread_pool *pool);
 
 void
 recorder_destroy(struct recorder *recorder);
@@ -0,0 +1,634 @@
+#include "restreamer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <signal.h>
+# include <unistd.h>
+# include <sys/stat.h>
+#endif
+
+#include "util/log.h"
+#include "util/str_util.h"
+
+/** Downcast packet_sink to sc_restreamer */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_restreamer, packet_sink)
+
+static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
+
+static const AVOutputFormat *
+find_muxer(const char *name) {
+#ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
+    void *opaque = NULL;
+#endif
+    const AVOutputFormat *oformat = NULL;
+    do {
+#ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
+        oformat = av_muxer_iterate(&opaque);
+#else
+        oformat = av_oformat_next(oformat);
+#endif
+        // until null or containing the requested name
+    } while (oformat && !strlist_contains(oformat->name, ',', name));
+    return oformat;
+}
+
+static const char *
+get_format_name(enum sc_restream_format format) {
+    switch (format) {
+        case SC_RESTREAM_FORMAT_MPEGTS: return "mpegts";
+        case SC_RESTREAM_FORMAT_RTP: return "rtp";
+        default: return NULL;
+    }
+}
+
+static enum sc_restream_format
+guess_format(const char *url) {
+    if (!strncmp(url, "rtp://", 6)) {
+        return SC_RESTREAM_FORMAT_RTP;
+    }
+    return SC_RESTREAM_FORMAT_MPEGTS;
+}
+
+static struct sc_restream_packet *
+restream_packet_new(const AVPacket *packet) {
+    struct sc_restream_packet *rp = malloc(sizeof(*rp));
+    if (!rp) {
+        return NULL;
+    }
+
+    // the packet data is refcounted, it is not copied
+    rp->packet = av_packet_alloc();
+    if (!rp->packet) {
+        free(rp);
+        return NULL;
+    }
+
+    if (av_packet_ref(rp->packet, packet)) {
+        av_packet_free(&rp->packet);
+        free(rp);
+        return NULL;
+    }
+    return rp;
+}
+
+static void
+restream_packet_delete(struct sc_restream_packet *rp) {
+    av_packet_free(&rp->packet);
+    free(rp);
+}
+
+static inline bool
+is_config_packet(const AVPacket *packet) {
+    return packet->pts == AV_NOPTS_VALUE;
+}
+
+// Drop the pending data packets (config packets are kept)
+//
+// Must be called with the mutex locked.
+static void
+restreamer_drop_pending(struct sc_restreamer *restreamer) {
+    struct sc_restream_queue kept;
+    sc_queue_init(&kept);
+
+    while (!sc_queue_is_empty(&restreamer->queue)) {
+        struct sc_restream_packet *rp;
+        sc_queue_take(&restreamer->queue, next, &rp);
+        if (is_config_packet(rp->packet)) {
+            sc_queue_push(&kept, next, rp);
+        } else {
+            restream_packet_delete(rp);
+            --restreamer->queue_size;
+            ++restreamer->dropped;
+        }
+    }
+
+    restreamer->queue = kept;
+}
+
+static void
+restreamer_clear(struct sc_restreamer *restreamer) {
+    while (!sc_queue_is_empty(&restreamer->queue)) {
+        struct sc_restream_packet *rp;
+        sc_queue_take(&restreamer->queue, next, &rp);
+        restream_packet_delete(rp);
+    }
+    restreamer->queue_size = 0;
+}
+
+static int
+restreamer_interrupt_cb(void *opaque) {
+    struct sc_restreamer *restreamer = opaque;
+    return atomic_load(&restreamer->interrupted);
+}
+
+#ifndef _WIN32
+static bool
+is_fifo(const char *path) {
+    struct stat st;
+    return !stat(path, &st) && S_ISFIFO(st.st_mode);
+}
+
+// The file protocol ignores the interrupt callback, so a write to a FIFO
+// whose reader does not read would block forever. Instead, write to a
+// non-blocking file descriptor through the pipe protocol: FFmpeg retries the
+// writes failing with EAGAIN, and checks the interrupt callback meanwhile.
+static int
+open_fifo(const char *path) {
+    // blocks until a reader opens the FIFO (unblocked on close)
+    int fd = open(path, O_WRONLY);
+    if (fd == -1) {
+        LOGE("Could not open FIFO: %s", path);
+        return -1;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        LOGE("Could not make FIFO non-blocking: %s", path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+#endif
+
+static bool
+restreamer_open_output(struct sc_restreamer *restreamer) {
+    const char *format_name = get_format_name(restreamer->format);
+    assert(format_name);
+    const AVOutputFormat *format = find_muxer(format_name);
+    if (!format) {
+        LOGE("Could not find muxer: %s", format_name);
+        return false;
+    }
+
+    restreamer->ctx = avformat_alloc_context();
+    if (!restreamer->ctx) {
+        LOGE("Could not allocate restream output context");
+        return false;
+    }
+
+    // contrary to the deprecated API (av_oformat_next()), av_muxer_iterate()
+    // returns (on purpose) a pointer-to-const, but AVFormatContext.oformat
+    // still expects a pointer-to-non-const (it has not be updated accordingly)
+    // <https://github.com/FFmpeg/FFmpeg/commit/0694d8702421e7aff1340038559c438b61bb30dd>
+    restreamer->ctx->oformat = (AVOutputFormat *) format;
+#ifdef SCRCPY_LAVF_HAS_AVFORMATCONTEXT_URL
+    // the RTP muxer reads the destination from the url
+    restreamer->ctx->url = strdup(restreamer->url);
+    if (!restreamer->ctx->url) {
+        LOGE("Could not strdup restream url");
+        goto error_avformat_free_context;
+    }
+#else
+    strncpy(restreamer->ctx->filename, restreamer->url,
+            sizeof(restreamer->ctx->filename));
+#endif
+
+    // send each packet as soon as it is muxed
+    restreamer->ctx->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+
+    const AVIOInterruptCB int_cb = {
+        .callback = restreamer_interrupt_cb,
+        .opaque = restreamer,
+    };
+    restreamer->ctx->interrupt_callback = int_cb;
+
+    AVStream *ostream = avformat_new_stream(restreamer->ctx, restreamer->codec);
+    if (!ostream) {
+        LOGE("Could not allocate restream stream");
+        goto error_avformat_free_context;
+    }
+
+    ostream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    ostream->codecpar->codec_id = restreamer->codec->id;
+    ostream->codecpar->format = AV_PIX_FMT_YUV420P;
+    ostream->codecpar->width = restreamer->declared_frame_size.width;
+    ostream->codecpar->height = restreamer->declared_frame_size.height;
+
+    const char *url = restreamer->url;
+    restreamer->fifo_fd = -1;
+#ifndef _WIN32
+    // This may block until a reader opens the FIFO, this is the reason why
+    // the output is opened from the restreamer thread
+    char pipe_url[32];
+    if (is_fifo(url)) {
+        restreamer->fifo_fd = open_fifo(url);
+        if (restreamer->fifo_fd == -1) {
+            goto error_avformat_free_context;
+        }
+        sprintf(pipe_url, "pipe:%d", restreamer->fifo_fd);
+        url = pipe_url;
+    }
+#endif
+
+    AVDictionary *opts = NULL;
+    if (!strncmp(url, "unix:", 5)) {
+        // datagram by default, so that a slow reader loses packets rather
+        // than blocking the sender
+        av_dict_set(&opts, "type", "datagram", 0);
+    } else if (!strncmp(url, "udp:", 4)
+            && restreamer->format == SC_RESTREAM_FORMAT_MPEGTS) {
+        // 7 MPEG-TS packets of 188 bytes per datagram: the default (1472)
+        // would split TS packets across datagrams
+        av_dict_set(&opts, "pkt_size", "1316", 0);
+    }
+
+    int ret = avio_open2(&restreamer->ctx->pb, url, AVIO_FLAG_WRITE, &int_cb,
+                         &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        LOGE("Failed to open restream output: %s", restreamer->url);
+        // ostream will be cleaned up during context cleaning
+        goto error_close_fifo;
+    }
+
+    return true;
+
+error_close_fifo:
+#ifndef _WIN32
+    if (restreamer->fifo_fd != -1) {
+        close(restreamer->fifo_fd);
+    }
+#endif
+error_avformat_free_context:
+    avformat_free_context(restreamer->ctx);
+
+    return false;
+}
+
+static void
+restreamer_close_output(struct sc_restreamer *restreamer) {
+    avio_closep(&restreamer->ctx->pb);
+#ifndef _WIN32
+    // the pipe protocol does not close its file descriptor
+    if (restreamer->fifo_fd != -1) {
+        close(restreamer->fifo_fd);
+    }
+#endif
+    avformat_free_context(restreamer->ctx);
+}
+
+static void
+restreamer_log_sdp(struct sc_restreamer *restreamer) {
+    char sdp[2048];
+    AVFormatContext *ctxs[] = {restreamer->ctx};
+    if (av_sdp_create(ctxs, 1, sdp, sizeof(sdp))) {
+        LOGW("Could not create SDP");
+        return;
+    }
+    LOGI("Restream SDP:\n%s", sdp);
+}
+
+static bool
+restreamer_write_header(struct sc_restreamer *restreamer,
+                        const AVPacket *packet) {
+    AVStream *ostream = restreamer->ctx->streams[0];
+
+    uint8_t *extradata = av_malloc(packet->size * sizeof(uint8_t));
+    if (!extradata) {
+        LOGC("Could not allocate extradata");
+        return false;
+    }
+
+    // copy the first packet to the extra data
+    memcpy(extradata, packet->data, packet->size);
+
+    ostream->codecpar->extradata = extradata;
+    ostream->codecpar->extradata_size = packet->size;
+
+    int ret = avformat_write_header(restreamer->ctx, NULL);
+    if (ret < 0) {
+        LOGE("Failed to write header to %s", restreamer->url);
+        return false;
+    }
+
+    if (restreamer->format == SC_RESTREAM_FORMAT_RTP) {
+        // the SDP is necessary to play the RTP stream
+        restreamer_log_sdp(restreamer);
+    }
+
+    return true;
+}
+
+static bool
+restreamer_write(struct sc_restreamer *restreamer, AVPacket *packet) {
+    if (!restreamer->header_written) {
+        if (!is_config_packet(packet)) {
+            LOGE("The first packet is not a config packet");
+            return false;
+        }
+        bool ok = restreamer_write_header(restreamer, packet);
+        if (!ok) {
+            return false;
+        }
+        restreamer->header_written = true;
+        return true;
+    }
+
+    if (is_config_packet(packet)) {
+        // ignore config packets (keyframes are prefixed by the config)
+        return true;
+    }
+
+    // no B-frames
+    packet->dts = packet->pts;
+
+    AVStream *ostream = restreamer->ctx->streams[0];
+    av_packet_rescale_ts(packet, SCRCPY_TIME_BASE, ostream->time_base);
+    return av_write_frame(restreamer->ctx, packet) >= 0;
+}
+
+static void
+restreamer_fail(struct sc_restreamer *restreamer) {
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->failed = true;
+    // discard pending packets
+    restreamer_clear(restreamer);
+    sc_mutex_unlock(&restreamer->mutex);
+}
+
+static int
+run_restreamer(void *data) {
+    struct sc_restreamer *restreamer = data;
+
+#ifndef _WIN32
+    // If the reader of a FIFO goes away, write() must fail with EPIPE rather
+    // than killing the whole process
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+
+    bool opened = restreamer_open_output(restreamer);
+
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->opening = false;
+    sc_cond_signal(&restreamer->opened_cond);
+    sc_mutex_unlock(&restreamer->mutex);
+
+    if (!opened) {
+        restreamer_fail(restreamer);
+        goto end;
+    }
+
+    LOGI("Restreaming started to %s", restreamer->url);
+
+    for (;;) {
+        sc_mutex_lock(&restreamer->mutex);
+
+        while (!restreamer->stopped
+                && sc_queue_is_empty(&restreamer->queue)) {
+            sc_cond_wait(&restreamer->queue_cond, &restreamer->mutex);
+        }
+
+        if (restreamer->stopped) {
+            // contrary to the recorder, the pending packets are not flushed
+            sc_mutex_unlock(&restreamer->mutex);
+            break;
+        }
+
+        struct sc_restream_packet *rp;
+        sc_queue_take(&restreamer->queue, next, &rp);
+        --restreamer->queue_size;
+
+        sc_mutex_unlock(&restreamer->mutex);
+
+        bool ok = restreamer_write(restreamer, rp->packet);
+        restream_packet_delete(rp);
+        if (!ok) {
+            LOGE("Could not restream packet to %s, restreaming disabled",
+                 restreamer->url);
+            restreamer_fail(restreamer);
+            break;
+        }
+    }
+
+    if (!restreamer->failed && restreamer->header_written) {
+        // the trailer is only useful for files (it does nothing for UDP)
+        if (av_write_trailer(restreamer->ctx) < 0) {
+            LOGW("Failed to write trailer to %s", restreamer->url);
+        }
+    }
+
+    restreamer_close_output(restreamer);
+
+end:
+    LOGD("Restreamer thread ended");
+
+    return 0;
+}
+
+static bool
+restreamer_open(struct sc_restreamer *restreamer, const AVCodec *codec) {
+    bool ok = sc_mutex_init(&restreamer->mutex);
+    if (!ok) {
+        LOGC("Could not create mutex");
+        return false;
+    }
+
+    ok = sc_cond_init(&restreamer->queue_cond);
+    if (!ok) {
+        LOGC("Could not create cond");
+        goto error_mutex_destroy;
+    }
+
+    ok = sc_cond_init(&restreamer->opened_cond);
+    if (!ok) {
+        LOGC("Could not create cond");
+        goto error_queue_cond_destroy;
+    }
+
+    sc_queue_init(&restreamer->queue);
+    restreamer->queue_size = 0;
+    restreamer->opening = true;
+    restreamer->stopped = false;
+    restreamer->failed = false;
+    restreamer->wait_keyframe = false;
+    restreamer->dropped = 0;
+    restreamer->header_written = false;
+    restreamer->codec = codec;
+    atomic_init(&restreamer->interrupted, false);
+
+    LOGD("Starting restreamer thread");
+    ok = sc_thread_create(&restreamer->thread, run_restreamer, "restreamer",
+                          restreamer);
+    if (!ok) {
+        LOGC("Could not start restreamer thread");
+        goto error_opened_cond_destroy;
+    }
+
+    return true;
+
+error_opened_cond_destroy:
+    sc_cond_destroy(&restreamer->opened_cond);
+error_queue_cond_destroy:
+    sc_cond_destroy(&restreamer->queue_cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&restreamer->mutex);
+
+    return false;
+}
+
+#ifndef _WIN32
+// Opening a FIFO for writing blocks until a reader opens it: open it for
+// reading to unblock the restreamer thread
+//
+// Return the file descriptor to close once the thread has opened the output
+// (-1 if the path is not a FIFO).
+static int
+unblock_fifo(const char *path) {
+    if (!is_fifo(path)) {
+        return -1;
+    }
+
+    return open(path, O_RDONLY | O_NONBLOCK);
+}
+#endif
+
+static void
+restreamer_close(struct sc_restreamer *restreamer) {
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->stopped = true;
+    sc_cond_signal(&restreamer->queue_cond);
+    sc_mutex_unlock(&restreamer->mutex);
+
+    // interrupt any blocking network operation
+    atomic_store(&restreamer->interrupted, true);
+#ifndef _WIN32
+    // The thread may not have reached open() yet: the reader must remain
+    // open until it has returned
+    int fifo_fd = unblock_fifo(restreamer->url);
+#endif
+
+    sc_mutex_lock(&restreamer->mutex);
+    while (restreamer->opening) {
+        sc_cond_wait(&restreamer->opened_cond, &restreamer->mutex);
+    }
+    sc_mutex_unlock(&restreamer->mutex);
+
+#ifndef _WIN32
+    if (fifo_fd != -1) {
+        close(fifo_fd);
+    }
+#endif
+
+    sc_thread_join(&restreamer->thread, NULL);
+
+    restreamer_clear(restreamer);
+
+    if (restreamer->dropped) {
+        LOGI("Restreaming dropped %llu packets",
+             (unsigned long long) restreamer->dropped);
+    }
+
+    sc_cond_destroy(&restreamer->opened_cond);
+    sc_cond_destroy(&restreamer->queue_cond);
+    sc_mutex_destroy(&restreamer->mutex);
+}
+
+static bool
+restreamer_push(struct sc_restreamer *restreamer, const AVPacket *packet) {
+    sc_mutex_lock(&restreamer->mutex);
+    assert(!restreamer->stopped);
+
+    if (restreamer->failed) {
+        // never stop the stream, just discard the packet
+        sc_mutex_unlock(&restreamer->mutex);
+        return true;
+    }
+
+    if (!is_config_packet(packet)) {
+        bool key = packet->flags & AV_PKT_FLAG_KEY;
+        if (restreamer->queue_size >= SC_RESTREAMER_QUEUE_LIMIT) {
+            // The consumer does not keep up. The pending packets depend on
+            // each other, so drop them all.
+            LOGW("Restreaming too slow, dropping packets until the next "
+                 "keyframe");
+            restreamer_drop_pending(restreamer);
+            restreamer->wait_keyframe = true;
+        }
+
+        if (restreamer->wait_keyframe) {
+            if (!key) {
+                ++restreamer->dropped;
+                sc_mutex_unlock(&restreamer->mutex);
+                return true;
+            }
+            restreamer->wait_keyframe = false;
+        }
+    }
+
+    struct sc_restream_packet *rp = restream_packet_new(packet);
+    if (!rp) {
+        LOGC("Could not allocate restream packet");
+        ++restreamer->dropped;
+        // the next packets may depend on this one
+        restreamer->wait_keyframe = true;
+        sc_mutex_unlock(&restreamer->mutex);
+        return true;
+    }
+
+    sc_queue_push(&restreamer->queue, next, rp);
+    ++restreamer->queue_size;
+    sc_cond_signal(&restreamer->queue_cond);
+
+    sc_mutex_unlock(&restreamer->mutex);
+    return true;
+}
+
+static bool
+restreamer_packet_sink_open(struct sc_packet_sink *sink, const AVCodec *codec) {
+    struct sc_restreamer *restreamer = DOWNCAST(sink);
+    return restreamer_open(restreamer, codec);
+}
+
+static void
+restreamer_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_restreamer *restreamer = DOWNCAST(sink);
+    restreamer_close(restreamer);
+}
+
+static bool
+restreamer_packet_sink_push(struct sc_packet_sink *sink,
+                            const AVPacket *packet) {
+    struct sc_restreamer *restreamer = DOWNCAST(sink);
+    return restreamer_push(restreamer, packet);
+}
+
+bool
+sc_restreamer_init(struct sc_restreamer *restreamer, const char *url,
+                   enum sc_restream_format format,
+                   struct size declared_frame_size) {
+    restreamer->url = strdup(url);
+    if (!restreamer->url) {
+        LOGE("Could not strdup url");
+        return false;
+    }
+
+    if (format == SC_RESTREAM_FORMAT_AUTO) {
+        format = guess_format(url);
+    }
+
+    restreamer->format = format;
+    restreamer->declared_frame_size = declared_frame_size;
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = restreamer_packet_sink_open,
+        .close = restreamer_packet_sink_close,
+        .push = restreamer_packet_sink_push,
+    };
+
+    restreamer->packet_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_restreamer_destroy(struct sc_restreamer *restreamer) {
+    free(restreamer->url);
+}
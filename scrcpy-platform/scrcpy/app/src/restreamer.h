@@ -0,0 +1,72 @@
+#ifndef SC_RESTREAMER_H
+#define SC_RESTREAMER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavformat/avformat.h>
+
+#include "coords.h"
+#include "scrcpy.h"
+#include "trait/packet_sink.h"
+#include "util/queue.h"
+#include "util/thread.h"
+
+// Maximum number of packets waiting to be sent. On overflow, the pending
+// packets are dropped, and the next packets are dropped until a keyframe.
+#define SC_RESTREAMER_QUEUE_LIMIT 60
+
+struct sc_restream_packet {
+    AVPacket *packet;
+    struct sc_restream_packet *next;
+};
+
+struct sc_restream_queue SC_QUEUE(struct sc_restream_packet);
+
+// Remux the H.264 stream (without decoding it) to MPEG-TS or RTP, and send it
+// to a local target:
+//  - "udp://host:port" (UDP, typically on the loopback),
+//  - "rtp://host:port" (RTP over UDP, with the RTP format),
+//  - "unix:/path/to/socket" (UNIX datagram socket),
+//  - a path to a FIFO or a file.
+//
+// A restreamer never stops the stream: on failure, it discards the packets.
+struct sc_restreamer {
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    char *url;
+    enum sc_restream_format format;
+    struct size declared_frame_size;
+
+    // only accessed from the restreamer thread once started
+    const AVCodec *codec;
+    AVFormatContext *ctx;
+    int fifo_fd; // the non-blocking FIFO written by the output, or -1
+    bool header_written;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond queue_cond;
+    sc_cond opened_cond;
+    bool opening; // until the thread has returned from opening the output
+    bool stopped; // set on restreamer_close()
+    bool failed; // set on output failure
+    atomic_bool interrupted; // interrupt blocking I/O on close
+    struct sc_restream_queue queue;
+    unsigned queue_size;
+    // set on queue overflow, reset on the next keyframe
+    bool wait_keyframe;
+    uint64_t dropped;
+};
+
+bool
+sc_restreamer_init(struct sc_restreamer *restreamer, const char *url,
+                   enum sc_restream_format format,
+                   struct size declared_frame_size);
+
+void
+sc_restreamer_destroy(struct sc_restreamer *restreamer);
+
+#endif
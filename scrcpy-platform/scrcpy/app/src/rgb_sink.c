@@ -0,0 +1,69 @@
+#include "rgb_sink.h"
+
+#include <assert.h>
+#include <libavutil/frame.h>
+
+#include "util/log.h"
+
+bool
+sc_rgb_sink_convert(struct sc_rgb_sink *rs, sc_tick timeout) {
+    uint64_t seq;
+    const AVFrame *frame = sc_latest_frame_acquire(&rs->latest, timeout, &seq);
+    if (!frame) {
+        return false;
+    }
+
+    // the frames published meanwhile have been replaced without conversion
+    assert(seq > rs->last_seq);
+    atomic_fetch_add_explicit(&rs->skipped, seq - rs->last_seq - 1,
+                              memory_order_relaxed);
+    rs->last_seq = seq;
+
+    bool ok = frame->format == AV_PIX_FMT_YUV420P;
+    if (ok) {
+        struct sc_yuv_image image = {
+            .data = {frame->data[0], frame->data[1], frame->data[2]},
+            .linesize = {frame->linesize[0], frame->linesize[1],
+                         frame->linesize[2]},
+            .width = frame->width,
+            .height = frame->height,
+        };
+        sc_yuv_scale_to_rgb(&rs->scaler, &image, rs->buffer, rs->stride);
+    } else {
+        LOGE("Unsupported frame format for RGB sink: %d", frame->format);
+    }
+
+    sc_latest_frame_release(&rs->latest);
+    return ok;
+}
+
+bool
+sc_rgb_sink_init(struct sc_rgb_sink *rs, enum sc_rgb_format format,
+                 unsigned width, unsigned height, uint8_t *buffer,
+                 size_t stride) {
+    assert(buffer);
+    assert(stride >= width * sc_rgb_format_bpp(format));
+
+    if (!sc_yuv_scaler_init(&rs->scaler, format, width, height)) {
+        LOGE("Could not initialize RGB scaler");
+        return false;
+    }
+
+    if (!sc_latest_frame_init(&rs->latest)) {
+        sc_yuv_scaler_destroy(&rs->scaler);
+        return false;
+    }
+
+    rs->buffer = buffer;
+    rs->stride = stride;
+    rs->last_seq = 0;
+    atomic_init(&rs->skipped, 0);
+
+    return true;
+}
+
+void
+sc_rgb_sink_destroy(struct sc_rgb_sink *rs) {
+    sc_latest_frame_destroy(&rs->latest);
+    sc_yuv_scaler_destroy(&rs->scaler);
+}
@@ -0,0 +1,70 @@
+#ifndef SC_RGB_SINK_H
+#define SC_RGB_SINK_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "latest_frame.h"
+#include "util/tick.h"
+#include "util/yuv.h"
+
+// Convert and scale the decoded frames to RGB, directly into a buffer
+// provided by the consumer (typically the memory of an image of the UI
+// toolkit), so that a frame is converted and written only once.
+//
+// The decoder thread only keeps the latest frame (by reference, without copy,
+// see latest_frame.h). The consumer converts it from its own thread, at its
+// own rate: the frames it does not take are never converted.
+struct sc_rgb_sink {
+    struct sc_latest_frame latest; // provides the frame sink trait
+
+    struct sc_yuv_scaler scaler;
+    uint8_t *buffer;
+    size_t stride;
+
+    // accessed only by the consumer
+    uint64_t last_seq;
+    atomic_uint_least64_t skipped; // frames never converted
+};
+
+bool
+sc_rgb_sink_init(struct sc_rgb_sink *rs, enum sc_rgb_format format,
+                 unsigned width, unsigned height, uint8_t *buffer,
+                 size_t stride);
+
+void
+sc_rgb_sink_destroy(struct sc_rgb_sink *rs);
+
+static inline struct sc_frame_sink *
+sc_rgb_sink_frame_sink(struct sc_rgb_sink *rs) {
+    return &rs->latest.frame_sink;
+}
+
+// Convert the latest frame into the buffer, if it has not been converted yet
+//
+// If there is no new frame, wait at most timeout (0 to return immediately,
+// negative to wait until a frame is received, the stream is closed or the
+// sink is interrupted). Return false if no frame has been converted.
+//
+// Must always be called from the same thread (or with external
+// synchronization).
+bool
+sc_rgb_sink_convert(struct sc_rgb_sink *rs, sc_tick timeout);
+
+// Wake up the consumer waiting in sc_rgb_sink_convert() (if any), and make the
+// next calls fail immediately
+static inline void
+sc_rgb_sink_interrupt(struct sc_rgb_sink *rs) {
+    sc_latest_frame_interrupt(&rs->latest);
+}
+
+static inline uint64_t
+sc_rgb_sink_get_skipped(struct sc_rgb_sink *rs) {
+    return atomic_load_explicit(&rs->skipped, memory_order_relaxed);
+}
+
+#endif
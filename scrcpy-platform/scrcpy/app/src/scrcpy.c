@@ -1,5 +1,8 @@
 #include "scrcpy.h"
 
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -15,16 +18,30 @@
 
 #include "controller.h"
 #include "decoder.h"
+#include "es_dump.h"
 #include "events.h"
 #include "file_handler.h"
+#include "fleet.h"
+#include "gesture.h"
 #include "input_manager.h"
+#include "input_replay.h"
+#include "input_trace.h"
+#include "latest_frame.h"
+#include "metrics.h"
 #include "recorder.h"
+#include "restreamer.h"
+#include "rgb_sink.h"
 #include "screen.h"
 #include "server.h"
+#ifdef HAVE_SHM_SINK
+# include "shm_sink.h"
+#endif
 #include "stream.h"
 #include "tiny_xpm.h"
+#include "util/async_log.h"
 #include "util/log.h"
 #include "util/net.h"
+#include "util/thread.h"
 #ifdef HAVE_V4L2
 # include "v4l2_sink.h"
 #endif
@@ -34,33 +51,98 @@ struct scrcpy {
     struct screen screen;
     struct stream stream;
     struct decoder decoder;
-    struct recorder recorder;
+    // the primary recorder, then the extra ones
+    struct recorder recorders[1 + SC_MAX_EXTRA_RECORDS];
+    struct sc_restreamer restreamer;
+    struct sc_es_dump es_dump;
 #ifdef HAVE_V4L2
     struct sc_v4l2_sink v4l2_sink;
 #endif
+#ifdef HAVE_SHM_SINK
+    struct sc_shm_sink shm_sink;
+#endif
+    struct sc_latest_frame latest_frame;
     struct controller controller;
+    struct sc_input_trace_writer input_trace;
+    struct sc_input_replay input_replay;
+    // the last gesture injected by scrcpy_swipe() & co
+    struct sc_input_replay gesture_replay;
+    unsigned gesture_rate;
     struct file_handler file_handler;
     struct input_manager input_manager;
     // do not allocate this on stack, keep it in the struct
     struct stream_callbacks stream_cbs;
+    struct sc_es_dump_callbacks es_dump_cbs;
+    struct receiver_callbacks receiver_cbs;
+
+    sc_tick start_tick; // for the startup statistics
+
+    // shared with the other sessions of a fleet (NULL for a single session)
+    struct sc_thread_pool *pool;
+
+    struct sc_metrics metrics;
+
+    // to restart the server on reconnection
+    struct server_params server_params;
+    unsigned reconnect_attempts;
+    // protects the server and the controller, restarted from the stream
+    // thread on reconnection, against a concurrent scrcpy_stop()
+    sc_mutex session_mutex;
+    sc_cond session_cond; // signaled on stop, to interrupt the backoff
+    bool stopped;
+    atomic_uint_least32_t reconnect_count;
+    atomic_int_least64_t reconnect_downtime;
+    atomic_bool stream_ended; // the device is disconnected (for good)
+
+    // set by scrcpy_set_clipboard_listener(), called from the receiver thread
+    sc_mutex clipboard_mutex;
+    void (*on_clipboard)(void *userdata, const char *text);
+    void *on_clipboard_userdata;
 
     // status of scrcpy process
+    bool clipboard_mutex_initialized;
+    bool session_initialized;
     bool server_started;
+    bool decoder_initialized;
     bool file_handler_initialized;
-    bool recorder_initialized;
+    unsigned recorder_count; // number of initialized recorders
+    bool restreamer_initialized;
+    bool es_dump_initialized;
+    bool es_dump_started;
 #ifdef HAVE_V4L2
     bool v4l2_sink_initialized;
 #endif
+#ifdef HAVE_SHM_SINK
+    bool shm_sink_initialized;
+#endif
+    bool latest_frame_initialized;
     bool stream_started;
     bool controller_initialized;
     bool controller_started;
+    bool input_trace_initialized;
+    bool input_replay_initialized;
+    bool input_replay_started;
+    bool gesture_replay_started;
     bool screen_initialized;
+    bool metrics_server_started;
+    bool metrics_registered;
 
     // External sinks- allocated on HEAP. Remember them so that they can be freed later.
     struct sc_frame_sink *external_sinks[DECODER_MAX_SINKS];
     unsigned external_sink_count;
+    struct scrcpy_rgb_sink *rgb_sinks[DECODER_MAX_SINKS];
+    unsigned rgb_sink_count;
+};
+
+struct scrcpy_rgb_sink {
+    struct sc_rgb_sink sink;
 };
 
+static_assert((int) SCRCPY_RGB_FORMAT_BGR24 == (int) SC_RGB_FORMAT_BGR24
+           && (int) SCRCPY_RGB_FORMAT_RGBA == (int) SC_RGB_FORMAT_RGBA
+           && (int) SCRCPY_RGB_FORMAT_BGRA == (int) SC_RGB_FORMAT_BGRA,
+              "unexpected RGB formats");
+
 #ifdef _WIN32
 BOOL WINAPI windows_ctrl_handler(DWORD ctrl_type) {
     if (ctrl_type == CTRL_C_EVENT) {
@@ -250,25 +332,325 @@ av_log_callback(void *avcl, int level, const char *fmt, va_list vl) {
 static void
 stream_on_eos(struct stream *stream, void *userdata) {
     (void) stream;
-    (void) userdata;
+    struct scrcpy *s = userdata;
+
+    atomic_store(&s->stream_ended, true);
 
     SDL_Event stop_event;
     stop_event.type = EVENT_STREAM_STOPPED;
     SDL_PushEvent(&stop_event);
 }
 
+#define RECONNECT_INITIAL_DELAY SC_TICK_FROM_MS(250)
+#define RECONNECT_MAX_DELAY SC_TICK_FROM_SEC(5)
+
+static bool
+is_stopped(struct scrcpy *s) {
+    sc_mutex_lock(&s->session_mutex);
+    bool stopped = s->stopped;
+    sc_mutex_unlock(&s->session_mutex);
+    return stopped;
+}
+
+// Start a new server session
+//
+// The session mutex must not be held, so that scrcpy_stop() is not blocked
+// during the push and the connection.
+static bool
+restart_session(struct scrcpy *s, bool restart_controller) {
+    if (!server_restart(&s->server, &s->server_params)) {
+        return false;
+    }
+
+    if (is_stopped(s)) {
+        goto error_stop_server;
+    }
+
+    // the window title and the frame sinks keep the initial values, a new
+    // frame size is handled by the sinks
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size frame_size;
+    if (!server_connect_to(&s->server, device_name, &frame_size)) {
+        goto error_stop_server;
+    }
+
+    if (is_stopped(s)) {
+        goto error_stop_server;
+    }
+
+    if (restart_controller
+            && !controller_restart(&s->controller,
+                                   s->server.control_socket)) {
+        LOGE("Could not restart the controller");
+        goto error_stop_server;
+    }
+
+    return true;
+
+error_stop_server:
+    server_stop(&s->server);
+    return false;
+}
+
+static socket_t
+reconnect(struct scrcpy *s) {
+    sc_mutex_lock(&s->session_mutex);
+    if (s->stopped) {
+        sc_mutex_unlock(&s->session_mutex);
+        return INVALID_SOCKET;
+    }
+
+    // the sockets are broken, terminate the current session
+    bool restart_controller = s->controller_started;
+    if (s->controller_started) {
+        controller_stop(&s->controller);
+        controller_join(&s->controller);
+        // set again only once restarted, so that scrcpy_stop() does not join
+        // it twice if the device does not come back
+        s->controller_started = false;
+    }
+    server_stop(&s->server);
+    s->server_started = false;
+
+    // the startup statistics describe the initial connection
+    struct server_startup_times startup = s->server.startup;
+
+    socket_t socket = INVALID_SOCKET;
+    sc_tick delay = RECONNECT_INITIAL_DELAY;
+    for (unsigned attempt = 1; attempt <= s->reconnect_attempts; ++attempt) {
+        sc_tick deadline = sc_tick_now() + delay;
+        bool timed_out = false;
+        while (!s->stopped && !timed_out) {
+            timed_out = !sc_cond_timedwait(&s->session_cond,
+                                           &s->session_mutex, deadline);
+        }
+        if (s->stopped) {
+            break;
+        }
+
+        LOGI("Reconnecting (attempt %u/%u)...", attempt,
+             s->reconnect_attempts);
+        sc_mutex_unlock(&s->session_mutex);
+        bool ok = restart_session(s, restart_controller);
+        sc_mutex_lock(&s->session_mutex);
+
+        if (ok && s->stopped) {
+            // scrcpy_stop() has been called meanwhile, it will not stop this
+            // session
+            if (restart_controller) {
+                controller_stop(&s->controller);
+                controller_join(&s->controller);
+            }
+            server_stop(&s->server);
+            break;
+        }
+
+        if (ok) {
+            s->server_started = true;
+            s->controller_started = restart_controller;
+            socket = s->server.video_socket;
+            break;
+        }
+
+        delay = MIN(delay * 2, RECONNECT_MAX_DELAY);
+    }
+
+    s->server.startup = startup;
+    sc_mutex_unlock(&s->session_mutex);
+    return socket;
+}
+
+static socket_t
+stream_on_disconnected(struct stream *stream, void *userdata) {
+    (void) stream;
+    struct scrcpy *s = userdata;
+
+    LOGW("Device disconnected");
+    sc_tick start = sc_tick_now();
+    socket_t socket = reconnect(s);
+    if (socket == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    sc_tick downtime = sc_tick_now() - start;
+    atomic_fetch_add_explicit(&s->reconnect_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->reconnect_downtime, downtime,
+                              memory_order_relaxed);
+    LOGI("Device reconnected (after %" PRItick " ms)",
+         SC_TICK_TO_MS(downtime));
+    return socket;
+}
+
+static void
+es_dump_on_eos(struct sc_es_dump *dump, void *userdata) {
+    (void) dump;
+    struct scrcpy *s = userdata;
+
+    atomic_store(&s->stream_ended, true);
+
+    SDL_Event stop_event;
+    stop_event.type = EVENT_STREAM_STOPPED;
+    SDL_PushEvent(&stop_event);
+}
+
+static void
+set_computer_clipboard(const char *text) {
+    char *current = SDL_GetClipboardText();
+    bool same = current && !strcmp(current, text);
+    SDL_free(current);
+    if (same) {
+        LOGD("Computer clipboard unchanged");
+        return;
+    }
+
+    LOGI("Device clipboard copied");
+    SDL_SetClipboardText(text);
+}
+
+static void
+receiver_on_device_msg(struct receiver *receiver,
+                       const struct device_msg *msg, void *userdata) {
+    (void) receiver;
+    struct scrcpy *s = userdata;
+
+    switch (msg->type) {
+        case DEVICE_MSG_TYPE_CLIPBOARD:
+            sc_mutex_lock(&s->clipboard_mutex);
+            if (s->on_clipboard) {
+                s->on_clipboard(s->on_clipboard_userdata, msg->clipboard.text);
+            } else {
+                set_computer_clipboard(msg->clipboard.text);
+            }
+            sc_mutex_unlock(&s->clipboard_mutex);
+            break;
+        default:
+            break;
+    }
+}
+
+static int64_t
+sample_control_msgs(void *userdata) {
+    struct controller *controller = userdata;
+    return atomic_load_explicit(&controller->stats.msgs, memory_order_relaxed);
+}
+
+static int64_t
+sample_control_bytes(void *userdata) {
+    struct controller *controller = userdata;
+    return atomic_load_explicit(&controller->stats.bytes,
+                                memory_order_relaxed);
+}
+
+static int64_t
+sample_control_queue(void *userdata) {
+    struct controller *controller = userdata;
+    return sc_mpsc_size(&controller->queue);
+}
+
+static int64_t
+sample_reconnections(void *userdata) {
+    struct scrcpy *s = userdata;
+    return atomic_load_explicit(&s->reconnect_count, memory_order_relaxed);
+}
+
+static int64_t
+sample_reconnect_downtime(void *userdata) {
+    struct scrcpy *s = userdata;
+    return atomic_load_explicit(&s->reconnect_downtime, memory_order_relaxed);
+}
+
+static int64_t
+sample_rendered_frames(void *userdata) {
+    struct fps_counter *counter = userdata;
+    return atomic_load_explicit(&counter->nr_rendered, memory_order_relaxed);
+}
+
+static int64_t
+sample_skipped_frames(void *userdata) {
+    struct fps_counter *counter = userdata;
+    return atomic_load_explicit(&counter->nr_skipped, memory_order_relaxed);
+}
+
 struct scrcpy_process *
-scrcpy_start(const struct scrcpy_options *options) {
-    struct scrcpy *s = malloc(sizeof(struct scrcpy));
+scrcpy_start_pooled(const struct scrcpy_options *options,
+                    struct sc_thread_pool *pool) {
+    // the sessions of a fleet are configured by the fleet
+    if (!pool && !sc_thread_config_init(options->thread_config)) {
+        return NULL;
+    }
+
+    // from now on, logging never blocks (the messages are written by a
+    // background thread)
+    if (!sc_async_log_start()) {
+        return NULL;
+    }
+
+    // zero-initialize, so that all the "initialized" flags are false
+    struct scrcpy *s = calloc(1, sizeof(struct scrcpy));
     struct scrcpy_process *p = malloc(sizeof(struct scrcpy));
     p->scrcpy_struct = s;
+    s->pool = pool;
+
+    if (!sc_mutex_init(&s->clipboard_mutex)) {
+        free(s);
+        free(p);
+        return NULL;
+    }
+    s->clipboard_mutex_initialized = true;
+    s->start_tick = sc_tick_now();
+
+    if (!sc_mutex_init(&s->session_mutex)) {
+        scrcpy_stop(p);
+        return NULL;
+    }
+
+    if (!sc_cond_init(&s->session_cond)) {
+        sc_mutex_destroy(&s->session_mutex);
+        scrcpy_stop(p);
+        return NULL;
+    }
+    s->session_initialized = true;
+    s->reconnect_attempts = options->reconnect_attempts;
+    atomic_init(&s->reconnect_count, 0);
+    atomic_init(&s->reconnect_downtime, 0);
+    atomic_init(&s->stream_ended, false);
 
     if (!server_init(&s->server)) {
         return NULL;
     }
 
     bool record = !!options->record_filename;
-    struct server_params params = {
+    bool record_raw = !!options->record_raw_filename;
+    bool restream = !!options->restream_url;
+
+    struct decoder *dec = NULL;
+    bool needs_decoder = options->display;
+#ifdef HAVE_V4L2
+    needs_decoder |= !!options->v4l2_device;
+#endif
+#ifdef HAVE_SHM_SINK
+    needs_decoder |= !!options->shm_name;
+#endif
+    needs_decoder |= options->latest_frame;
+    needs_decoder |= options->force_decoder;
+    if (record_raw && (needs_decoder || record || restream)) {
+        // the raw dump reads the video socket directly, bypassing the stream
+        LOGE("Raw stream dump is incompatible with any other video output");
+        scrcpy_stop(p);
+        return NULL;
+    }
+    if (needs_decoder) {
+        if (!decoder_init(&s->decoder)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+        s->decoder_initialized = true;
+        dec = &s->decoder;
+
+        // open the codec while the server starts
+        decoder_preopen(dec);
+    }
+    s->server_params = (struct server_params) {
         .serial = options->serial,
         .log_level = options->log_level,
         .crop = options->crop,
@@ -286,15 +668,18 @@ scrcpy_start(const struct scrcpy_options *options) {
         .force_adb_forward = options->force_adb_forward,
         .power_off_on_close = options->power_off_on_close,
     };
-    if (!server_start(&s->server, &params)) {
+    if (!server_start(&s->server, &s->server_params)) {
         scrcpy_stop(p);
         return NULL;
     }
 
     s->server_started = true;
 
-    if (!sdl_init_and_configure(options->display, options->render_driver,
-                                options->disable_screensaver)) {
+    // the sessions of a fleet share the SDL initialization of the fleet, which
+    // is not thread-safe
+    if (!pool && !sdl_init_and_configure(options->display,
+                                         options->render_driver,
+                                         options->disable_screensaver)) {
         scrcpy_stop(p);
         return NULL;
     }
@@ -306,6 +691,30 @@ scrcpy_start(const struct scrcpy_options *options) {
         return NULL;
     }
 
+    const struct server_startup_times *times = &s->server.startup;
+    LOGD("Startup (ms): push=%" PRItick " tunnel=%" PRItick " execute=%"
+         PRItick " connect=%" PRItick " (%u attempts)",
+         SC_TICK_TO_MS(times->push), SC_TICK_TO_MS(times->tunnel),
+         SC_TICK_TO_MS(times->execute), SC_TICK_TO_MS(times->connect),
+         times->connect_attempts);
+
+    sc_metrics_init(&s->metrics, s->server.serial);
+    sc_metrics_set_sample(&s->metrics, SC_METRIC_RECONNECTIONS,
+                          sample_reconnections, s);
+    sc_metrics_set_sample(&s->metrics, SC_METRIC_RECONNECT_DOWNTIME,
+                          sample_reconnect_downtime, s);
+    if (dec) {
+        dec->metrics = &s->metrics;
+    }
+
+    if (options->metrics_listen) {
+        if (!sc_metrics_server_start(options->metrics_listen)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+        s->metrics_server_started = true;
+    }
+
     if (options->display && options->control) {
         if (!file_handler_init(&s->file_handler, s->server.serial,
                                options->push_target)) {
@@ -315,50 +724,128 @@ scrcpy_start(const struct scrcpy_options *options) {
         s->file_handler_initialized = true;
     }
 
-    struct decoder *dec = NULL;
-    bool needs_decoder = options->display;
-#ifdef HAVE_V4L2
-    needs_decoder |= !!options->v4l2_device;
-#endif
-    needs_decoder |= options->force_decoder;
-    if (needs_decoder) {
-        decoder_init(&s->decoder);
-        dec = &s->decoder;
+    struct sc_record records[1 + SC_MAX_EXTRA_RECORDS];
+    unsigned record_count = 0;
+    if (record) {
+        if (options->extra_record_count > SC_MAX_EXTRA_RECORDS) {
+            LOGE("Too many recordings (max %d)", 1 + SC_MAX_EXTRA_RECORDS);
+            scrcpy_stop(p);
+            return NULL;
+        }
+
+        records[record_count++] = (struct sc_record) {
+            .filename = options->record_filename,
+            .format = options->record_format,
+        };
+        for (unsigned i = 0; i < options->extra_record_count; ++i) {
+            records[record_count++] = options->extra_records[i];
+        }
     }
 
-    struct recorder *rec = NULL;
-    if (record) {
-        if (!recorder_init(&s->recorder,
-                           options->record_filename,
-                           options->record_format,
-                           p->frame_size)) {
+    // If there are other outputs, a failing recorder must not stop them
+    bool isolate_failure = needs_decoder || restream || record_count > 1;
+    for (unsigned i = 0; i < record_count; ++i) {
+        if (!recorder_init(&s->recorders[i],
+                           records[i].filename,
+                           records[i].format,
+                           p->frame_size,
+                           isolate_failure, s->pool)) {
             scrcpy_stop(p);
             return NULL;
         }
-        rec = &s->recorder;
-        s->recorder_initialized = true;
+        s->recorders[i].metrics = &s->metrics;
+        s->recorder_count++;
+    }
+
+    if (restream) {
+        if (!sc_restreamer_init(&s->restreamer, options->restream_url,
+                                options->restream_format, p->frame_size)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+        s->restreamer_initialized = true;
     }
 
     av_log_set_callback(av_log_callback);
 
-    // don't allocate callbacks on stack
-    s->stream_cbs.on_eos = stream_on_eos;
-    stream_init(&s->stream, s->server.video_socket, &s->stream_cbs, NULL);
+    if (record_raw) {
+        // don't allocate callbacks on stack
+        s->es_dump_cbs.on_eos = es_dump_on_eos;
+        if (!sc_es_dump_init(&s->es_dump, s->server.video_socket,
+                             options->record_raw_filename,
+                             options->record_raw_pts_filename,
+                             &s->es_dump_cbs, s)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+        s->es_dump_initialized = true;
+    } else {
+        // don't allocate callbacks on stack
+        s->stream_cbs.on_eos = stream_on_eos;
+        if (options->reconnect_attempts) {
+            s->stream_cbs.on_disconnected = stream_on_disconnected;
+        }
+        stream_init(&s->stream, s->server.video_socket, &s->stream_cbs, s);
+        s->stream.metrics = &s->metrics;
 
-    if (dec) {
-        stream_add_sink(&s->stream, &dec->packet_sink);
-    }
+        if (dec) {
+            stream_add_sink(&s->stream, &dec->packet_sink);
+        }
+
+        for (unsigned i = 0; i < s->recorder_count; ++i) {
+            stream_add_sink(&s->stream, &s->recorders[i].packet_sink);
+        }
 
-    if (rec) {
-        stream_add_sink(&s->stream, &rec->packet_sink);
+        if (restream) {
+            stream_add_sink(&s->stream, &s->restreamer.packet_sink);
+        }
     }
 
     if (options->control) {
-        if (!controller_init(&s->controller, s->server.control_socket)) {
+        s->gesture_rate = options->gesture_rate;
+        s->receiver_cbs.on_device_msg = receiver_on_device_msg;
+        if (!controller_init(&s->controller, s->server.control_socket,
+                             options->coalesce_moves, &s->receiver_cbs, s)) {
                 scrcpy_stop(p);
                 return NULL;
         }
         s->controller_initialized = true;
+        s->controller.rtt_probe_interval = options->rtt_probe_interval;
+
+        // the controller already counts its messages
+        sc_metrics_set_sample(&s->metrics, SC_METRIC_CONTROL_MSGS,
+                              sample_control_msgs, &s->controller);
+        sc_metrics_set_sample(&s->metrics, SC_METRIC_CONTROL_BYTES,
+                              sample_control_bytes, &s->controller);
+        sc_metrics_set_sample(&s->metrics, SC_METRIC_CONTROL_QUEUE,
+                              sample_control_queue, &s->controller);
+
+        if (options->record_input_filename) {
+            if (!sc_input_trace_writer_init(&s->input_trace,
+                                            options->record_input_filename)) {
+                scrcpy_stop(p);
+                return NULL;
+            }
+            s->input_trace_initialized = true;
+            s->controller.trace = &s->input_trace;
+        }
+
+        if (options->replay_input_filename) {
+            struct sc_timed_msg *msgs;
+            size_t count;
+            if (!sc_input_trace_load(options->replay_input_filename, &msgs,
+                                     &count)) {
+                scrcpy_stop(p);
+                return NULL;
+            }
+
+            if (!sc_input_replay_init(&s->input_replay, &s->controller, msgs,
+                                      count)) {
+                scrcpy_stop(p);
+                return NULL;
+            }
+            s->input_replay_initialized = true;
+        }
 
         if (!controller_start(&s->controller)) {
                 scrcpy_stop(p);
@@ -375,6 +862,14 @@ scrcpy_start(const struct scrcpy_options *options) {
                 LOGW("Could not request 'set screen power mode'");
             }
         }
+
+        if (s->input_replay_initialized) {
+            if (!sc_input_replay_start(&s->input_replay)) {
+                scrcpy_stop(p);
+                return NULL;
+            }
+            s->input_replay_started = true;
+        }
     }
 
     if (options->display) {
@@ -402,13 +897,19 @@ scrcpy_start(const struct scrcpy_options *options) {
         }
         s->screen_initialized = true;
 
+        // the FPS counter already counts the frames
+        sc_metrics_set_sample(&s->metrics, SC_METRIC_RENDERED_FRAMES,
+                              sample_rendered_frames, &s->screen.fps_counter);
+        sc_metrics_set_sample(&s->metrics, SC_METRIC_SKIPPED_FRAMES,
+                              sample_skipped_frames, &s->screen.fps_counter);
+
         decoder_add_sink(&s->decoder, &s->screen.frame_sink);
     }
 
 #ifdef HAVE_V4L2
     if (options->v4l2_device) {
         if (!sc_v4l2_sink_init(&s->v4l2_sink, options->v4l2_device, p->frame_size,
-                               options->v4l2_buffer)) {
+                               options->v4l2_buffer, options->v4l2_format)) {
             scrcpy_stop(p);
             return NULL;
         }
@@ -419,13 +920,50 @@ scrcpy_start(const struct scrcpy_options *options) {
     }
 #endif
 
+#ifdef HAVE_SHM_SINK
+    if (options->shm_name) {
+        if (!sc_shm_sink_init(&s->shm_sink, options->shm_name,
+                              p->frame_size)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+
+        decoder_add_sink(&s->decoder, &s->shm_sink.frame_sink);
+
+        s->shm_sink_initialized = true;
+    }
+#endif
+
+    if (options->latest_frame) {
+        if (!sc_latest_frame_init(&s->latest_frame)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+
+        decoder_add_sink(&s->decoder, &s->latest_frame.frame_sink);
+
+        s->latest_frame_initialized = true;
+    }
+
+    // all the sample functions are set, the metrics may be exported
+    sc_metrics_register(&s->metrics);
+    s->metrics_registered = true;
+
     // now we consumed the header values, the socket receives the video stream
     // start the stream
-    if (!stream_start(&s->stream)) {
-        scrcpy_stop(p);
-        return NULL;
+    if (record_raw) {
+        if (!sc_es_dump_start(&s->es_dump)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+        s->es_dump_started = true;
+    } else {
+        if (!stream_start(&s->stream)) {
+            scrcpy_stop(p);
+            return NULL;
+        }
+        s->stream_started = true;
     }
-    s->stream_started = true;
 
     return p;
 }
@@ -441,10 +979,282 @@ scrcpy_loop(struct scrcpy_process *p, const struct scrcpy_options *options) {
 }
 
 
+void
+scrcpy_set_clipboard_listener(struct scrcpy_process *p,
+                              void (*on_clipboard)(void *userdata,
+                                                   const char *text),
+                              void *userdata) {
+    struct scrcpy *s = p->scrcpy_struct;
+    sc_mutex_lock(&s->clipboard_mutex);
+    s->on_clipboard = on_clipboard;
+    s->on_clipboard_userdata = userdata;
+    sc_mutex_unlock(&s->clipboard_mutex);
+}
+
+static bool
+play_gesture(struct scrcpy *s, struct sc_timed_msg *msgs, size_t count) {
+    if (s->gesture_replay_started) {
+        // wait for the previous gesture to complete
+        sc_input_replay_join(&s->gesture_replay);
+        sc_input_replay_destroy(&s->gesture_replay);
+        s->gesture_replay_started = false;
+    }
+
+    if (!sc_input_replay_init(&s->gesture_replay, &s->controller, msgs,
+                              count)) {
+        return false;
+    }
+
+    if (!sc_input_replay_start(&s->gesture_replay)) {
+        sc_input_replay_destroy(&s->gesture_replay);
+        return false;
+    }
+
+    s->gesture_replay_started = true;
+    return true;
+}
+
+bool
+scrcpy_swipe(struct scrcpy_process *p, int32_t x0, int32_t y0, int32_t x1,
+             int32_t y1, uint32_t duration_ms) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_started) {
+        return false;
+    }
+
+    struct sc_swipe swipe = {
+        .from = {x0, y0},
+        .to = {x1, y1},
+        .bezier = false,
+        .duration = SC_TICK_FROM_MS((sc_tick) duration_ms),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    if (!sc_gesture_swipe(&swipe, p->frame_size, s->gesture_rate, &msgs,
+                          &count)) {
+        return false;
+    }
+
+    return play_gesture(s, msgs, count);
+}
+
+bool
+scrcpy_swipe_bezier(struct scrcpy_process *p, int32_t x0, int32_t y0,
+                    int32_t cx1, int32_t cy1, int32_t cx2, int32_t cy2,
+                    int32_t x1, int32_t y1, uint32_t duration_ms) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_started) {
+        return false;
+    }
+
+    struct sc_swipe swipe = {
+        .from = {x0, y0},
+        .to = {x1, y1},
+        .bezier = true,
+        .control1 = {cx1, cy1},
+        .control2 = {cx2, cy2},
+        .duration = SC_TICK_FROM_MS((sc_tick) duration_ms),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    if (!sc_gesture_swipe(&swipe, p->frame_size, s->gesture_rate, &msgs,
+                          &count)) {
+        return false;
+    }
+
+    return play_gesture(s, msgs, count);
+}
+
+bool
+scrcpy_pinch(struct scrcpy_process *p, int32_t cx, int32_t cy,
+             uint16_t start_span, uint16_t end_span, float start_angle,
+             float end_angle, uint32_t duration_ms) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_started) {
+        return false;
+    }
+
+    struct sc_pinch pinch = {
+        .center = {cx, cy},
+        .start_span = start_span,
+        .end_span = end_span,
+        .start_angle = start_angle,
+        .end_angle = end_angle,
+        .duration = SC_TICK_FROM_MS((sc_tick) duration_ms),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    if (!sc_gesture_pinch(&pinch, p->frame_size, s->gesture_rate, &msgs,
+                          &count)) {
+        return false;
+    }
+
+    return play_gesture(s, msgs, count);
+}
+
+bool
+scrcpy_fling(struct scrcpy_process *p, int32_t x0, int32_t y0, int32_t x1,
+             int32_t y1, float velocity) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_started) {
+        return false;
+    }
+
+    struct sc_fling fling = {
+        .from = {x0, y0},
+        .to = {x1, y1},
+        .velocity = velocity,
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    if (!sc_gesture_fling(&fling, p->frame_size, s->gesture_rate, &msgs,
+                          &count)) {
+        return false;
+    }
+
+    return play_gesture(s, msgs, count);
+}
+
+void
+scrcpy_get_startup_stats(struct scrcpy_process *p,
+                         struct scrcpy_startup_stats *stats) {
+    struct scrcpy *s = p->scrcpy_struct;
+
+    const struct server_startup_times *times = &s->server.startup;
+    stats->push = times->push;
+    stats->tunnel = times->tunnel;
+    stats->execute = times->execute;
+    stats->connect = times->connect;
+    stats->connect_attempts = times->connect_attempts;
+
+    sc_tick first_frame = s->decoder_initialized
+                        ? decoder_get_first_frame_tick(&s->decoder)
+                        : 0;
+    stats->first_frame = first_frame ? first_frame - s->start_tick : 0;
+}
+
+bool
+scrcpy_ping(struct scrcpy_process *p) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_started) {
+        return false;
+    }
+
+    return controller_ping(&s->controller);
+}
+
+bool
+scrcpy_get_rtt_stats(struct scrcpy_process *p, struct scrcpy_rtt_stats *stats) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_initialized) {
+        return false;
+    }
+
+    struct sc_histogram_snapshot rtt;
+    controller_get_rtt(&s->controller, &rtt);
+    stats->count = rtt.count;
+    stats->p50 = sc_histogram_percentile(&rtt, 50);
+    stats->p90 = sc_histogram_percentile(&rtt, 90);
+    stats->p99 = sc_histogram_percentile(&rtt, 99);
+    stats->max = rtt.max;
+    return true;
+}
+
+bool
+scrcpy_is_stream_ended(struct scrcpy_process *p) {
+    struct scrcpy *s = p->scrcpy_struct;
+    return atomic_load(&s->stream_ended);
+}
+
+void
+scrcpy_get_reconnect_stats(struct scrcpy_process *p,
+                           struct scrcpy_reconnect_stats *stats) {
+    struct scrcpy *s = p->scrcpy_struct;
+    stats->count = atomic_load_explicit(&s->reconnect_count,
+                                        memory_order_relaxed);
+    stats->downtime = atomic_load_explicit(&s->reconnect_downtime,
+                                           memory_order_relaxed);
+}
+
+void
+scrcpy_get_metrics(struct scrcpy_process *p, struct scrcpy_metrics *metrics) {
+    struct scrcpy *s = p->scrcpy_struct;
+    struct sc_metrics *m = &s->metrics;
+
+    metrics->received_bytes = sc_metrics_get(m, SC_METRIC_RECEIVED_BYTES);
+    metrics->packets = sc_metrics_get(m, SC_METRIC_PACKETS);
+    metrics->keyframes = sc_metrics_get(m, SC_METRIC_KEYFRAMES);
+    metrics->decoded_frames = sc_metrics_get(m, SC_METRIC_DECODED_FRAMES);
+    metrics->rendered_frames = sc_metrics_get(m, SC_METRIC_RENDERED_FRAMES);
+    metrics->skipped_frames = sc_metrics_get(m, SC_METRIC_SKIPPED_FRAMES);
+    metrics->control_msgs = sc_metrics_get(m, SC_METRIC_CONTROL_MSGS);
+    metrics->control_bytes = sc_metrics_get(m, SC_METRIC_CONTROL_BYTES);
+    metrics->recorded_bytes = sc_metrics_get(m, SC_METRIC_RECORDED_BYTES);
+    metrics->reconnections = sc_metrics_get(m, SC_METRIC_RECONNECTIONS);
+    metrics->reconnect_downtime =
+        sc_metrics_get(m, SC_METRIC_RECONNECT_DOWNTIME);
+    metrics->control_queue = sc_metrics_get(m, SC_METRIC_CONTROL_QUEUE);
+    metrics->recorder_queue = sc_metrics_get(m, SC_METRIC_RECORDER_QUEUE);
+
+    struct sc_histogram_snapshot decode_time;
+    sc_histogram_snapshot(&m->decode_time, &decode_time);
+    metrics->decode_count = decode_time.count;
+    metrics->decode_p50 = sc_histogram_percentile(&decode_time, 50);
+    metrics->decode_p99 = sc_histogram_percentile(&decode_time, 99);
+    metrics->decode_max = decode_time.max;
+}
+
+bool
+scrcpy_get_fps_stats(struct scrcpy_process *p, sc_tick window,
+                     struct scrcpy_fps_stats *stats) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->screen_initialized) {
+        return false;
+    }
+
+    struct fps_counter_stats fps;
+    fps_counter_get_stats(&s->screen.fps_counter, sc_tick_now(),
+                          window ? window : SC_TICK_FROM_SEC(1), &fps);
+    stats->rendered = fps.rendered;
+    stats->skipped = fps.skipped;
+    stats->fps = fps.fps;
+    stats->interval_p50 = fps.interval_p50;
+    stats->interval_p90 = fps.interval_p90;
+    stats->interval_p99 = fps.interval_p99;
+    stats->interval_max = fps.interval_max;
+    stats->jitter = fps.jitter;
+    return true;
+}
+
+size_t
+scrcpy_format_metrics(char *buf, size_t size) {
+    return sc_metrics_format_prometheus(buf, size);
+}
+
 void
 scrcpy_stop(struct scrcpy_process *p) {
     struct scrcpy *s = p->scrcpy_struct;
 
+    // the sample functions read the controller, destroyed below
+    if (s->metrics_registered) {
+        sc_metrics_unregister(&s->metrics);
+    }
+    if (s->metrics_server_started) {
+        sc_metrics_server_stop();
+    }
+
+    if (s->session_initialized) {
+        // interrupt a reconnection in progress, and prevent any further one
+        sc_mutex_lock(&s->session_mutex);
+        s->stopped = true;
+        sc_cond_signal(&s->session_cond);
+        sc_mutex_unlock(&s->session_mutex);
+    }
+
     if (s->screen_initialized) {
         // Close the window immediately on closing, because screen_destroy() may
         // only be called once the stream thread is joined (it may take time)
@@ -453,6 +1263,12 @@ scrcpy_stop(struct scrcpy_process *p) {
 
     // The stream is not stopped explicitly, because it will stop by itself on
     // end-of-stream
+    if (s->input_replay_started) {
+        sc_input_replay_stop(&s->input_replay);
+    }
+    if (s->gesture_replay_started) {
+        sc_input_replay_stop(&s->gesture_replay);
+    }
     if (s->controller_started) {
         controller_stop(&s->controller);
     }
@@ -473,12 +1289,23 @@ scrcpy_stop(struct scrcpy_process *p) {
     if (s->stream_started) {
         stream_join(&s->stream);
     }
+    if (s->es_dump_started) {
+        sc_es_dump_join(&s->es_dump);
+    }
 
 #ifdef HAVE_V4L2
     if (s->v4l2_sink_initialized) {
         sc_v4l2_sink_destroy(&s->v4l2_sink);
     }
 #endif
+#ifdef HAVE_SHM_SINK
+    if (s->shm_sink_initialized) {
+        sc_shm_sink_destroy(&s->shm_sink);
+    }
+#endif
+    if (s->latest_frame_initialized) {
+        sc_latest_frame_destroy(&s->latest_frame);
+    }
 
     // Destroy the screen only after the stream is guaranteed to be finished,
     // because otherwise the screen could receive new frames after destruction
@@ -487,15 +1314,63 @@ scrcpy_stop(struct scrcpy_process *p) {
         screen_destroy(&s->screen);
     }
 
+    if (s->decoder_initialized) {
+        sc_tick first_frame = decoder_get_first_frame_tick(&s->decoder);
+        if (first_frame) {
+            LOGD("Time to first frame: %" PRItick " ms",
+                 SC_TICK_TO_MS(first_frame - s->start_tick));
+        }
+        decoder_destroy(&s->decoder);
+    }
+
+    if (s->input_replay_started) {
+        sc_input_replay_join(&s->input_replay);
+
+        struct sc_input_replay_stats stats;
+        sc_input_replay_get_stats(&s->input_replay, &stats);
+        LOGI("Input replay: %" PRIu64 "/%" PRIu64 " events, lateness (us): "
+             "p50=%" PRItick " p90=%" PRItick " p99=%" PRItick
+             " max=%" PRItick, (uint64_t) stats.count,
+             (uint64_t) s->input_replay.count, stats.p50, stats.p90,
+             stats.p99, stats.max);
+    }
+    if (s->input_replay_initialized) {
+        sc_input_replay_destroy(&s->input_replay);
+    }
+    if (s->gesture_replay_started) {
+        sc_input_replay_join(&s->gesture_replay);
+        sc_input_replay_destroy(&s->gesture_replay);
+    }
+
     if (s->controller_started) {
         controller_join(&s->controller);
     }
     if (s->controller_initialized) {
+        struct scrcpy_rtt_stats rtt;
+        scrcpy_get_rtt_stats(p, &rtt);
+        if (rtt.count) {
+            LOGI("Control round-trip time: %" PRIu64 " samples, (us): "
+                 "p50=%" PRIi64 " p90=%" PRIi64 " p99=%" PRIi64
+                 " max=%" PRIi64, rtt.count, rtt.p50, rtt.p90, rtt.p99,
+                 rtt.max);
+        }
         controller_destroy(&s->controller);
     }
 
-    if (s->recorder_initialized) {
-        recorder_destroy(&s->recorder);
+    if (s->input_trace_initialized) {
+        sc_input_trace_writer_destroy(&s->input_trace);
+    }
+
+    for (unsigned i = 0; i < s->recorder_count; ++i) {
+        recorder_destroy(&s->recorders[i]);
+    }
+
+    if (s->restreamer_initialized) {
+        sc_restreamer_destroy(&s->restreamer);
+    }
+
+    if (s->es_dump_initialized) {
+        sc_es_dump_destroy(&s->es_dump);
     }
 
     if (s->file_handler_initialized) {
@@ -505,6 +1380,21 @@ scrcpy_stop(struct scrcpy_process *p) {
 
     server_destroy(&s->server);
 
+    if (s->clipboard_mutex_initialized) {
+        sc_mutex_destroy(&s->clipboard_mutex);
+    }
+
+    if (s->session_initialized) {
+        struct scrcpy_reconnect_stats reconnect;
+        scrcpy_get_reconnect_stats(p, &reconnect);
+        if (reconnect.count) {
+            LOGI("Reconnections: %" PRIu32 " (downtime: %" PRItick " ms)",
+                 reconnect.count, SC_TICK_TO_MS(reconnect.downtime));
+        }
+        sc_cond_destroy(&s->session_cond);
+        sc_mutex_destroy(&s->session_mutex);
+    }
+
     // free up sinks
     while (s->external_sink_count > 0) {
         struct sc_frame_sink *sink = s->external_sinks[--s->external_sink_count];
@@ -512,12 +1402,77 @@ scrcpy_stop(struct scrcpy_process *p) {
         free((void*)ops);
         free(sink);
     }
+    while (s->rgb_sink_count > 0) {
+        struct scrcpy_rgb_sink *sink = s->rgb_sinks[--s->rgb_sink_count];
+        sc_rgb_sink_destroy(&sink->sink);
+        free(sink);
+    }
 
     // given that these structures were allocated in heap, free them
     free(s);
     free(p);
 }
 
+bool
+scrcpy_init_pooled(const struct scrcpy_options *options) {
+    return sdl_init_and_configure(options->display, options->render_driver,
+                                  options->disable_screensaver);
+}
+
+struct scrcpy_process *
+scrcpy_start(const struct scrcpy_options *options) {
+    return scrcpy_start_pooled(options, NULL);
+}
+
+struct log_callback {
+    void (*callback)(void *userdata, int64_t timestamp,
+                     enum sc_log_level level, const char *message);
+    void *userdata;
+};
+
+static void
+log_callback_write(void *userdata, sc_tick timestamp, enum sc_log_level level,
+                   const char *message) {
+    const struct log_callback *cb = userdata;
+    cb->callback(cb->userdata, SC_TICK_TO_US(timestamp), level, message);
+}
+
+void
+scrcpy_set_log_callback(void (*callback)(void *userdata, int64_t timestamp,
+                                         enum sc_log_level level,
+                                         const char *message),
+                        void *userdata) {
+    // only read by the log thread while it is the sink
+    static struct log_callback log_callback;
+
+    if (!sc_async_log_start()) {
+        return;
+    }
+
+    if (!callback) {
+        sc_async_log_set_sink(NULL);
+        return;
+    }
+
+    // uninstall the current callback before changing it
+    sc_async_log_set_sink(NULL);
+    log_callback.callback = callback;
+    log_callback.userdata = userdata;
+    struct sc_log_sink sink = {
+        .write = log_callback_write,
+        .userdata = &log_callback,
+    };
+    sc_async_log_set_sink(&sink);
+}
+
+bool
+scrcpy_set_log_file(const char *filename) {
+    if (!sc_async_log_start()) {
+        return false;
+    }
+    return sc_async_log_set_file(filename);
+}
+
 bool
 scrcpy(const struct scrcpy_options *options) {
     struct scrcpy_process *p = scrcpy_start(options);
@@ -550,15 +1505,175 @@ scrcpy_add_sink(struct scrcpy_process *p,
     ops->close = (void (*)(struct sc_frame_sink *sink)) close;
     ops->push = (bool (*)(struct sc_frame_sink *sink, const AVFrame *frame))push;
     sink->ops = ops;
-    s->external_sinks[s->external_sink_count++] = sink;
 
-    decoder_add_sink(&s->decoder, sink);
+    if (!decoder_add_sink(&s->decoder, sink)) {
+        free(ops);
+        free(sink);
+        return false;
+    }
+    s->external_sinks[s->external_sink_count++] = sink;
     return true;
 }
 
+struct scrcpy_rgb_sink *
+scrcpy_add_rgb_sink(struct scrcpy_process *p, enum scrcpy_rgb_format format,
+                    unsigned width, unsigned height, void *buffer,
+                    size_t stride) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->decoder_initialized) {
+        LOGE("No decoder, frames are not available");
+        return NULL;
+    }
+    struct scrcpy_rgb_sink *sink = malloc(sizeof(*sink));
+    if (!sink) {
+        LOGC("Could not allocate RGB sink");
+        return NULL;
+    }
+
+    if (!sc_rgb_sink_init(&sink->sink, (enum sc_rgb_format) format, width,
+                          height, buffer, stride)) {
+        free(sink);
+        return NULL;
+    }
+
+    if (!decoder_add_sink(&s->decoder, sc_rgb_sink_frame_sink(&sink->sink))) {
+        sc_rgb_sink_destroy(&sink->sink);
+        free(sink);
+        return NULL;
+    }
+    s->rgb_sinks[s->rgb_sink_count++] = sink;
+    return sink;
+}
+
+bool
+scrcpy_rgb_sink_convert(struct scrcpy_rgb_sink *sink, sc_tick timeout) {
+    return sc_rgb_sink_convert(&sink->sink, timeout);
+}
+
+void
+scrcpy_rgb_sink_interrupt(struct scrcpy_rgb_sink *sink) {
+    sc_rgb_sink_interrupt(&sink->sink);
+}
+
+uint64_t
+scrcpy_rgb_sink_get_skipped(struct scrcpy_rgb_sink *sink) {
+    return sc_rgb_sink_get_skipped(&sink->sink);
+}
+
+const void *
+scrcpy_acquire_latest_frame(struct scrcpy_process *p, sc_tick timeout,
+                            uint64_t *seq) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->latest_frame_initialized) {
+        LOGE("The latest frame is not kept (option latest_frame)");
+        return NULL;
+    }
+    return sc_latest_frame_acquire(&s->latest_frame, timeout, seq);
+}
+
+void
+scrcpy_release_frame(struct scrcpy_process *p) {
+    struct scrcpy *s = p->scrcpy_struct;
+    assert(s->latest_frame_initialized);
+    sc_latest_frame_release(&s->latest_frame);
+}
+
+void
+scrcpy_interrupt_latest_frame(struct scrcpy_process *p) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (s->latest_frame_initialized) {
+        sc_latest_frame_interrupt(&s->latest_frame);
+    }
+}
+
 void
 scrcpy_push_event(struct scrcpy_process *p,
                     const struct control_msg *msg) {
     struct scrcpy *s = p->scrcpy_struct;
     controller_push_msg(&s->controller, msg);
 }
+
+static_assert(sizeof(struct scrcpy_event) == SCRCPY_EVENT_SIZE,
+              "unexpected scrcpy_event layout");
+// The controller queue fails on overflow: a batch as large as the queue would
+// fail unless the queue was empty
+static_assert(SCRCPY_MAX_EVENTS < CONTROLLER_QUEUE_SIZE,
+              "SCRCPY_MAX_EVENTS must be smaller than the controller capacity");
+
+static bool
+convert_event(const struct scrcpy_event *event, struct control_msg *msg) {
+    msg->type = event->type;
+    switch (event->type) {
+        case CONTROL_MSG_TYPE_INJECT_KEYCODE:
+            msg->inject_keycode.action = event->action;
+            msg->inject_keycode.keycode = event->keycode;
+            msg->inject_keycode.repeat = event->repeat;
+            msg->inject_keycode.metastate = event->metastate;
+            return true;
+        case CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            msg->inject_touch_event.action = event->action;
+            msg->inject_touch_event.buttons = event->buttons;
+            msg->inject_touch_event.pointer_id = event->pointer_id;
+            msg->inject_touch_event.position.screen_size.width =
+                event->screen_width;
+            msg->inject_touch_event.position.screen_size.height =
+                event->screen_height;
+            msg->inject_touch_event.position.point.x = event->x;
+            msg->inject_touch_event.position.point.y = event->y;
+            msg->inject_touch_event.pressure = event->pressure;
+            return true;
+        case CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+            msg->inject_scroll_event.position.screen_size.width =
+                event->screen_width;
+            msg->inject_scroll_event.position.screen_size.height =
+                event->screen_height;
+            msg->inject_scroll_event.position.point.x = event->x;
+            msg->inject_scroll_event.position.point.y = event->y;
+            msg->inject_scroll_event.hscroll = event->hscroll;
+            msg->inject_scroll_event.vscroll = event->vscroll;
+            return true;
+        case CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
+            msg->back_or_screen_on.action = event->action;
+            return true;
+        case CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
+            msg->set_screen_power_mode.mode = event->action;
+            return true;
+        case CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
+        case CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
+        case CONTROL_MSG_TYPE_COLLAPSE_PANELS:
+        case CONTROL_MSG_TYPE_GET_CLIPBOARD:
+        case CONTROL_MSG_TYPE_ROTATE_DEVICE:
+            // no payload
+            return true;
+        default:
+            LOGW("Unsupported event type: %d", (int) event->type);
+            return false;
+    }
+}
+
+bool
+scrcpy_push_events(struct scrcpy_process *p, const struct scrcpy_event *events,
+                   size_t count) {
+    struct scrcpy *s = p->scrcpy_struct;
+    if (!s->controller_started) {
+        return false;
+    }
+
+    if (!count) {
+        return true;
+    }
+
+    if (count > SCRCPY_MAX_EVENTS) {
+        LOGE("Too many events: %zu (max %d)", count, SCRCPY_MAX_EVENTS);
+        return false;
+    }
+
+    struct control_msg msgs[SCRCPY_MAX_EVENTS];
+    for (size_t i = 0; i < count; ++i) {
+        if (!convert_event(&events[i], &msgs[i])) {
+            return false;
+        }
+    }
+
+    return controller_push_msgs(&s->controller, msgs, count);
+}
@@ -23,6 +23,20 @@ enum sc_record_format {
     SC_RECORD_FORMAT_AUTO,
     SC_RECORD_FORMAT_MP4,
     SC_RECORD_FORMAT_MKV,
+    // fragmented MP4, readable while it is being written
+    SC_RECORD_FORMAT_FMP4,
+};
+
+enum sc_restream_format {
+    SC_RESTREAM_FORMAT_AUTO,
+    SC_RESTREAM_FORMAT_MPEGTS,
+    SC_RESTREAM_FORMAT_RTP,
+};
+
+enum sc_v4l2_format {
+    SC_V4L2_FORMAT_YUV420,
+    SC_V4L2_FORMAT_NV12,
+    SC_V4L2_FORMAT_YUYV,
 };
 
 enum sc_lock_video_orientation {
@@ -58,23 +72,51 @@ struct sc_port_range {
 
 #define SC_WINDOW_POSITION_UNDEFINED (-0x8000)
 
+// recordings in addition to record_filename
+#define SC_MAX_EXTRA_RECORDS 3
+
+struct sc_record {
+    const char *filename;
+    enum sc_record_format format;
+};
+
 struct scrcpy_options {
     const char *serial;
     const char *crop;
     const char *record_filename;
+    const char *record_raw_filename;
+    const char *record_raw_pts_filename;
     const char *window_title;
     const char *push_target;
     const char *render_driver;
     const char *codec_options;
     const char *encoder_name;
     const char *v4l2_device;
+    const char *restream_url;
+    const char *shm_name;
+    const char *record_input_filename;
+    const char *replay_input_filename;
+    // per-role thread attributes (see sc_thread_config_parse()), NULL to use
+    // the environment variable SCRCPY_THREAD_CONFIG
+    const char *thread_config;
+    // serve the metrics of all the sessions in the Prometheus text format, on
+    // a local port ("9100") or a UNIX socket ("unix:/tmp/scrcpy.sock")
+    const char *metrics_listen;
     enum sc_log_level log_level;
     enum sc_record_format record_format;
+    enum sc_restream_format restream_format;
+    enum sc_v4l2_format v4l2_format;
     struct sc_port_range port_range;
     struct sc_shortcut_mods shortcut_mods;
+    struct sc_record extra_records[SC_MAX_EXTRA_RECORDS];
+    unsigned extra_record_count;
     uint16_t max_size;
     uint32_t bit_rate;
     uint16_t max_fps;
+    uint16_t gesture_rate; // events per second, for scrcpy_swipe() & co
+    // consecutive attempts to reconnect when the device is disconnected,
+    // without closing the video outputs (0 to stop on disconnection)
+    uint16_t reconnect_attempts;
     enum sc_lock_video_orientation lock_video_orientation;
     uint8_t rotation;
     int16_t window_x; // SC_WINDOW_POSITION_UNDEFINED for "auto"
@@ -84,6 +126,7 @@ struct scrcpy_options {
     uint32_t display_id;
     sc_tick display_buffer;
     sc_tick v4l2_buffer;
+    sc_tick rtt_probe_interval; // 0 to disable the idle round-trip probes
     bool show_touches;
     bool fullscreen;
     bool always_on_top;
@@ -101,20 +144,33 @@ struct scrcpy_options {
     bool forward_all_clicks;
     bool legacy_paste;
     bool power_off_on_close;
+    bool coalesce_moves;
+    // keep the latest frame for scrcpy_acquire_latest_frame()
+    bool latest_frame;
 };
 
 #define SCRCPY_OPTIONS_DEFAULT { \
     .serial = NULL, \
     .crop = NULL, \
     .record_filename = NULL, \
+    .record_raw_filename = NULL, \
+    .record_raw_pts_filename = NULL, \
     .window_title = NULL, \
     .push_target = NULL, \
     .render_driver = NULL, \
     .codec_options = NULL, \
     .encoder_name = NULL, \
     .v4l2_device = NULL, \
+    .restream_url = NULL, \
+    .shm_name = NULL, \
+    .record_input_filename = NULL, \
+    .replay_input_filename = NULL, \
+    .thread_config = NULL, \
+    .metrics_listen = NULL, \
     .log_level = SC_LOG_LEVEL_INFO, \
     .record_format = SC_RECORD_FORMAT_AUTO, \
+    .restream_format = SC_RESTREAM_FORMAT_AUTO, \
+    .v4l2_format = SC_V4L2_FORMAT_YUV420, \
     .port_range = { \
         .first = DEFAULT_LOCAL_PORT_RANGE_FIRST, \
         .last = DEFAULT_LOCAL_PORT_RANGE_LAST, \
@@ -123,9 +179,11 @@ struct scrcpy_options {
         .data = {SC_MOD_LALT, SC_MOD_LSUPER}, \
         .count = 2, \
     }, \
+    .extra_record_count = 0, \
     .max_size = 0, \
     .bit_rate = DEFAULT_BIT_RATE, \
     .max_fps = 0, \
+    .gesture_rate = DEFAULT_GESTURE_RATE, \
     .lock_video_orientation = SC_LOCK_VIDEO_ORIENTATION_UNLOCKED, \
     .rotation = 0, \
     .window_x = SC_WINDOW_POSITION_UNDEFINED, \
@@ -135,6 +193,8 @@ struct scrcpy_options {
     .display_id = 0, \
     .display_buffer = 0, \
     .v4l2_buffer = 0, \
+    .rtt_probe_interval = 0, \
+    .reconnect_attempts = 0, \
     .show_touches = false, \
     .fullscreen = false, \
     .always_on_top = false, \
@@ -151,6 +211,8 @@ struct scrcpy_options {
     .forward_all_clicks = false, \
     .legacy_paste = false, \
     .power_off_on_close = false, \
+    .coalesce_moves = false, \
+    .latest_frame = false, \
 }
 
 struct scrcpy_process {
@@ -162,6 +224,38 @@ struct scrcpy_process {
     struct size frame_size;
 };
 
+// Fixed-size event, without pointers, for scrcpy_push_events(): an array of
+// events may be filled directly in a native buffer (e.g. a Java direct
+// ByteBuffer in native byte order), at the offsets commented below.
+//
+// Only the messages which do not own data are supported (not text nor
+// clipboard).
+struct scrcpy_event {
+    int32_t type; // 0: enum control_msg_type
+    // 4: enum android_keyevent_action or enum android_motionevent_action
+    // (for CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE: enum screen_power_mode)
+    int32_t action;
+    uint64_t pointer_id; // 8
+    int32_t x; // 16
+    int32_t y; // 20
+    uint16_t screen_width; // 24
+    uint16_t screen_height; // 26
+    float pressure; // 28
+    int32_t buttons; // 32: enum android_motionevent_buttons
+    int32_t keycode; // 36: enum android_keycode
+    int32_t metastate; // 40: enum android_metastate
+    uint32_t repeat; // 44
+    int32_t hscroll; // 48
+    int32_t vscroll; // 52
+};
+
+#define SCRCPY_EVENT_SIZE 56
+
+// The maximum number of events per scrcpy_push_events() call (a quarter of
+// the controller queue, so that a batch fails only if the device does not
+// keep up)
+#define SCRCPY_MAX_EVENTS 64
+
 struct scrcpy_process *
 scrcpy_start(const struct scrcpy_options *options);
 
@@ -172,14 +266,288 @@ scrcpy_add_sink(struct scrcpy_process *p,
                 void (*close)(void *sink),
                 bool (*push)(void *sink, const void *avframe));
 
+enum scrcpy_rgb_format {
+    SCRCPY_RGB_FORMAT_BGR24, // e.g. Java BufferedImage.TYPE_3BYTE_BGR
+    SCRCPY_RGB_FORMAT_RGBA,
+    SCRCPY_RGB_FORMAT_BGRA, // e.g. Java BufferedImage.TYPE_INT_ARGB
+};
+
+struct scrcpy_rgb_sink;
+
+// Add a frame sink converting and scaling the frames to RGB, directly into
+// buffer (width x height pixels, lines stride bytes apart)
+//
+// The decoder thread only keeps the latest frame (by reference, without any
+// callback): it is converted by scrcpy_rgb_sink_convert(), on the thread of
+// the caller. The frames never taken are never converted.
+//
+// The sink may be added while the stream is running. It is destroyed by
+// scrcpy_stop().
+struct scrcpy_rgb_sink *
+scrcpy_add_rgb_sink(struct scrcpy_process *p, enum scrcpy_rgb_format format,
+                    unsigned width, unsigned height, void *buffer,
+                    size_t stride);
+
+// Convert the latest decoded frame into the buffer, if it has not been
+// converted yet
+//
+// If there is no new frame, wait at most timeout microseconds (0 to return
+// immediately, negative to wait until a frame is decoded, the stream ends or
+// the sink is interrupted). Return false if no frame has been converted.
+//
+// Must not be called concurrently (nor with scrcpy_stop()).
+bool
+scrcpy_rgb_sink_convert(struct scrcpy_rgb_sink *sink, sc_tick timeout);
+
+// Wake up a scrcpy_rgb_sink_convert() in progress (from another thread), and
+// make the next calls return false immediately, typically before
+// scrcpy_stop()
+void
+scrcpy_rgb_sink_interrupt(struct scrcpy_rgb_sink *sink);
+
+// Return the number of frames which have not been converted (replaced by a
+// more recent one before scrcpy_rgb_sink_convert())
+uint64_t
+scrcpy_rgb_sink_get_skipped(struct scrcpy_rgb_sink *sink);
+
+// Return the latest decoded frame (a const AVFrame *) if it has not been
+// acquired yet, without any callback from the decoder thread (requires the
+// option latest_frame)
+//
+// If there is no new frame, wait at most timeout microseconds (0 to return
+// immediately, negative to wait until a frame is decoded or the stream ends).
+// Return NULL if there is no new frame.
+//
+// The sequence numbers of the frames are consecutive (starting at 1): a gap
+// between two acquired frames is the number of frames skipped.
+//
+// The frame is valid until scrcpy_release_frame(), which must be called
+// before acquiring another one. Must not be called concurrently (nor with
+// scrcpy_stop()).
+const void *
+scrcpy_acquire_latest_frame(struct scrcpy_process *p, sc_tick timeout,
+                            uint64_t *seq);
+
+void
+scrcpy_release_frame(struct scrcpy_process *p);
+
+// Wake up a scrcpy_acquire_latest_frame() in progress (from another thread),
+// and make the next calls return NULL immediately, typically before
+// scrcpy_stop()
+void
+scrcpy_interrupt_latest_frame(struct scrcpy_process *p);
+
 void
 scrcpy_push_event(struct scrcpy_process *p,
                     const struct control_msg *msg);
 
+// Push count events at once (all or none), with a single wakeup of the
+// controller. The events of a batch are never interleaved with other events.
+//
+// count must not exceed SCRCPY_MAX_EVENTS. Fail (without pushing any event) if
+// the controller queue has not enough free space.
+bool
+scrcpy_push_events(struct scrcpy_process *p, const struct scrcpy_event *events,
+                   size_t count);
+
+// Replace the default handling of the device clipboard (copying it to the
+// computer clipboard) by a listener, called from the receiver thread each
+// time the device clipboard changes. The text is valid only during the call.
+//
+// Pass NULL to restore the default behavior.
+void
+scrcpy_set_clipboard_listener(struct scrcpy_process *p,
+                              void (*on_clipboard)(void *userdata,
+                                                   const char *text),
+                              void *userdata);
+
+// Gestures, generated natively and injected with precise timings from a
+// dedicated thread, at options->gesture_rate events per second.
+//
+// The call does not wait for the gesture to be injected, but if a gesture is
+// still in progress, it waits for it to complete first (the gestures never
+// overlap). These functions must not be called concurrently.
+//
+// The coordinates are relative to the device screen (p->frame_size). The
+// durations are in milliseconds.
+
+bool
+scrcpy_swipe(struct scrcpy_process *p, int32_t x0, int32_t y0, int32_t x1,
+             int32_t y1, uint32_t duration_ms);
+
+// Swipe along a cubic Bézier curve, with control points (cx1, cy1) and
+// (cx2, cy2)
+bool
+scrcpy_swipe_bezier(struct scrcpy_process *p, int32_t x0, int32_t y0,
+                    int32_t cx1, int32_t cy1, int32_t cx2, int32_t cy2,
+                    int32_t x1, int32_t y1, uint32_t duration_ms);
+
+// Two-finger pinch around (cx, cy): the distance between the fingers goes
+// from start_span to end_span (zoom), and their angle from start_angle to
+// end_angle, in degrees (rotation)
+bool
+scrcpy_pinch(struct scrcpy_process *p, int32_t cx, int32_t cy,
+             uint16_t start_span, uint16_t end_span, float start_angle,
+             float end_angle, uint32_t duration_ms);
+
+// Fling from (x0, y0) to (x1, y1), released at velocity pixels per second
+bool
+scrcpy_fling(struct scrcpy_process *p, int32_t x0, int32_t y0, int32_t x1,
+             int32_t y1, float velocity);
+
+// Durations of the startup steps, in microseconds (0 if not done)
+struct scrcpy_startup_stats {
+    int64_t push; // push the server (or check that it is already pushed)
+    int64_t tunnel; // enable the adb tunnel (in parallel with the push)
+    int64_t execute; // execute the server
+    int64_t connect; // connect to the server
+    int64_t first_frame; // from scrcpy_start() to the first decoded frame
+    uint32_t connect_attempts; // before the server accepted the connection
+};
+
+void
+scrcpy_get_startup_stats(struct scrcpy_process *p,
+                         struct scrcpy_startup_stats *stats);
+
+// Round-trip times of the control channel, in microseconds
+struct scrcpy_rtt_stats {
+    uint64_t count;
+    int64_t p50;
+    int64_t p90;
+    int64_t p99;
+    int64_t max;
+};
+
+// Request a round-trip time measurement of the control channel (the result
+// is available later from scrcpy_get_rtt_stats())
+bool
+scrcpy_ping(struct scrcpy_process *p);
+
+// Get the round-trip times measured so far (by scrcpy_ping() and by the
+// periodic probes enabled by options->rtt_probe_interval)
+//
+// Return false if control is disabled.
+bool
+scrcpy_get_rtt_stats(struct scrcpy_process *p, struct scrcpy_rtt_stats *stats);
+
+// Reconnections after a disconnection of the device (see
+// options->reconnect_attempts)
+struct scrcpy_reconnect_stats {
+    uint32_t count; // successful reconnections
+    int64_t downtime; // total time without connection, in microseconds
+};
+
+void
+scrcpy_get_reconnect_stats(struct scrcpy_process *p,
+                           struct scrcpy_reconnect_stats *stats);
+
+// Snapshot of the metrics of a session (the counters are cumulative since the
+// start, the durations are in microseconds)
+struct scrcpy_metrics {
+    uint64_t received_bytes;
+    uint64_t packets;
+    uint64_t keyframes;
+    uint64_t decoded_frames;
+    uint64_t rendered_frames;
+    uint64_t skipped_frames;
+    uint64_t control_msgs;
+    uint64_t control_bytes;
+    uint64_t recorded_bytes;
+    uint64_t reconnections;
+    uint64_t reconnect_downtime; // in microseconds
+    int64_t control_queue; // current depth
+    int64_t recorder_queue; // current depth
+    uint64_t decode_count;
+    int64_t decode_p50;
+    int64_t decode_p99;
+    int64_t decode_max;
+};
+
+void
+scrcpy_get_metrics(struct scrcpy_process *p, struct scrcpy_metrics *metrics);
+
+// Frames rendered on the screen during a sliding window (the intervals
+// between frames are in microseconds)
+struct scrcpy_fps_stats {
+    uint64_t rendered; // since the start
+    uint64_t skipped; // since the start
+    double fps;
+    int64_t interval_p50;
+    int64_t interval_p90;
+    int64_t interval_p99;
+    int64_t interval_max;
+    int64_t jitter; // mean difference between consecutive intervals
+};
+
+// Get the statistics of the last window (in microseconds, 0 for 1 second)
+//
+// Return false if the session has no display.
+bool
+scrcpy_get_fps_stats(struct scrcpy_process *p, sc_tick window,
+                     struct scrcpy_fps_stats *stats);
+
+// Format the metrics of all the running sessions in the Prometheus text
+// format, labeled by device serial
+//
+// Return the length of the text: if it is greater or equal to size, the text
+// has been truncated (call again with a larger buffer).
+size_t
+scrcpy_format_metrics(char *buf, size_t size);
+
 void
 scrcpy_stop(struct scrcpy_process *p);
 
 bool
 scrcpy(const struct scrcpy_options *options);
 
+// Receive the log messages (of all the sessions) instead of writing them to
+// stderr. The callback is called from a single background thread, so logging
+// never blocks the session threads. The timestamp is in microseconds, from a
+// monotonic clock.
+//
+// The callback must not call scrcpy_set_log_callback() nor
+// scrcpy_set_log_file(). Pass NULL to restore the default output.
+void
+scrcpy_set_log_callback(void (*callback)(void *userdata, int64_t timestamp,
+                                         enum sc_log_level level,
+                                         const char *message),
+                        void *userdata);
+
+// Write the log messages to a file (appended), prefixed by their timestamp,
+// instead of stderr (unless a log callback is set). Pass NULL to restore
+// stderr.
+bool
+scrcpy_set_log_file(const char *filename);
+
+// Manage one session per connected device, started and stopped automatically
+// when the device is plugged or unplugged (tracked from the adb server).
+//
+// Each session is started with the options, for the serial of its device. The
+// recording filenames must contain "%s", replaced by the serial, so that the
+// sessions never write to the same file. The recordings of all the sessions
+// are written by a shared pool of threads (one per CPU core).
+//
+// The sessions have no display: options->display must be false. The options
+// (including the strings) must remain valid until the fleet is stopped.
+//
+// The sessions are started concurrently, each from its own thread. A session
+// which could not be started, or whose device was disconnected for good while
+// still listed by adb (e.g. if the server died), is started again on the next
+// update of the device list.
+//
+// on_session is called after a session is started (started = true), from the
+// thread which started it (possibly concurrently for different devices), and
+// before it is stopped (started = false), from the fleet thread.
+struct scrcpy_fleet;
+
+struct scrcpy_fleet *
+scrcpy_fleet_start(const struct scrcpy_options *options,
+                   void (*on_session)(void *userdata, const char *serial,
+                                      struct scrcpy_process *p, bool started),
+                   void *userdata);
+
+// Stop all the sessions
+void
+scrcpy_fleet_stop(struct scrcpy_fleet *fleet);
+
 #endif
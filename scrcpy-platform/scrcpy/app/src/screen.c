@@ -321,10 +321,7 @@ screen_init(struct screen *screen, const struct screen_params *params) {
         goto error_destroy_video_buffer;
     }
 
-    if (!fps_counter_init(&screen->fps_counter)) {
-        LOGE("Could not initialize FPS counter");
-        goto error_stop_and_join_video_buffer;
-    }
+    fps_counter_init(&screen->fps_counter);
 
     screen->frame_size = params->frame_size;
     screen->rotation = params->rotation;
@@ -362,7 +359,7 @@ screen_init(struct screen *screen, const struct screen_params *params) {
                                       window_flags);
     if (!screen->window) {
         LOGC("Could not create window: %s", SDL_GetError());
-        goto error_destroy_fps_counter;
+        goto error_stop_and_join_video_buffer;
     }
 
     screen->renderer = SDL_CreateRenderer(screen->window, -1,
@@ -462,8 +459,6 @@ error_destroy_renderer:
     SDL_DestroyRenderer(screen->renderer);
 error_destroy_window:
     SDL_DestroyWindow(screen->window);
-error_destroy_fps_counter:
-    fps_counter_destroy(&screen->fps_counter);
 error_stop_and_join_video_buffer:
     sc_video_buffer_stop(&screen->vb);
     sc_video_buffer_join(&screen->vb);
@@ -486,13 +481,11 @@ screen_hide_window(struct screen *screen) {
 void
 screen_interrupt(struct screen *screen) {
     sc_video_buffer_stop(&screen->vb);
-    fps_counter_interrupt(&screen->fps_counter);
 }
 
 void
 screen_join(struct screen *screen) {
     sc_video_buffer_join(&screen->vb);
-    fps_counter_join(&screen->fps_counter);
 }
 
 void
@@ -504,7 +497,6 @@ screen_destroy(struct screen *screen) {
     SDL_DestroyTexture(screen->texture);
     SDL_DestroyRenderer(screen->renderer);
     SDL_DestroyWindow(screen->window);
-    fps_counter_destroy(&screen->fps_counter);
     sc_video_buffer_destroy(&screen->vb);
 }
 
@@ -614,7 +606,7 @@ screen_update_frame(struct screen *screen) {
     sc_video_buffer_consume(&screen->vb, screen->frame);
     AVFrame *frame = screen->frame;
 
-    fps_counter_add_rendered_frame(&screen->fps_counter);
+    fps_counter_add_rendered_frame(&screen->fps_counter, sc_tick_now());
 
     struct size new_frame_size = {frame->width, frame->height};
     if (!prepare_for_frame(screen, new_frame_size)) {
@@ -729,7 +721,8 @@ screen_handle_event(struct screen *screen, SDL_Event *event) {
             }
             bool ok = screen_update_frame(screen);
             if (!ok) {
-                LOGW("Frame update failed\n");
+                LOG_RATELIMITED(LOGW, SC_TICK_FROM_SEC(1),
+                                "Frame update failed");
             }
             return true;
         case SDL_WINDOWEVENT:
@@ -5,10 +5,12 @@
 #include <inttypes.h>
 #include <libgen.h>
 #include <stdio.h>
-#include <SDL2/SDL_timer.h>
 #include <SDL2/SDL_platform.h>
 
 #include "adb.h"
+#include "adb_client.h"
+#include "port_lease.h"
+#include "push_cache.h"
 #include "util/log.h"
 #include "util/net.h"
 #include "util/str_util.h"
@@ -19,6 +21,9 @@
 #define DEFAULT_SERVER_PATH PREFIX "/share/scrcpy/" SERVER_FILENAME
 #define DEVICE_SERVER_PATH "/data/local/tmp/scrcpy-server.jar"
 
+// the server may take some time to start (especially on the first launch)
+#define CONNECT_TIMEOUT SC_TICK_FROM_SEC(10)
+
 static char *
 get_server_path(void) {
 #ifdef __WINDOWS__
@@ -96,31 +101,80 @@ push_server(const char *serial) {
         free(server_path);
         return false;
     }
-    process_t process = adb_push(serial, server_path, DEVICE_SERVER_PATH);
+
+    // Do not push the same server again on every launch
+    struct sc_push_cache_entry entry;
+    bool cache = sc_push_cache_entry_from_file(server_path, &entry);
+    if (cache) {
+        struct sc_adb_file_stat st;
+        enum sc_adb_result r = sc_adb_stat(serial, DEVICE_SERVER_PATH, &st);
+        if (r == SC_ADB_OK && sc_push_cache_check(serial, &entry, &st)) {
+            LOGD("Server already pushed");
+            free(server_path);
+            return true;
+        }
+    }
+
+    // The adb commands are executed by the native adb client if possible. If
+    // the adb server is not running, fall back to the adb binary, which starts
+    // it.
+    bool ok;
+    enum sc_adb_result r = sc_adb_push(serial, server_path, DEVICE_SERVER_PATH);
+    if (r != SC_ADB_UNAVAILABLE) {
+        ok = r == SC_ADB_OK;
+    } else {
+        process_t process = adb_push(serial, server_path, DEVICE_SERVER_PATH);
+        ok = process_check_success(process, "adb push", true);
+    }
+
+    if (ok && cache) {
+        sc_push_cache_store(serial, &entry);
+    }
+
     free(server_path);
-    return process_check_success(process, "adb push", true);
+    return ok;
 }
 
 static bool
 enable_tunnel_reverse(const char *serial, uint16_t local_port) {
+    enum sc_adb_result r = sc_adb_reverse(serial, SOCKET_NAME, local_port);
+    if (r != SC_ADB_UNAVAILABLE) {
+        return r == SC_ADB_OK;
+    }
+
     process_t process = adb_reverse(serial, SOCKET_NAME, local_port);
     return process_check_success(process, "adb reverse", true);
 }
 
 static bool
 disable_tunnel_reverse(const char *serial) {
+    enum sc_adb_result r = sc_adb_reverse_remove(serial, SOCKET_NAME);
+    if (r != SC_ADB_UNAVAILABLE) {
+        return r == SC_ADB_OK;
+    }
+
     process_t process = adb_reverse_remove(serial, SOCKET_NAME);
     return process_check_success(process, "adb reverse --remove", true);
 }
 
 static bool
 enable_tunnel_forward(const char *serial, uint16_t local_port) {
+    enum sc_adb_result r = sc_adb_forward(serial, local_port, SOCKET_NAME);
+    if (r != SC_ADB_UNAVAILABLE) {
+        return r == SC_ADB_OK;
+    }
+
     process_t process = adb_forward(serial, local_port, SOCKET_NAME);
     return process_check_success(process, "adb forward", true);
 }
 
 static bool
 disable_tunnel_forward(const char *serial, uint16_t local_port) {
+    enum sc_adb_result r = sc_adb_forward_remove(serial, local_port);
+    if (r != SC_ADB_UNAVAILABLE) {
+        return r == SC_ADB_OK;
+    }
+
     process_t process = adb_forward_remove(serial, local_port);
     return process_check_success(process, "adb forward --remove", true);
 }
@@ -133,85 +187,65 @@ disable_tunnel(struct server *server) {
     return disable_tunnel_reverse(server->serial);
 }
 
-static socket_t
-listen_on_port(uint16_t port) {
 #define IPV4_LOCALHOST 0x7F000001
-    return net_listen(IPV4_LOCALHOST, port, 1);
+
+static void
+release_port(struct server *server) {
+    if (server->port_leased) {
+        sc_port_lease_release(server->local_port);
+        server->port_leased = false;
+    }
 }
 
 static bool
 enable_tunnel_reverse_any_port(struct server *server,
                                struct sc_port_range port_range) {
-    uint16_t port = port_range.first;
-    for (;;) {
-        if (!enable_tunnel_reverse(server->serial, port)) {
-            // the command itself failed, it will fail on any port
-            return false;
-        }
-
-        // At the application level, the device part is "the server" because it
-        // serves video stream and control. However, at the network level, the
-        // client listens and the server connects to the client. That way, the
-        // client can listen before starting the server app, so there is no
-        // need to try to connect until the server socket is listening on the
-        // device.
-        server->server_socket = listen_on_port(port);
-        if (server->server_socket != INVALID_SOCKET) {
-            // success
-            server->local_port = port;
-            return true;
-        }
-
-        // failure, disable tunnel and try another port
-        if (!disable_tunnel_reverse(server->serial)) {
-            LOGW("Could not remove reverse tunnel on port %" PRIu16, port);
-        }
-
-        // check before incrementing to avoid overflow on port 65535
-        if (port < port_range.last) {
-            LOGW("Could not listen on port %" PRIu16", retrying on %" PRIu16,
-                 port, (uint16_t) (port + 1));
-            port++;
-            continue;
-        }
+    // At the application level, the device part is "the server" because it
+    // serves video stream and control. However, at the network level, the
+    // client listens and the server connects to the client. That way, the
+    // client can listen before starting the server app, so there is no need to
+    // try to connect until the server socket is listening on the device.
+    //
+    // Listen first, so that a single adb command is necessary.
+    uint16_t port;
+    socket_t server_socket = sc_port_lease_listen(port_range, &port);
+    if (server_socket == INVALID_SOCKET) {
+        return false;
+    }
 
-        if (port_range.first == port_range.last) {
-            LOGE("Could not listen on port %" PRIu16, port_range.first);
-        } else {
-            LOGE("Could not listen on any port in range %" PRIu16 ":%" PRIu16,
-                 port_range.first, port_range.last);
-        }
+    if (!enable_tunnel_reverse(server->serial, port)) {
+        // the command itself failed, it would fail on any port
+        net_close(server_socket);
+        sc_port_lease_release(port);
         return false;
     }
+
+    server->server_socket = server_socket;
+    server->local_port = port;
+    server->port_leased = true;
+    return true;
 }
 
 static bool
 enable_tunnel_forward_any_port(struct server *server,
                                struct sc_port_range port_range) {
     server->tunnel_forward = true;
-    uint16_t port = port_range.first;
-    for (;;) {
-        if (enable_tunnel_forward(server->serial, port)) {
-            // success
-            server->local_port = port;
-            return true;
-        }
 
-        if (port < port_range.last) {
-            LOGW("Could not forward port %" PRIu16", retrying on %" PRIu16,
-                 port, (uint16_t) (port + 1));
-            port++;
-            continue;
-        }
+    // the port is free, so a single adb command is necessary
+    uint16_t port;
+    if (!sc_port_lease_reserve(port_range, &port)) {
+        return false;
+    }
 
-        if (port_range.first == port_range.last) {
-            LOGE("Could not forward port %" PRIu16, port_range.first);
-        } else {
-            LOGE("Could not forward any port in range %" PRIu16 ":%" PRIu16,
-                 port_range.first, port_range.last);
-        }
+    if (!enable_tunnel_forward(server->serial, port)) {
+        LOGE("Could not forward port %" PRIu16, port);
+        sc_port_lease_release(port);
         return false;
     }
+
+    server->local_port = port;
+    server->port_leased = true;
+    return true;
 }
 
 static bool
@@ -251,7 +285,8 @@ log_level_to_server_string(enum sc_log_level level) {
     }
 }
 
-static process_t
+// Set either server->shell_socket (native adb client) or server->process
+static bool
 execute_server(struct server *server, const struct server_params *params) {
     char max_size_string[6];
     char bit_rate_string[11];
@@ -310,41 +345,37 @@ execute_server(struct server *server, const struct server_params *params) {
     //     Port: 5005
     // Then click on "Debug"
 #endif
-    return adb_execute(server->serial, cmd, ARRAY_LEN(cmd));
-}
-
-static socket_t
-connect_and_read_byte(uint16_t port) {
-    socket_t socket = net_connect(IPV4_LOCALHOST, port);
-    if (socket == INVALID_SOCKET) {
-        return INVALID_SOCKET;
+    enum sc_adb_result r = sc_adb_shell(server->serial, cmd, ARRAY_LEN(cmd),
+                                        &server->shell_socket);
+    if (r != SC_ADB_UNAVAILABLE) {
+        return r == SC_ADB_OK;
     }
 
-    char byte;
+    server->process = adb_execute(server->serial, cmd, ARRAY_LEN(cmd));
+    return server->process != PROCESS_NONE;
+}
+
+static bool
+read_byte(socket_t socket, sc_tick deadline) {
     // the connection may succeed even if the server behind the "adb tunnel"
     // is not listening, so read one byte to detect a working connection
-    if (net_recv(socket, &byte, 1) != 1) {
-        // the server is not listening yet behind the adb tunnel
-        net_close(socket);
-        return INVALID_SOCKET;
+    if (!net_wait_readable(socket, deadline)) {
+        return false;
     }
-    return socket;
+
+    char byte;
+    // if the server is not listening yet behind the adb tunnel, the
+    // connection is closed immediately
+    return net_recv(socket, &byte, 1) == 1;
 }
 
 static socket_t
-connect_to_server(uint16_t port, uint32_t attempts, uint32_t delay) {
-    do {
-        LOGD("Remaining connection attempts: %d", (int) attempts);
-        socket_t socket = connect_and_read_byte(port);
-        if (socket != INVALID_SOCKET) {
-            // it worked!
-            return socket;
-        }
-        if (attempts) {
-            SDL_Delay(delay);
-        }
-    } while (--attempts > 0);
-    return INVALID_SOCKET;
+connect_to_server(uint16_t port, sc_tick timeout, unsigned *attempts) {
+    sc_tick deadline = sc_tick_now() + timeout;
+    socket_t socket = net_connect_retry(IPV4_LOCALHOST, port, deadline,
+                                        read_byte, attempts);
+    LOGD("Connection attempts: %u", *attempts);
+    return socket;
 }
 
 static void
@@ -356,13 +387,31 @@ close_socket(socket_t socket) {
     }
 }
 
-bool
-server_init(struct server *server) {
+static void
+server_init_state(struct server *server) {
     server->serial = NULL;
     server->process = PROCESS_NONE;
+    server->shell_socket = INVALID_SOCKET;
     atomic_flag_clear_explicit(&server->server_socket_closed,
                                memory_order_relaxed);
 
+    server->process_terminated = false;
+
+    server->server_socket = INVALID_SOCKET;
+    server->video_socket = INVALID_SOCKET;
+    server->control_socket = INVALID_SOCKET;
+
+    server->local_port = 0;
+    server->port_leased = false;
+
+    server->tunnel_enabled = false;
+    server->tunnel_forward = false;
+
+    server->push_ok = false;
+}
+
+bool
+server_init(struct server *server) {
     bool ok = sc_mutex_init(&server->mutex);
     if (!ok) {
         return false;
@@ -374,24 +423,38 @@ server_init(struct server *server) {
         return false;
     }
 
-    server->process_terminated = false;
+    server_init_state(server);
+    memset(&server->startup, 0, sizeof(server->startup));
 
-    server->server_socket = INVALID_SOCKET;
-    server->video_socket = INVALID_SOCKET;
-    server->control_socket = INVALID_SOCKET;
+    return true;
+}
 
-    server->local_port = 0;
+static int
+run_push_server(void *data) {
+    struct server *server = data;
 
-    server->tunnel_enabled = false;
-    server->tunnel_forward = false;
+    sc_tick start = sc_tick_now();
+    server->push_ok = push_server(server->serial);
+    server->startup.push = sc_tick_now() - start;
 
-    return true;
+    return 0;
 }
 
 static int
 run_wait_server(void *data) {
     struct server *server = data;
-    process_wait(server->process, false); // ignore exit code
+    if (server->shell_socket != INVALID_SOCKET) {
+        // forward the server output (like the adb process would do), until
+        // the server terminates
+        char buf[1024];
+        ssize_t r;
+        while ((r = net_recv(server->shell_socket, buf, sizeof(buf))) > 0) {
+            fwrite(buf, 1, r, stdout);
+            fflush(stdout);
+        }
+    } else {
+        process_wait(server->process, false); // ignore exit code
+    }
 
     sc_mutex_lock(&server->mutex);
     server->process_terminated = true;
@@ -419,19 +482,38 @@ server_start(struct server *server, const struct server_params *params) {
         }
     }
 
-    if (!push_server(params->serial)) {
+    // The push and the tunnel are independent, the push is executed in
+    // parallel (if the thread could not be created, push synchronously)
+    sc_thread push_thread;
+    bool push_async = sc_thread_create(&push_thread, run_push_server,
+                                       "push-server", server);
+    if (!push_async) {
+        run_push_server(server);
+    }
+
+    sc_tick start = sc_tick_now();
+    bool tunnel_ok = enable_tunnel_any_port(server, params->port_range,
+                                            params->force_adb_forward);
+    server->startup.tunnel = sc_tick_now() - start;
+
+    if (push_async) {
+        sc_thread_join(&push_thread, NULL);
+    }
+
+    if (!tunnel_ok) {
         /* server->serial will be freed on server_destroy() */
         return false;
     }
 
-    if (!enable_tunnel_any_port(server, params->port_range,
-                                params->force_adb_forward)) {
-        return false;
+    if (!server->push_ok) {
+        goto error;
     }
 
     // server will connect to our server socket
-    server->process = execute_server(server, params);
-    if (server->process == PROCESS_NONE) {
+    start = sc_tick_now();
+    bool ok = execute_server(server, params);
+    server->startup.execute = sc_tick_now() - start;
+    if (!ok) {
         goto error;
     }
 
@@ -441,11 +523,15 @@ server_start(struct server *server, const struct server_params *params) {
     // things simple and multiplatform, just spawn a new thread waiting for the
     // server process and calling shutdown()/close() on the server socket if
     // necessary to wake up any accept() blocking call.
-    bool ok = sc_thread_create(&server->wait_server_thread, run_wait_server,
-                               "wait-server", server);
+    ok = sc_thread_create(&server->wait_server_thread, run_wait_server,
+                          "wait-server", server);
     if (!ok) {
-        process_terminate(server->process);
-        process_wait(server->process, true); // ignore exit code
+        if (server->shell_socket != INVALID_SOCKET) {
+            close_socket(server->shell_socket);
+        } else {
+            process_terminate(server->process);
+            process_wait(server->process, true); // ignore exit code
+        }
         goto error;
     }
 
@@ -463,6 +549,7 @@ error:
         close_socket(server->server_socket);
     }
     disable_tunnel(server);
+    release_port(server);
 
     return false;
 }
@@ -487,8 +574,8 @@ device_read_info(socket_t device_socket, char *device_name, struct size *size) {
     return true;
 }
 
-bool
-server_connect_to(struct server *server, char *device_name, struct size *size) {
+static bool
+connect_to(struct server *server, char *device_name, struct size *size) {
     if (!server->tunnel_forward) {
         server->video_socket = net_accept(server->server_socket);
         if (server->video_socket == INVALID_SOCKET) {
@@ -507,11 +594,11 @@ server_connect_to(struct server *server, char *device_name, struct size *size) {
             close_socket(server->server_socket);
             // otherwise, it is closed by run_wait_server()
         }
+        server->startup.connect_attempts = 1;
     } else {
-        uint32_t attempts = 100;
-        uint32_t delay = 100; // ms
         server->video_socket =
-            connect_to_server(server->local_port, attempts, delay);
+            connect_to_server(server->local_port, CONNECT_TIMEOUT,
+                              &server->startup.connect_attempts);
         if (server->video_socket == INVALID_SOCKET) {
             return false;
         }
@@ -527,11 +614,21 @@ server_connect_to(struct server *server, char *device_name, struct size *size) {
     // we don't need the adb tunnel anymore
     disable_tunnel(server); // ignore failure
     server->tunnel_enabled = false;
+    // the server socket is closed, the port may be used by another session
+    release_port(server);
 
     // The sockets will be closed on stop if device_read_info() fails
     return device_read_info(server->video_socket, device_name, size);
 }
 
+bool
+server_connect_to(struct server *server, char *device_name, struct size *size) {
+    sc_tick start = sc_tick_now();
+    bool ok = connect_to(server, device_name, size);
+    server->startup.connect = sc_tick_now() - start;
+    return ok;
+}
+
 void
 server_stop(struct server *server) {
     if (server->server_socket != INVALID_SOCKET
@@ -545,12 +642,14 @@ server_stop(struct server *server) {
         close_socket(server->control_socket);
     }
 
-    assert(server->process != PROCESS_NONE);
+    assert(server->process != PROCESS_NONE
+            || server->shell_socket != INVALID_SOCKET);
 
     if (server->tunnel_enabled) {
         // ignore failure
         disable_tunnel(server);
     }
+    release_port(server);
 
     // Give some delay for the server to terminate properly
     sc_mutex_lock(&server->mutex);
@@ -570,11 +669,27 @@ server_stop(struct server *server) {
         // The process is terminated, but not reaped (closed) yet, so its PID
         // is still valid.
         LOGW("Killing the server...");
-        process_terminate(server->process);
+        if (server->shell_socket != INVALID_SOCKET) {
+            // closing the shell connection terminates the command
+            net_shutdown(server->shell_socket, SHUT_RDWR);
+        } else {
+            process_terminate(server->process);
+        }
     }
 
     sc_thread_join(&server->wait_server_thread, NULL);
-    process_close(server->process);
+    if (server->shell_socket != INVALID_SOCKET) {
+        net_close(server->shell_socket);
+    } else {
+        process_close(server->process);
+    }
+}
+
+bool
+server_restart(struct server *server, const struct server_params *params) {
+    free(server->serial);
+    server_init_state(server);
+    return server_start(server, params);
 }
 
 void
@@ -13,10 +13,21 @@
 #include "util/log.h"
 #include "util/net.h"
 #include "util/thread.h"
+#include "util/tick.h"
+
+// Durations of the startup steps
+struct server_startup_times {
+    sc_tick push; // push the server (or check that it is already pushed)
+    sc_tick tunnel; // enable the tunnel (in parallel with the push)
+    sc_tick execute;
+    sc_tick connect; // until the device info is received
+    unsigned connect_attempts; // before the server accepted the connection
+};
 
 struct server {
     char *serial;
-    process_t process;
+    process_t process; // if executed by the adb binary
+    socket_t shell_socket; // if executed by the native adb client
     sc_thread wait_server_thread;
     atomic_flag server_socket_closed;
 
@@ -28,8 +39,12 @@ struct server {
     socket_t video_socket;
     socket_t control_socket;
     uint16_t local_port; // selected from port_range
+    bool port_leased; // local_port must be released (see port_lease.h)
     bool tunnel_enabled;
     bool tunnel_forward; // use "adb forward" instead of "adb reverse"
+
+    bool push_ok; // result of the push, executed from a separate thread
+    struct server_startup_times startup;
 };
 
 struct server_params {
@@ -69,6 +84,11 @@ server_connect_to(struct server *server, char *device_name, struct size *size);
 void
 server_stop(struct server *server);
 
+// start the server again, after server_stop() (e.g. if the device has been
+// disconnected)
+bool
+server_restart(struct server *server, const struct server_params *params);
+
 // close and release sockets
 void
 server_destroy(struct server *server);
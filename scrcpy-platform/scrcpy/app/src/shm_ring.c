@@ -0,0 +1,228 @@
+#ifndef _POSIX_C_SOURCE
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "shm_ring.h"
+
+#include <assert.h>
+#include <string.h>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+#define SLOT_ALIGN 64
+
+static inline size_t
+align_up(size_t value, size_t align) {
+    return (value + align - 1) / align * align;
+}
+
+static size_t
+get_data_offset(uint32_t slot_count) {
+    return align_up(sizeof(struct sc_shm_ring)
+                  + slot_count * sizeof(struct sc_shm_slot), SLOT_ALIGN);
+}
+
+size_t
+sc_shm_ring_size(uint32_t slot_count, uint32_t slot_size) {
+    return get_data_offset(slot_count)
+         + slot_count * align_up(slot_size, SLOT_ALIGN);
+}
+
+void
+sc_shm_ring_init(struct sc_shm_ring *ring, uint32_t slot_count,
+                 uint32_t slot_size) {
+    assert(slot_count);
+    ring->version = SC_SHM_RING_VERSION;
+    ring->slot_count = slot_count;
+    ring->slot_size = align_up(slot_size, SLOT_ALIGN);
+    ring->data_offset = get_data_offset(slot_count);
+    atomic_init(&ring->latest, 0);
+
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        struct sc_shm_slot *slot = &ring->slots[i];
+        memset(slot, 0, sizeof(*slot));
+        atomic_init(&slot->lock, 0);
+    }
+
+    // write the magic last, so that a reader never sees a partially
+    // initialized ring
+    atomic_thread_fence(memory_order_release);
+    ring->magic = SC_SHM_RING_MAGIC;
+}
+
+static inline uint8_t *
+get_slot_data(struct sc_shm_ring *ring, uint32_t index) {
+    return (uint8_t *) ring + ring->data_offset
+                            + (size_t) index * ring->slot_size;
+}
+
+static uint8_t *
+copy_plane(uint8_t *dst, const uint8_t *src, int linesize, uint32_t width,
+           uint32_t height) {
+    if ((uint32_t) linesize == width) {
+        memcpy(dst, src, (size_t) width * height);
+        return dst + (size_t) width * height;
+    }
+
+    for (uint32_t i = 0; i < height; ++i) {
+        memcpy(dst, src, width);
+        src += linesize;
+        dst += width;
+    }
+    return dst;
+}
+
+bool
+sc_shm_ring_publish(struct sc_shm_ring *ring, const uint8_t *const data[3],
+                    const int linesize[3], uint32_t width, uint32_t height,
+                    int64_t pts) {
+    uint32_t cw = (width + 1) / 2;
+    uint32_t ch = (height + 1) / 2;
+    size_t luma = (size_t) width * height;
+    size_t chroma = (size_t) cw * ch;
+    size_t size = luma + 2 * chroma;
+    if (size > ring->slot_size) {
+        return false;
+    }
+
+    // only the producer writes "latest", a relaxed load is sufficient
+    uint64_t seq = atomic_load_explicit(&ring->latest, memory_order_relaxed)
+                 + 1;
+    uint32_t index = (seq - 1) % ring->slot_count;
+    struct sc_shm_slot *slot = &ring->slots[index];
+
+    uint32_t lock = atomic_load_explicit(&slot->lock, memory_order_relaxed);
+    assert(!(lock & 1));
+    atomic_store_explicit(&slot->lock, lock + 1, memory_order_relaxed);
+    // the lock must be visible as odd before any write to the slot
+    atomic_thread_fence(memory_order_release);
+
+    slot->width = width;
+    slot->height = height;
+    slot->size = size;
+    slot->linesize[0] = width;
+    slot->linesize[1] = cw;
+    slot->linesize[2] = cw;
+    slot->offset[0] = 0;
+    slot->offset[1] = luma;
+    slot->offset[2] = luma + chroma;
+    slot->pts = pts;
+    slot->frame_seq = seq;
+
+    uint8_t *dst = get_slot_data(ring, index);
+    dst = copy_plane(dst, data[0], linesize[0], width, height);
+    dst = copy_plane(dst, data[1], linesize[1], cw, ch);
+    copy_plane(dst, data[2], linesize[2], cw, ch);
+
+    atomic_store_explicit(&slot->lock, lock + 2, memory_order_release);
+    atomic_store_explicit(&ring->latest, seq, memory_order_release);
+
+    return true;
+}
+
+bool
+sc_shm_ring_is_valid(const struct sc_shm_ring *ring, size_t size) {
+    return size >= sizeof(*ring)
+        && ring->magic == SC_SHM_RING_MAGIC
+        && ring->version == SC_SHM_RING_VERSION
+        && ring->slot_count
+        && size >= sc_shm_ring_size(ring->slot_count, ring->slot_size);
+}
+
+bool
+sc_shm_ring_read_latest(const struct sc_shm_ring *ring,
+                        struct sc_shm_frame *frame) {
+    // the cast is only necessary for old compilers (atomic_load() on a
+    // pointer-to-const is valid C11)
+    uint64_t seq = atomic_load_explicit((atomic_uint_least64_t *) &ring->latest,
+                                        memory_order_acquire);
+    if (!seq) {
+        // no frame published yet
+        return false;
+    }
+
+    uint32_t index = (seq - 1) % ring->slot_count;
+    const struct sc_shm_slot *slot = &ring->slots[index];
+
+    uint32_t lock =
+        atomic_load_explicit((atomic_uint_least32_t *) &slot->lock,
+                             memory_order_acquire);
+    if (lock & 1) {
+        // the slot is being written (the reader is late by a whole ring)
+        return false;
+    }
+
+    frame->seq = slot->frame_seq;
+    frame->pts = slot->pts;
+    frame->width = slot->width;
+    frame->height = slot->height;
+
+    const uint8_t *slot_data =
+        (const uint8_t *) ring + ring->data_offset
+                               + (size_t) index * ring->slot_size;
+    for (int i = 0; i < 3; ++i) {
+        frame->data[i] = slot_data + slot->offset[i];
+        frame->linesize[i] = slot->linesize[i];
+    }
+
+    frame->slot = slot;
+    frame->lock = lock;
+
+    bool consistent = frame->seq == seq && slot->size <= ring->slot_size;
+    // the metadata must not have been modified while being read
+    return sc_shm_ring_validate(frame) && consistent;
+}
+
+bool
+sc_shm_ring_validate(const struct sc_shm_frame *frame) {
+    // all the reads from the slot must happen before reading the lock again
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t lock =
+        atomic_load_explicit((atomic_uint_least32_t *) &frame->slot->lock,
+                             memory_order_relaxed);
+    return lock == frame->lock;
+}
+
+#ifndef _WIN32
+bool
+sc_shm_reader_open(struct sc_shm_reader *reader, const char *name) {
+    reader->fd = shm_open(name, O_RDONLY, 0);
+    if (reader->fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(reader->fd, &st) || (size_t) st.st_size < sizeof(*reader->ring)) {
+        goto error_close;
+    }
+
+    reader->size = st.st_size;
+    reader->map = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, reader->fd,
+                       0);
+    if (reader->map == MAP_FAILED) {
+        goto error_close;
+    }
+
+    reader->ring = reader->map;
+    if (!sc_shm_ring_is_valid(reader->ring, reader->size)) {
+        munmap(reader->map, reader->size);
+        goto error_close;
+    }
+
+    return true;
+
+error_close:
+    close(reader->fd);
+    return false;
+}
+
+void
+sc_shm_reader_close(struct sc_shm_reader *reader) {
+    munmap(reader->map, reader->size);
+    close(reader->fd);
+}
+#endif
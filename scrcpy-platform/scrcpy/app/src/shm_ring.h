@@ -0,0 +1,117 @@
+#ifndef SC_SHM_RING_H
+#define SC_SHM_RING_H
+
+// This header and shm_ring.c do not depend on the rest of scrcpy, so that
+// they can be copied as-is into a consumer process (the "reader library").
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SC_SHM_RING_MAGIC 0x53435246 // "SCRF"
+#define SC_SHM_RING_VERSION 1
+
+// Shared memory layout:
+//
+//     [ring header][slot headers...][slot data...]
+//
+// Each published frame has a sequence number (starting at 1); the frame N is
+// written to the slot (N - 1) % slot_count, as YUV420P without padding.
+//
+// Each slot header is protected by a seqlock: its lock value is odd while the
+// slot is being written. A reader reads the lock, then reads the frame in
+// place, then checks that the lock has not changed. The producer never waits
+// for the readers.
+
+struct sc_shm_slot {
+    atomic_uint_least32_t lock; // seqlock, odd while being written
+    uint32_t width;
+    uint32_t height;
+    uint32_t size; // total size of the 3 planes
+    uint32_t linesize[3];
+    uint32_t offset[3]; // offset of each plane in the slot data
+    int64_t pts;
+    uint64_t frame_seq;
+};
+
+struct sc_shm_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size; // capacity of each slot data
+    uint64_t data_offset; // offset of the first slot data from the ring
+    // sequence number of the last published frame (0 if none)
+    atomic_uint_least64_t latest;
+    struct sc_shm_slot slots[];
+};
+
+// A frame read from the ring (pointing directly into the shared memory)
+struct sc_shm_frame {
+    uint64_t seq;
+    int64_t pts;
+    uint32_t width;
+    uint32_t height;
+    const uint8_t *data[3];
+    uint32_t linesize[3];
+
+    // to validate the frame after reading
+    const struct sc_shm_slot *slot;
+    uint32_t lock;
+};
+
+// Return the total size of a ring
+size_t
+sc_shm_ring_size(uint32_t slot_count, uint32_t slot_size);
+
+// Initialize a ring in a memory area of sc_shm_ring_size() bytes
+void
+sc_shm_ring_init(struct sc_shm_ring *ring, uint32_t slot_count,
+                 uint32_t slot_size);
+
+// Copy a YUV420P image into the next slot and publish it
+//
+// Return false if the image does not fit in a slot.
+bool
+sc_shm_ring_publish(struct sc_shm_ring *ring, const uint8_t *const data[3],
+                    const int linesize[3], uint32_t width, uint32_t height,
+                    int64_t pts);
+
+// Check that the memory area contains a valid ring
+bool
+sc_shm_ring_is_valid(const struct sc_shm_ring *ring, size_t size);
+
+// Get the latest frame, if any
+//
+// The frame data may be overwritten by the producer at any time: once the
+// frame has been read (or copied), sc_shm_ring_validate() must be called to
+// check that it has not been overwritten meanwhile.
+//
+// Return false if no frame is available (or if the slot is currently being
+// written).
+bool
+sc_shm_ring_read_latest(const struct sc_shm_ring *ring,
+                        struct sc_shm_frame *frame);
+
+// Check that the frame has not been overwritten since it was read
+bool
+sc_shm_ring_validate(const struct sc_shm_frame *frame);
+
+#ifndef _WIN32
+// A read-only mapping of a ring created by the producer (e.g. scrcpy with
+// --shm-sink=/name)
+struct sc_shm_reader {
+    int fd;
+    void *map;
+    size_t size;
+    const struct sc_shm_ring *ring;
+};
+
+bool
+sc_shm_reader_open(struct sc_shm_reader *reader, const char *name);
+
+void
+sc_shm_reader_close(struct sc_shm_reader *reader);
+#endif
+
+#endif
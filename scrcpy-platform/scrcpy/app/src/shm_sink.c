@@ -0,0 +1,132 @@
+#include "shm_sink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <libavutil/frame.h>
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_shm_sink */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_shm_sink, frame_sink)
+
+static bool
+sc_shm_sink_open(struct sc_shm_sink *ss) {
+    // The device may be rotated, so a slot must be able to contain a frame in
+    // both orientations
+    uint32_t max = MAX(ss->frame_size.width, ss->frame_size.height);
+    uint32_t chroma = (max + 1) / 2;
+    uint32_t slot_size = max * max + 2 * chroma * chroma;
+
+    ss->size = sc_shm_ring_size(SC_SHM_SINK_SLOTS, slot_size);
+
+    ss->fd = shm_open(ss->name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (ss->fd == -1) {
+        LOGE("Could not create shared memory %s: %s", ss->name,
+             strerror(errno));
+        return false;
+    }
+
+    if (ftruncate(ss->fd, ss->size)) {
+        LOGE("Could not resize shared memory %s", ss->name);
+        goto error_unlink;
+    }
+
+    void *map = mmap(NULL, ss->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     ss->fd, 0);
+    if (map == MAP_FAILED) {
+        LOGE("Could not map shared memory %s", ss->name);
+        goto error_unlink;
+    }
+
+    ss->ring = map;
+    sc_shm_ring_init(ss->ring, SC_SHM_SINK_SLOTS, slot_size);
+    ss->too_large_logged = false;
+
+    LOGI("Shared memory sink started: %s (%zu bytes)", ss->name, ss->size);
+
+    return true;
+
+error_unlink:
+    shm_unlink(ss->name);
+    close(ss->fd);
+
+    return false;
+}
+
+static void
+sc_shm_sink_close(struct sc_shm_sink *ss) {
+    munmap(ss->ring, ss->size);
+    // the readers which have already mapped the memory keep their mapping
+    shm_unlink(ss->name);
+    close(ss->fd);
+}
+
+static bool
+sc_shm_sink_push(struct sc_shm_sink *ss, const AVFrame *frame) {
+    if (frame->format != AV_PIX_FMT_YUV420P) {
+        LOGE("Unsupported frame format for shared memory: %d", frame->format);
+        return false;
+    }
+
+    const uint8_t *const data[3] = {frame->data[0], frame->data[1],
+                                    frame->data[2]};
+    bool ok = sc_shm_ring_publish(ss->ring, data, frame->linesize,
+                                  frame->width, frame->height, frame->pts);
+    if (!ok && !ss->too_large_logged) {
+        // not fatal, just ignore the frame
+        LOGW("Frame too large for shared memory: %dx%d", frame->width,
+             frame->height);
+        ss->too_large_logged = true;
+    }
+
+    return true;
+}
+
+static bool
+sc_shm_frame_sink_open(struct sc_frame_sink *sink) {
+    struct sc_shm_sink *ss = DOWNCAST(sink);
+    return sc_shm_sink_open(ss);
+}
+
+static void
+sc_shm_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_shm_sink *ss = DOWNCAST(sink);
+    sc_shm_sink_close(ss);
+}
+
+static bool
+sc_shm_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct sc_shm_sink *ss = DOWNCAST(sink);
+    return sc_shm_sink_push(ss, frame);
+}
+
+bool
+sc_shm_sink_init(struct sc_shm_sink *ss, const char *name,
+                 struct size frame_size) {
+    ss->name = strdup(name);
+    if (!ss->name) {
+        LOGE("Could not strdup shared memory name");
+        return false;
+    }
+
+    ss->frame_size = frame_size;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_shm_frame_sink_open,
+        .close = sc_shm_frame_sink_close,
+        .push = sc_shm_frame_sink_push,
+    };
+
+    ss->frame_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_shm_sink_destroy(struct sc_shm_sink *ss) {
+    free(ss->name);
+}
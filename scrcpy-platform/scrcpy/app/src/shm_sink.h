@@ -0,0 +1,39 @@
+#ifndef SC_SHM_SINK_H
+#define SC_SHM_SINK_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "coords.h"
+#include "shm_ring.h"
+#include "trait/frame_sink.h"
+
+#define SC_SHM_SINK_SLOTS 3
+
+// Publish the decoded frames into a POSIX shared memory ring, so that other
+// local processes can read the latest frame (see shm_ring.h).
+//
+// The frames are copied (once) from the decoder thread; there is no thread,
+// no socket and no synchronization with the readers.
+struct sc_shm_sink {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    char *name;
+    struct size frame_size;
+
+    int fd;
+    struct sc_shm_ring *ring;
+    size_t size;
+    bool too_large_logged;
+};
+
+bool
+sc_shm_sink_init(struct sc_shm_sink *ss, const char *name,
+                 struct size frame_size);
+
+void
+sc_shm_sink_destroy(struct sc_shm_sink *ss);
+
+#endif
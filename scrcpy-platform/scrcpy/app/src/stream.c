@@ -16,6 +16,28 @@
 #define HEADER_SIZE 12
 #define NO_PTS UINT64_C(-1)
 
+static int64_t
+stream_splice_pts(struct stream *stream, int64_t pts) {
+    sc_tick now = sc_tick_now();
+    if (stream->splice) {
+        stream->splice = false;
+        if (stream->last_pts != -1) {
+            // the PTS are in microseconds, like the ticks: continue the
+            // timeline of the previous connection, after the downtime
+            sc_tick gap = now - stream->last_packet_tick;
+            if (gap < 1) {
+                gap = 1;
+            }
+            stream->pts_offset = stream->last_pts + gap - pts;
+        }
+    }
+
+    pts += stream->pts_offset;
+    stream->last_pts = pts;
+    stream->last_packet_tick = now;
+    return pts;
+}
+
 static bool
 stream_recv_packet(struct stream *stream, AVPacket *packet) {
     // The video stream contains raw packets, without time information. When we
@@ -52,7 +74,12 @@ stream_recv_packet(struct stream *stream, AVPacket *packet) {
         return false;
     }
 
-    packet->pts = pts != NO_PTS ? (int64_t) pts : AV_NOPTS_VALUE;
+    packet->pts = pts != NO_PTS ? stream_splice_pts(stream, pts)
+                                : AV_NOPTS_VALUE;
+
+    sc_metrics_add(stream->metrics, SC_METRIC_RECEIVED_BYTES,
+                   HEADER_SIZE + len);
+    sc_metrics_add(stream->metrics, SC_METRIC_PACKETS, 1);
 
     return true;
 }
@@ -87,6 +114,7 @@ stream_parse(struct stream *stream, AVPacket *packet) {
 
     if (stream->parser->key_frame == 1) {
         packet->flags |= AV_PKT_FLAG_KEY;
+        sc_metrics_add(stream->metrics, SC_METRIC_KEYFRAMES, 1);
     }
 
     packet->dts = packet->pts;
@@ -188,6 +216,47 @@ stream_open_sinks(struct stream *stream, const AVCodec *codec) {
     return true;
 }
 
+static bool
+stream_init_parser(struct stream *stream) {
+    stream->parser = av_parser_init(AV_CODEC_ID_H264);
+    if (!stream->parser) {
+        LOGE("Could not initialize parser");
+        return false;
+    }
+
+    // We must only pass complete frames to av_parser_parse2()!
+    // It's more complicated, but this allows to reduce the latency by 1 frame!
+    stream->parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+    return true;
+}
+
+static bool
+stream_reconnect(struct stream *stream) {
+    if (!stream->cbs->on_disconnected) {
+        return false;
+    }
+
+    socket_t socket = stream->cbs->on_disconnected(stream,
+                                                   stream->cbs_userdata);
+    if (socket == INVALID_SOCKET) {
+        return false;
+    }
+
+    // the new server starts a new H.264 stream (beginning with a config
+    // packet), the state related to the previous one must be dropped
+    if (stream->pending) {
+        av_packet_free(&stream->pending);
+    }
+    av_parser_close(stream->parser);
+    if (!stream_init_parser(stream)) {
+        return false;
+    }
+
+    stream->socket = socket;
+    stream->splice = true;
+    return true;
+}
+
 static int
 run_stream(void *data) {
     struct stream *stream = data;
@@ -209,16 +278,10 @@ run_stream(void *data) {
         goto finally_free_codec_ctx;
     }
 
-    stream->parser = av_parser_init(AV_CODEC_ID_H264);
-    if (!stream->parser) {
-        LOGE("Could not initialize parser");
+    if (!stream_init_parser(stream)) {
         goto finally_close_sinks;
     }
 
-    // We must only pass complete frames to av_parser_parse2()!
-    // It's more complicated, but this allows to reduce the latency by 1 frame!
-    stream->parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
-
     AVPacket *packet = av_packet_alloc();
     if (!packet) {
         LOGE("Could not allocate packet");
@@ -228,6 +291,9 @@ run_stream(void *data) {
     for (;;) {
         bool ok = stream_recv_packet(stream, packet);
         if (!ok) {
+            if (stream_reconnect(stream)) {
+                continue;
+            }
             // end of stream
             break;
         }
@@ -265,11 +331,16 @@ stream_init(struct stream *stream, socket_t socket,
     stream->socket = socket;
     stream->pending = NULL;
     stream->sink_count = 0;
+    stream->splice = false;
+    stream->pts_offset = 0;
+    stream->last_pts = -1;
+    stream->last_packet_tick = 0;
 
     assert(cbs && cbs->on_eos);
 
     stream->cbs = cbs;
     stream->cbs_userdata = cbs_userdata;
+    stream->metrics = NULL;
 }
 
 void
@@ -7,11 +7,13 @@
 #include <stdint.h>
 #include <libavformat/avformat.h>
 
+#include "metrics.h"
 #include "trait/packet_sink.h"
 #include "util/net.h"
 #include "util/thread.h"
+#include "util/tick.h"
 
-#define STREAM_MAX_SINKS 2
+#define STREAM_MAX_SINKS 8
 
 struct stream {
     socket_t socket;
@@ -26,12 +28,26 @@ struct stream {
     // packet is available
     AVPacket *pending;
 
+    // after a reconnection, the PTS are shifted so that they follow the
+    // previous ones (the new server starts its timeline from scratch)
+    bool splice;
+    int64_t pts_offset;
+    int64_t last_pts; // -1 if no packet has been received yet
+    sc_tick last_packet_tick;
+
     const struct stream_callbacks *cbs;
     void *cbs_userdata;
+
+    struct sc_metrics *metrics; // optional, set before stream_start()
 };
 
 struct stream_callbacks {
     void (*on_eos)(struct stream *stream, void *userdata);
+    // Optional, called from the stream thread when the connection is lost
+    //
+    // Return a new socket to resume the stream without closing the sinks, or
+    // INVALID_SOCKET to end it (on_eos() is then called).
+    socket_t (*on_disconnected)(struct stream *stream, void *userdata);
 };
 
 void
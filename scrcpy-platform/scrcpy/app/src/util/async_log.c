@@ -0,0 +1,276 @@
+#include "async_log.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_log.h>
+
+#include "log.h"
+#include "mpsc.h"
+#include "thread.h"
+
+#define QUEUE_CAPACITY 256
+
+struct sc_log_entry {
+    sc_tick timestamp;
+    enum sc_log_level level;
+    char message[SC_ASYNC_LOG_MESSAGE_SIZE];
+};
+
+enum async_log_state {
+    ASYNC_LOG_STOPPED,
+    ASYNC_LOG_STARTING,
+    ASYNC_LOG_STARTED,
+};
+
+static atomic_int state = ASYNC_LOG_STOPPED;
+
+static struct {
+    // initialized once, never destroyed: a thread may still be pushing a
+    // message while the log thread is stopped
+    bool initialized;
+    struct sc_mpsc queue;
+    sc_mutex sink_mutex;
+
+    sc_thread thread;
+    SDL_LogOutputFunction previous_output;
+    void *previous_userdata;
+
+    // protected by sink_mutex
+    struct sc_log_sink sink; // write is NULL for stderr
+    FILE *file; // opened by sc_async_log_set_file()
+    uint64_t reported_dropped;
+} async_log;
+
+static enum sc_log_level
+level_from_sdl(SDL_LogPriority priority) {
+    switch (priority) {
+        case SDL_LOG_PRIORITY_VERBOSE:
+            return SC_LOG_LEVEL_VERBOSE;
+        case SDL_LOG_PRIORITY_DEBUG:
+            return SC_LOG_LEVEL_DEBUG;
+        case SDL_LOG_PRIORITY_INFO:
+            return SC_LOG_LEVEL_INFO;
+        case SDL_LOG_PRIORITY_WARN:
+            return SC_LOG_LEVEL_WARN;
+        default:
+            return SC_LOG_LEVEL_ERROR;
+    }
+}
+
+static const char *
+level_label(enum sc_log_level level) {
+    switch (level) {
+        case SC_LOG_LEVEL_VERBOSE:
+            return "VERBOSE";
+        case SC_LOG_LEVEL_DEBUG:
+            return "DEBUG";
+        case SC_LOG_LEVEL_INFO:
+            return "INFO";
+        case SC_LOG_LEVEL_WARN:
+            return "WARN";
+        default:
+            return "ERROR";
+    }
+}
+
+// Called by SDL on the logging thread, with the formatted message
+static void
+log_output(void *userdata, int category, SDL_LogPriority priority,
+           const char *message) {
+    (void) userdata;
+    (void) category;
+
+    struct sc_log_entry entry;
+    entry.timestamp = sc_tick_now();
+    entry.level = level_from_sdl(priority);
+    size_t len = strlen(message);
+    if (len >= sizeof(entry.message)) {
+        len = sizeof(entry.message) - 1;
+    }
+    memcpy(entry.message, message, len);
+    entry.message[len] = '\0';
+
+    // never blocks, the overflows are counted by the queue
+    sc_mpsc_push(&async_log.queue, &entry);
+}
+
+static void
+write_message(sc_tick timestamp, enum sc_log_level level,
+              const char *message) {
+    sc_mutex_assert(&async_log.sink_mutex);
+
+    if (async_log.sink.write) {
+        async_log.sink.write(async_log.sink.userdata, timestamp, level,
+                             message);
+    } else if (async_log.file) {
+        fprintf(async_log.file, "[%" PRItick ".%06" PRItick "] %s: %s\n",
+                SC_TICK_TO_SEC(timestamp),
+                SC_TICK_TO_US(timestamp) % 1000000, level_label(level),
+                message);
+    } else {
+        // like the default SDL log output
+        fprintf(stderr, "%s: %s\n", level_label(level), message);
+    }
+}
+
+static void
+write_batch(struct sc_log_entry *entry) {
+    sc_mutex_lock(&async_log.sink_mutex);
+
+    // write all the pending messages at once
+    do {
+        write_message(entry->timestamp, entry->level, entry->message);
+    } while (sc_mpsc_take(&async_log.queue, entry));
+
+    uint64_t dropped = sc_mpsc_get_overflows(&async_log.queue);
+    if (dropped != async_log.reported_dropped) {
+        char message[64];
+        sprintf(message, "%" PRIu64 " log messages dropped",
+                dropped - async_log.reported_dropped);
+        write_message(sc_tick_now(), SC_LOG_LEVEL_WARN, message);
+        async_log.reported_dropped = dropped;
+    }
+
+    if (async_log.file && !async_log.sink.write) {
+        fflush(async_log.file);
+    }
+
+    sc_mutex_unlock(&async_log.sink_mutex);
+}
+
+static int
+run_async_log(void *data) {
+    (void) data;
+
+    struct sc_log_entry entry;
+    while (sc_mpsc_take_wait(&async_log.queue, &entry)) {
+        write_batch(&entry);
+    }
+
+    // write the messages pushed before the interruption
+    if (sc_mpsc_take(&async_log.queue, &entry)) {
+        write_batch(&entry);
+    }
+
+    return 0;
+}
+
+static void
+async_log_atexit(void) {
+    sc_async_log_stop();
+}
+
+bool
+sc_async_log_start(void) {
+    int expected = ASYNC_LOG_STOPPED;
+    if (!atomic_compare_exchange_strong(&state, &expected,
+                                        ASYNC_LOG_STARTING)) {
+        // started (or being started) by another call
+        while (expected == ASYNC_LOG_STARTING) {
+            expected = atomic_load(&state);
+        }
+        return expected == ASYNC_LOG_STARTED;
+    }
+
+    if (!async_log.initialized) {
+        if (!sc_mpsc_init(&async_log.queue, sizeof(struct sc_log_entry),
+                          QUEUE_CAPACITY, SC_MPSC_OVERFLOW_FAIL)) {
+            goto error;
+        }
+        if (!sc_mutex_init(&async_log.sink_mutex)) {
+            sc_mpsc_destroy(&async_log.queue);
+            goto error;
+        }
+        async_log.sink.write = NULL;
+        async_log.file = NULL;
+        async_log.reported_dropped = 0;
+        async_log.initialized = true;
+        atexit(async_log_atexit);
+    } else {
+        // restarted after sc_async_log_stop()
+        sc_mpsc_resume(&async_log.queue);
+    }
+
+    if (!sc_thread_create(&async_log.thread, run_async_log, "log", NULL)) {
+        LOGC("Could not start log thread");
+        goto error;
+    }
+
+    SDL_LogGetOutputFunction(&async_log.previous_output,
+                             &async_log.previous_userdata);
+    SDL_LogSetOutputFunction(log_output, NULL);
+
+    atomic_store(&state, ASYNC_LOG_STARTED);
+    return true;
+
+error:
+    atomic_store(&state, ASYNC_LOG_STOPPED);
+    return false;
+}
+
+void
+sc_async_log_stop(void) {
+    int expected = ASYNC_LOG_STARTED;
+    if (!atomic_compare_exchange_strong(&state, &expected,
+                                        ASYNC_LOG_STARTING)) {
+        // not started
+        return;
+    }
+
+    SDL_LogSetOutputFunction(async_log.previous_output,
+                             async_log.previous_userdata);
+
+    sc_mpsc_interrupt(&async_log.queue);
+    sc_thread_join(&async_log.thread, NULL);
+
+    atomic_store(&state, ASYNC_LOG_STOPPED);
+}
+
+void
+sc_async_log_set_sink(const struct sc_log_sink *sink) {
+    assert(async_log.initialized);
+
+    sc_mutex_lock(&async_log.sink_mutex);
+    if (sink) {
+        async_log.sink = *sink;
+    } else {
+        async_log.sink.write = NULL;
+    }
+    sc_mutex_unlock(&async_log.sink_mutex);
+}
+
+bool
+sc_async_log_set_file(const char *filename) {
+    assert(async_log.initialized);
+
+    FILE *file = NULL;
+    if (filename) {
+        file = fopen(filename, "a");
+        if (!file) {
+            LOGE("Could not open log file: %s", filename);
+            return false;
+        }
+    }
+
+    sc_mutex_lock(&async_log.sink_mutex);
+    FILE *previous = async_log.file;
+    async_log.file = file;
+    sc_mutex_unlock(&async_log.sink_mutex);
+
+    if (previous) {
+        fclose(previous);
+    }
+    return true;
+}
+
+uint64_t
+sc_async_log_get_dropped(void) {
+    if (!async_log.initialized) {
+        return 0;
+    }
+    return sc_mpsc_get_overflows(&async_log.queue);
+}
@@ -0,0 +1,54 @@
+#ifndef SC_ASYNC_LOG_H
+#define SC_ASYNC_LOG_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scrcpy.h"
+#include "tick.h"
+
+// Asynchronous backend of the SDL log, so of LOG*() and of the FFmpeg logs.
+//
+// The messages are formatted on the calling thread, then pushed to a bounded
+// lock-free queue, and written to the sink by a single background thread. A
+// log call never blocks: if the queue is full, the message is dropped (and
+// counted).
+
+// Maximum length of a message (longer messages are truncated)
+#define SC_ASYNC_LOG_MESSAGE_SIZE 512
+
+struct sc_log_sink {
+    // called from the log thread only
+    void (*write)(void *userdata, sc_tick timestamp, enum sc_log_level level,
+                  const char *message);
+    void *userdata;
+};
+
+// Start the log thread, and redirect the SDL log to it (for the whole process)
+//
+// It may be called several times, only the first call starts the log thread.
+// The remaining messages are flushed on exit.
+bool
+sc_async_log_start(void);
+
+// Flush the remaining messages, stop the log thread and restore the
+// synchronous log
+void
+sc_async_log_stop(void);
+
+// Write to the sink instead of stderr (NULL to restore stderr)
+void
+sc_async_log_set_sink(const struct sc_log_sink *sink);
+
+// Write to a file instead of stderr, each message prefixed by its timestamp
+// (NULL to restore stderr)
+bool
+sc_async_log_set_file(const char *filename);
+
+// Number of messages dropped because the queue was full
+uint64_t
+sc_async_log_get_dropped(void);
+
+#endif
@@ -26,6 +26,14 @@ buffer_write64be(uint8_t *buf, uint64_t value) {
     buffer_write32be(&buf[4], (uint32_t) value);
 }
 
+static inline void
+buffer_write32le(uint8_t *buf, uint32_t value) {
+    buf[0] = value;
+    buf[1] = value >> 8;
+    buf[2] = value >> 16;
+    buf[3] = value >> 24;
+}
+
 static inline uint16_t
 buffer_read16be(const uint8_t *buf) {
     return (buf[0] << 8) | buf[1];
@@ -43,4 +51,9 @@ buffer_read64be(const uint8_t *buf) {
     return ((uint64_t) msb << 32) | lsb;
 }
 
+static inline uint32_t
+buffer_read32le(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t) buf[3] << 24);
+}
+
 #endif
@@ -0,0 +1,81 @@
+#include "histogram.h"
+
+#include <assert.h>
+
+void
+sc_histogram_init(struct sc_histogram *hist) {
+    for (int i = 0; i < SC_HISTOGRAM_BUCKETS; ++i) {
+        atomic_init(&hist->buckets[i], 0);
+    }
+    atomic_init(&hist->count, 0);
+    atomic_init(&hist->sum, 0);
+    atomic_init(&hist->max, 0);
+}
+
+static unsigned
+get_bucket(uint64_t value) {
+    // floor(log2(value))
+    unsigned bucket = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++bucket;
+    }
+    return bucket < SC_HISTOGRAM_BUCKETS ? bucket : SC_HISTOGRAM_BUCKETS - 1;
+}
+
+void
+sc_histogram_record(struct sc_histogram *hist, uint64_t value) {
+    atomic_fetch_add_explicit(&hist->buckets[get_bucket(value)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum, value, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (value > max
+            && !atomic_compare_exchange_weak_explicit(&hist->max, &max, value,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+        // max has been updated by the failed CAS
+    }
+}
+
+void
+sc_histogram_snapshot(struct sc_histogram *hist,
+                      struct sc_histogram_snapshot *snapshot) {
+    snapshot->count = 0;
+    for (int i = 0; i < SC_HISTOGRAM_BUCKETS; ++i) {
+        snapshot->buckets[i] =
+            atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        // consistent with the buckets, even if values are being recorded
+        snapshot->count += snapshot->buckets[i];
+    }
+    snapshot->sum = atomic_load_explicit(&hist->sum, memory_order_relaxed);
+    snapshot->max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+}
+
+uint64_t
+sc_histogram_percentile(const struct sc_histogram_snapshot *snapshot,
+                        unsigned percent) {
+    assert(percent <= 100);
+    if (!snapshot->count) {
+        return 0;
+    }
+
+    // nearest-rank
+    uint64_t rank = (snapshot->count * percent + 99) / 100;
+    if (!rank) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < SC_HISTOGRAM_BUCKETS; ++i) {
+        seen += snapshot->buckets[i];
+        if (seen >= rank) {
+            // the upper bound of the bucket, but never more than the max
+            uint64_t upper = (UINT64_C(2) << i) - 1;
+            return upper < snapshot->max ? upper : snapshot->max;
+        }
+    }
+
+    return snapshot->max;
+}
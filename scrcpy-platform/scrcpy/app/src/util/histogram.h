@@ -0,0 +1,48 @@
+#ifndef SC_HISTOGRAM_H
+#define SC_HISTOGRAM_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Bucket i counts the values in [2^i, 2^(i+1)) (bucket 0 also counts 0)
+#define SC_HISTOGRAM_BUCKETS 40
+
+// Histogram of non-negative values (typically durations in microseconds),
+// with logarithmic buckets: the relative error of the percentiles is at most
+// a factor 2, but recording is a few relaxed atomic increments, so that it
+// may be done from any thread without lock.
+struct sc_histogram {
+    atomic_uint_least64_t buckets[SC_HISTOGRAM_BUCKETS];
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t sum;
+    atomic_uint_least64_t max;
+};
+
+// A copy of the values, to compute the percentiles
+struct sc_histogram_snapshot {
+    uint64_t buckets[SC_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+void
+sc_histogram_init(struct sc_histogram *hist);
+
+void
+sc_histogram_record(struct sc_histogram *hist, uint64_t value);
+
+// The snapshot is not atomic as a whole: if values are recorded concurrently,
+// the counters may be slightly inconsistent
+void
+sc_histogram_snapshot(struct sc_histogram *hist,
+                      struct sc_histogram_snapshot *snapshot);
+
+// Return an upper bound of the percentile (in [0, 100]), 0 if empty
+uint64_t
+sc_histogram_percentile(const struct sc_histogram_snapshot *snapshot,
+                        unsigned percent);
+
+#endif
@@ -3,9 +3,11 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <SDL2/SDL_log.h>
 
 #include "scrcpy.h"
+#include "tick.h"
 
 #define LOGV(...) SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
 #define LOGD(...) SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
@@ -14,6 +16,48 @@
 #define LOGE(...) SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
 #define LOGC(...) SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, __VA_ARGS__)
 
+// Log at most one message per interval from the call site, for the logs which
+// could be repeated on every frame or every event. The number of suppressed
+// messages is reported before the next message.
+//
+// Usage: LOG_RATELIMITED(LOGW, SC_TICK_FROM_SEC(1), "...", ...);
+#define LOG_RATELIMITED(LOG, interval, ...) \
+    do { \
+        static struct sc_log_ratelimit sc_log_ratelimit_; \
+        unsigned sc_log_suppressed_; \
+        if (sc_log_ratelimit_check(&sc_log_ratelimit_, interval, \
+                                   &sc_log_suppressed_)) { \
+            if (sc_log_suppressed_) { \
+                LOG("(%u similar messages suppressed)", sc_log_suppressed_); \
+            } \
+            LOG(__VA_ARGS__); \
+        } \
+    } while (0)
+
+struct sc_log_ratelimit {
+    atomic_int_least64_t next; // the tick from which the next message passes
+    atomic_uint suppressed;
+};
+
+static inline bool
+sc_log_ratelimit_check(struct sc_log_ratelimit *ratelimit, sc_tick interval,
+                       unsigned *suppressed) {
+    sc_tick now = sc_tick_now();
+    int_least64_t next =
+        atomic_load_explicit(&ratelimit->next, memory_order_relaxed);
+    if (now < next
+            || !atomic_compare_exchange_strong(&ratelimit->next, &next,
+                                               now + interval)) {
+        atomic_fetch_add_explicit(&ratelimit->suppressed, 1,
+                                  memory_order_relaxed);
+        return false;
+    }
+
+    *suppressed = atomic_exchange_explicit(&ratelimit->suppressed, 0,
+                                           memory_order_relaxed);
+    return true;
+}
+
 void
 sc_set_log_level(enum sc_log_level level);
 
@@ -0,0 +1,337 @@
+#include "mpsc.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+# include <limits.h>
+# include <time.h>
+# include <unistd.h>
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#endif
+
+#include "log.h"
+
+// cell layout: [seq][item], the item is aligned as if it was malloc()ed
+#define CELL_HEADER_SIZE \
+    ((sizeof(atomic_size_t) + _Alignof(max_align_t) - 1) \
+            / _Alignof(max_align_t) * _Alignof(max_align_t))
+
+static inline atomic_size_t *
+get_cell_seq(struct sc_mpsc *queue, size_t pos) {
+    return (atomic_size_t *) &queue->cells[(pos & (queue->capacity - 1))
+                                           * queue->cell_size];
+}
+
+static inline void *
+get_cell_item(atomic_size_t *seq) {
+    return (unsigned char *) seq + CELL_HEADER_SIZE;
+}
+
+static bool
+sc_mpsc_event_init(struct sc_mpsc_event *event) {
+    atomic_init(&event->seq, 0);
+    atomic_init(&event->armed, false);
+#ifndef __linux__
+    if (!sc_mutex_init(&event->mutex)) {
+        return false;
+    }
+    if (!sc_cond_init(&event->cond)) {
+        sc_mutex_destroy(&event->mutex);
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void
+sc_mpsc_event_destroy(struct sc_mpsc_event *event) {
+#ifndef __linux__
+    sc_cond_destroy(&event->cond);
+    sc_mutex_destroy(&event->mutex);
+#else
+    (void) event;
+#endif
+}
+
+// Arm the event and return the key to pass to sc_mpsc_event_wait()
+//
+// The condition must be checked again after this call, before waiting.
+static uint32_t
+sc_mpsc_event_prepare(struct sc_mpsc_event *event) {
+    atomic_store(&event->armed, true);
+    uint32_t key = atomic_load(&event->seq);
+    // the condition must be read after arming (paired with the fence in
+    // sc_mpsc_event_notify())
+    atomic_thread_fence(memory_order_seq_cst);
+    return key;
+}
+
+// Wait until notified, or until the deadline (if not SC_MPSC_NO_DEADLINE)
+static void
+sc_mpsc_event_wait(struct sc_mpsc_event *event, uint32_t key,
+                   sc_tick deadline) {
+#ifdef __linux__
+    struct timespec timeout;
+    struct timespec *ptimeout = NULL;
+    if (deadline != SC_MPSC_NO_DEADLINE) {
+        sc_tick remaining = deadline - sc_tick_now();
+        if (remaining <= 0) {
+            return;
+        }
+        // FUTEX_WAIT takes a relative timeout
+        timeout.tv_sec = SC_TICK_TO_SEC(remaining);
+        timeout.tv_nsec = SC_TICK_TO_US(remaining % SC_TICK_FREQ) * 1000;
+        ptimeout = &timeout;
+    }
+    // returns immediately if seq != key (EAGAIN), or on spurious wakeup
+    syscall(SYS_futex, &event->seq, FUTEX_WAIT_PRIVATE, key, ptimeout, NULL,
+            0);
+#else
+    sc_mutex_lock(&event->mutex);
+    while (atomic_load(&event->seq) == key) {
+        if (deadline == SC_MPSC_NO_DEADLINE) {
+            sc_cond_wait(&event->cond, &event->mutex);
+        } else if (!sc_cond_timedwait(&event->cond, &event->mutex, deadline)
+                && sc_tick_now() >= deadline) {
+            break;
+        }
+    }
+    sc_mutex_unlock(&event->mutex);
+#endif
+}
+
+static void
+sc_mpsc_event_notify(struct sc_mpsc_event *event) {
+    // the condition change must be visible before reading armed (paired with
+    // the fence in sc_mpsc_event_prepare())
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&event->armed, memory_order_relaxed)
+            || !atomic_exchange(&event->armed, false)) {
+        // fast path: nobody waits (or they have already been woken up), no
+        // syscall
+        return;
+    }
+
+    // wake up all the waiters, they will re-arm the event if necessary
+
+    atomic_fetch_add(&event->seq, 1);
+#ifdef __linux__
+    syscall(SYS_futex, &event->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL,
+            0);
+#else
+    sc_mutex_lock(&event->mutex);
+    sc_cond_broadcast(&event->cond);
+    sc_mutex_unlock(&event->mutex);
+#endif
+}
+
+static size_t
+next_power_of_2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+bool
+sc_mpsc_init(struct sc_mpsc *queue, size_t item_size, size_t capacity,
+             enum sc_mpsc_overflow overflow) {
+    assert(item_size);
+    assert(capacity);
+
+    queue->capacity = next_power_of_2(capacity);
+    queue->item_size = item_size;
+    size_t align = _Alignof(max_align_t);
+    queue->cell_size = (CELL_HEADER_SIZE + item_size + align - 1)
+                     / align * align;
+    queue->overflow = overflow;
+
+    queue->cells = malloc(queue->capacity * queue->cell_size);
+    if (!queue->cells) {
+        LOGC("Could not allocate queue");
+        return false;
+    }
+
+    for (size_t i = 0; i < queue->capacity; ++i) {
+        atomic_init(get_cell_seq(queue, i), i);
+    }
+
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->interrupted, false);
+    atomic_init(&queue->overflows, 0);
+
+    if (!sc_mpsc_event_init(&queue->not_empty)) {
+        goto error_free_cells;
+    }
+
+    if (!sc_mpsc_event_init(&queue->not_full)) {
+        goto error_destroy_not_empty;
+    }
+
+    return true;
+
+error_destroy_not_empty:
+    sc_mpsc_event_destroy(&queue->not_empty);
+error_free_cells:
+    free(queue->cells);
+
+    return false;
+}
+
+void
+sc_mpsc_destroy(struct sc_mpsc *queue) {
+    sc_mpsc_event_destroy(&queue->not_full);
+    sc_mpsc_event_destroy(&queue->not_empty);
+    free(queue->cells);
+}
+
+// Push count consecutive items
+static bool
+try_push(struct sc_mpsc *queue, const void *items, size_t count) {
+    assert(count && count <= queue->capacity);
+
+    size_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    for (;;) {
+        // The consumer releases the cells in order, so if the last cell is
+        // free, then all the previous ones are free too
+        size_t last = pos + count - 1;
+        atomic_size_t *seq = get_cell_seq(queue, last);
+        size_t s = atomic_load_explicit(seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) s - (intptr_t) last;
+        if (!diff) {
+            // the cells are free, try to claim them
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos,
+                                                      pos + count,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+            // pos has been updated by the failed CAS
+        } else if (diff < 0) {
+            // the cell still contains the item from the previous lap
+            return false;
+        } else {
+            // another producer claimed this cell meanwhile
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+
+    const unsigned char *item = items;
+    for (size_t i = 0; i < count; ++i) {
+        atomic_size_t *seq = get_cell_seq(queue, pos + i);
+        memcpy(get_cell_item(seq), item, queue->item_size);
+        // publish the item to the consumer
+        atomic_store_explicit(seq, pos + i + 1, memory_order_release);
+        item += queue->item_size;
+    }
+    return true;
+}
+
+bool
+sc_mpsc_push_n(struct sc_mpsc *queue, const void *items, size_t count) {
+    for (;;) {
+        if (atomic_load_explicit(&queue->interrupted, memory_order_relaxed)) {
+            return false;
+        }
+
+        if (try_push(queue, items, count)) {
+            sc_mpsc_event_notify(&queue->not_empty);
+            return true;
+        }
+
+        if (queue->overflow == SC_MPSC_OVERFLOW_FAIL) {
+            atomic_fetch_add_explicit(&queue->overflows, 1,
+                                      memory_order_relaxed);
+            return false;
+        }
+
+        uint32_t key = sc_mpsc_event_prepare(&queue->not_full);
+        if (try_push(queue, items, count)) {
+            sc_mpsc_event_notify(&queue->not_empty);
+            return true;
+        }
+        if (atomic_load(&queue->interrupted)) {
+            return false;
+        }
+        sc_mpsc_event_wait(&queue->not_full, key, SC_MPSC_NO_DEADLINE);
+    }
+}
+
+bool
+sc_mpsc_push(struct sc_mpsc *queue, const void *item) {
+    return sc_mpsc_push_n(queue, item, 1);
+}
+
+bool
+sc_mpsc_take(struct sc_mpsc *queue, void *item) {
+    size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_size_t *seq = get_cell_seq(queue, pos);
+    size_t s = atomic_load_explicit(seq, memory_order_acquire);
+    if (s != pos + 1) {
+        // empty (or the next item is not published yet)
+        return false;
+    }
+
+    memcpy(item, get_cell_item(seq), queue->item_size);
+    // release the cell for the next lap
+    atomic_store_explicit(seq, pos + queue->capacity, memory_order_release);
+    atomic_store_explicit(&queue->tail, pos + 1, memory_order_relaxed);
+
+    if (queue->overflow == SC_MPSC_OVERFLOW_BLOCK) {
+        // Do not wake up the blocked producers for every item taken, but only
+        // once half of the queue is free (otherwise, the consumer and the
+        // producers would keep waking up each other)
+        size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        if (head - (pos + 1) <= queue->capacity / 2) {
+            sc_mpsc_event_notify(&queue->not_full);
+        }
+    }
+    return true;
+}
+
+bool
+sc_mpsc_take_timedwait(struct sc_mpsc *queue, void *item, sc_tick deadline) {
+    for (;;) {
+        if (atomic_load(&queue->interrupted)) {
+            return false;
+        }
+
+        if (sc_mpsc_take(queue, item)) {
+            return true;
+        }
+
+        if (deadline != SC_MPSC_NO_DEADLINE && sc_tick_now() >= deadline) {
+            return false;
+        }
+
+        uint32_t key = sc_mpsc_event_prepare(&queue->not_empty);
+        if (atomic_load(&queue->interrupted)) {
+            return false;
+        }
+        if (sc_mpsc_take(queue, item)) {
+            return true;
+        }
+        sc_mpsc_event_wait(&queue->not_empty, key, deadline);
+    }
+}
+
+bool
+sc_mpsc_take_wait(struct sc_mpsc *queue, void *item) {
+    return sc_mpsc_take_timedwait(queue, item, SC_MPSC_NO_DEADLINE);
+}
+
+void
+sc_mpsc_interrupt(struct sc_mpsc *queue) {
+    atomic_store(&queue->interrupted, true);
+    sc_mpsc_event_notify(&queue->not_empty);
+    sc_mpsc_event_notify(&queue->not_full);
+}
+
+void
+sc_mpsc_resume(struct sc_mpsc *queue) {
+    atomic_store(&queue->interrupted, false);
+}
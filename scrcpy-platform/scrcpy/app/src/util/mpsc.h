@@ -0,0 +1,144 @@
+// bounded lock-free multi-producer single-consumer queue
+#ifndef SC_MPSC_H
+#define SC_MPSC_H
+
+#include "common.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thread.h"
+#include "tick.h"
+
+#define SC_MPSC_NO_DEADLINE (-1)
+
+// What to do when a producer pushes to a full queue
+enum sc_mpsc_overflow {
+    // sc_mpsc_push() fails immediately (the item is not pushed)
+    SC_MPSC_OVERFLOW_FAIL,
+    // sc_mpsc_push() waits until the consumer takes an item (or until the
+    // queue is interrupted)
+    SC_MPSC_OVERFLOW_BLOCK,
+};
+
+// A wait/notify primitive. On Linux, waiting is a futex on seq; elsewhere, it
+// falls back to a mutex and a condition variable.
+//
+// Notifying costs a single atomic load when nobody waits, and a single wakeup
+// syscall per wait (not per notification) otherwise.
+struct sc_mpsc_event {
+    atomic_uint_least32_t seq;
+    atomic_bool armed; // set by the waiters, cleared by the notifier
+#ifndef __linux__
+    sc_mutex mutex;
+    sc_cond cond;
+#endif
+};
+
+// Bounded queue of fixed-size items (copied by value), based on the bounded
+// MPMC queue by Dmitry Vyukov: each cell has its own sequence number, so
+// producers only contend on a single atomic counter (head), and never block
+// each other.
+//
+// Any number of threads may push concurrently, but only a single thread may
+// take.
+struct sc_mpsc {
+    size_t capacity; // power of 2
+    size_t item_size;
+    size_t cell_size;
+    enum sc_mpsc_overflow overflow;
+    unsigned char *cells;
+
+    // written by the producers
+    alignas(64) atomic_size_t head;
+    // written by the consumer only (atomic for sc_mpsc_size())
+    alignas(64) atomic_size_t tail;
+
+    atomic_bool interrupted;
+    atomic_uint_least64_t overflows; // number of failed pushes
+
+    struct sc_mpsc_event not_empty;
+    struct sc_mpsc_event not_full; // only used for SC_MPSC_OVERFLOW_BLOCK
+};
+
+// The capacity is rounded up to the next power of 2
+bool
+sc_mpsc_init(struct sc_mpsc *queue, size_t item_size, size_t capacity,
+             enum sc_mpsc_overflow overflow);
+
+// The remaining items must be taken (and released) by the caller beforehand
+void
+sc_mpsc_destroy(struct sc_mpsc *queue);
+
+// Copy item into the queue (may be called from any thread)
+//
+// Return false if the queue is full (with SC_MPSC_OVERFLOW_FAIL) or
+// interrupted.
+bool
+sc_mpsc_push(struct sc_mpsc *queue, const void *item);
+
+// Copy count items (an array of count * item_size bytes) into the queue,
+// atomically: either all or none are pushed, and no item from another producer
+// is interleaved. The consumer is woken up only once.
+//
+// count must not exceed the capacity.
+//
+// Return false if the queue has not enough room (with SC_MPSC_OVERFLOW_FAIL)
+// or is interrupted.
+bool
+sc_mpsc_push_n(struct sc_mpsc *queue, const void *items, size_t count);
+
+// Take the oldest item, without waiting (consumer thread only)
+//
+// Return false if the queue is empty.
+bool
+sc_mpsc_take(struct sc_mpsc *queue, void *item);
+
+// Take the oldest item, waiting until one is available (consumer thread only)
+//
+// Return false if the queue is interrupted (the pending items are not taken).
+bool
+sc_mpsc_take_wait(struct sc_mpsc *queue, void *item);
+
+// Like sc_mpsc_take_wait(), but wait at most until deadline (or forever if
+// deadline is SC_MPSC_NO_DEADLINE)
+//
+// Return false on timeout or if the queue is interrupted (see
+// sc_mpsc_is_interrupted()).
+bool
+sc_mpsc_take_timedwait(struct sc_mpsc *queue, void *item, sc_tick deadline);
+
+// Wake up the consumer and the blocked producers, and make any further
+// sc_mpsc_take_wait() and sc_mpsc_push() fail
+void
+sc_mpsc_interrupt(struct sc_mpsc *queue);
+
+// Cancel sc_mpsc_interrupt(), once the consumer is not running anymore
+//
+// The items pushed before the interruption are kept.
+void
+sc_mpsc_resume(struct sc_mpsc *queue);
+
+static inline bool
+sc_mpsc_is_interrupted(struct sc_mpsc *queue) {
+    return atomic_load(&queue->interrupted);
+}
+
+// Approximate number of items in the queue (may be called from any thread)
+static inline size_t
+sc_mpsc_size(struct sc_mpsc *queue) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    // head may be read after concurrent takes
+    return head > tail ? head - tail : 0;
+}
+
+static inline uint64_t
+sc_mpsc_get_overflows(struct sc_mpsc *queue) {
+    return atomic_load_explicit(&queue->overflows, memory_order_relaxed);
+}
+
+#endif
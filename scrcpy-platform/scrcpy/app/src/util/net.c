@@ -1,15 +1,26 @@
 #include "net.h"
 
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_timer.h>
 
 #include "log.h"
 
+#define CONNECT_INITIAL_DELAY SC_TICK_FROM_MS(2)
+#define CONNECT_MAX_DELAY SC_TICK_FROM_MS(64)
+
 #ifdef __WINDOWS__
   typedef int socklen_t;
+# define poll WSAPoll
 #else
+# include <fcntl.h>
+# include <poll.h>
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
 # include <netinet/in.h>
 # include <arpa/inet.h>
 # include <unistd.h>
@@ -41,6 +52,149 @@ net_connect(uint32_t addr, uint16_t port) {
     return sock;
 }
 
+static bool
+set_blocking(socket_t socket, bool blocking) {
+#ifdef __WINDOWS__
+    u_long mode = !blocking;
+    return !ioctlsocket(socket, FIONBIO, &mode);
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    flags = blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK;
+    return !fcntl(socket, F_SETFL, flags);
+#endif
+}
+
+static bool
+wait_socket(socket_t socket, short events, sc_tick deadline) {
+    struct pollfd pfd = {
+        .fd = socket,
+        .events = events,
+    };
+
+    for (;;) {
+        sc_tick now = sc_tick_now();
+        if (now >= deadline) {
+            return false;
+        }
+
+        // round up, to not wake up just before the deadline
+        int timeout_ms = (int) SC_TICK_TO_MS(deadline - now + 999);
+        int r = poll(&pfd, 1, timeout_ms);
+        if (r > 0) {
+            return true;
+        }
+#ifndef __WINDOWS__
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (r == -1) {
+            return false;
+        }
+        // timeout, check the deadline again
+    }
+}
+
+bool
+net_wait_readable(socket_t socket, sc_tick deadline) {
+    return wait_socket(socket, POLLIN, deadline);
+}
+
+socket_t
+net_connect_deadline(uint32_t addr, uint16_t port, sc_tick deadline) {
+    socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) {
+        perror("socket");
+        return INVALID_SOCKET;
+    }
+
+    if (!set_blocking(sock, false)) {
+        goto error;
+    }
+
+    SOCKADDR_IN sin;
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(addr);
+    sin.sin_port = htons(port);
+
+    if (connect(sock, (SOCKADDR *) &sin, sizeof(sin)) == SOCKET_ERROR) {
+#ifdef __WINDOWS__
+        bool in_progress = WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        bool in_progress = errno == EINPROGRESS;
+#endif
+        if (!in_progress) {
+            // typically ECONNREFUSED, not an error for the caller
+            goto error;
+        }
+
+        if (!wait_socket(sock, POLLOUT, deadline)) {
+            goto error;
+        }
+
+        int err;
+        socklen_t len = sizeof(err);
+        if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *) &err, &len)
+                || err) {
+            goto error;
+        }
+    }
+
+    if (!set_blocking(sock, true)) {
+        goto error;
+    }
+
+    return sock;
+
+error:
+    net_close(sock);
+    return INVALID_SOCKET;
+}
+
+socket_t
+net_connect_retry(uint32_t addr, uint16_t port, sc_tick deadline,
+                  bool (*check)(socket_t socket, sc_tick deadline),
+                  unsigned *attempts) {
+    sc_tick delay = CONNECT_INITIAL_DELAY;
+    unsigned count = 0;
+    socket_t sock = INVALID_SOCKET;
+
+    for (;;) {
+        ++count;
+        sock = net_connect_deadline(addr, port, deadline);
+        if (sock != INVALID_SOCKET) {
+            if (!check || check(sock, deadline)) {
+                break;
+            }
+            net_close(sock);
+            sock = INVALID_SOCKET;
+        }
+
+        sc_tick now = sc_tick_now();
+        if (now >= deadline) {
+            break;
+        }
+
+        if (delay > deadline - now) {
+            delay = deadline - now;
+        }
+        SDL_Delay(SC_TICK_TO_MS(delay + 999));
+
+        delay *= 2;
+        if (delay > CONNECT_MAX_DELAY) {
+            delay = CONNECT_MAX_DELAY;
+        }
+    }
+
+    if (attempts) {
+        *attempts = count;
+    }
+    return sock;
+}
+
 socket_t
 net_listen(uint32_t addr, uint16_t port, int backlog) {
     socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
@@ -75,6 +229,48 @@ net_listen(uint32_t addr, uint16_t port, int backlog) {
     return sock;
 }
 
+#ifndef _WIN32
+socket_t
+net_listen_unix(const char *path, int backlog) {
+    struct sockaddr_un sun;
+    size_t len = strlen(path);
+    if (len >= sizeof(sun.sun_path)) {
+        LOGE("UNIX socket path too long: %s", path);
+        return INVALID_SOCKET;
+    }
+
+    socket_t sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) {
+        perror("socket");
+        return INVALID_SOCKET;
+    }
+
+    sun.sun_family = AF_UNIX;
+    memcpy(sun.sun_path, path, len + 1);
+
+    // a socket left by a previous process would make bind() fail (any other
+    // file is preserved, bind() fails)
+    struct stat st;
+    if (!lstat(path, &st) && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    if (bind(sock, (struct sockaddr *) &sun, sizeof(sun)) == SOCKET_ERROR) {
+        perror("bind");
+        net_close(sock);
+        return INVALID_SOCKET;
+    }
+
+    if (listen(sock, backlog) == SOCKET_ERROR) {
+        perror("listen");
+        net_close(sock);
+        return INVALID_SOCKET;
+    }
+
+    return sock;
+}
+#endif
+
 socket_t
 net_accept(socket_t server_socket) {
     SOCKADDR_IN csin;
@@ -82,6 +278,19 @@ net_accept(socket_t server_socket) {
     return accept(server_socket, (SOCKADDR *) &csin, &sinsize);
 }
 
+bool
+net_get_local_port(socket_t socket, uint16_t *port) {
+    SOCKADDR_IN sin;
+    socklen_t len = sizeof(sin);
+    if (getsockname(socket, (SOCKADDR *) &sin, &len) == SOCKET_ERROR) {
+        perror("getsockname");
+        return false;
+    }
+
+    *port = ntohs(sin.sin_port);
+    return true;
+}
+
 ssize_t
 net_recv(socket_t socket, void *buf, size_t len) {
     return recv(socket, buf, len, 0);
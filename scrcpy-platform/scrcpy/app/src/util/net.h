@@ -7,6 +7,8 @@
 #include <stdint.h>
 #include <SDL2/SDL_platform.h>
 
+#include "tick.h"
+
 #ifdef __WINDOWS__
 # include <winsock2.h>
   #define SHUT_RD SD_RECEIVE
@@ -28,12 +30,47 @@ net_cleanup(void);
 socket_t
 net_connect(uint32_t addr, uint16_t port);
 
+// Connect using a non-blocking connect(), waiting at most until deadline
+//
+// The returned socket is in blocking mode.
+socket_t
+net_connect_deadline(uint32_t addr, uint16_t port, sc_tick deadline);
+
+// Connect until it succeeds or until deadline, with an exponential backoff
+// between attempts (starting at a few milliseconds)
+//
+// If check is not NULL, it is called on each connected socket, and the attempt
+// fails if it returns false (e.g. if the connection succeeds but the actual
+// service behind a tunnel is not ready yet).
+//
+// The number of attempts is written to attempts if not NULL.
+socket_t
+net_connect_retry(uint32_t addr, uint16_t port, sc_tick deadline,
+                  bool (*check)(socket_t socket, sc_tick deadline),
+                  unsigned *attempts);
+
+// Wait until data is available (or the connection is closed), at most until
+// deadline
+bool
+net_wait_readable(socket_t socket, sc_tick deadline);
+
 socket_t
 net_listen(uint32_t addr, uint16_t port, int backlog);
 
+#ifndef _WIN32
+// Listen on a UNIX socket (an existing socket at path is replaced, but not
+// any other file)
+socket_t
+net_listen_unix(const char *path, int backlog);
+#endif
+
 socket_t
 net_accept(socket_t server_socket);
 
+// Get the port a socket is bound to (e.g. when listening on port 0)
+bool
+net_get_local_port(socket_t socket, uint16_t *port);
+
 // the _all versions wait/retry until len bytes have been written/read
 ssize_t
 net_recv(socket_t socket, void *buf, size_t len);
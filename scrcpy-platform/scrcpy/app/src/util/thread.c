@@ -1,14 +1,141 @@
 #include "thread.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+#ifdef __linux__
+# include <sched.h>
+# include <sys/resource.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
 
 #include "log.h"
 
+// the configuration of the threads, set by sc_thread_config_init()
+static struct sc_thread_config thread_configs[SC_THREAD_CONFIG_MAX_ROLES];
+static unsigned thread_config_count;
+static sc_static_mutex thread_config_lock = SC_STATIC_MUTEX_INIT;
+
+static bool
+role_matches(const char *role, const char *name) {
+    size_t len = strlen(role);
+    return !strncmp(role, name, len) && (!name[len] || name[len] == '-');
+}
+
+static bool
+find_thread_config(const char *name, struct sc_thread_config *config) {
+    bool found = false;
+    sc_static_mutex_lock(&thread_config_lock);
+    for (unsigned i = 0; i < thread_config_count; ++i) {
+        if (role_matches(thread_configs[i].role, name)) {
+            *config = thread_configs[i];
+            found = true;
+            break;
+        }
+    }
+    sc_static_mutex_unlock(&thread_config_lock);
+    return found;
+}
+
+static bool
+has_cpus(const struct sc_thread_config *config) {
+    for (unsigned i = 0; i < ARRAY_LEN(config->cpus); ++i) {
+        if (config->cpus[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Apply the configuration to the current thread (failures are not fatal,
+// e.g. a real-time priority requires CAP_SYS_NICE)
+static void
+apply_thread_config(const struct sc_thread_config *config) {
+#ifdef __linux__
+    if (has_cpus(config)) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned cpu = 0; cpu < SC_THREAD_CONFIG_MAX_CPUS; ++cpu) {
+            if (config->cpus[cpu / 64] & (UINT64_C(1) << (cpu % 64))) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set)) {
+            LOGW("Could not set the CPU affinity of thread %s: %s",
+                 config->role, strerror(errno));
+        }
+    }
+
+    if (config->has_nice) {
+        // on Linux, the nice value is per-thread
+        pid_t tid = syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, tid, config->nice)) {
+            LOGW("Could not set the nice value of thread %s: %s",
+                 config->role, strerror(errno));
+        }
+    }
+
+    if (config->fifo_priority) {
+        struct sched_param param = {.sched_priority = config->fifo_priority};
+        if (sched_setscheduler(0, SCHED_FIFO, &param)) {
+            LOGW("Could not set the SCHED_FIFO priority of thread %s: %s",
+                 config->role, strerror(errno));
+        }
+    }
+#else
+    (void) config;
+#endif
+}
+
+struct thread_start {
+    sc_thread_fn *fn;
+    void *userdata;
+    struct sc_thread_config config;
+};
+
+static int
+run_configured_thread(void *data) {
+    struct thread_start *start = data;
+    sc_thread_fn *fn = start->fn;
+    void *userdata = start->userdata;
+    apply_thread_config(&start->config);
+    free(start);
+
+    return fn(userdata);
+}
+
 bool
 sc_thread_create(sc_thread *thread, sc_thread_fn fn, const char *name,
                  void *userdata) {
-    SDL_Thread *sdl_thread = SDL_CreateThread(fn, name, userdata);
+    SDL_Thread *sdl_thread;
+
+    struct sc_thread_config config;
+    if (find_thread_config(name, &config)) {
+        struct thread_start *start = malloc(sizeof(*start));
+        if (!start) {
+            LOGC("Could not allocate thread start");
+            return false;
+        }
+        start->fn = fn;
+        start->userdata = userdata;
+        start->config = config;
+
+        // SDL sets the name of the system thread
+        const char *thread_name = config.name[0] ? config.name : name;
+        sdl_thread = SDL_CreateThread(run_configured_thread, thread_name,
+                                      start);
+        if (!sdl_thread) {
+            free(start);
+        }
+    } else {
+        sdl_thread = SDL_CreateThread(fn, name, userdata);
+    }
+
     if (!sdl_thread) {
         return false;
     }
@@ -41,6 +168,40 @@ sc_mutex_destroy(sc_mutex *mutex) {
     SDL_DestroyMutex(mutex->mutex);
 }
 
+#define STATIC_MUTEX_UNINITIALIZED 0
+#define STATIC_MUTEX_INITIALIZING 1
+#define STATIC_MUTEX_INITIALIZED 2
+
+void
+sc_static_mutex_lock(sc_static_mutex *mutex) {
+    int state = atomic_load_explicit(&mutex->state, memory_order_acquire);
+    if (state != STATIC_MUTEX_INITIALIZED) {
+        int expected = STATIC_MUTEX_UNINITIALIZED;
+        if (atomic_compare_exchange_strong(&mutex->state, &expected,
+                                           STATIC_MUTEX_INITIALIZING)) {
+            if (!sc_mutex_init(&mutex->mutex)) {
+                LOGC("Could not create mutex: %s", SDL_GetError());
+                abort();
+            }
+            atomic_store_explicit(&mutex->state, STATIC_MUTEX_INITIALIZED,
+                                  memory_order_release);
+        } else {
+            // being created by another thread (only once in the process)
+            while (atomic_load_explicit(&mutex->state, memory_order_acquire)
+                    != STATIC_MUTEX_INITIALIZED) {
+                SDL_Delay(1);
+            }
+        }
+    }
+
+    sc_mutex_lock(&mutex->mutex);
+}
+
+void
+sc_static_mutex_unlock(sc_static_mutex *mutex) {
+    sc_mutex_unlock(&mutex->mutex);
+}
+
 void
 sc_mutex_lock(sc_mutex *mutex) {
     // SDL mutexes are recursive, but we don't want to use recursive mutexes
@@ -169,3 +330,231 @@ sc_cond_broadcast(sc_cond *cond) {
     (void) r;
 #endif
 }
+
+// Parse a decimal integer in [min, max], ending at end
+static bool
+parse_config_int(const char *s, const char *end, long min, long max,
+                 long *out) {
+    char *endptr;
+    errno = 0;
+    long value = strtol(s, &endptr, 10);
+    if (endptr == s || endptr != end || errno == ERANGE || value < min
+            || value > max) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+// Parse a CPU list like "0-3,8"
+static bool
+parse_cpus(const char *s, const char *end, uint64_t *cpus) {
+    while (s < end) {
+        const char *comma = memchr(s, ',', end - s);
+        const char *item_end = comma ? comma : end;
+        const char *dash = memchr(s, '-', item_end - s);
+
+        long first;
+        long last;
+        if (dash) {
+            if (!parse_config_int(s, dash, 0, SC_THREAD_CONFIG_MAX_CPUS - 1,
+                                  &first)
+                    || !parse_config_int(dash + 1, item_end, first,
+                                         SC_THREAD_CONFIG_MAX_CPUS - 1,
+                                         &last)) {
+                return false;
+            }
+        } else {
+            if (!parse_config_int(s, item_end, 0,
+                                  SC_THREAD_CONFIG_MAX_CPUS - 1, &first)) {
+                return false;
+            }
+            last = first;
+        }
+
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus[cpu / 64] |= UINT64_C(1) << (cpu % 64);
+        }
+
+        s = comma ? comma + 1 : end;
+    }
+    return true;
+}
+
+static bool
+parse_attribute(const char *s, const char *end,
+                struct sc_thread_config *config) {
+    const char *eq = memchr(s, '=', end - s);
+    if (!eq) {
+        return false;
+    }
+
+    size_t key_len = eq - s;
+    const char *value = eq + 1;
+    size_t value_len = end - value;
+    long v;
+
+    if (key_len == 4 && !strncmp(s, "cpus", 4)) {
+        return value_len && parse_cpus(value, end, config->cpus);
+    }
+    if (key_len == 4 && !strncmp(s, "nice", 4)) {
+        if (!parse_config_int(value, end, -20, 19, &v)) {
+            return false;
+        }
+        config->has_nice = true;
+        config->nice = v;
+        return true;
+    }
+    if (key_len == 4 && !strncmp(s, "fifo", 4)) {
+        if (!parse_config_int(value, end, 1, 99, &v)) {
+            return false;
+        }
+        config->fifo_priority = v;
+        return true;
+    }
+    if (key_len == 4 && !strncmp(s, "name", 4)) {
+        if (!value_len || value_len >= sizeof(config->name)) {
+            return false;
+        }
+        memcpy(config->name, value, value_len);
+        config->name[value_len] = '\0';
+        return true;
+    }
+    return false;
+}
+
+static bool
+parse_role(const char *s, const char *end, struct sc_thread_config *config) {
+    memset(config, 0, sizeof(*config));
+
+    const char *colon = memchr(s, ':', end - s);
+    const char *role_end = colon ? colon : end;
+    size_t role_len = role_end - s;
+    if (!role_len || role_len >= sizeof(config->role)) {
+        LOGE("Invalid thread role: %.*s", (int) role_len, s);
+        return false;
+    }
+    memcpy(config->role, s, role_len);
+    config->role[role_len] = '\0';
+
+    while (colon) {
+        const char *attr = colon + 1;
+        colon = memchr(attr, ':', end - attr);
+        const char *attr_end = colon ? colon : end;
+        if (!parse_attribute(attr, attr_end, config)) {
+            LOGE("Invalid attribute for thread role %s: %.*s", config->role,
+                 (int) (attr_end - attr), attr);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+sc_thread_config_parse(const char *s, struct sc_thread_config *configs,
+                       unsigned *count) {
+    unsigned n = 0;
+    const char *end = s + strlen(s);
+    while (s < end) {
+        const char *semicolon = strchr(s, ';');
+        const char *role_end = semicolon ? semicolon : end;
+        if (role_end != s) {
+            if (n == SC_THREAD_CONFIG_MAX_ROLES) {
+                LOGE("Too many thread roles (max %d)",
+                     SC_THREAD_CONFIG_MAX_ROLES);
+                return false;
+            }
+            if (!parse_role(s, role_end, &configs[n])) {
+                return false;
+            }
+            ++n;
+        }
+        s = semicolon ? semicolon + 1 : end;
+    }
+
+    *count = n;
+    return true;
+}
+
+// Format the CPU set as a list of ranges (e.g. "0-3,8")
+static void
+format_cpus(const uint64_t *cpus, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    unsigned cpu = 0;
+    while (cpu < SC_THREAD_CONFIG_MAX_CPUS) {
+        if (!(cpus[cpu / 64] & (UINT64_C(1) << (cpu % 64)))) {
+            ++cpu;
+            continue;
+        }
+        unsigned last = cpu;
+        while (last + 1 < SC_THREAD_CONFIG_MAX_CPUS
+                && (cpus[(last + 1) / 64] & (UINT64_C(1) << ((last + 1) % 64)))) {
+            ++last;
+        }
+        int w = last == cpu
+              ? snprintf(&buf[len], size - len, "%s%u", len ? "," : "", cpu)
+              : snprintf(&buf[len], size - len, "%s%u-%u", len ? "," : "", cpu,
+                         last);
+        if (w < 0 || (size_t) w >= size - len) {
+            // truncated
+            return;
+        }
+        len += w;
+        cpu = last + 1;
+    }
+}
+
+static void
+log_thread_config(const struct sc_thread_config *config) {
+    char cpus[128] = "any";
+    if (has_cpus(config)) {
+        format_cpus(config->cpus, cpus, sizeof(cpus));
+    }
+
+    char nice[16] = "default";
+    if (config->has_nice) {
+        sprintf(nice, "%d", config->nice);
+    }
+
+    char fifo[16] = "no";
+    if (config->fifo_priority) {
+        sprintf(fifo, "%d", config->fifo_priority);
+    }
+
+    LOGI("Thread %s: cpus=%s nice=%s fifo=%s name=%s", config->role, cpus,
+         nice, fifo, config->name[0] ? config->name : config->role);
+}
+
+bool
+sc_thread_config_init(const char *s) {
+    if (!s) {
+        s = getenv("SCRCPY_THREAD_CONFIG");
+        if (!s) {
+            return true;
+        }
+    }
+
+    struct sc_thread_config configs[SC_THREAD_CONFIG_MAX_ROLES];
+    unsigned count;
+    if (!sc_thread_config_parse(s, configs, &count)) {
+        return false;
+    }
+
+#ifndef __linux__
+    if (count) {
+        LOGW("Thread configuration is not supported on this platform");
+    }
+#endif
+
+    sc_static_mutex_lock(&thread_config_lock);
+    memcpy(thread_configs, configs, count * sizeof(*configs));
+    thread_config_count = count;
+    sc_static_mutex_unlock(&thread_config_lock);
+
+    for (unsigned i = 0; i < count; ++i) {
+        log_thread_config(&configs[i]);
+    }
+    return true;
+}
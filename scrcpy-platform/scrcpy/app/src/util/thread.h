@@ -5,6 +5,7 @@
 
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "tick.h"
 
@@ -32,6 +33,16 @@ typedef struct sc_cond {
     SDL_cond *cond;
 } sc_cond;
 
+// A mutex for a process-wide state, statically initialized with
+// SC_STATIC_MUTEX_INIT: it is created on first use, and never destroyed
+typedef struct sc_static_mutex {
+    atomic_int state;
+    sc_mutex mutex;
+} sc_static_mutex;
+
+#define SC_STATIC_MUTEX_INIT {0}
+
+// The name also identifies the role of the thread, for its configuration
 bool
 sc_thread_create(sc_thread *thread, sc_thread_fn fn, const char *name,
                  void *userdata);
@@ -51,6 +62,12 @@ sc_mutex_lock(sc_mutex *mutex);
 void
 sc_mutex_unlock(sc_mutex *mutex);
 
+void
+sc_static_mutex_lock(sc_static_mutex *mutex);
+
+void
+sc_static_mutex_unlock(sc_static_mutex *mutex);
+
 sc_thread_id
 sc_thread_get_id(void);
 
@@ -81,4 +98,37 @@ sc_cond_signal(sc_cond *cond);
 void
 sc_cond_broadcast(sc_cond *cond);
 
+// Attributes of the threads of a role, applied by sc_thread_create()
+//
+// A role matches the threads of the same name, or whose name starts with the
+// role followed by '-' (e.g. "pool" matches "pool-0", "pool-1"…).
+//
+// Only supported on Linux.
+
+#define SC_THREAD_CONFIG_MAX_ROLES 16
+#define SC_THREAD_CONFIG_MAX_CPUS 256
+
+struct sc_thread_config {
+    char role[16];
+    char name[16]; // thread name, empty to keep the default one
+    uint64_t cpus[SC_THREAD_CONFIG_MAX_CPUS / 64]; // affinity, empty for any
+    bool has_nice;
+    int nice;
+    int fifo_priority; // SCHED_FIFO priority (1-99), 0 to keep the default
+};
+
+// Parse a configuration like "stream:cpus=0-3,8:nice=-5;recorder:nice=10":
+// roles separated by ';', each followed by its attributes separated by ':'
+// (cpus, nice, fifo and name)
+bool
+sc_thread_config_parse(const char *s, struct sc_thread_config *configs,
+                       unsigned *count);
+
+// Configure the threads created from now on, for the whole process
+//
+// If s is NULL, the environment variable SCRCPY_THREAD_CONFIG is used (if
+// set). The configuration is logged.
+bool
+sc_thread_config_init(const char *s);
+
 #endif
@@ -0,0 +1,217 @@
+#include "thread_pool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL_cpuinfo.h>
+
+#include "log.h"
+
+// the worker running on the current thread, if any
+static _Thread_local struct sc_pool_worker *current_worker;
+
+static void
+push_front(struct sc_pool_worker *worker, struct sc_pool_task *task) {
+    sc_mutex_lock(&worker->mutex);
+    task->prev = NULL;
+    task->next = worker->front;
+    if (worker->front) {
+        worker->front->prev = task;
+    } else {
+        worker->back = task;
+    }
+    worker->front = task;
+    sc_mutex_unlock(&worker->mutex);
+}
+
+static struct sc_pool_task *
+pop_front(struct sc_pool_worker *worker) {
+    sc_mutex_lock(&worker->mutex);
+    struct sc_pool_task *task = worker->front;
+    if (task) {
+        worker->front = task->next;
+        if (worker->front) {
+            worker->front->prev = NULL;
+        } else {
+            worker->back = NULL;
+        }
+        atomic_fetch_sub(&worker->pool->pending, 1);
+    }
+    sc_mutex_unlock(&worker->mutex);
+    return task;
+}
+
+static struct sc_pool_task *
+pop_back(struct sc_pool_worker *worker) {
+    sc_mutex_lock(&worker->mutex);
+    struct sc_pool_task *task = worker->back;
+    if (task) {
+        worker->back = task->prev;
+        if (worker->back) {
+            worker->back->next = NULL;
+        } else {
+            worker->front = NULL;
+        }
+        atomic_fetch_sub(&worker->pool->pending, 1);
+    }
+    sc_mutex_unlock(&worker->mutex);
+    return task;
+}
+
+static struct sc_pool_task *
+steal(struct sc_pool_worker *worker) {
+    struct sc_thread_pool *pool = worker->pool;
+    unsigned index = worker - pool->workers;
+    for (unsigned i = 1; i < pool->worker_count; ++i) {
+        struct sc_pool_worker *victim =
+            &pool->workers[(index + i) % pool->worker_count];
+        struct sc_pool_task *task = pop_back(victim);
+        if (task) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static int
+run_worker(void *data) {
+    struct sc_pool_worker *worker = data;
+    struct sc_thread_pool *pool = worker->pool;
+    current_worker = worker;
+
+    for (;;) {
+        struct sc_pool_task *task = pop_front(worker);
+        if (!task) {
+            task = steal(worker);
+        }
+        if (task) {
+            task->run(task);
+            continue;
+        }
+
+        sc_mutex_lock(&pool->mutex);
+        while (!pool->stopped && !atomic_load(&pool->pending)) {
+            sc_cond_wait(&pool->cond, &pool->mutex);
+        }
+        // on stop, execute the remaining tasks before exiting
+        bool done = pool->stopped && !atomic_load(&pool->pending);
+        sc_mutex_unlock(&pool->mutex);
+
+        if (done) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void
+sc_thread_pool_submit(struct sc_thread_pool *pool, struct sc_pool_task *task) {
+    struct sc_pool_worker *worker = current_worker;
+    if (!worker || worker->pool != pool) {
+        unsigned index = atomic_fetch_add(&pool->next_worker, 1);
+        worker = &pool->workers[index % pool->worker_count];
+    }
+
+    // count the task before it may be taken
+    atomic_fetch_add(&pool->pending, 1);
+    push_front(worker, task);
+
+    sc_mutex_lock(&pool->mutex);
+    sc_cond_signal(&pool->cond);
+    sc_mutex_unlock(&pool->mutex);
+}
+
+static void
+destroy_worker_mutexes(struct sc_thread_pool *pool, unsigned count) {
+    for (unsigned i = 0; i < count; ++i) {
+        sc_mutex_destroy(&pool->workers[i].mutex);
+    }
+}
+
+static void
+stop_workers(struct sc_thread_pool *pool, unsigned count) {
+    sc_mutex_lock(&pool->mutex);
+    pool->stopped = true;
+    sc_cond_broadcast(&pool->cond);
+    sc_mutex_unlock(&pool->mutex);
+
+    for (unsigned i = 0; i < count; ++i) {
+        sc_thread_join(&pool->workers[i].thread, NULL);
+    }
+}
+
+bool
+sc_thread_pool_init(struct sc_thread_pool *pool, unsigned worker_count) {
+    if (!worker_count) {
+        int cpus = SDL_GetCPUCount();
+        worker_count = cpus > 0 ? cpus : 1;
+    }
+
+    pool->workers = malloc(worker_count * sizeof(*pool->workers));
+    if (!pool->workers) {
+        LOGC("Could not allocate workers");
+        return false;
+    }
+
+    if (!sc_mutex_init(&pool->mutex)) {
+        goto error_free_workers;
+    }
+
+    if (!sc_cond_init(&pool->cond)) {
+        goto error_destroy_mutex;
+    }
+
+    pool->worker_count = worker_count;
+    atomic_init(&pool->next_worker, 0);
+    atomic_init(&pool->pending, 0);
+    pool->stopped = false;
+
+    // initialize all the deques before starting any worker, which may steal
+    // from the others
+    for (unsigned i = 0; i < worker_count; ++i) {
+        struct sc_pool_worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->front = NULL;
+        worker->back = NULL;
+        if (!sc_mutex_init(&worker->mutex)) {
+            destroy_worker_mutexes(pool, i);
+            goto error_destroy_cond;
+        }
+    }
+
+    for (unsigned i = 0; i < worker_count; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "pool-%u", i);
+        if (!sc_thread_create(&pool->workers[i].thread, run_worker, name,
+                              &pool->workers[i])) {
+            LOGC("Could not start pool worker");
+            stop_workers(pool, i);
+            destroy_worker_mutexes(pool, worker_count);
+            goto error_destroy_cond;
+        }
+    }
+
+    LOGD("Thread pool started with %u workers", worker_count);
+    return true;
+
+error_destroy_cond:
+    sc_cond_destroy(&pool->cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&pool->mutex);
+error_free_workers:
+    free(pool->workers);
+
+    return false;
+}
+
+void
+sc_thread_pool_destroy(struct sc_thread_pool *pool) {
+    stop_workers(pool, pool->worker_count);
+    assert(!atomic_load(&pool->pending));
+    destroy_worker_mutexes(pool, pool->worker_count);
+
+    sc_cond_destroy(&pool->cond);
+    sc_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+}
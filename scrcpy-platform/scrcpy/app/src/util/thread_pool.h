@@ -0,0 +1,60 @@
+#ifndef SC_THREAD_POOL_H
+#define SC_THREAD_POOL_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "thread.h"
+
+// A fixed set of worker threads executing the submitted tasks, to share a
+// bounded number of threads between many sessions.
+//
+// Each worker owns a deque of tasks. A task submitted from a worker is pushed
+// to the front of its own deque (it is likely to use the same data), the other
+// tasks are distributed between the workers. A worker takes its tasks from the
+// front, and when it has none left, steals the oldest task (at the back) of
+// another worker.
+//
+// The tasks are intrusive (typically embedded in the structure they process),
+// so submitting never allocates. A task must not be submitted again before it
+// is started.
+
+struct sc_pool_task {
+    void (*run)(struct sc_pool_task *task);
+    struct sc_pool_task *prev;
+    struct sc_pool_task *next;
+};
+
+struct sc_pool_worker {
+    sc_thread thread;
+    struct sc_thread_pool *pool;
+    sc_mutex mutex; // protects the deque
+    struct sc_pool_task *front;
+    struct sc_pool_task *back;
+};
+
+struct sc_thread_pool {
+    struct sc_pool_worker *workers;
+    unsigned worker_count;
+    atomic_uint next_worker; // for the tasks submitted from other threads
+
+    sc_mutex mutex;
+    sc_cond cond; // signaled when a task is submitted or on stop
+    atomic_uint pending; // tasks submitted but not taken yet
+    bool stopped;
+};
+
+// If worker_count is 0, start one worker per CPU core
+bool
+sc_thread_pool_init(struct sc_thread_pool *pool, unsigned worker_count);
+
+// Execute all the pending tasks, then join the workers
+void
+sc_thread_pool_destroy(struct sc_thread_pool *pool);
+
+void
+sc_thread_pool_submit(struct sc_thread_pool *pool, struct sc_pool_task *task);
+
+#endif
@@ -1,16 +1,31 @@
 #include "tick.h"
 
-#include <SDL2/SDL_timer.h>
+#include <assert.h>
+#ifdef _WIN32
+# include <SDL2/SDL_timer.h>
+#else
+# include <time.h>
+#endif
 
 sc_tick
 sc_tick_now(void) {
-    // SDL_GetTicks() resolution is in milliseconds, but sc_tick are expressed
-    // in microseconds to store PTS without precision loss.
-    //
-    // As an alternative, SDL_GetPerformanceCounter() and
-    // SDL_GetPerformanceFrequency() could be used, but:
-    //  - the conversions (avoiding overflow) are expansive, since the
-    //    frequency is not known at compile time;
-    //  - in practice, we don't need more precision for now.
-    return (sc_tick) SDL_GetTicks() * 1000;
+    // sc_tick are expressed in microseconds, to store PTS without precision
+    // loss and to schedule input events precisely (SDL_GetTicks() resolution
+    // is in milliseconds).
+#ifdef _WIN32
+    static uint64_t freq = 0;
+    if (!freq) {
+        freq = SDL_GetPerformanceFrequency();
+    }
+    uint64_t counter = SDL_GetPerformanceCounter();
+    // split the conversion to avoid overflow
+    return (sc_tick) (counter / freq * SC_TICK_FREQ
+                    + counter % freq * SC_TICK_FREQ / freq);
+#else
+    struct timespec ts;
+    int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+    assert(!ret);
+    (void) ret;
+    return SC_TICK_FROM_SEC((sc_tick) ts.tv_sec) + ts.tv_nsec / 1000;
+#endif
 }
@@ -1,6 +1,8 @@
 #ifndef SC_TICK_H
 #define SC_TICK_H
 
+#include "common.h"
+
 #include <stdint.h>
 
 typedef int64_t sc_tick;
@@ -0,0 +1,58 @@
+#include "triple_buffer.h"
+
+#include <assert.h>
+
+#define SC_TRIPLE_BUFFER_DIRTY 4
+#define SC_TRIPLE_BUFFER_INDEX_MASK 3
+
+void
+sc_triple_buffer_init(struct sc_triple_buffer *tb) {
+    tb->back = 0;
+    atomic_init(&tb->middle, 1);
+    tb->front = 2;
+    tb->seq = 0;
+    for (unsigned i = 0; i < 3; ++i) {
+        tb->seqs[i] = 0;
+    }
+}
+
+uint64_t
+sc_triple_buffer_publish(struct sc_triple_buffer *tb) {
+    uint64_t seq = ++tb->seq;
+    tb->seqs[tb->back] = seq;
+
+    // Sequentially consistent (not only acq_rel), so that a thread waiting
+    // for a new value may check sc_triple_buffer_has_new() after announcing
+    // itself, without missing a wakeup
+    unsigned old = atomic_exchange(&tb->middle,
+                                   tb->back | SC_TRIPLE_BUFFER_DIRTY);
+    tb->back = old & SC_TRIPLE_BUFFER_INDEX_MASK;
+    assert(tb->back < 3);
+
+    return seq;
+}
+
+bool
+sc_triple_buffer_has_new(struct sc_triple_buffer *tb) {
+    return atomic_load(&tb->middle) & SC_TRIPLE_BUFFER_DIRTY;
+}
+
+bool
+sc_triple_buffer_acquire(struct sc_triple_buffer *tb, unsigned *index,
+                         uint64_t *seq) {
+    if (!sc_triple_buffer_has_new(tb)) {
+        return false;
+    }
+
+    // only the consumer clears the flag, so the middle slot is still new
+    unsigned old = atomic_exchange(&tb->middle, tb->front);
+    assert(old & SC_TRIPLE_BUFFER_DIRTY);
+    tb->front = old & SC_TRIPLE_BUFFER_INDEX_MASK;
+    assert(tb->front < 3);
+
+    *index = tb->front;
+    if (seq) {
+        *seq = tb->seqs[tb->front];
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef SC_TRIPLE_BUFFER_H
+#define SC_TRIPLE_BUFFER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free exchange of the latest value between a single producer and a
+// single consumer, through 3 slots (allocated by the caller, indexed from 0 to
+// 2): the producer writes the back slot, the consumer reads the front slot,
+// and the middle slot holds the latest value published.
+//
+// Publishing and acquiring only swap indexes, so neither side ever waits for
+// the other. A value published while the previous one has not been acquired
+// replaces it; the sequence numbers allow the consumer to count the values it
+// missed.
+struct sc_triple_buffer {
+    // the index of the middle slot, with SC_TRIPLE_BUFFER_DIRTY if it has not
+    // been acquired yet
+    atomic_uint middle;
+
+    // accessed only by the producer
+    unsigned back;
+    uint64_t seq; // the sequence number of the last value published
+
+    // accessed only by the consumer
+    unsigned front;
+
+    // the sequence number of the value of each slot (written with the back
+    // slot, read with the front slot)
+    uint64_t seqs[3];
+};
+
+void
+sc_triple_buffer_init(struct sc_triple_buffer *tb);
+
+// Return the index of the slot to write
+static inline unsigned
+sc_triple_buffer_back(struct sc_triple_buffer *tb) {
+    return tb->back;
+}
+
+// Return the index of the slot last acquired by the consumer
+static inline unsigned
+sc_triple_buffer_front(struct sc_triple_buffer *tb) {
+    return tb->front;
+}
+
+// Publish the back slot (the producer must not access it anymore), and return
+// its sequence number (starting at 1)
+uint64_t
+sc_triple_buffer_publish(struct sc_triple_buffer *tb);
+
+// Indicate whether a value has been published since the last acquire (from
+// any thread)
+bool
+sc_triple_buffer_has_new(struct sc_triple_buffer *tb);
+
+// Take the latest value published, if it has not been acquired yet
+//
+// On success, the front slot (whose index is written to index) belongs to the
+// consumer until the next acquire. Return false if there is no new value.
+bool
+sc_triple_buffer_acquire(struct sc_triple_buffer *tb, unsigned *index,
+                         uint64_t *seq);
+
+#endif
@@ -0,0 +1,418 @@
+#include "yuv.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#elif defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
+size_t
+sc_yuv_image_size(enum sc_yuv_format format, unsigned width, unsigned height) {
+    assert(!(width & 1) && !(height & 1));
+    size_t luma = (size_t) width * height;
+    switch (format) {
+        case SC_YUV_FORMAT_I420:
+        case SC_YUV_FORMAT_NV12:
+            return luma + luma / 2;
+        case SC_YUV_FORMAT_YUYV:
+            return luma * 2;
+        default:
+            assert(!"unexpected format");
+            return 0;
+    }
+}
+
+void
+sc_yuv_interleave(const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                  size_t len) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= len; i += 16) {
+        __m128i mu = _mm_loadu_si128((const __m128i *) &u[i]);
+        __m128i mv = _mm_loadu_si128((const __m128i *) &v[i]);
+        _mm_storeu_si128((__m128i *) &dst[2 * i], _mm_unpacklo_epi8(mu, mv));
+        _mm_storeu_si128((__m128i *) &dst[2 * i + 16],
+                         _mm_unpackhi_epi8(mu, mv));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16x2_t uv = {{vld1q_u8(&u[i]), vld1q_u8(&v[i])}};
+        vst2q_u8(&dst[2 * i], uv);
+    }
+#endif
+    // remaining bytes
+    for (; i < len; ++i) {
+        dst[2 * i] = u[i];
+        dst[2 * i + 1] = v[i];
+    }
+}
+
+void
+sc_yuv_pack_yuyv_line(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                      uint8_t *dst, size_t width) {
+    assert(!(width & 1));
+
+    // YUYV is the interleaving of Y with the interleaved U and V:
+    //   Y0 U0 Y1 V0 Y2 U1 Y3 V1...
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= width; i += 16) {
+        __m128i mu = _mm_loadl_epi64((const __m128i *) &u[i / 2]);
+        __m128i mv = _mm_loadl_epi64((const __m128i *) &v[i / 2]);
+        __m128i uv = _mm_unpacklo_epi8(mu, mv);
+        __m128i my = _mm_loadu_si128((const __m128i *) &y[i]);
+        _mm_storeu_si128((__m128i *) &dst[2 * i], _mm_unpacklo_epi8(my, uv));
+        _mm_storeu_si128((__m128i *) &dst[2 * i + 16],
+                         _mm_unpackhi_epi8(my, uv));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= width; i += 16) {
+        uint8x8x2_t uv = vzip_u8(vld1_u8(&u[i / 2]), vld1_u8(&v[i / 2]));
+        uint8x16x2_t yuv = {{vld1q_u8(&y[i]), vcombine_u8(uv.val[0],
+                                                           uv.val[1])}};
+        vst2q_u8(&dst[2 * i], yuv);
+    }
+#endif
+    // remaining pixels
+    for (; i < width; i += 2) {
+        dst[2 * i] = y[i];
+        dst[2 * i + 1] = u[i / 2];
+        dst[2 * i + 2] = y[i + 1];
+        dst[2 * i + 3] = v[i / 2];
+    }
+}
+
+static uint8_t *
+copy_plane(const uint8_t *src, int linesize, unsigned width, unsigned height,
+           uint8_t *dst) {
+    if ((unsigned) linesize == width) {
+        // no padding, copy the plane at once
+        size_t size = (size_t) width * height;
+        memcpy(dst, src, size);
+        return dst + size;
+    }
+
+    for (unsigned i = 0; i < height; ++i) {
+        memcpy(dst, src, width);
+        src += linesize;
+        dst += width;
+    }
+    return dst;
+}
+
+void
+sc_yuv_convert(enum sc_yuv_format format, const struct sc_yuv_image *src,
+               uint8_t *dst) {
+    unsigned w = src->width;
+    unsigned h = src->height;
+    assert(!(w & 1) && !(h & 1));
+
+    switch (format) {
+        case SC_YUV_FORMAT_I420:
+            dst = copy_plane(src->data[0], src->linesize[0], w, h, dst);
+            dst = copy_plane(src->data[1], src->linesize[1], w / 2, h / 2,
+                             dst);
+            copy_plane(src->data[2], src->linesize[2], w / 2, h / 2, dst);
+            break;
+        case SC_YUV_FORMAT_NV12: {
+            dst = copy_plane(src->data[0], src->linesize[0], w, h, dst);
+            const uint8_t *u = src->data[1];
+            const uint8_t *v = src->data[2];
+            for (unsigned i = 0; i < h / 2; ++i) {
+                sc_yuv_interleave(u, v, dst, w / 2);
+                u += src->linesize[1];
+                v += src->linesize[2];
+                dst += w;
+            }
+            break;
+        }
+        case SC_YUV_FORMAT_YUYV: {
+            const uint8_t *y = src->data[0];
+            for (unsigned i = 0; i < h; ++i) {
+                // each chroma line is used for 2 luma lines
+                const uint8_t *u = src->data[1] + (i / 2) * src->linesize[1];
+                const uint8_t *v = src->data[2] + (i / 2) * src->linesize[2];
+                sc_yuv_pack_yuyv_line(y, u, v, dst, w);
+                y += src->linesize[0];
+                dst += 2 * w;
+            }
+            break;
+        }
+        default:
+            assert(!"unexpected format");
+    }
+}
+
+unsigned
+sc_rgb_format_bpp(enum sc_rgb_format format) {
+    return format == SC_RGB_FORMAT_BGR24 ? 3 : 4;
+}
+
+// BT.601 limited range coefficients, in 10.6 fixed point (so that the
+// intermediate values fit in 16 bits, for the vectorized loops)
+//
+// The luma coefficient is 74.5 (1.164), computed as 74 * y + y / 2.
+#define RGB_Y 74
+#define RGB_RV 102 // 1.596
+#define RGB_GU 25 // 0.391
+#define RGB_GV 52 // 0.813
+#define RGB_BU 129 // 2.018
+
+static inline uint8_t
+clamp_rgb(int value) {
+    value >>= 6;
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// Write one pixel (the same computation as the vectorized loops)
+static inline void
+write_rgb(enum sc_rgb_format format, uint8_t y, uint8_t u, uint8_t v,
+          uint8_t *dst) {
+    int yy = RGB_Y * (y - 16) + ((y - 16) >> 1) + 32;
+    int cu = u - 128;
+    int cv = v - 128;
+    uint8_t r = clamp_rgb(yy + RGB_RV * cv);
+    uint8_t g = clamp_rgb(yy - RGB_GU * cu - RGB_GV * cv);
+    uint8_t b = clamp_rgb(yy + RGB_BU * cu);
+    switch (format) {
+        case SC_RGB_FORMAT_BGR24:
+            dst[0] = b;
+            dst[1] = g;
+            dst[2] = r;
+            break;
+        case SC_RGB_FORMAT_RGBA:
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            dst[3] = 0xFF;
+            break;
+        default:
+            dst[0] = b;
+            dst[1] = g;
+            dst[2] = r;
+            dst[3] = 0xFF;
+    }
+}
+
+#ifdef __SSE2__
+// Compute 8 channel values (before the final shift) from 16-bit values
+static inline void
+rgb_sse2(__m128i y, __m128i u, __m128i v, __m128i *r, __m128i *g,
+         __m128i *b) {
+    y = _mm_sub_epi16(y, _mm_set1_epi16(16));
+    __m128i yy = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(y, _mm_set1_epi16(RGB_Y)),
+                          _mm_srai_epi16(y, 1)),
+            _mm_set1_epi16(32));
+    u = _mm_sub_epi16(u, _mm_set1_epi16(128));
+    v = _mm_sub_epi16(v, _mm_set1_epi16(128));
+    // saturated values are out of range anyway, so clamped correctly
+    *r = _mm_srai_epi16(
+            _mm_adds_epi16(yy, _mm_mullo_epi16(v, _mm_set1_epi16(RGB_RV))),
+            6);
+    *g = _mm_srai_epi16(
+            _mm_subs_epi16(
+                _mm_subs_epi16(yy,
+                               _mm_mullo_epi16(u, _mm_set1_epi16(RGB_GU))),
+                _mm_mullo_epi16(v, _mm_set1_epi16(RGB_GV))),
+            6);
+    *b = _mm_srai_epi16(
+            _mm_adds_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(RGB_BU))),
+            6);
+}
+
+// Write 16 pixels of 4 bytes, from 16 values of each channel
+static inline void
+store_4_sse2(__m128i c0, __m128i c1, __m128i c2, __m128i c3, uint8_t *dst) {
+    __m128i c01_lo = _mm_unpacklo_epi8(c0, c1);
+    __m128i c01_hi = _mm_unpackhi_epi8(c0, c1);
+    __m128i c23_lo = _mm_unpacklo_epi8(c2, c3);
+    __m128i c23_hi = _mm_unpackhi_epi8(c2, c3);
+    _mm_storeu_si128((__m128i *) &dst[0], _mm_unpacklo_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i *) &dst[16],
+                     _mm_unpackhi_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i *) &dst[32],
+                     _mm_unpacklo_epi16(c01_hi, c23_hi));
+    _mm_storeu_si128((__m128i *) &dst[48],
+                     _mm_unpackhi_epi16(c01_hi, c23_hi));
+}
+#endif
+
+void
+sc_yuv_to_rgb_line(enum sc_rgb_format format, const uint8_t *y,
+                   const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                   size_t width) {
+    unsigned bpp = sc_rgb_format_bpp(format);
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= width; i += 16) {
+        __m128i my = _mm_loadu_si128((const __m128i *) &y[i]);
+        __m128i mu = _mm_loadl_epi64((const __m128i *) &u[i / 2]);
+        __m128i mv = _mm_loadl_epi64((const __m128i *) &v[i / 2]);
+        // each chroma sample is shared by 2 pixels
+        mu = _mm_unpacklo_epi8(mu, mu);
+        mv = _mm_unpacklo_epi8(mv, mv);
+
+        __m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+        rgb_sse2(_mm_unpacklo_epi8(my, zero), _mm_unpacklo_epi8(mu, zero),
+                 _mm_unpacklo_epi8(mv, zero), &r_lo, &g_lo, &b_lo);
+        rgb_sse2(_mm_unpackhi_epi8(my, zero), _mm_unpackhi_epi8(mu, zero),
+                 _mm_unpackhi_epi8(mv, zero), &r_hi, &g_hi, &b_hi);
+        __m128i r = _mm_packus_epi16(r_lo, r_hi);
+        __m128i g = _mm_packus_epi16(g_lo, g_hi);
+        __m128i b = _mm_packus_epi16(b_lo, b_hi);
+
+        uint8_t *out = &dst[bpp * i];
+        if (format == SC_RGB_FORMAT_RGBA) {
+            store_4_sse2(r, g, b, _mm_set1_epi8(-1), out);
+        } else if (format == SC_RGB_FORMAT_BGRA) {
+            store_4_sse2(b, g, r, _mm_set1_epi8(-1), out);
+        } else {
+            // SSE2 has no byte shuffle, interleave the 3 channels in scalar
+            uint8_t rs[16], gs[16], bs[16];
+            _mm_storeu_si128((__m128i *) rs, r);
+            _mm_storeu_si128((__m128i *) gs, g);
+            _mm_storeu_si128((__m128i *) bs, b);
+            for (unsigned j = 0; j < 16; ++j) {
+                out[3 * j] = bs[j];
+                out[3 * j + 1] = gs[j];
+                out[3 * j + 2] = rs[j];
+            }
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= width; i += 16) {
+        uint8x16_t my = vld1q_u8(&y[i]);
+        // each chroma sample is shared by 2 pixels
+        uint8x8x2_t mu = vzip_u8(vld1_u8(&u[i / 2]), vld1_u8(&u[i / 2]));
+        uint8x8x2_t mv = vzip_u8(vld1_u8(&v[i / 2]), vld1_u8(&v[i / 2]));
+
+        uint8x8_t rgb[3][2]; // r, g, b for the low and high halves
+        for (unsigned h = 0; h < 2; ++h) {
+            uint8x8_t y8 = h ? vget_high_u8(my) : vget_low_u8(my);
+            int16x8_t y16 = vreinterpretq_s16_u16(vmovl_u8(y8));
+            int16x8_t u16 = vreinterpretq_s16_u16(vmovl_u8(mu.val[h]));
+            int16x8_t v16 = vreinterpretq_s16_u16(vmovl_u8(mv.val[h]));
+            y16 = vsubq_s16(y16, vdupq_n_s16(16));
+            int16x8_t yy = vaddq_s16(
+                    vaddq_s16(vmulq_n_s16(y16, RGB_Y), vshrq_n_s16(y16, 1)),
+                    vdupq_n_s16(32));
+            u16 = vsubq_s16(u16, vdupq_n_s16(128));
+            v16 = vsubq_s16(v16, vdupq_n_s16(128));
+            int16x8_t r = vqaddq_s16(yy, vmulq_n_s16(v16, RGB_RV));
+            int16x8_t g = vqsubq_s16(vqsubq_s16(yy, vmulq_n_s16(u16, RGB_GU)),
+                                     vmulq_n_s16(v16, RGB_GV));
+            int16x8_t b = vqaddq_s16(yy, vmulq_n_s16(u16, RGB_BU));
+            rgb[0][h] = vqshrun_n_s16(r, 6);
+            rgb[1][h] = vqshrun_n_s16(g, 6);
+            rgb[2][h] = vqshrun_n_s16(b, 6);
+        }
+        uint8x16_t r = vcombine_u8(rgb[0][0], rgb[0][1]);
+        uint8x16_t g = vcombine_u8(rgb[1][0], rgb[1][1]);
+        uint8x16_t b = vcombine_u8(rgb[2][0], rgb[2][1]);
+
+        uint8_t *out = &dst[bpp * i];
+        if (format == SC_RGB_FORMAT_RGBA) {
+            uint8x16x4_t px = {{r, g, b, vdupq_n_u8(0xFF)}};
+            vst4q_u8(out, px);
+        } else if (format == SC_RGB_FORMAT_BGRA) {
+            uint8x16x4_t px = {{b, g, r, vdupq_n_u8(0xFF)}};
+            vst4q_u8(out, px);
+        } else {
+            uint8x16x3_t px = {{b, g, r}};
+            vst3q_u8(out, px);
+        }
+    }
+#endif
+    // remaining pixels
+    for (; i < width; ++i) {
+        write_rgb(format, y[i], u[i / 2], v[i / 2], &dst[bpp * i]);
+    }
+}
+
+bool
+sc_yuv_scaler_init(struct sc_yuv_scaler *scaler, enum sc_rgb_format format,
+                   unsigned width, unsigned height) {
+    assert(width && height);
+
+    scaler->xmap = malloc(width * sizeof(*scaler->xmap));
+    if (!scaler->xmap) {
+        return false;
+    }
+
+    // y, then u and v (one sample per 2 pixels)
+    scaler->line = malloc(width + 2 * (width / 2 + 1));
+    if (!scaler->line) {
+        free(scaler->xmap);
+        return false;
+    }
+
+    scaler->format = format;
+    scaler->width = width;
+    scaler->height = height;
+    scaler->src_width = 0;
+    return true;
+}
+
+void
+sc_yuv_scaler_destroy(struct sc_yuv_scaler *scaler) {
+    free(scaler->line);
+    free(scaler->xmap);
+}
+
+// Return the source index of the center of the destination index i
+static inline unsigned
+map_index(unsigned i, unsigned src_len, unsigned dst_len) {
+    return ((uint64_t) 2 * i + 1) * src_len / (2 * dst_len);
+}
+
+void
+sc_yuv_scale_to_rgb(struct sc_yuv_scaler *scaler,
+                    const struct sc_yuv_image *src, uint8_t *dst,
+                    size_t stride) {
+    unsigned w = scaler->width;
+    unsigned h = scaler->height;
+    // no horizontal scaling: convert the source lines directly
+    bool same_width = src->width == w;
+
+    if (!same_width && scaler->src_width != src->width) {
+        // the source size changes on device rotation
+        for (unsigned i = 0; i < w; ++i) {
+            scaler->xmap[i] = map_index(i, src->width, w);
+        }
+        scaler->src_width = src->width;
+    }
+
+    uint8_t *ly = scaler->line;
+    uint8_t *lu = ly + w;
+    uint8_t *lv = lu + w / 2 + 1;
+
+    for (unsigned i = 0; i < h; ++i) {
+        unsigned sy = h == src->height ? i : map_index(i, src->height, h);
+        const uint8_t *y = src->data[0] + (size_t) sy * src->linesize[0];
+        const uint8_t *u = src->data[1] + (size_t) (sy / 2) * src->linesize[1];
+        const uint8_t *v = src->data[2] + (size_t) (sy / 2) * src->linesize[2];
+
+        if (!same_width) {
+            const unsigned *xmap = scaler->xmap;
+            for (unsigned j = 0; j < w; ++j) {
+                ly[j] = y[xmap[j]];
+            }
+            // the 2 pixels of a pair share the chroma of the first one
+            for (unsigned j = 0; j < w; j += 2) {
+                lu[j / 2] = u[xmap[j] / 2];
+                lv[j / 2] = v[xmap[j] / 2];
+            }
+            y = ly;
+            u = lu;
+            v = lv;
+        }
+
+        sc_yuv_to_rgb_line(scaler->format, y, u, v, dst, w);
+        dst += stride;
+    }
+}
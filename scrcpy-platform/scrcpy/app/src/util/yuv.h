@@ -0,0 +1,92 @@
+#ifndef SC_YUV_H
+#define SC_YUV_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Packed output formats of a YUV 4:2:0 planar image
+enum sc_yuv_format {
+    SC_YUV_FORMAT_I420, // planar Y, U, V (same as YUV420P, without padding)
+    SC_YUV_FORMAT_NV12, // planar Y, interleaved UV
+    SC_YUV_FORMAT_YUYV, // packed 4:2:2 (chroma lines are duplicated)
+};
+
+// A YUV 4:2:0 planar source image (typically the planes of an AVFrame)
+struct sc_yuv_image {
+    const uint8_t *data[3];
+    int linesize[3];
+    unsigned width;
+    unsigned height;
+};
+
+// Return the size of a packed image in the given format
+//
+// The width and height must be even.
+size_t
+sc_yuv_image_size(enum sc_yuv_format format, unsigned width, unsigned height);
+
+// Write the image to dst, which must be at least sc_yuv_image_size() bytes
+void
+sc_yuv_convert(enum sc_yuv_format format, const struct sc_yuv_image *src,
+               uint8_t *dst);
+
+// Interleave u and v: dst = u[0] v[0] u[1] v[1]...
+void
+sc_yuv_interleave(const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                  size_t len);
+
+// Write one YUYV line from one luma line and its chroma lines
+void
+sc_yuv_pack_yuyv_line(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                      uint8_t *dst, size_t width);
+
+// Packed RGB output formats
+enum sc_rgb_format {
+    SC_RGB_FORMAT_BGR24, // e.g. Java BufferedImage.TYPE_3BYTE_BGR
+    SC_RGB_FORMAT_RGBA,
+    SC_RGB_FORMAT_BGRA, // e.g. Java BufferedImage.TYPE_INT_ARGB
+};
+
+// Return the number of bytes per pixel
+unsigned
+sc_rgb_format_bpp(enum sc_rgb_format format);
+
+// Write one RGB line from one luma line and its chroma lines (BT.601, limited
+// range, as encoded by the device)
+void
+sc_yuv_to_rgb_line(enum sc_rgb_format format, const uint8_t *y,
+                   const uint8_t *u, const uint8_t *v, uint8_t *dst,
+                   size_t width);
+
+// Convert and scale (nearest neighbor) images to a fixed RGB size
+//
+// The scaling is done by sampling the source lines before the conversion, so
+// the conversion cost depends only on the destination size.
+struct sc_yuv_scaler {
+    enum sc_rgb_format format;
+    unsigned width;
+    unsigned height;
+
+    unsigned src_width; // for which xmap is computed, 0 if none
+    unsigned *xmap; // source column of each destination column
+    uint8_t *line; // sampled y, u and v of one destination line
+};
+
+bool
+sc_yuv_scaler_init(struct sc_yuv_scaler *scaler, enum sc_rgb_format format,
+                   unsigned width, unsigned height);
+
+void
+sc_yuv_scaler_destroy(struct sc_yuv_scaler *scaler);
+
+// Write the image to dst, whose lines are stride bytes apart (at least
+// width * sc_rgb_format_bpp())
+void
+sc_yuv_scale_to_rgb(struct sc_yuv_scaler *scaler,
+                    const struct sc_yuv_image *src, uint8_t *dst,
+                    size_t stride);
+
+#endif
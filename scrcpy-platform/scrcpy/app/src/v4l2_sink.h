@@ -4,37 +4,37 @@
 #include "common.h"
 
 #include "coords.h"
+#include "scrcpy.h"
 #include "trait/frame_sink.h"
+#include "v4l2_writer.h"
 #include "video_buffer.h"
 #include "util/tick.h"
-
-#include <libavformat/avformat.h>
+#include "util/yuv.h"
 
 struct sc_v4l2_sink {
     struct sc_frame_sink frame_sink; // frame sink trait
 
     struct sc_video_buffer vb;
-    AVFormatContext *format_ctx;
-    AVCodecContext *encoder_ctx;
+    struct sc_v4l2_writer writer;
 
     char *device_name;
     struct size frame_size;
     sc_tick buffering_time;
+    enum sc_yuv_format format;
 
     sc_thread thread;
     sc_mutex mutex;
     sc_cond cond;
     bool has_frame;
     bool stopped;
-    bool header_written;
 
     AVFrame *frame;
-    AVPacket *packet;
 };
 
 bool
 sc_v4l2_sink_init(struct sc_v4l2_sink *vs, const char *device_name,
-                  struct size frame_size, sc_tick buffering_time);
+                  struct size frame_size, sc_tick buffering_time,
+                  enum sc_v4l2_format format);
 
 void
 sc_v4l2_sink_destroy(struct sc_v4l2_sink *vs);
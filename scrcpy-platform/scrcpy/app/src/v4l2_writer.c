@@ -0,0 +1,274 @@
+#include "v4l2_writer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util/log.h"
+
+static int
+xioctl(int fd, unsigned long request, void *arg) {
+    int r;
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static bool
+write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        ssize_t w = write(fd, buf, len);
+        if (w == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += w;
+        len -= w;
+    }
+    return true;
+}
+
+static uint32_t
+get_pixelformat(enum sc_yuv_format format) {
+    switch (format) {
+        case SC_YUV_FORMAT_I420: return V4L2_PIX_FMT_YUV420;
+        case SC_YUV_FORMAT_NV12: return V4L2_PIX_FMT_NV12;
+        case SC_YUV_FORMAT_YUYV: return V4L2_PIX_FMT_YUYV;
+        default:
+            assert(!"unexpected format");
+            return 0;
+    }
+}
+
+static bool
+set_format(struct sc_v4l2_writer *writer) {
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    fmt.fmt.pix.width = writer->width;
+    fmt.fmt.pix.height = writer->height;
+    fmt.fmt.pix.pixelformat = get_pixelformat(writer->format);
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    fmt.fmt.pix.bytesperline = writer->format == SC_YUV_FORMAT_YUYV
+                             ? 2 * writer->width
+                             : writer->width;
+    fmt.fmt.pix.sizeimage = writer->frame_size;
+    fmt.fmt.pix.colorspace = V4L2_COLORSPACE_SMPTE170M;
+
+    if (xioctl(writer->fd, VIDIOC_S_FMT, &fmt) == -1) {
+        LOGE("Could not set v4l2 format: %s", strerror(errno));
+        return false;
+    }
+
+    if (fmt.fmt.pix.width != writer->width
+            || fmt.fmt.pix.height != writer->height
+            || fmt.fmt.pix.pixelformat != get_pixelformat(writer->format)) {
+        LOGE("v4l2 format not supported by the device (%ux%u)",
+             fmt.fmt.pix.width, fmt.fmt.pix.height);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+release_buffers(struct sc_v4l2_writer *writer) {
+    for (unsigned i = 0; i < writer->buffer_count; ++i) {
+        munmap(writer->buffers[i].start, writer->buffers[i].length);
+    }
+    writer->buffer_count = 0;
+
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_MMAP;
+    xioctl(writer->fd, VIDIOC_REQBUFS, &req); // ignore failure
+}
+
+// Return false if streaming I/O is not available (not an error, write() will
+// be used instead)
+static bool
+request_buffers(struct sc_v4l2_writer *writer) {
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = SC_V4L2_WRITER_BUFFERS;
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(writer->fd, VIDIOC_REQBUFS, &req) == -1) {
+        LOGD("v4l2 streaming I/O not supported: %s", strerror(errno));
+        return false;
+    }
+
+    if (req.count < SC_V4L2_WRITER_BUFFERS) {
+        LOGD("Not enough v4l2 buffers: %u", req.count);
+        release_buffers(writer);
+        return false;
+    }
+
+    for (unsigned i = 0; i < SC_V4L2_WRITER_BUFFERS; ++i) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(writer->fd, VIDIOC_QUERYBUF, &buf) == -1
+                || buf.length < writer->frame_size) {
+            LOGD("Could not query v4l2 buffer %u", i);
+            release_buffers(writer);
+            return false;
+        }
+
+        void *start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, writer->fd, buf.m.offset);
+        if (start == MAP_FAILED) {
+            LOGD("Could not mmap v4l2 buffer %u", i);
+            release_buffers(writer);
+            return false;
+        }
+
+        writer->buffers[i].start = start;
+        writer->buffers[i].length = buf.length;
+        writer->buffer_count = i + 1;
+    }
+
+    return true;
+}
+
+bool
+sc_v4l2_writer_open(struct sc_v4l2_writer *writer, const char *path,
+                    enum sc_yuv_format format, unsigned width,
+                    unsigned height) {
+    writer->format = format;
+    writer->width = width;
+    writer->height = height;
+    writer->frame_size = sc_yuv_image_size(format, width, height);
+    writer->buffer = NULL;
+    writer->buffer_count = 0;
+    writer->queued = 0;
+    writer->streaming = false;
+
+    struct stat st;
+    writer->device = !stat(path, &st) && S_ISCHR(st.st_mode);
+
+    if (writer->device) {
+        // O_RDWR is required to mmap the buffers
+        writer->fd = open(path, O_RDWR);
+    } else {
+        writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (writer->fd == -1) {
+        LOGE("Could not open v4l2 output %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    if (writer->device) {
+        if (!set_format(writer)) {
+            goto error_close;
+        }
+
+        if (request_buffers(writer)) {
+            LOGD("v4l2 streaming I/O enabled");
+            return true;
+        }
+    }
+
+    writer->buffer = malloc(writer->frame_size);
+    if (!writer->buffer) {
+        LOGC("Could not allocate v4l2 buffer");
+        goto error_close;
+    }
+
+    return true;
+
+error_close:
+    close(writer->fd);
+
+    return false;
+}
+
+static bool
+write_streaming(struct sc_v4l2_writer *writer,
+                const struct sc_yuv_image *image) {
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    buf.memory = V4L2_MEMORY_MMAP;
+
+    if (writer->queued < writer->buffer_count) {
+        // this buffer has never been queued
+        buf.index = writer->queued++;
+    } else if (xioctl(writer->fd, VIDIOC_DQBUF, &buf) == -1) {
+        LOGE("Could not dequeue v4l2 buffer: %s", strerror(errno));
+        return false;
+    }
+
+    assert(buf.index < writer->buffer_count);
+
+    // convert directly into the device buffer
+    sc_yuv_convert(writer->format, image, writer->buffers[buf.index].start);
+
+    buf.bytesused = writer->frame_size;
+    buf.field = V4L2_FIELD_NONE;
+
+    if (xioctl(writer->fd, VIDIOC_QBUF, &buf) == -1) {
+        LOGE("Could not queue v4l2 buffer: %s", strerror(errno));
+        return false;
+    }
+
+    if (!writer->streaming) {
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        if (xioctl(writer->fd, VIDIOC_STREAMON, &type) == -1) {
+            LOGE("Could not start v4l2 streaming: %s", strerror(errno));
+            return false;
+        }
+        writer->streaming = true;
+    }
+
+    return true;
+}
+
+bool
+sc_v4l2_writer_write(struct sc_v4l2_writer *writer,
+                     const struct sc_yuv_image *image) {
+    assert(image->width == writer->width);
+    assert(image->height == writer->height);
+
+    if (writer->buffer_count) {
+        return write_streaming(writer, image);
+    }
+
+    // a v4l2 device expects a whole frame per write()
+    sc_yuv_convert(writer->format, image, writer->buffer);
+    if (!write_all(writer->fd, writer->buffer, writer->frame_size)) {
+        LOGE("Could not write v4l2 frame: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_v4l2_writer_close(struct sc_v4l2_writer *writer) {
+    if (writer->streaming) {
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        xioctl(writer->fd, VIDIOC_STREAMOFF, &type); // ignore failure
+    }
+    if (writer->buffer_count) {
+        release_buffers(writer);
+    }
+    free(writer->buffer);
+    close(writer->fd);
+}
@@ -0,0 +1,56 @@
+#ifndef SC_V4L2_WRITER_H
+#define SC_V4L2_WRITER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/yuv.h"
+
+#define SC_V4L2_WRITER_BUFFERS 2
+
+// Write raw frames to a V4L2 output device (typically v4l2loopback), without
+// any encoder or muxer.
+//
+// The format is negotiated with VIDIOC_S_FMT. If the device supports
+// streaming I/O, frames are converted directly into mmap'd buffers; otherwise,
+// they are written with write().
+//
+// If the path is not a character device (e.g. a regular file), no ioctl is
+// called and the frames are just written one after the other.
+struct sc_v4l2_writer {
+    int fd;
+    bool device; // false for a regular file (or a FIFO)
+    enum sc_yuv_format format;
+    unsigned width;
+    unsigned height;
+    size_t frame_size;
+
+    // write() mode (if buffer_count == 0)
+    uint8_t *buffer;
+
+    // streaming I/O mode
+    struct {
+        uint8_t *start;
+        size_t length;
+    } buffers[SC_V4L2_WRITER_BUFFERS];
+    unsigned buffer_count;
+    unsigned queued; // number of buffers queued at least once
+    bool streaming; // set once VIDIOC_STREAMON succeeded
+};
+
+bool
+sc_v4l2_writer_open(struct sc_v4l2_writer *writer, const char *path,
+                    enum sc_yuv_format format, unsigned width,
+                    unsigned height);
+
+bool
+sc_v4l2_writer_write(struct sc_v4l2_writer *writer,
+                     const struct sc_yuv_image *image);
+
+void
+sc_v4l2_writer_close(struct sc_v4l2_writer *writer);
+
+#endif
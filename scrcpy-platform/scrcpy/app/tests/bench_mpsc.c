@@ -0,0 +1,148 @@
+// Producer contention benchmark: sc_mpsc vs a mutex-protected cbuf (the
+// previous implementation of the controller queue).
+//
+// Not run as a test, execute it manually:
+//     ./bench_mpsc
+#include "common.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "util/cbuf.h"
+#include "util/mpsc.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+#define ITEMS_PER_PRODUCER 200000
+#define CAPACITY 64
+
+struct item {
+    uint64_t value[4]; // about the size of a control_msg
+};
+
+struct item_queue CBUF(struct item, CAPACITY);
+
+struct locked_queue {
+    sc_mutex mutex;
+    sc_cond not_empty;
+    sc_cond not_full;
+    struct item_queue queue;
+};
+
+struct bench {
+    struct sc_mpsc mpsc;
+    struct locked_queue locked;
+    bool use_mpsc;
+};
+
+static void locked_push(struct locked_queue *lq, const struct item *item) {
+    sc_mutex_lock(&lq->mutex);
+    while (cbuf_is_full(&lq->queue)) {
+        sc_cond_wait(&lq->not_full, &lq->mutex);
+    }
+    bool was_empty = cbuf_is_empty(&lq->queue);
+    cbuf_push(&lq->queue, *item);
+    if (was_empty) {
+        sc_cond_signal(&lq->not_empty);
+    }
+    sc_mutex_unlock(&lq->mutex);
+}
+
+static void locked_take(struct locked_queue *lq, struct item *item) {
+    sc_mutex_lock(&lq->mutex);
+    while (cbuf_is_empty(&lq->queue)) {
+        sc_cond_wait(&lq->not_empty, &lq->mutex);
+    }
+    bool was_full = cbuf_is_full(&lq->queue);
+    cbuf_take(&lq->queue, item);
+    if (was_full) {
+        sc_cond_broadcast(&lq->not_full);
+    }
+    sc_mutex_unlock(&lq->mutex);
+}
+
+static int run_producer(void *data) {
+    struct bench *bench = data;
+    struct item item = {{0}};
+    for (unsigned i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        item.value[0] = i;
+        if (bench->use_mpsc) {
+            bool ok = sc_mpsc_push(&bench->mpsc, &item);
+            assert(ok);
+            (void) ok;
+        } else {
+            locked_push(&bench->locked, &item);
+        }
+    }
+    return 0;
+}
+
+static sc_tick run(struct bench *bench, unsigned producers) {
+    sc_thread threads[16];
+    assert(producers <= ARRAY_LEN(threads));
+
+    sc_tick start = sc_tick_now();
+    for (unsigned i = 0; i < producers; ++i) {
+        bool ok = sc_thread_create(&threads[i], run_producer, "producer",
+                                   bench);
+        assert(ok);
+        (void) ok;
+    }
+
+    struct item item;
+    for (unsigned i = 0; i < producers * ITEMS_PER_PRODUCER; ++i) {
+        if (bench->use_mpsc) {
+            bool ok = sc_mpsc_take_wait(&bench->mpsc, &item);
+            assert(ok);
+            (void) ok;
+        } else {
+            locked_take(&bench->locked, &item);
+        }
+    }
+
+    for (unsigned i = 0; i < producers; ++i) {
+        sc_thread_join(&threads[i], NULL);
+    }
+    return sc_tick_now() - start;
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    struct bench bench;
+    bool ok = sc_mpsc_init(&bench.mpsc, sizeof(struct item), CAPACITY,
+                           SC_MPSC_OVERFLOW_BLOCK);
+    assert(ok);
+    ok = sc_mutex_init(&bench.locked.mutex);
+    assert(ok);
+    ok = sc_cond_init(&bench.locked.not_empty);
+    assert(ok);
+    ok = sc_cond_init(&bench.locked.not_full);
+    assert(ok);
+    (void) ok;
+    cbuf_init(&bench.locked.queue);
+
+    printf("producers   mutex+cbuf (ns/item)   mpsc (ns/item)\n");
+    static const unsigned counts[] = {1, 2, 4, 8};
+    for (unsigned i = 0; i < ARRAY_LEN(counts); ++i) {
+        unsigned producers = counts[i];
+        uint64_t items = (uint64_t) producers * ITEMS_PER_PRODUCER;
+
+        bench.use_mpsc = false;
+        sc_tick locked = run(&bench, producers);
+        bench.use_mpsc = true;
+        sc_tick mpsc = run(&bench, producers);
+
+        printf("%9u   %20.1f   %14.1f\n", producers,
+               SC_TICK_TO_US(locked) * 1000.0 / items,
+               SC_TICK_TO_US(mpsc) * 1000.0 / items);
+    }
+
+    sc_cond_destroy(&bench.locked.not_full);
+    sc_cond_destroy(&bench.locked.not_empty);
+    sc_mutex_destroy(&bench.locked.mutex);
+    sc_mpsc_destroy(&bench.mpsc);
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "adb_client.h"
+#include "util/buffer_util.h"
+#include "util/thread.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+// A stand-in adb server, handling the connections one by one, following a
+// script for each test
+struct fake_adb {
+    socket_t server_socket;
+    sc_thread thread;
+    void (*handle)(socket_t socket);
+    unsigned connections;
+};
+
+static void
+expect_request(socket_t socket, const char *expected) {
+    char buf[1024];
+    ssize_t r = net_recv_all(socket, buf, 4);
+    assert(r == 4);
+    buf[4] = '\0';
+    size_t len = strtoul(buf, NULL, 16);
+    assert(len == strlen(expected));
+    r = net_recv_all(socket, buf, len);
+    assert(r == (ssize_t) len);
+    buf[len] = '\0';
+    assert(!strcmp(buf, expected));
+}
+
+static void
+send_raw(socket_t socket, const char *s) {
+    ssize_t w = net_send_all(socket, s, strlen(s));
+    assert(w == (ssize_t) strlen(s));
+}
+
+static void
+expect_sync(socket_t socket, const char *id, uint32_t *value) {
+    uint8_t header[8];
+    ssize_t r = net_recv_all(socket, header, 8);
+    assert(r == 8);
+    assert(!memcmp(header, id, 4));
+    *value = buffer_read32le(&header[4]);
+}
+
+static int
+run_fake_adb(void *data) {
+    struct fake_adb *adb = data;
+    for (;;) {
+        socket_t socket = net_accept(adb->server_socket);
+        if (socket == INVALID_SOCKET) {
+            break;
+        }
+        adb->handle(socket);
+        ++adb->connections;
+        net_close(socket);
+    }
+    return 0;
+}
+
+static void
+fake_adb_start(struct fake_adb *adb, void (*handle)(socket_t socket)) {
+    adb->server_socket = net_listen(IPV4_LOCALHOST, 0, 1);
+    assert(adb->server_socket != INVALID_SOCKET);
+
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+    int r = getsockname(adb->server_socket, (struct sockaddr *) &sin, &len);
+    assert(!r);
+    (void) r;
+
+    char port[6];
+    sprintf(port, "%u", ntohs(sin.sin_port));
+    setenv("ANDROID_ADB_SERVER_PORT", port, 1);
+
+    adb->handle = handle;
+    adb->connections = 0;
+    bool ok = sc_thread_create(&adb->thread, run_fake_adb, "fake-adb", adb);
+    assert(ok);
+    (void) ok;
+}
+
+static void
+fake_adb_stop(struct fake_adb *adb) {
+    net_shutdown(adb->server_socket, SHUT_RDWR);
+    sc_thread_join(&adb->thread, NULL);
+    net_close(adb->server_socket);
+}
+
+static void
+handle_version(socket_t socket) {
+    expect_request(socket, "host:version");
+    send_raw(socket, "OKAY00040029");
+}
+
+static void test_host_query(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_version);
+
+    char *version;
+    enum sc_adb_result r = sc_adb_host_query("host:version", &version);
+    assert(r == SC_ADB_OK);
+    assert(!strcmp(version, "0029"));
+    free(version);
+
+    fake_adb_stop(&adb);
+    assert(adb.connections == 1);
+}
+
+static void
+handle_forward(socket_t socket) {
+    expect_request(socket, "host-serial:0123:forward:tcp:27183;"
+                           "localabstract:scrcpy");
+    send_raw(socket, "OKAYOKAY");
+}
+
+static void test_forward(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_forward);
+
+    enum sc_adb_result r = sc_adb_forward("0123", 27183, "scrcpy");
+    assert(r == SC_ADB_OK);
+
+    fake_adb_stop(&adb);
+    assert(adb.connections == 1);
+}
+
+static void
+handle_forward_remove_fail(socket_t socket) {
+    expect_request(socket, "host:killforward:tcp:27183");
+    send_raw(socket, "OKAYFAIL0012listener not found");
+}
+
+static void test_forward_remove_fail(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_forward_remove_fail);
+
+    enum sc_adb_result r = sc_adb_forward_remove(NULL, 27183);
+    assert(r == SC_ADB_ERROR);
+
+    fake_adb_stop(&adb);
+}
+
+static void
+handle_reverse(socket_t socket) {
+    expect_request(socket, "host:transport:0123");
+    send_raw(socket, "OKAY");
+    expect_request(socket, "reverse:forward:localabstract:scrcpy;tcp:27183");
+    send_raw(socket, "OKAYOKAY");
+}
+
+static void test_reverse(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_reverse);
+
+    enum sc_adb_result r = sc_adb_reverse("0123", "scrcpy", 27183);
+    assert(r == SC_ADB_OK);
+
+    fake_adb_stop(&adb);
+    assert(adb.connections == 1);
+}
+
+static void
+handle_device_not_found(socket_t socket) {
+    expect_request(socket, "host:transport:0123");
+    send_raw(socket, "FAIL0017device '0123' not found");
+}
+
+static void test_device_not_found(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_device_not_found);
+
+    enum sc_adb_result r = sc_adb_reverse_remove("0123", "scrcpy");
+    assert(r == SC_ADB_ERROR);
+
+    fake_adb_stop(&adb);
+}
+
+static void
+handle_shell(socket_t socket) {
+    expect_request(socket, "host:transport-any");
+    send_raw(socket, "OKAY");
+    expect_request(socket, "shell:echo hello");
+    send_raw(socket, "OKAYhello\n");
+}
+
+static void test_shell(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_shell);
+
+    socket_t socket;
+    const char *const argv[] = {"echo", "hello"};
+    enum sc_adb_result r = sc_adb_shell(NULL, argv, ARRAY_LEN(argv), &socket);
+    assert(r == SC_ADB_OK);
+
+    // read the output until the command terminates
+    char buf[16];
+    size_t len = 0;
+    ssize_t n;
+    while ((n = net_recv(socket, &buf[len], sizeof(buf) - len)) > 0) {
+        len += n;
+    }
+    assert(len == 6 && !memcmp(buf, "hello\n", 6));
+    net_close(socket);
+
+    fake_adb_stop(&adb);
+}
+
+#define PUSH_FILENAME "test_adb_client.data"
+#define PUSH_SIZE (150 * 1024) // several DATA chunks
+
+static void
+handle_push(socket_t socket) {
+    expect_request(socket, "host:transport:0123");
+    send_raw(socket, "OKAY");
+    expect_request(socket, "sync:");
+    send_raw(socket, "OKAY");
+
+    // the remote path is a directory
+    uint32_t len;
+    char path[256];
+    expect_sync(socket, "STAT", &len);
+    assert(len == strlen("/sdcard/Download"));
+    net_recv_all(socket, path, len);
+    assert(!memcmp(path, "/sdcard/Download", len));
+    uint8_t stat[16] = "STAT";
+    buffer_write32le(&stat[4], 040771);
+    net_send_all(socket, stat, sizeof(stat));
+
+    expect_sync(socket, "SEND", &len);
+    assert(len < sizeof(path));
+    net_recv_all(socket, path, len);
+    path[len] = '\0';
+    assert(!strncmp(path, "/sdcard/Download/" PUSH_FILENAME ",",
+                    strlen("/sdcard/Download/" PUSH_FILENAME ",")));
+
+    static uint8_t data[PUSH_SIZE];
+    size_t total = 0;
+    for (;;) {
+        uint8_t header[8];
+        ssize_t r = net_recv_all(socket, header, 8);
+        assert(r == 8);
+        len = buffer_read32le(&header[4]);
+        if (!memcmp(header, "DONE", 4)) {
+            break;
+        }
+        assert(!memcmp(header, "DATA", 4));
+        assert(total + len <= PUSH_SIZE);
+        r = net_recv_all(socket, &data[total], len);
+        assert(r == (ssize_t) len);
+        total += len;
+    }
+
+    assert(total == PUSH_SIZE);
+    for (size_t i = 0; i < PUSH_SIZE; ++i) {
+        assert(data[i] == (uint8_t) (i * 7));
+    }
+
+    uint8_t okay[8] = "OKAY";
+    buffer_write32le(&okay[4], 0);
+    net_send_all(socket, okay, sizeof(okay));
+
+    expect_sync(socket, "QUIT", &len);
+}
+
+static void test_push(void) {
+    FILE *file = fopen(PUSH_FILENAME, "wb");
+    assert(file);
+    for (size_t i = 0; i < PUSH_SIZE; ++i) {
+        fputc((uint8_t) (i * 7), file);
+    }
+    fclose(file);
+
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_push);
+
+    enum sc_adb_result r = sc_adb_push("0123", PUSH_FILENAME,
+                                       "/sdcard/Download");
+    assert(r == SC_ADB_OK);
+
+    fake_adb_stop(&adb);
+    assert(adb.connections == 1);
+
+    remove(PUSH_FILENAME);
+}
+
+static void
+handle_track_devices(socket_t socket) {
+    expect_request(socket, "host:track-devices");
+    send_raw(socket, "OKAY0015emulator-5554\tdevice\n");
+    send_raw(socket, "0000");
+}
+
+static void test_track_devices(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_track_devices);
+
+    socket_t socket;
+    enum sc_adb_result r = sc_adb_track_devices(&socket);
+    assert(r == SC_ADB_OK);
+
+    char *devices;
+    r = sc_adb_read_devices(socket, &devices);
+    assert(r == SC_ADB_OK);
+    assert(!strcmp(devices, "emulator-5554\tdevice\n"));
+    free(devices);
+
+    // the device has been disconnected
+    r = sc_adb_read_devices(socket, &devices);
+    assert(r == SC_ADB_OK);
+    assert(!strcmp(devices, ""));
+    free(devices);
+
+    // the connection is closed
+    r = sc_adb_read_devices(socket, &devices);
+    assert(r == SC_ADB_UNAVAILABLE);
+
+    net_close(socket);
+    fake_adb_stop(&adb);
+    assert(adb.connections == 1);
+}
+
+static void test_unavailable(void) {
+    struct fake_adb adb;
+    fake_adb_start(&adb, handle_version);
+    // nothing is listening on the port anymore
+    fake_adb_stop(&adb);
+
+    enum sc_adb_result r = sc_adb_forward(NULL, 27183, "scrcpy");
+    assert(r == SC_ADB_UNAVAILABLE);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_host_query();
+    test_forward();
+    test_forward_remove_fail();
+    test_reverse();
+    test_device_not_found();
+    test_shell();
+    test_push();
+    test_track_devices();
+    test_unavailable();
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/async_log.h"
+#include "util/log.h"
+
+#define MESSAGES 1000
+
+struct capture {
+    unsigned count;
+    unsigned last_index;
+    sc_tick last_timestamp;
+    unsigned dropped_reports;
+    unsigned suppressed_reports;
+};
+
+static void
+capture_write(void *userdata, sc_tick timestamp, enum sc_log_level level,
+              const char *message) {
+    struct capture *capture = userdata;
+
+    // the timestamps are monotonic
+    assert(timestamp >= capture->last_timestamp);
+    capture->last_timestamp = timestamp;
+
+    unsigned index;
+    if (sscanf(message, "message %u", &index) == 1) {
+        assert(level == SC_LOG_LEVEL_INFO);
+        // in order, even if some messages are dropped
+        assert(!capture->count || index > capture->last_index);
+        capture->last_index = index;
+        ++capture->count;
+    } else if (strstr(message, "log messages dropped")) {
+        assert(level == SC_LOG_LEVEL_WARN);
+        ++capture->dropped_reports;
+    } else if (strstr(message, "similar messages suppressed")) {
+        ++capture->suppressed_reports;
+    }
+}
+
+static void test_sink(void) {
+    bool ok = sc_async_log_start();
+    assert(ok);
+
+    struct capture capture = {0};
+    struct sc_log_sink sink = {
+        .write = capture_write,
+        .userdata = &capture,
+    };
+    sc_async_log_set_sink(&sink);
+
+    uint64_t dropped = sc_async_log_get_dropped();
+    for (unsigned i = 0; i < MESSAGES; ++i) {
+        LOGI("message %u", i);
+    }
+
+    // flush
+    sc_async_log_stop();
+    dropped = sc_async_log_get_dropped() - dropped;
+
+    // every message is either written or counted as dropped
+    assert(capture.count + dropped == MESSAGES);
+    assert(!dropped || capture.dropped_reports);
+
+    // restart with the same sink
+    ok = sc_async_log_start();
+    assert(ok);
+    sc_async_log_set_sink(NULL);
+    sc_async_log_stop();
+}
+
+static void test_ratelimit(void) {
+    bool ok = sc_async_log_start();
+    assert(ok);
+
+    struct capture capture = {0};
+    struct sc_log_sink sink = {
+        .write = capture_write,
+        .userdata = &capture,
+    };
+    sc_async_log_set_sink(&sink);
+
+    for (unsigned i = 0; i < 10; ++i) {
+        LOG_RATELIMITED(LOGI, SC_TICK_FROM_SEC(60), "message %u", i);
+    }
+
+    sc_async_log_stop();
+
+    assert(capture.count == 1);
+    assert(capture.last_index == 0);
+    assert(!capture.suppressed_reports);
+
+    ok = sc_async_log_start();
+    assert(ok);
+    sc_async_log_set_sink(NULL);
+    sc_async_log_stop();
+}
+
+static void test_file(void) {
+    const char *filename = "test_async_log.txt";
+    remove(filename);
+
+    bool ok = sc_async_log_start();
+    assert(ok);
+    ok = sc_async_log_set_file(filename);
+    assert(ok);
+
+    LOGW("written to %s", "file");
+
+    sc_async_log_stop();
+
+    FILE *file = fopen(filename, "r");
+    assert(file);
+    char line[256];
+    char *r = fgets(line, sizeof(line), file);
+    assert(r);
+    (void) r;
+    fclose(file);
+
+    // prefixed by the timestamp
+    assert(line[0] == '[');
+    assert(strstr(line, "] WARN: written to file\n"));
+
+    ok = sc_async_log_start();
+    assert(ok);
+    ok = sc_async_log_set_file(NULL);
+    assert(ok);
+    sc_async_log_stop();
+
+    remove(filename);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_sink();
+    test_ratelimit();
+    test_file();
+    return 0;
+}
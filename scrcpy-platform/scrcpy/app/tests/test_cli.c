@@ -122,6 +122,35 @@ static void test_options2(void) {
     assert(opts->record_format == SC_RECORD_FORMAT_MP4);
 }
 
+static void test_options_multiple_records(void) {
+    struct scrcpy_cli_args args = {
+        .opts = SCRCPY_OPTIONS_DEFAULT,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--no-display",
+        "--record", "archive.mkv",
+        "--record", "live.mp4",
+        "--record-format", "fmp4",
+        "--record", "copy.mp4",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(!strcmp(opts->record_filename, "archive.mkv"));
+    assert(opts->record_format == SC_RECORD_FORMAT_MKV);
+    assert(opts->extra_record_count == 2);
+    assert(!strcmp(opts->extra_records[0].filename, "live.mp4"));
+    assert(opts->extra_records[0].format == SC_RECORD_FORMAT_FMP4);
+    assert(!strcmp(opts->extra_records[1].filename, "copy.mp4"));
+    assert(opts->extra_records[1].format == SC_RECORD_FORMAT_MP4);
+}
+
 static void test_parse_shortcut_mods(void) {
     struct sc_shortcut_mods mods;
     bool ok;
@@ -167,6 +196,7 @@ int main(int argc, char *argv[]) {
     test_flag_help();
     test_options();
     test_options2();
+    test_options_multiple_records();
     test_parse_shortcut_mods();
     return 0;
 };
@@ -278,6 +278,132 @@ static void test_serialize_rotate_device(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_ping(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_PING,
+        .ping = {
+            .timestamp = UINT64_C(0x0123456789abcdef),
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    size_t size = control_msg_serialize(&msg, buf);
+    assert(size == 9);
+
+    const unsigned char expected[] = {
+        CONTROL_MSG_TYPE_PING,
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, // timestamp
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+
+    struct control_msg out;
+    ssize_t r = control_msg_deserialize(buf, size, &out);
+    assert(r == 9);
+    assert(out.type == CONTROL_MSG_TYPE_PING);
+    assert(out.ping.timestamp == UINT64_C(0x0123456789abcdef));
+
+    // incomplete
+    r = control_msg_deserialize(buf, size - 1, &out);
+    assert(r == 0);
+}
+
+static void test_deserialize_inject_touch_event(void) {
+    struct control_msg msg = {
+        .type = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = 0x1234567887654321L,
+            .position = {
+                .point = {
+                    .x = -100,
+                    .y = 200,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .pressure = 0.5f,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+
+    unsigned char buf[CONTROL_MSG_MAX_SIZE];
+    size_t size = control_msg_serialize(&msg, buf);
+    assert(size == 28);
+
+    // incomplete
+    struct control_msg out;
+    ssize_t r = control_msg_deserialize(buf, 27, &out);
+    assert(r == 0);
+
+    r = control_msg_deserialize(buf, size, &out);
+    assert(r == 28);
+    assert(out.type == CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+    assert(out.inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE);
+    assert(out.inject_touch_event.pointer_id == 0x1234567887654321L);
+    assert(out.inject_touch_event.position.point.x == -100);
+    assert(out.inject_touch_event.position.point.y == 200);
+    assert(out.inject_touch_event.position.screen_size.width == 1080);
+    assert(out.inject_touch_event.position.screen_size.height == 1920);
+    assert(out.inject_touch_event.pressure == 0.5f);
+    assert(out.inject_touch_event.buttons == AMOTION_EVENT_BUTTON_PRIMARY);
+}
+
+static void test_deserialize_inject_keycode(void) {
+    const unsigned char input[] = {
+        CONTROL_MSG_TYPE_INJECT_KEYCODE,
+        0x01, // AKEY_EVENT_ACTION_UP
+        0x00, 0x00, 0x00, 0x42, // AKEYCODE_ENTER
+        0x00, 0x00, 0x00, 0X05, // repeat
+        0x00, 0x00, 0x00, 0x41, // AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON
+    };
+
+    struct control_msg msg;
+    ssize_t r = control_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 14);
+    assert(msg.type == CONTROL_MSG_TYPE_INJECT_KEYCODE);
+    assert(msg.inject_keycode.action == AKEY_EVENT_ACTION_UP);
+    assert(msg.inject_keycode.keycode == AKEYCODE_ENTER);
+    assert(msg.inject_keycode.repeat == 5);
+    assert(msg.inject_keycode.metastate ==
+            (AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON));
+}
+
+static void test_deserialize_set_clipboard(void) {
+    const unsigned char input[] = {
+        CONTROL_MSG_TYPE_SET_CLIPBOARD,
+        1, // paste
+        0x00, 0x00, 0x00, 0x03, // text length
+        'a', 'b', 'c',
+        CONTROL_MSG_TYPE_ROTATE_DEVICE, // next message
+    };
+
+    struct control_msg msg;
+    ssize_t r = control_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 9);
+    assert(msg.type == CONTROL_MSG_TYPE_SET_CLIPBOARD);
+    assert(msg.set_clipboard.paste);
+    assert(!strcmp(msg.set_clipboard.text, "abc"));
+    control_msg_destroy(&msg);
+
+    r = control_msg_deserialize(&input[9], sizeof(input) - 9, &msg);
+    assert(r == 1);
+    assert(msg.type == CONTROL_MSG_TYPE_ROTATE_DEVICE);
+
+    // incomplete text
+    r = control_msg_deserialize(input, 8, &msg);
+    assert(r == 0);
+}
+
+static void test_deserialize_invalid(void) {
+    const unsigned char input[] = {0xff, 0x00};
+
+    struct control_msg msg;
+    ssize_t r = control_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == -1);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -295,5 +421,10 @@ int main(int argc, char *argv[]) {
     test_serialize_set_clipboard();
     test_serialize_set_screen_power_mode();
     test_serialize_rotate_device();
+    test_serialize_ping();
+    test_deserialize_inject_touch_event();
+    test_deserialize_inject_keycode();
+    test_deserialize_set_clipboard();
+    test_deserialize_invalid();
     return 0;
 }
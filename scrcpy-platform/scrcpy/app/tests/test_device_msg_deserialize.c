@@ -19,10 +19,33 @@ static void test_deserialize_clipboard(void) {
     assert(r == 8);
 
     assert(msg.type == DEVICE_MSG_TYPE_CLIPBOARD);
-    assert(msg.clipboard.text);
-    assert(!strcmp("ABC", msg.clipboard.text));
+    assert(msg.clipboard.length == 3);
+    // parsed in place
+    assert(msg.clipboard.text == (const char *) &input[5]);
+    assert(!memcmp("ABC", msg.clipboard.text, 3));
+}
+
+static void test_deserialize_clipboard_partial(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_CLIPBOARD,
+        0x00, 0x00, 0x00, 0x03, // text length
+        0x41, 0x42, // "AB", the last byte is not received yet
+    };
+
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 0);
+}
+
+static void test_deserialize_clipboard_too_big(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_CLIPBOARD,
+        0x00, 0x04, 0x00, 0x00, // text length, greater than the max
+    };
 
-    device_msg_destroy(&msg);
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == -1);
 }
 
 static void test_deserialize_clipboard_big(void) {
@@ -40,11 +63,27 @@ static void test_deserialize_clipboard_big(void) {
     assert(r == DEVICE_MSG_MAX_SIZE);
 
     assert(msg.type == DEVICE_MSG_TYPE_CLIPBOARD);
-    assert(msg.clipboard.text);
-    assert(strlen(msg.clipboard.text) == DEVICE_MSG_TEXT_MAX_LENGTH);
+    assert(msg.clipboard.length == DEVICE_MSG_TEXT_MAX_LENGTH);
     assert(msg.clipboard.text[0] == 'a');
+    assert(msg.clipboard.text[DEVICE_MSG_TEXT_MAX_LENGTH - 1] == 'a');
+}
+
+static void test_deserialize_pong(void) {
+    const unsigned char input[] = {
+        DEVICE_MSG_TYPE_PONG,
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, // timestamp
+    };
+
+    struct device_msg msg;
+    ssize_t r = device_msg_deserialize(input, sizeof(input), &msg);
+    assert(r == 9);
+
+    assert(msg.type == DEVICE_MSG_TYPE_PONG);
+    assert(msg.pong.timestamp == UINT64_C(0x0123456789abcdef));
 
-    device_msg_destroy(&msg);
+    // incomplete
+    r = device_msg_deserialize(input, sizeof(input) - 1, &msg);
+    assert(r == 0);
 }
 
 int main(int argc, char *argv[]) {
@@ -52,6 +91,9 @@ int main(int argc, char *argv[]) {
     (void) argv;
 
     test_deserialize_clipboard();
+    test_deserialize_clipboard_partial();
+    test_deserialize_clipboard_too_big();
     test_deserialize_clipboard_big();
+    test_deserialize_pong();
     return 0;
 }
@@ -0,0 +1,85 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "fleet.h"
+
+// The options are rejected before any session is started
+struct scrcpy_process *
+scrcpy_start_pooled(const struct scrcpy_options *options,
+                    struct sc_thread_pool *pool) {
+    (void) options;
+    (void) pool;
+    abort();
+}
+
+bool
+scrcpy_init_pooled(const struct scrcpy_options *options) {
+    (void) options;
+    abort();
+}
+
+bool
+scrcpy_is_stream_ended(struct scrcpy_process *p) {
+    (void) p;
+    abort();
+}
+
+void
+scrcpy_stop(struct scrcpy_process *p) {
+    (void) p;
+    abort();
+}
+
+static struct scrcpy_options
+fleet_options(void) {
+    struct scrcpy_options options = SCRCPY_OPTIONS_DEFAULT;
+    options.display = false;
+    return options;
+}
+
+static void test_fleet_reject_display(void) {
+    // enabled by default
+    struct scrcpy_options options = SCRCPY_OPTIONS_DEFAULT;
+    assert(options.display);
+
+    struct scrcpy_fleet *fleet = scrcpy_fleet_start(&options, NULL, NULL);
+    assert(!fleet);
+}
+
+static void test_fleet_reject_serial(void) {
+    struct scrcpy_options options = fleet_options();
+    options.serial = "0123456789";
+
+    struct scrcpy_fleet *fleet = scrcpy_fleet_start(&options, NULL, NULL);
+    assert(!fleet);
+}
+
+static void test_fleet_reject_record_filename(void) {
+    struct scrcpy_options options = fleet_options();
+    // the same file for all the devices
+    options.record_filename = "record.mp4";
+
+    struct scrcpy_fleet *fleet = scrcpy_fleet_start(&options, NULL, NULL);
+    assert(!fleet);
+}
+
+static void test_fleet_reject_shared_outputs(void) {
+    struct scrcpy_options options = fleet_options();
+    options.restream_url = "udp://127.0.0.1:1234";
+
+    struct scrcpy_fleet *fleet = scrcpy_fleet_start(&options, NULL, NULL);
+    assert(!fleet);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_fleet_reject_display();
+    test_fleet_reject_serial();
+    test_fleet_reject_record_filename();
+    test_fleet_reject_shared_outputs();
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "fps_counter.h"
+
+#define START SC_TICK_FROM_SEC(100)
+
+static void test_empty(void) {
+    struct fps_counter counter;
+    fps_counter_init(&counter);
+
+    struct fps_counter_stats stats;
+    fps_counter_get_stats(&counter, START, SC_TICK_FROM_SEC(1), &stats);
+    assert(stats.rendered == 0);
+    assert(stats.skipped == 0);
+    assert(stats.fps == 0);
+    assert(stats.interval_max == 0);
+}
+
+static void test_regular(void) {
+    struct fps_counter counter;
+    fps_counter_init(&counter);
+
+    // 60 fps during 2 seconds
+    sc_tick now = START;
+    for (int i = 0; i < 120; ++i) {
+        now += SC_TICK_FROM_US(16667);
+        fps_counter_add_rendered_frame(&counter, now);
+    }
+    fps_counter_add_skipped_frame(&counter);
+
+    struct fps_counter_stats stats;
+    fps_counter_get_stats(&counter, now, SC_TICK_FROM_SEC(1), &stats);
+    assert(stats.rendered == 120);
+    assert(stats.skipped == 1);
+    assert(stats.fps == 60);
+    assert(stats.interval_p50 == 16667);
+    assert(stats.interval_p99 == 16667);
+    assert(stats.interval_max == 16667);
+    assert(stats.jitter == 0);
+
+    // no frame during the last window
+    fps_counter_get_stats(&counter, now + SC_TICK_FROM_SEC(2),
+                          SC_TICK_FROM_SEC(1), &stats);
+    assert(stats.rendered == 120);
+    assert(stats.fps == 0);
+}
+
+static void test_jitter(void) {
+    struct fps_counter counter;
+    fps_counter_init(&counter);
+
+    // alternate intervals of 10 and 30 ms
+    sc_tick now = START;
+    for (int i = 0; i < 21; ++i) {
+        now += SC_TICK_FROM_MS(i % 2 ? 30 : 10);
+        fps_counter_add_rendered_frame(&counter, now);
+    }
+
+    struct fps_counter_stats stats;
+    fps_counter_get_stats(&counter, now, SC_TICK_FROM_SEC(1), &stats);
+    assert(stats.fps == 21);
+    assert(stats.jitter == SC_TICK_FROM_MS(20));
+    assert(stats.interval_p50 == SC_TICK_FROM_MS(10));
+    assert(stats.interval_p90 == SC_TICK_FROM_MS(30));
+    assert(stats.interval_max == SC_TICK_FROM_MS(30));
+}
+
+static void test_history_limit(void) {
+    struct fps_counter counter;
+    fps_counter_init(&counter);
+
+    // more frames in the window than the history can hold
+    sc_tick now = START;
+    for (int i = 0; i < 1000; ++i) {
+        now += SC_TICK_FROM_MS(1);
+        fps_counter_add_rendered_frame(&counter, now);
+    }
+
+    struct fps_counter_stats stats;
+    fps_counter_get_stats(&counter, now, SC_TICK_FROM_SEC(1), &stats);
+    assert(stats.rendered == 1000);
+    // the rate is computed over the frames of the history
+    assert(stats.fps > 1000 && stats.fps < 1010);
+    assert(stats.interval_max == SC_TICK_FROM_MS(1));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_empty();
+    test_regular();
+    test_jitter();
+    test_history_limit();
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "gesture.h"
+
+static const struct size SCREEN_SIZE = {.width = 1080, .height = 1920};
+
+static const struct control_msg *
+touch(const struct sc_timed_msg *msgs, size_t i) {
+    assert(msgs[i].msg.type == CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+    return &msgs[i].msg;
+}
+
+static void test_swipe_linear(void) {
+    struct sc_swipe swipe = {
+        .from = {100, 200},
+        .to = {300, 1200},
+        .duration = SC_TICK_FROM_MS(100),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    bool ok = sc_gesture_swipe(&swipe, SCREEN_SIZE, 100, &msgs, &count);
+    assert(ok);
+
+    // down, 10 moves, up
+    assert(count == 12);
+
+    const struct control_msg *m = touch(msgs, 0);
+    assert(msgs[0].offset == 0);
+    assert(m->inject_touch_event.action == AMOTION_EVENT_ACTION_DOWN);
+    assert(m->inject_touch_event.pointer_id == POINTER_ID_GESTURE(0));
+    assert(m->inject_touch_event.position.point.x == 100);
+    assert(m->inject_touch_event.position.point.y == 200);
+    assert(m->inject_touch_event.pressure == 1.0f);
+
+    for (size_t i = 1; i <= 10; ++i) {
+        m = touch(msgs, i);
+        assert(m->inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE);
+        assert(msgs[i].offset == SC_TICK_FROM_MS(10 * (sc_tick) i));
+    }
+
+    // the middle of the swipe
+    m = touch(msgs, 5);
+    assert(m->inject_touch_event.position.point.x == 200);
+    assert(m->inject_touch_event.position.point.y == 700);
+
+    m = touch(msgs, 11);
+    assert(msgs[11].offset == SC_TICK_FROM_MS(100));
+    assert(m->inject_touch_event.action == AMOTION_EVENT_ACTION_UP);
+    assert(m->inject_touch_event.position.point.x == 300);
+    assert(m->inject_touch_event.position.point.y == 1200);
+    assert(m->inject_touch_event.pressure == 0.0f);
+
+    sc_timed_msgs_destroy(msgs, count);
+}
+
+static void test_swipe_bezier(void) {
+    struct sc_swipe swipe = {
+        .from = {0, 0},
+        .to = {1000, 0},
+        .bezier = true,
+        .control1 = {0, 800},
+        .control2 = {1000, 800},
+        .duration = SC_TICK_FROM_MS(100),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    bool ok = sc_gesture_swipe(&swipe, SCREEN_SIZE, 100, &msgs, &count);
+    assert(ok);
+    assert(count == 12);
+
+    // B(1/2) = (P0 + 3 C1 + 3 C2 + P1) / 8
+    const struct control_msg *m = touch(msgs, 5);
+    assert(m->inject_touch_event.position.point.x == 500);
+    assert(m->inject_touch_event.position.point.y == 600);
+
+    m = touch(msgs, 11);
+    assert(m->inject_touch_event.position.point.x == 1000);
+    assert(m->inject_touch_event.position.point.y == 0);
+
+    sc_timed_msgs_destroy(msgs, count);
+}
+
+static void test_pinch(void) {
+    struct sc_pinch pinch = {
+        .center = {500, 1000},
+        .start_span = 200,
+        .end_span = 600,
+        .start_angle = 0,
+        .end_angle = 90,
+        .duration = SC_TICK_FROM_MS(50),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    bool ok = sc_gesture_pinch(&pinch, SCREEN_SIZE, 100, &msgs, &count);
+    assert(ok);
+
+    // 2 fingers: 2 downs, 2 * 5 moves, 2 ups
+    assert(count == 14);
+
+    const struct control_msg *m0 = touch(msgs, 0);
+    const struct control_msg *m1 = touch(msgs, 1);
+    assert(m0->inject_touch_event.action == AMOTION_EVENT_ACTION_DOWN);
+    assert(m1->inject_touch_event.action == AMOTION_EVENT_ACTION_DOWN);
+    assert(m0->inject_touch_event.pointer_id == POINTER_ID_GESTURE(0));
+    assert(m1->inject_touch_event.pointer_id == POINTER_ID_GESTURE(1));
+    assert(m0->inject_touch_event.position.point.x == 600);
+    assert(m0->inject_touch_event.position.point.y == 1000);
+    assert(m1->inject_touch_event.position.point.x == 400);
+    assert(m1->inject_touch_event.position.point.y == 1000);
+
+    // the fingers are always symmetric around the center
+    for (size_t i = 2; i < 12; i += 2) {
+        m0 = touch(msgs, i);
+        m1 = touch(msgs, i + 1);
+        assert(msgs[i].offset == msgs[i + 1].offset);
+        assert(m0->inject_touch_event.position.point.x
+             + m1->inject_touch_event.position.point.x == 1000);
+        assert(m0->inject_touch_event.position.point.y
+             + m1->inject_touch_event.position.point.y == 2000);
+    }
+
+    // rotated by 90 degrees counterclockwise (the y axis points down)
+    m0 = touch(msgs, 10);
+    assert(m0->inject_touch_event.position.point.x == 500);
+    assert(m0->inject_touch_event.position.point.y == 700);
+
+    // released in reverse order
+    m1 = touch(msgs, 12);
+    m0 = touch(msgs, 13);
+    assert(m1->inject_touch_event.action == AMOTION_EVENT_ACTION_UP);
+    assert(m1->inject_touch_event.pointer_id == POINTER_ID_GESTURE(1));
+    assert(m0->inject_touch_event.action == AMOTION_EVENT_ACTION_UP);
+    assert(m0->inject_touch_event.pointer_id == POINTER_ID_GESTURE(0));
+
+    sc_timed_msgs_destroy(msgs, count);
+}
+
+static void test_fling(void) {
+    struct sc_fling fling = {
+        .from = {500, 1500},
+        .to = {500, 500},
+        .velocity = 10000, // px/s
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    bool ok = sc_gesture_fling(&fling, SCREEN_SIZE, 200, &msgs, &count);
+    assert(ok);
+
+    // 1000 px, released at 10000 px/s from rest: 200 ms
+    assert(msgs[count - 1].offset == SC_TICK_FROM_MS(200));
+    // down, 40 moves, up
+    assert(count == 42);
+
+    // the finger accelerates
+    int32_t prev_y = 1500;
+    int32_t prev_delta = 0;
+    for (size_t i = 1; i <= 40; ++i) {
+        int32_t y = touch(msgs, i)->inject_touch_event.position.point.y;
+        int32_t delta = prev_y - y;
+        assert(delta >= prev_delta);
+        prev_y = y;
+        prev_delta = delta;
+    }
+    assert(prev_y == 500);
+
+    sc_timed_msgs_destroy(msgs, count);
+}
+
+static void test_clamp_and_invalid(void) {
+    struct sc_swipe swipe = {
+        .from = {-50, 100},
+        .to = {5000, 100},
+        .duration = SC_TICK_FROM_MS(10),
+    };
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    bool ok = sc_gesture_swipe(&swipe, SCREEN_SIZE, 100, &msgs, &count);
+    assert(ok);
+    assert(count == 3);
+    assert(touch(msgs, 0)->inject_touch_event.position.point.x == 0);
+    assert(touch(msgs, 2)->inject_touch_event.position.point.x == 1079);
+    sc_timed_msgs_destroy(msgs, count);
+
+    ok = sc_gesture_swipe(&swipe, SCREEN_SIZE, 0, &msgs, &count);
+    assert(!ok);
+
+    swipe.duration = 0;
+    ok = sc_gesture_swipe(&swipe, SCREEN_SIZE, 100, &msgs, &count);
+    assert(!ok);
+
+    struct sc_fling fling = {
+        .from = {0, 0},
+        .to = {100, 100},
+        .velocity = 0,
+    };
+    ok = sc_gesture_fling(&fling, SCREEN_SIZE, 100, &msgs, &count);
+    assert(!ok);
+
+    // the duration would not fit in a sc_tick
+    fling.velocity = 1e-30f;
+    ok = sc_gesture_fling(&fling, SCREEN_SIZE, 100, &msgs, &count);
+    assert(!ok);
+
+    swipe.duration = SC_GESTURE_MAX_DURATION + 1;
+    ok = sc_gesture_swipe(&swipe, SCREEN_SIZE, 100, &msgs, &count);
+    assert(!ok);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_swipe_linear();
+    test_swipe_bezier();
+    test_pinch();
+    test_fling();
+    test_clamp_and_invalid();
+    return 0;
+}
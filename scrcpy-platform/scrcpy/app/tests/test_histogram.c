@@ -0,0 +1,70 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "util/histogram.h"
+
+static void test_histogram_empty(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    struct sc_histogram_snapshot snapshot;
+    sc_histogram_snapshot(&hist, &snapshot);
+    assert(snapshot.count == 0);
+    assert(sc_histogram_percentile(&snapshot, 50) == 0);
+}
+
+static void test_histogram_percentiles(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    // 90 values of 100, then 10 values of 5000
+    for (int i = 0; i < 90; ++i) {
+        sc_histogram_record(&hist, 100);
+    }
+    for (int i = 0; i < 10; ++i) {
+        sc_histogram_record(&hist, 5000);
+    }
+
+    struct sc_histogram_snapshot snapshot;
+    sc_histogram_snapshot(&hist, &snapshot);
+    assert(snapshot.count == 100);
+    assert(snapshot.sum == 90 * 100 + 10 * 5000);
+    assert(snapshot.max == 5000);
+
+    // 100 is in [64, 128)
+    uint64_t p50 = sc_histogram_percentile(&snapshot, 50);
+    assert(p50 == 127);
+    uint64_t p90 = sc_histogram_percentile(&snapshot, 90);
+    assert(p90 == 127);
+    // 5000 is in [4096, 8192), bounded by the max
+    uint64_t p99 = sc_histogram_percentile(&snapshot, 99);
+    assert(p99 == 5000);
+    assert(sc_histogram_percentile(&snapshot, 100) == 5000);
+}
+
+static void test_histogram_bounds(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    sc_histogram_record(&hist, 0);
+    sc_histogram_record(&hist, 1);
+    sc_histogram_record(&hist, UINT64_MAX);
+
+    struct sc_histogram_snapshot snapshot;
+    sc_histogram_snapshot(&hist, &snapshot);
+    assert(snapshot.buckets[0] == 2);
+    assert(snapshot.buckets[SC_HISTOGRAM_BUCKETS - 1] == 1);
+    assert(sc_histogram_percentile(&snapshot, 50) == 1);
+    assert(snapshot.max == UINT64_MAX);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_histogram_empty();
+    test_histogram_percentiles();
+    test_histogram_bounds();
+    return 0;
+}
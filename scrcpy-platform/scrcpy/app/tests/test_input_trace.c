@@ -0,0 +1,111 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "input_trace.h"
+
+#define TRACE_FILENAME "test_input_trace.scit"
+
+static void test_input_trace_roundtrip(void) {
+    struct sc_input_trace_writer writer;
+    bool ok = sc_input_trace_writer_init(&writer, TRACE_FILENAME);
+    assert(ok);
+
+    struct control_msg touch = {
+        .type = CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = 42,
+            .position = {
+                .point = {.x = 100, .y = 200},
+                .screen_size = {.width = 1080, .height = 1920},
+            },
+            .pressure = 1.0f,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+    ok = sc_input_trace_writer_write(&writer, &touch);
+    assert(ok);
+
+    struct control_msg text = {
+        .type = CONTROL_MSG_TYPE_INJECT_TEXT,
+        .inject_text = {
+            .text = "hello",
+        },
+    };
+    ok = sc_input_trace_writer_write(&writer, &text);
+    assert(ok);
+
+    // not recorded, as if the push had failed
+    struct control_msg discarded = {
+        .type = CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL,
+    };
+    sc_input_trace_writer_lock(&writer);
+    ok = sc_input_trace_writer_add(&writer, &discarded);
+    assert(ok);
+    sc_input_trace_writer_unlock(&writer, false);
+
+    struct control_msg back = {
+        .type = CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON,
+    };
+    ok = sc_input_trace_writer_write(&writer, &back);
+    assert(ok);
+
+    sc_input_trace_writer_destroy(&writer);
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    ok = sc_input_trace_load(TRACE_FILENAME, &msgs, &count);
+    assert(ok);
+    assert(count == 3);
+
+    // the first event is the time reference
+    assert(msgs[0].offset == 0);
+    assert(msgs[1].offset >= msgs[0].offset);
+    assert(msgs[2].offset >= msgs[1].offset);
+
+    const struct control_msg *m = &msgs[0].msg;
+    assert(m->type == CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+    assert(m->inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE);
+    assert(m->inject_touch_event.pointer_id == 42);
+    assert(m->inject_touch_event.position.point.x == 100);
+    assert(m->inject_touch_event.position.point.y == 200);
+    assert(m->inject_touch_event.position.screen_size.width == 1080);
+    assert(m->inject_touch_event.position.screen_size.height == 1920);
+    assert(m->inject_touch_event.pressure == 1.0f);
+    assert(m->inject_touch_event.buttons == AMOTION_EVENT_BUTTON_PRIMARY);
+
+    m = &msgs[1].msg;
+    assert(m->type == CONTROL_MSG_TYPE_INJECT_TEXT);
+    assert(!strcmp(m->inject_text.text, "hello"));
+
+    assert(msgs[2].msg.type == CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON);
+
+    sc_timed_msgs_destroy(msgs, count);
+    remove(TRACE_FILENAME);
+}
+
+static void test_input_trace_invalid(void) {
+    FILE *file = fopen(TRACE_FILENAME, "wb");
+    assert(file);
+    fputs("not a trace", file);
+    fclose(file);
+
+    struct sc_timed_msg *msgs;
+    size_t count;
+    bool ok = sc_input_trace_load(TRACE_FILENAME, &msgs, &count);
+    assert(!ok);
+
+    remove(TRACE_FILENAME);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_input_trace_roundtrip();
+    test_input_trace_invalid();
+    return 0;
+}
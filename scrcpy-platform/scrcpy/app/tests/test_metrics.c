@@ -0,0 +1,275 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "util/net.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+static char *
+format(void) {
+    size_t len = sc_metrics_format_prometheus(NULL, 0);
+    char *buf = malloc(len + 1);
+    assert(buf);
+    size_t r = sc_metrics_format_prometheus(buf, len + 1);
+    assert(r == len);
+    (void) r;
+    assert(strlen(buf) == len);
+    return buf;
+}
+
+static int64_t
+sample_42(void *userdata) {
+    (void) userdata;
+    return 42;
+}
+
+static void test_format(void) {
+    struct sc_metrics m1;
+    struct sc_metrics m2;
+    sc_metrics_init(&m1, "device1");
+    sc_metrics_init(&m2, "192.168.1.2:5555");
+
+    sc_metrics_add(&m1, SC_METRIC_RECEIVED_BYTES, 1000);
+    sc_metrics_add(&m1, SC_METRIC_RECEIVED_BYTES, 234);
+    sc_metrics_add(&m1, SC_METRIC_RECORDER_QUEUE, 3);
+    sc_metrics_add(&m1, SC_METRIC_RECORDER_QUEUE, -1);
+    sc_metrics_add_sink_frame(&m1, 1);
+    sc_metrics_add_sink_frame(&m1, 1);
+    sc_metrics_set_sample(&m2, SC_METRIC_CONTROL_QUEUE, sample_42, NULL);
+
+    sc_histogram_record(&m1.decode_time, 1);
+    sc_histogram_record(&m1.decode_time, 5);
+    sc_histogram_record(&m1.decode_time, 6);
+
+    // optional metrics
+    sc_metrics_add(NULL, SC_METRIC_PACKETS, 1);
+
+    sc_metrics_register(&m1);
+    sc_metrics_register(&m2);
+
+    char *text = format();
+    assert(strstr(text, "# TYPE scrcpy_received_bytes_total counter\n"));
+    assert(strstr(text, "scrcpy_received_bytes_total{serial=\"device1\"} "
+                        "1234\n"));
+    assert(strstr(text, "scrcpy_received_bytes_total"
+                        "{serial=\"192.168.1.2:5555\"} 0\n"));
+    assert(strstr(text, "# TYPE scrcpy_recorder_queue_depth gauge\n"));
+    assert(strstr(text, "scrcpy_recorder_queue_depth{serial=\"device1\"} 2\n"));
+    assert(strstr(text, "scrcpy_control_queue_depth"
+                        "{serial=\"192.168.1.2:5555\"} 42\n"));
+    assert(strstr(text, "scrcpy_sink_frames_total"
+                        "{serial=\"device1\",sink=\"1\"} 2\n"));
+    // unused sinks are not exported
+    assert(!strstr(text, "sink=\"0\""));
+
+    const char *hist = "scrcpy_decode_duration_microseconds";
+    char expected[256];
+    sprintf(expected, "# TYPE %s histogram\n", hist);
+    assert(strstr(text, expected));
+    sprintf(expected, "%s_bucket{serial=\"device1\",le=\"1\"} 1\n", hist);
+    assert(strstr(text, expected));
+    sprintf(expected, "%s_bucket{serial=\"device1\",le=\"3\"} 1\n", hist);
+    assert(strstr(text, expected));
+    sprintf(expected, "%s_bucket{serial=\"device1\",le=\"7\"} 3\n", hist);
+    assert(strstr(text, expected));
+    sprintf(expected, "%s_bucket{serial=\"device1\",le=\"15\"}", hist);
+    assert(!strstr(text, expected));
+    sprintf(expected, "%s_bucket{serial=\"device1\",le=\"+Inf\"} 3\n", hist);
+    assert(strstr(text, expected));
+    sprintf(expected, "%s_sum{serial=\"device1\"} 12\n", hist);
+    assert(strstr(text, expected));
+    sprintf(expected, "%s_count{serial=\"device1\"} 3\n", hist);
+    assert(strstr(text, expected));
+    free(text);
+
+    sc_metrics_unregister(&m1);
+    text = format();
+    assert(!strstr(text, "device1"));
+    assert(strstr(text, "192.168.1.2:5555"));
+    free(text);
+
+    sc_metrics_unregister(&m2);
+}
+
+static void test_truncated(void) {
+    struct sc_metrics m;
+    sc_metrics_init(&m, "device");
+    sc_metrics_register(&m);
+
+    char buf[64];
+    size_t len = sc_metrics_format_prometheus(buf, sizeof(buf));
+    assert(len >= sizeof(buf));
+    assert(strlen(buf) == sizeof(buf) - 1);
+
+    sc_metrics_unregister(&m);
+}
+
+static void test_escape(void) {
+    struct sc_metrics m;
+    sc_metrics_init(&m, "a\"b\\c");
+    sc_metrics_register(&m);
+
+    char *text = format();
+    assert(strstr(text, "scrcpy_packets_total{serial=\"a\\\"b\\\\c\"} 0\n"));
+    free(text);
+
+    sc_metrics_unregister(&m);
+}
+
+// Send an HTTP request and return the whole response
+static char *
+request(socket_t socket) {
+    const char *req = "GET /metrics HTTP/1.0\r\n\r\n";
+    ssize_t w = net_send_all(socket, req, strlen(req));
+    assert(w == (ssize_t) strlen(req));
+    (void) w;
+
+    size_t size = 65536;
+    char *buf = malloc(size);
+    assert(buf);
+    size_t len = 0;
+    for (;;) {
+        ssize_t r = net_recv(socket, buf + len, size - len - 1);
+        if (r <= 0) {
+            break;
+        }
+        len += r;
+    }
+    buf[len] = '\0';
+
+    net_close(socket);
+    return buf;
+}
+
+static void
+assert_response(char *response) {
+    assert(!strncmp(response, "HTTP/1.0 200 OK\r\n", 17));
+    assert(strstr(response, "Content-Type: text/plain; version=0.0.4\r\n"));
+    assert(strstr(response, "scrcpy_packets_total{serial=\"served\"} 7\n"));
+    free(response);
+}
+
+static void test_server_tcp(void) {
+    // find a free port
+    socket_t socket = net_listen(IPV4_LOCALHOST, 0, 1);
+    assert(socket != INVALID_SOCKET);
+    uint16_t port;
+    bool ok = net_get_local_port(socket, &port);
+    assert(ok);
+    net_close(socket);
+
+    struct sc_metrics m;
+    sc_metrics_init(&m, "served");
+    sc_metrics_add(&m, SC_METRIC_PACKETS, 7);
+    sc_metrics_register(&m);
+
+    char address[8];
+    sprintf(address, "%u", port);
+    ok = sc_metrics_server_start(address);
+    assert(ok);
+    // shared by the sessions
+    ok = sc_metrics_server_start(address);
+    assert(ok);
+    (void) ok;
+
+    for (int i = 0; i < 3; ++i) {
+        socket = net_connect(IPV4_LOCALHOST, port);
+        assert(socket != INVALID_SOCKET);
+        assert_response(request(socket));
+    }
+
+    sc_metrics_server_stop();
+    // still running
+    socket = net_connect(IPV4_LOCALHOST, port);
+    assert(socket != INVALID_SOCKET);
+    assert_response(request(socket));
+
+    sc_metrics_server_stop();
+
+    sc_metrics_unregister(&m);
+}
+
+static void test_server_unix(void) {
+    char path[64];
+    sprintf(path, "/tmp/scrcpy_test_metrics_%d.sock", (int) getpid());
+    char address[80];
+    sprintf(address, "unix:%s", path);
+
+    struct sc_metrics m;
+    sc_metrics_init(&m, "served");
+    sc_metrics_add(&m, SC_METRIC_PACKETS, 7);
+    sc_metrics_register(&m);
+
+    bool ok = sc_metrics_server_start(address);
+    assert(ok);
+
+    socket_t sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(sock != INVALID_SOCKET);
+    struct sockaddr_un sun;
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    int r = connect(sock, (struct sockaddr *) &sun, sizeof(sun));
+    assert(!r);
+    (void) r;
+    assert_response(request(sock));
+
+    sc_metrics_server_stop();
+    // the socket file is removed
+    assert(access(path, F_OK));
+
+    sc_metrics_unregister(&m);
+    (void) ok;
+}
+
+static void test_server_stop_idle_client(void) {
+    socket_t sock = net_listen(IPV4_LOCALHOST, 0, 1);
+    assert(sock != INVALID_SOCKET);
+    uint16_t port;
+    bool ok = net_get_local_port(sock, &port);
+    assert(ok);
+    net_close(sock);
+
+    char address[8];
+    sprintf(address, "%u", port);
+    ok = sc_metrics_server_start(address);
+    assert(ok);
+    (void) ok;
+
+    // a client which never sends its request
+    sock = net_connect(IPV4_LOCALHOST, port);
+    assert(sock != INVALID_SOCKET);
+    // let the server accept it
+    usleep(100000);
+
+    // must not wait for the request
+    sc_metrics_server_stop();
+
+    net_close(sock);
+}
+
+static void test_server_invalid(void) {
+    assert(!sc_metrics_server_start("abc"));
+    assert(!sc_metrics_server_start("70000"));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_format();
+    test_truncated();
+    test_escape();
+    test_server_tcp();
+    test_server_unix();
+    test_server_stop_idle_client();
+    test_server_invalid();
+    return 0;
+}
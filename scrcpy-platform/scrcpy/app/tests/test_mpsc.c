@@ -0,0 +1,268 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "util/mpsc.h"
+#include "util/thread.h"
+
+#define PRODUCERS 4
+#define ITEMS_PER_PRODUCER 100000
+#define BATCH 5 // ITEMS_PER_PRODUCER must be a multiple
+
+struct item {
+    uint32_t producer;
+    uint32_t index;
+};
+
+static void test_mpsc_single_thread(void) {
+    struct sc_mpsc queue;
+    bool ok = sc_mpsc_init(&queue, sizeof(struct item), 3,
+                           SC_MPSC_OVERFLOW_FAIL);
+    assert(ok);
+
+    // rounded up to a power of 2
+    assert(queue.capacity == 4);
+
+    struct item item;
+    assert(!sc_mpsc_take(&queue, &item));
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        item = (struct item) {.producer = 0, .index = i};
+        ok = sc_mpsc_push(&queue, &item);
+        assert(ok);
+    }
+
+    item.index = 4;
+    ok = sc_mpsc_push(&queue, &item);
+    assert(!ok); // full
+    assert(sc_mpsc_get_overflows(&queue) == 1);
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        ok = sc_mpsc_take(&queue, &item);
+        assert(ok);
+        assert(item.index == i);
+    }
+
+    assert(!sc_mpsc_take(&queue, &item));
+
+    // wrap around several times
+    for (uint32_t i = 0; i < 10; ++i) {
+        item.index = i;
+        ok = sc_mpsc_push(&queue, &item);
+        assert(ok);
+        ok = sc_mpsc_take(&queue, &item);
+        assert(ok);
+        assert(item.index == i);
+    }
+
+    sc_mpsc_destroy(&queue);
+}
+
+static void test_mpsc_push_n(void) {
+    struct sc_mpsc queue;
+    bool ok = sc_mpsc_init(&queue, sizeof(struct item), 4,
+                           SC_MPSC_OVERFLOW_FAIL);
+    assert(ok);
+
+    struct item items[3];
+    for (uint32_t i = 0; i < 3; ++i) {
+        items[i] = (struct item) {.producer = 0, .index = i};
+    }
+
+    ok = sc_mpsc_push_n(&queue, items, 3);
+    assert(ok);
+
+    // only 1 free cell, all or nothing
+    ok = sc_mpsc_push_n(&queue, items, 2);
+    assert(!ok);
+
+    struct item item = {.producer = 0, .index = 3};
+    ok = sc_mpsc_push(&queue, &item);
+    assert(ok);
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        ok = sc_mpsc_take(&queue, &item);
+        assert(ok);
+        assert(item.index == i);
+    }
+
+    // wrap around
+    for (uint32_t i = 0; i < 3; ++i) {
+        items[i].index = 10 + i;
+    }
+    ok = sc_mpsc_push_n(&queue, items, 3);
+    assert(ok);
+    for (uint32_t i = 0; i < 3; ++i) {
+        ok = sc_mpsc_take(&queue, &item);
+        assert(ok);
+        assert(item.index == 10 + i);
+    }
+    assert(!sc_mpsc_take(&queue, &item));
+
+    sc_mpsc_destroy(&queue);
+}
+
+struct producer {
+    struct sc_mpsc *queue;
+    uint32_t id;
+};
+
+static int run_producer(void *data) {
+    struct producer *producer = data;
+    for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        struct item item = {.producer = producer->id, .index = i};
+        bool ok = sc_mpsc_push(producer->queue, &item);
+        assert(ok);
+        (void) ok;
+    }
+    return 0;
+}
+
+static int run_batch_producer(void *data) {
+    struct producer *producer = data;
+    for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; i += BATCH) {
+        struct item items[BATCH];
+        for (uint32_t j = 0; j < BATCH; ++j) {
+            items[j] = (struct item) {.producer = producer->id,
+                                      .index = i + j};
+        }
+        bool ok = sc_mpsc_push_n(producer->queue, items, BATCH);
+        assert(ok);
+        (void) ok;
+    }
+    return 0;
+}
+
+static void test_mpsc_producers(bool batch) {
+    struct sc_mpsc queue;
+    // small capacity, so that the producers block often
+    bool ok = sc_mpsc_init(&queue, sizeof(struct item), 16,
+                           SC_MPSC_OVERFLOW_BLOCK);
+    assert(ok);
+
+    struct producer producers[PRODUCERS];
+    sc_thread threads[PRODUCERS];
+    for (uint32_t i = 0; i < PRODUCERS; ++i) {
+        producers[i].queue = &queue;
+        producers[i].id = i;
+        ok = sc_thread_create(&threads[i],
+                              batch ? run_batch_producer : run_producer,
+                              "producer", &producers[i]);
+        assert(ok);
+    }
+
+    uint32_t next[PRODUCERS] = {0};
+    uint32_t last_producer = PRODUCERS;
+    for (uint32_t i = 0; i < PRODUCERS * ITEMS_PER_PRODUCER; ++i) {
+        struct item item;
+        ok = sc_mpsc_take_wait(&queue, &item);
+        assert(ok);
+        assert(item.producer < PRODUCERS);
+        // the items from each producer are received in order
+        assert(item.index == next[item.producer]);
+        ++next[item.producer];
+        if (batch && item.index % BATCH) {
+            // the items of a batch are never interleaved
+            assert(item.producer == last_producer);
+        }
+        last_producer = item.producer;
+    }
+
+    for (uint32_t i = 0; i < PRODUCERS; ++i) {
+        sc_thread_join(&threads[i], NULL);
+        assert(next[i] == ITEMS_PER_PRODUCER);
+    }
+
+    struct item item;
+    assert(!sc_mpsc_take(&queue, &item));
+    assert(!sc_mpsc_get_overflows(&queue));
+
+    sc_mpsc_destroy(&queue);
+}
+
+static int run_interrupter(void *data) {
+    struct sc_mpsc *queue = data;
+    sc_mpsc_interrupt(queue);
+    return 0;
+}
+
+static void test_mpsc_interrupt(void) {
+    struct sc_mpsc queue;
+    bool ok = sc_mpsc_init(&queue, sizeof(struct item), 4,
+                           SC_MPSC_OVERFLOW_FAIL);
+    assert(ok);
+
+    sc_thread thread;
+    ok = sc_thread_create(&thread, run_interrupter, "interrupter", &queue);
+    assert(ok);
+
+    // must be woken up by the interruption
+    struct item item;
+    ok = sc_mpsc_take_wait(&queue, &item);
+    assert(!ok);
+
+    sc_thread_join(&thread, NULL);
+
+    item = (struct item) {0};
+    ok = sc_mpsc_push(&queue, &item);
+    assert(!ok);
+
+    // the queue may be used again once resumed
+    sc_mpsc_resume(&queue);
+    assert(!sc_mpsc_is_interrupted(&queue));
+    item = (struct item) {.producer = 3, .index = 4};
+    ok = sc_mpsc_push(&queue, &item);
+    assert(ok);
+    item = (struct item) {0};
+    ok = sc_mpsc_take_wait(&queue, &item);
+    assert(ok);
+    assert(item.producer == 3 && item.index == 4);
+
+    sc_mpsc_destroy(&queue);
+}
+
+static void test_mpsc_timedwait(void) {
+    struct sc_mpsc queue;
+    bool ok = sc_mpsc_init(&queue, sizeof(struct item), 4,
+                           SC_MPSC_OVERFLOW_FAIL);
+    assert(ok);
+
+    struct item item;
+    sc_tick deadline = sc_tick_now() + SC_TICK_FROM_MS(10);
+    ok = sc_mpsc_take_timedwait(&queue, &item, deadline);
+    assert(!ok); // timeout
+    assert(sc_tick_now() >= deadline);
+    assert(!sc_mpsc_is_interrupted(&queue));
+
+    item = (struct item) {.producer = 1, .index = 2};
+    ok = sc_mpsc_push(&queue, &item);
+    assert(ok);
+
+    item = (struct item) {0};
+    ok = sc_mpsc_take_timedwait(&queue, &item,
+                                sc_tick_now() + SC_TICK_FROM_MS(10));
+    assert(ok);
+    assert(item.producer == 1 && item.index == 2);
+
+    sc_mpsc_interrupt(&queue);
+    ok = sc_mpsc_take_timedwait(&queue, &item,
+                                sc_tick_now() + SC_TICK_FROM_MS(10));
+    assert(!ok);
+    assert(sc_mpsc_is_interrupted(&queue));
+
+    sc_mpsc_destroy(&queue);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_mpsc_single_thread();
+    test_mpsc_push_n();
+    test_mpsc_producers(false);
+    test_mpsc_producers(true);
+    test_mpsc_interrupt();
+    test_mpsc_timedwait();
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <SDL2/SDL_timer.h>
+
+#include "util/net.h"
+#include "util/thread.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+// A server which starts listening after a delay, then sends one byte to the
+// first client
+struct late_server {
+    uint16_t port;
+    uint32_t delay; // ms
+    sc_thread thread;
+};
+
+static uint16_t
+find_free_port(void) {
+    socket_t socket = net_listen(IPV4_LOCALHOST, 0, 1);
+    assert(socket != INVALID_SOCKET);
+
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+    int r = getsockname(socket, (struct sockaddr *) &sin, &len);
+    assert(!r);
+    (void) r;
+
+    net_close(socket);
+    return ntohs(sin.sin_port);
+}
+
+static int
+run_late_server(void *data) {
+    struct late_server *server = data;
+    SDL_Delay(server->delay);
+
+    socket_t server_socket = net_listen(IPV4_LOCALHOST, server->port, 1);
+    assert(server_socket != INVALID_SOCKET);
+
+    socket_t socket = net_accept(server_socket);
+    assert(socket != INVALID_SOCKET);
+    ssize_t w = net_send_all(socket, "", 1);
+    assert(w == 1);
+    (void) w;
+
+    net_close(socket);
+    net_close(server_socket);
+    return 0;
+}
+
+static bool
+read_byte(socket_t socket, sc_tick deadline) {
+    char byte;
+    return net_wait_readable(socket, deadline)
+        && net_recv(socket, &byte, 1) == 1;
+}
+
+static void test_connect_late_server(void) {
+    struct late_server server = {
+        .port = find_free_port(),
+        .delay = 50 + rand() % 250,
+    };
+    bool ok = sc_thread_create(&server.thread, run_late_server, "late-server",
+                               &server);
+    assert(ok);
+    (void) ok;
+
+    sc_tick start = sc_tick_now();
+    unsigned attempts;
+    socket_t socket = net_connect_retry(IPV4_LOCALHOST, server.port,
+                                        start + SC_TICK_FROM_SEC(5), read_byte,
+                                        &attempts);
+    sc_tick elapsed = sc_tick_now() - start;
+    assert(socket != INVALID_SOCKET);
+    assert(attempts > 1);
+    // the backoff is capped, the connection must not be detected much later
+    // than the server is ready
+    assert(elapsed < SC_TICK_FROM_MS(server.delay + 200));
+    (void) elapsed;
+
+    net_close(socket);
+    sc_thread_join(&server.thread, NULL);
+}
+
+static void test_connect_timeout(void) {
+    // nothing listens on this port
+    uint16_t port = find_free_port();
+
+    sc_tick start = sc_tick_now();
+    unsigned attempts;
+    socket_t socket = net_connect_retry(IPV4_LOCALHOST, port,
+                                        start + SC_TICK_FROM_MS(200), NULL,
+                                        &attempts);
+    sc_tick elapsed = sc_tick_now() - start;
+    assert(socket == INVALID_SOCKET);
+    assert(attempts > 1);
+    assert(elapsed >= SC_TICK_FROM_MS(200));
+    assert(elapsed < SC_TICK_FROM_MS(400));
+    (void) socket;
+    (void) elapsed;
+}
+
+static void test_listen_unix_preserves_file(void) {
+    char path[64];
+    sprintf(path, "/tmp/scrcpy_test_net_%d", (int) getpid());
+
+    // a regular file is not replaced
+    FILE *file = fopen(path, "w");
+    assert(file);
+    fclose(file);
+    socket_t socket = net_listen_unix(path, 1);
+    assert(socket == INVALID_SOCKET);
+    assert(!access(path, F_OK));
+    unlink(path);
+
+    // a socket left by a previous server is replaced
+    socket = net_listen_unix(path, 1);
+    assert(socket != INVALID_SOCKET);
+    net_close(socket);
+    socket = net_listen_unix(path, 1);
+    assert(socket != INVALID_SOCKET);
+    net_close(socket);
+    unlink(path);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    srand(time(NULL));
+
+    test_connect_late_server();
+    test_connect_timeout();
+    test_listen_unix_preserves_file();
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_timer.h>
+
+#include "adb_client.h"
+#include "port_lease.h"
+#include "util/thread.h"
+
+#define IPV4_LOCALHOST 0x7F000001
+
+#define SESSIONS 48
+#define RANGE_FIRST 27183
+#define RANGE_LAST (RANGE_FIRST + 63)
+
+// A stand-in adb server, accepting any forward or reverse request
+struct fake_adb {
+    socket_t server_socket;
+    sc_thread thread;
+    atomic_uint tunnels; // number of forward or reverse requests
+};
+
+static bool
+recv_request(socket_t socket, char *buf, size_t size) {
+    ssize_t r = net_recv_all(socket, buf, 4);
+    if (r != 4) {
+        return false;
+    }
+    buf[4] = '\0';
+    size_t len = strtoul(buf, NULL, 16);
+    assert(len < size);
+    r = net_recv_all(socket, buf, len);
+    assert(r == (ssize_t) len);
+    buf[len] = '\0';
+    return true;
+}
+
+static void
+send_raw(socket_t socket, const char *s) {
+    ssize_t w = net_send_all(socket, s, strlen(s));
+    assert(w == (ssize_t) strlen(s));
+    (void) w;
+}
+
+static int
+run_fake_adb(void *data) {
+    struct fake_adb *adb = data;
+    for (;;) {
+        socket_t socket = net_accept(adb->server_socket);
+        if (socket == INVALID_SOCKET) {
+            break;
+        }
+
+        char request[256];
+        while (recv_request(socket, request, sizeof(request))) {
+            if (!strncmp(request, "host:transport:", 15)) {
+                send_raw(socket, "OKAY");
+                continue;
+            }
+
+            assert(strstr(request, "forward:"));
+            atomic_fetch_add(&adb->tunnels, 1);
+            send_raw(socket, "OKAYOKAY");
+            break;
+        }
+
+        net_close(socket);
+    }
+    return 0;
+}
+
+static void
+fake_adb_start(struct fake_adb *adb) {
+    adb->server_socket = net_listen(IPV4_LOCALHOST, 0, SESSIONS);
+    assert(adb->server_socket != INVALID_SOCKET);
+
+    uint16_t port;
+    bool ok = net_get_local_port(adb->server_socket, &port);
+    assert(ok);
+
+    char value[6];
+    sprintf(value, "%u", port);
+    setenv("ANDROID_ADB_SERVER_PORT", value, 1);
+
+    atomic_init(&adb->tunnels, 0);
+    ok = sc_thread_create(&adb->thread, run_fake_adb, "fake-adb", adb);
+    assert(ok);
+    (void) ok;
+}
+
+static void
+fake_adb_stop(struct fake_adb *adb) {
+    net_shutdown(adb->server_socket, SHUT_RDWR);
+    sc_thread_join(&adb->thread, NULL);
+    net_close(adb->server_socket);
+}
+
+// set while a session uses the port, to detect collisions
+static atomic_bool in_use[0x10000];
+
+struct session {
+    sc_thread thread;
+    unsigned index;
+    struct sc_port_range range;
+    bool ok;
+};
+
+static int
+run_session(void *data) {
+    struct session *session = data;
+
+    char serial[16];
+    sprintf(serial, "device%u", session->index);
+
+    // half of the sessions use "adb reverse", the others "adb forward"
+    bool reverse = session->index % 2;
+
+    uint16_t port;
+    socket_t socket = INVALID_SOCKET;
+    if (reverse) {
+        socket = sc_port_lease_listen(session->range, &port);
+        if (socket == INVALID_SOCKET) {
+            return 0;
+        }
+        session->ok = sc_adb_reverse(serial, "scrcpy", port) == SC_ADB_OK;
+    } else {
+        if (!sc_port_lease_reserve(session->range, &port)) {
+            return 0;
+        }
+        session->ok = sc_adb_forward(serial, port, "scrcpy") == SC_ADB_OK;
+    }
+
+    bool was_used = atomic_exchange(&in_use[port], true);
+    assert(!was_used);
+    (void) was_used;
+
+    // keep the port for some time, while the other sessions start
+    SDL_Delay(rand() % 20);
+
+    atomic_store(&in_use[port], false);
+    if (socket != INVALID_SOCKET) {
+        net_close(socket);
+    }
+    sc_port_lease_release(port);
+
+    return 0;
+}
+
+static void
+test_concurrent_sessions(struct sc_port_range range) {
+    struct fake_adb adb;
+    fake_adb_start(&adb);
+
+    static struct session sessions[SESSIONS];
+    for (unsigned i = 0; i < SESSIONS; ++i) {
+        sessions[i].index = i;
+        sessions[i].range = range;
+        sessions[i].ok = false;
+        bool ok = sc_thread_create(&sessions[i].thread, run_session,
+                                   "session", &sessions[i]);
+        assert(ok);
+        (void) ok;
+    }
+
+    for (unsigned i = 0; i < SESSIONS; ++i) {
+        sc_thread_join(&sessions[i].thread, NULL);
+        assert(sessions[i].ok);
+    }
+
+    fake_adb_stop(&adb);
+
+    // exactly one adb command per session, never retried on another port
+    assert(atomic_load(&adb.tunnels) == SESSIONS);
+}
+
+static void test_exhausted(void) {
+    uint16_t port;
+    socket_t socket = sc_port_lease_listen((struct sc_port_range) {0, 0},
+                                           &port);
+    assert(socket != INVALID_SOCKET);
+    net_close(socket);
+    sc_port_lease_release(port);
+
+    struct sc_port_range range = {port, port};
+    socket = sc_port_lease_listen(range, &port);
+    assert(socket != INVALID_SOCKET);
+
+    // the only port of the range is leased
+    uint16_t other;
+    assert(!sc_port_lease_reserve(range, &other));
+
+    net_close(socket);
+    sc_port_lease_release(port);
+
+    // available again
+    assert(sc_port_lease_reserve(range, &other));
+    assert(other == port);
+    sc_port_lease_release(other);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_concurrent_sessions((struct sc_port_range) {RANGE_FIRST, RANGE_LAST});
+    // any free port
+    test_concurrent_sessions((struct sc_port_range) {0, 0});
+    test_exhausted();
+    return 0;
+}
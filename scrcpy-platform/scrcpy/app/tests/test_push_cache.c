@@ -0,0 +1,75 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "push_cache.h"
+
+#define LOCAL_FILENAME "test_push_cache.jar"
+
+static void
+write_local_file(const char *content) {
+    FILE *file = fopen(LOCAL_FILENAME, "wb");
+    assert(file);
+    fputs(content, file);
+    fclose(file);
+}
+
+static void test_push_cache(void) {
+    // use the current directory as cache directory
+    setenv("XDG_CACHE_HOME", ".", 1);
+
+    write_local_file("server v1");
+
+    struct sc_push_cache_entry entry;
+    bool ok = sc_push_cache_entry_from_file(LOCAL_FILENAME, &entry);
+    assert(ok);
+    assert(entry.size == 9);
+
+    // as set by "adb push"
+    struct sc_adb_file_stat remote = {
+        .mode = 0100644,
+        .size = entry.size,
+        .mtime = entry.mtime,
+    };
+
+    // never pushed to this device
+    assert(!sc_push_cache_check("192.168.1.1:5555", &entry, &remote));
+
+    sc_push_cache_store("192.168.1.1:5555", &entry);
+    assert(sc_push_cache_check("192.168.1.1:5555", &entry, &remote));
+
+    // another device
+    assert(!sc_push_cache_check("0123", &entry, &remote));
+
+    // the device file has been replaced
+    struct sc_adb_file_stat other = remote;
+    other.mtime++;
+    assert(!sc_push_cache_check("192.168.1.1:5555", &entry, &other));
+
+    // the device file does not exist anymore
+    struct sc_adb_file_stat missing = {0};
+    assert(!sc_push_cache_check("192.168.1.1:5555", &entry, &missing));
+
+    // the local file has changed (same size)
+    write_local_file("server v2");
+    struct sc_push_cache_entry entry2;
+    ok = sc_push_cache_entry_from_file(LOCAL_FILENAME, &entry2);
+    assert(ok);
+    assert(entry2.hash != entry.hash);
+    entry2.mtime = entry.mtime; // even within the same second
+    assert(!sc_push_cache_check("192.168.1.1:5555", &entry2, &remote));
+
+    remove("scrcpy/push-192.168.1.1_5555");
+    remove("scrcpy");
+    remove(LOCAL_FILENAME);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_push_cache();
+    return 0;
+}
@@ -0,0 +1,297 @@
+#include "common.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#include "restreamer.h"
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define RTP_VERSION 2
+
+// SPS and PPS of a tiny H.264 stream, as sent by the device in the config
+// packet
+static const uint8_t config_data[] = {
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x0a, 0xd9, 0x1e, 0x84, 0x00,
+    0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xc8, 0x3c, 0x48, 0x99,
+    0x20,
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xcb, 0x83, 0xcb, 0x20,
+};
+
+// an IDR slice (its content does not matter, it is not decoded)
+static const uint8_t frame_data[] = {
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0xff, 0xfe, 0xf6,
+    0xf0, 0xfe, 0x05, 0x36, 0x56, 0x04, 0x50, 0x96, 0x7b, 0x3f, 0x53, 0xe1,
+};
+
+// A UDP socket bound to a free port on the loopback
+static int
+udp_receiver(uint16_t *port) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(sock != -1);
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = 0;
+    int r = bind(sock, (struct sockaddr *) &sin, sizeof(sin));
+    assert(!r);
+
+    socklen_t len = sizeof(sin);
+    r = getsockname(sock, (struct sockaddr *) &sin, &len);
+    assert(!r);
+    (void) r;
+
+    *port = ntohs(sin.sin_port);
+    return sock;
+}
+
+// Receive a datagram, waiting at most 5 seconds
+static ssize_t
+receive(int sock, uint8_t *buf, size_t len) {
+    struct pollfd pfd = {
+        .fd = sock,
+        .events = POLLIN,
+    };
+    int r = poll(&pfd, 1, 5000);
+    if (r != 1) {
+        return -1;
+    }
+    return recv(sock, buf, len, 0);
+}
+
+static void
+push(struct sc_packet_sink *sink, const uint8_t *data, size_t len,
+     int64_t pts, bool key) {
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+    int r = av_new_packet(packet, len);
+    assert(!r);
+    (void) r;
+    memcpy(packet->data, data, len);
+    packet->pts = pts;
+    packet->dts = pts;
+    if (key) {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    bool ok = sink->ops->push(sink, packet);
+    assert(ok);
+    (void) ok;
+
+    av_packet_free(&packet);
+}
+
+// Open the restreamer, and push a config packet then frames
+static void
+start_restream(struct sc_restreamer *restreamer, const char *url,
+               enum sc_restream_format format) {
+    struct size size = {
+        .width = 64,
+        .height = 64,
+    };
+    bool ok = sc_restreamer_init(restreamer, url, format, size);
+    assert(ok);
+
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    assert(codec);
+
+    struct sc_packet_sink *sink = &restreamer->packet_sink;
+    ok = sink->ops->open(sink, codec);
+    assert(ok);
+    (void) ok;
+
+    push(sink, config_data, sizeof(config_data), AV_NOPTS_VALUE, false);
+    for (int i = 0; i < 10; ++i) {
+        // one frame every 16 ms, timestamps in microseconds
+        push(sink, frame_data, sizeof(frame_data), i * 16000, true);
+    }
+}
+
+static void
+stop_restream(struct sc_restreamer *restreamer) {
+    struct sc_packet_sink *sink = &restreamer->packet_sink;
+    sink->ops->close(sink);
+    sc_restreamer_destroy(restreamer);
+}
+
+static void test_restream_udp_mpegts(void) {
+    uint16_t port;
+    int sock = udp_receiver(&port);
+
+    char url[64];
+    sprintf(url, "udp://127.0.0.1:%u", port);
+
+    struct sc_restreamer restreamer;
+    start_restream(&restreamer, url, SC_RESTREAM_FORMAT_AUTO);
+
+    // the datagrams contain whole MPEG-TS packets
+    bool video = false;
+    uint8_t buf[65536];
+    for (int i = 0; i < 100 && !video; ++i) {
+        ssize_t r = receive(sock, buf, sizeof(buf));
+        assert(r > 0);
+        assert(r % TS_PACKET_SIZE == 0);
+        for (ssize_t offset = 0; offset < r; offset += TS_PACKET_SIZE) {
+            const uint8_t *ts = &buf[offset];
+            assert(ts[0] == TS_SYNC_BYTE);
+            bool payload_start = ts[1] & 0x40;
+            // the PES start code of a video stream (0xE0 to 0xEF), if there
+            // is no adaptation field
+            if (payload_start && (ts[3] & 0x30) == 0x10 && !ts[4] && !ts[5]
+                    && ts[6] == 1 && (ts[7] & 0xF0) == 0xE0) {
+                video = true;
+            }
+        }
+    }
+    assert(video);
+
+    stop_restream(&restreamer);
+    close(sock);
+}
+
+static void test_restream_udp_mpegts_large_frame(void) {
+    uint16_t port;
+    int sock = udp_receiver(&port);
+
+    char url[64];
+    sprintf(url, "udp://127.0.0.1:%u", port);
+
+    struct sc_restreamer restreamer;
+    start_restream(&restreamer, url, SC_RESTREAM_FORMAT_AUTO);
+
+    // a frame much larger than one datagram
+    static uint8_t large_frame[16384];
+    memcpy(large_frame, frame_data, sizeof(frame_data));
+    memset(&large_frame[sizeof(frame_data)], 0xAB,
+           sizeof(large_frame) - sizeof(frame_data));
+    push(&restreamer.packet_sink, large_frame, sizeof(large_frame), 160000,
+         true);
+
+    // every datagram contains at most 7 whole MPEG-TS packets
+    size_t total = 0;
+    uint8_t buf[65536];
+    while (total < sizeof(large_frame)) {
+        ssize_t r = receive(sock, buf, sizeof(buf));
+        assert(r > 0);
+        assert(r % TS_PACKET_SIZE == 0);
+        assert(r <= 7 * TS_PACKET_SIZE);
+        for (ssize_t offset = 0; offset < r; offset += TS_PACKET_SIZE) {
+            assert(buf[offset] == TS_SYNC_BYTE);
+        }
+        total += r;
+    }
+
+    stop_restream(&restreamer);
+    close(sock);
+}
+
+static void test_restream_rtp(void) {
+    uint16_t port;
+    int sock = udp_receiver(&port);
+
+    char url[64];
+    sprintf(url, "rtp://127.0.0.1:%u", port);
+
+    struct sc_restreamer restreamer;
+    start_restream(&restreamer, url, SC_RESTREAM_FORMAT_AUTO);
+
+    uint8_t buf[65536];
+    ssize_t r = receive(sock, buf, sizeof(buf));
+    assert(r > 12); // the RTP header
+    assert(buf[0] >> 6 == RTP_VERSION);
+    // the dynamic payload type of H.264
+    assert((buf[1] & 0x7F) == 96);
+    (void) r;
+
+    stop_restream(&restreamer);
+    close(sock);
+}
+
+static void test_restream_fifo_without_reader(void) {
+    char path[64];
+    sprintf(path, "/tmp/scrcpy_test_restreamer_%d.fifo", (int) getpid());
+    int r = mkfifo(path, 0600);
+    assert(!r);
+    (void) r;
+
+    struct size size = {
+        .width = 64,
+        .height = 64,
+    };
+    struct sc_restreamer restreamer;
+    bool ok = sc_restreamer_init(&restreamer, path, SC_RESTREAM_FORMAT_MPEGTS,
+                                 size);
+    assert(ok);
+
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    assert(codec);
+
+    // closed immediately, possibly before the thread opens the FIFO: this
+    // must not block
+    struct sc_packet_sink *sink = &restreamer.packet_sink;
+    ok = sink->ops->open(sink, codec);
+    assert(ok);
+    (void) ok;
+    stop_restream(&restreamer);
+
+    unlink(path);
+}
+
+static void test_restream_fifo_reader_not_reading(void) {
+    char path[64];
+    sprintf(path, "/tmp/scrcpy_test_restreamer_%d.fifo", (int) getpid());
+    int r = mkfifo(path, 0600);
+    assert(!r);
+
+    // the reader is open, but never reads
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    assert(fd != -1);
+
+    struct sc_restreamer restreamer;
+    start_restream(&restreamer, path, SC_RESTREAM_FORMAT_MPEGTS);
+
+    // fill the pipe buffer, so that the restreamer thread is blocked writing
+    static uint8_t large_frame[16384];
+    memcpy(large_frame, frame_data, sizeof(frame_data));
+    memset(&large_frame[sizeof(frame_data)], 0xAB,
+           sizeof(large_frame) - sizeof(frame_data));
+    for (int i = 0; i < 64; ++i) {
+        push(&restreamer.packet_sink, large_frame, sizeof(large_frame),
+             (10 + i) * 16000, true);
+    }
+    usleep(100000);
+
+    // this must not block
+    stop_restream(&restreamer);
+
+    close(fd);
+    unlink(path);
+    (void) r;
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    avformat_network_init();
+
+    test_restream_udp_mpegts();
+    test_restream_udp_mpegts_large_frame();
+    test_restream_rtp();
+    test_restream_fifo_without_reader();
+    test_restream_fifo_reader_not_reading();
+
+    avformat_network_deinit();
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shm_ring.h"
+
+#define W 6
+#define H 4
+// padded lines, like in an AVFrame
+#define LINESIZE_Y 16
+#define LINESIZE_C 8
+
+static uint8_t y_plane[LINESIZE_Y * H];
+static uint8_t u_plane[LINESIZE_C * H / 2];
+static uint8_t v_plane[LINESIZE_C * H / 2];
+
+static void fill_planes(uint8_t value) {
+    memset(y_plane, value, sizeof(y_plane));
+    memset(u_plane, value + 1, sizeof(u_plane));
+    memset(v_plane, value + 2, sizeof(v_plane));
+}
+
+static bool publish(struct sc_shm_ring *ring, uint8_t value, int64_t pts) {
+    fill_planes(value);
+    const uint8_t *const data[3] = {y_plane, u_plane, v_plane};
+    const int linesize[3] = {LINESIZE_Y, LINESIZE_C, LINESIZE_C};
+    return sc_shm_ring_publish(ring, data, linesize, W, H, pts);
+}
+
+static struct sc_shm_ring *create_ring(uint32_t slot_count, size_t *size) {
+    *size = sc_shm_ring_size(slot_count, W * H * 3 / 2);
+    struct sc_shm_ring *ring = malloc(*size);
+    assert(ring);
+    sc_shm_ring_init(ring, slot_count, W * H * 3 / 2);
+    return ring;
+}
+
+static void test_empty(void) {
+    size_t size;
+    struct sc_shm_ring *ring = create_ring(3, &size);
+
+    assert(sc_shm_ring_is_valid(ring, size));
+    assert(!sc_shm_ring_is_valid(ring, size - 1));
+
+    struct sc_shm_frame frame;
+    assert(!sc_shm_ring_read_latest(ring, &frame));
+
+    free(ring);
+}
+
+static void test_publish_and_read(void) {
+    size_t size;
+    struct sc_shm_ring *ring = create_ring(3, &size);
+
+    bool ok = publish(ring, 42, 1000);
+    assert(ok);
+
+    struct sc_shm_frame frame;
+    ok = sc_shm_ring_read_latest(ring, &frame);
+    assert(ok);
+
+    assert(frame.seq == 1);
+    assert(frame.pts == 1000);
+    assert(frame.width == W);
+    assert(frame.height == H);
+    // the padding is removed
+    assert(frame.linesize[0] == W);
+    assert(frame.linesize[1] == W / 2);
+    assert(frame.linesize[2] == W / 2);
+
+    for (unsigned i = 0; i < W * H; ++i) {
+        assert(frame.data[0][i] == 42);
+    }
+    for (unsigned i = 0; i < W * H / 4; ++i) {
+        assert(frame.data[1][i] == 43);
+        assert(frame.data[2][i] == 44);
+    }
+
+    assert(sc_shm_ring_validate(&frame));
+
+    free(ring);
+}
+
+static void test_latest(void) {
+    size_t size;
+    struct sc_shm_ring *ring = create_ring(3, &size);
+
+    for (int i = 0; i < 5; ++i) {
+        bool ok = publish(ring, i, i * 100);
+        assert(ok);
+    }
+
+    struct sc_shm_frame frame;
+    bool ok = sc_shm_ring_read_latest(ring, &frame);
+    assert(ok);
+    assert(frame.seq == 5);
+    assert(frame.pts == 400);
+    assert(frame.data[0][0] == 4);
+
+    free(ring);
+}
+
+static void test_overwritten(void) {
+    size_t size;
+    struct sc_shm_ring *ring = create_ring(2, &size);
+
+    bool ok = publish(ring, 1, 0);
+    assert(ok);
+
+    struct sc_shm_frame frame;
+    ok = sc_shm_ring_read_latest(ring, &frame);
+    assert(ok);
+    assert(sc_shm_ring_validate(&frame));
+
+    // the next frame is written to the other slot
+    ok = publish(ring, 2, 0);
+    assert(ok);
+    assert(sc_shm_ring_validate(&frame));
+
+    // this one overwrites the slot of the frame being read
+    ok = publish(ring, 3, 0);
+    assert(ok);
+    assert(!sc_shm_ring_validate(&frame));
+
+    free(ring);
+}
+
+static void test_too_large(void) {
+    size_t size;
+    struct sc_shm_ring *ring = create_ring(2, &size);
+
+    uint8_t big[1024] = {0};
+    const uint8_t *const data[3] = {big, big, big};
+    const int linesize[3] = {32, 16, 16};
+    bool ok = sc_shm_ring_publish(ring, data, linesize, 32, 32, 0);
+    assert(!ok);
+
+    struct sc_shm_frame frame;
+    assert(!sc_shm_ring_read_latest(ring, &frame));
+
+    free(ring);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_empty();
+    test_publish_and_read();
+    test_latest();
+    test_overwritten();
+    test_too_large();
+
+    return 0;
+}
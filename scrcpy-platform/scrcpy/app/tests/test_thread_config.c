@@ -0,0 +1,146 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef __linux__
+# include <sched.h>
+# include <sys/resource.h>
+#endif
+
+#include "util/thread.h"
+
+static bool
+has_cpu(const struct sc_thread_config *config, unsigned cpu) {
+    return config->cpus[cpu / 64] & (UINT64_C(1) << (cpu % 64));
+}
+
+static void test_parse(void) {
+    struct sc_thread_config configs[SC_THREAD_CONFIG_MAX_ROLES];
+    unsigned count;
+    bool ok = sc_thread_config_parse("stream:cpus=0-3,70:fifo=10;"
+                                     "recorder:nice=-5:name=rec;pool",
+                                     configs, &count);
+    assert(ok);
+    assert(count == 3);
+
+    assert(!strcmp(configs[0].role, "stream"));
+    for (unsigned cpu = 0; cpu < 4; ++cpu) {
+        assert(has_cpu(&configs[0], cpu));
+    }
+    assert(!has_cpu(&configs[0], 4));
+    assert(has_cpu(&configs[0], 70));
+    assert(!configs[0].has_nice);
+    assert(configs[0].fifo_priority == 10);
+    assert(!configs[0].name[0]);
+
+    assert(!strcmp(configs[1].role, "recorder"));
+    assert(configs[1].has_nice);
+    assert(configs[1].nice == -5);
+    assert(!configs[1].fifo_priority);
+    assert(!strcmp(configs[1].name, "rec"));
+
+    // a role without attributes keeps the defaults
+    assert(!strcmp(configs[2].role, "pool"));
+    assert(!configs[2].has_nice);
+}
+
+static void test_parse_empty(void) {
+    struct sc_thread_config configs[SC_THREAD_CONFIG_MAX_ROLES];
+    unsigned count;
+    bool ok = sc_thread_config_parse("", configs, &count);
+    assert(ok);
+    assert(count == 0);
+
+    ok = sc_thread_config_parse(";stream:nice=1;", configs, &count);
+    assert(ok);
+    assert(count == 1);
+}
+
+static void test_parse_invalid(void) {
+    struct sc_thread_config configs[SC_THREAD_CONFIG_MAX_ROLES];
+    unsigned count;
+    assert(!sc_thread_config_parse("stream:cpus=", configs, &count));
+    assert(!sc_thread_config_parse("stream:cpus=3-1", configs, &count));
+    assert(!sc_thread_config_parse("stream:cpus=256", configs, &count));
+    assert(!sc_thread_config_parse("stream:cpus=0,,1", configs, &count));
+    assert(!sc_thread_config_parse("stream:nice=20", configs, &count));
+    assert(!sc_thread_config_parse("stream:fifo=0", configs, &count));
+    assert(!sc_thread_config_parse("stream:name=0123456789abcdef", configs,
+                                   &count));
+    assert(!sc_thread_config_parse("stream:unknown=1", configs, &count));
+    assert(!sc_thread_config_parse(":nice=1", configs, &count));
+}
+
+#ifdef __linux__
+struct check {
+    unsigned cpu; // the expected affinity
+    bool configured;
+};
+
+static int
+run_check(void *data) {
+    struct check *check = data;
+
+    cpu_set_t set;
+    int r = sched_getaffinity(0, sizeof(set), &set);
+    assert(!r);
+    (void) r;
+
+    // increasing the nice value is always allowed
+    check->configured = CPU_COUNT(&set) == 1 && CPU_ISSET(check->cpu, &set)
+                     && getpriority(PRIO_PROCESS, 0) == 5;
+    return 0;
+}
+
+static void test_apply(void) {
+    // the process may be restricted to some CPUs (e.g. in a container)
+    cpu_set_t allowed;
+    int r = sched_getaffinity(0, sizeof(allowed), &allowed);
+    assert(!r);
+    (void) r;
+    unsigned cpu = 0;
+    while (cpu < SC_THREAD_CONFIG_MAX_CPUS && !CPU_ISSET(cpu, &allowed)) {
+        ++cpu;
+    }
+    assert(cpu < SC_THREAD_CONFIG_MAX_CPUS);
+
+    char config[64];
+    sprintf(config, "check:cpus=%u:nice=5", cpu);
+    bool ok = sc_thread_config_init(config);
+    assert(ok);
+
+    struct check check = {
+        .cpu = cpu,
+        .configured = false,
+    };
+    sc_thread thread;
+    ok = sc_thread_create(&thread, run_check, "check-1", &check);
+    assert(ok);
+    sc_thread_join(&thread, NULL);
+    assert(check.configured);
+
+    // the other threads are not configured
+    check.configured = true;
+    ok = sc_thread_create(&thread, run_check, "other", &check);
+    assert(ok);
+    sc_thread_join(&thread, NULL);
+    assert(!check.configured);
+
+    ok = sc_thread_config_init("");
+    assert(ok);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_parse();
+    test_parse_empty();
+    test_parse_invalid();
+#ifdef __linux__
+    test_apply();
+#endif
+    return 0;
+}
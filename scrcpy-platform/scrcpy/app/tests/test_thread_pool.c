@@ -0,0 +1,158 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <SDL2/SDL_timer.h>
+
+#include "util/thread_pool.h"
+
+#define WORKERS 4
+#define TASKS 10000
+#define TREE_DEPTH 10 // 2^(TREE_DEPTH+1)-1 tasks
+#define SLOW_TASKS 32
+
+struct counter_task {
+    struct sc_pool_task task;
+    atomic_uint *counter;
+};
+
+static void
+run_counter_task(struct sc_pool_task *task) {
+    struct counter_task *t = container_of(task, struct counter_task, task);
+    atomic_fetch_add(t->counter, 1);
+}
+
+static void test_tasks(void) {
+    struct sc_thread_pool pool;
+    bool ok = sc_thread_pool_init(&pool, WORKERS);
+    assert(ok);
+    (void) ok;
+
+    atomic_uint counter;
+    atomic_init(&counter, 0);
+
+    static struct counter_task tasks[TASKS];
+    for (unsigned i = 0; i < TASKS; ++i) {
+        tasks[i].task.run = run_counter_task;
+        tasks[i].counter = &counter;
+        sc_thread_pool_submit(&pool, &tasks[i].task);
+    }
+
+    // all the pending tasks are executed before the workers are joined
+    sc_thread_pool_destroy(&pool);
+    assert(atomic_load(&counter) == TASKS);
+}
+
+struct tree_task {
+    struct sc_pool_task task;
+    struct sc_thread_pool *pool;
+    atomic_uint *counter;
+    unsigned depth;
+};
+
+static struct tree_task tree_tasks[(1 << (TREE_DEPTH + 1)) - 1];
+
+static void
+run_tree_task(struct sc_pool_task *task) {
+    struct tree_task *t = container_of(task, struct tree_task, task);
+    atomic_fetch_add(t->counter, 1);
+
+    if (t->depth == TREE_DEPTH) {
+        return;
+    }
+
+    // submit the two children (heap layout) from the worker
+    size_t index = t - tree_tasks;
+    for (size_t i = 2 * index + 1; i <= 2 * index + 2; ++i) {
+        struct tree_task *child = &tree_tasks[i];
+        child->task.run = run_tree_task;
+        child->pool = t->pool;
+        child->counter = t->counter;
+        child->depth = t->depth + 1;
+        sc_thread_pool_submit(t->pool, &child->task);
+    }
+}
+
+static void test_submit_from_workers(void) {
+    struct sc_thread_pool pool;
+    bool ok = sc_thread_pool_init(&pool, WORKERS);
+    assert(ok);
+    (void) ok;
+
+    atomic_uint counter;
+    atomic_init(&counter, 0);
+
+    tree_tasks[0].task.run = run_tree_task;
+    tree_tasks[0].pool = &pool;
+    tree_tasks[0].counter = &counter;
+    tree_tasks[0].depth = 0;
+    sc_thread_pool_submit(&pool, &tree_tasks[0].task);
+
+    sc_thread_pool_destroy(&pool);
+    assert(atomic_load(&counter) == ARRAY_LEN(tree_tasks));
+}
+
+struct slow_task {
+    struct sc_pool_task task;
+    atomic_uint *running;
+    atomic_uint *max_running;
+};
+
+static void
+run_slow_task(struct sc_pool_task *task) {
+    struct slow_task *t = container_of(task, struct slow_task, task);
+    unsigned running = atomic_fetch_add(t->running, 1) + 1;
+    unsigned max = atomic_load(t->max_running);
+    while (running > max
+            && !atomic_compare_exchange_weak(t->max_running, &max, running));
+    SDL_Delay(5);
+    atomic_fetch_sub(t->running, 1);
+}
+
+static struct slow_task slow_tasks[SLOW_TASKS];
+static struct sc_thread_pool *slow_pool;
+
+static void
+run_spawn_task(struct sc_pool_task *task) {
+    (void) task;
+    // all the tasks are pushed to the deque of the current worker
+    for (unsigned i = 0; i < SLOW_TASKS; ++i) {
+        sc_thread_pool_submit(slow_pool, &slow_tasks[i].task);
+    }
+}
+
+static void test_steal(void) {
+    struct sc_thread_pool pool;
+    bool ok = sc_thread_pool_init(&pool, WORKERS);
+    assert(ok);
+    (void) ok;
+
+    atomic_uint running;
+    atomic_uint max_running;
+    atomic_init(&running, 0);
+    atomic_init(&max_running, 0);
+    for (unsigned i = 0; i < SLOW_TASKS; ++i) {
+        slow_tasks[i].task.run = run_slow_task;
+        slow_tasks[i].running = &running;
+        slow_tasks[i].max_running = &max_running;
+    }
+
+    slow_pool = &pool;
+    struct sc_pool_task spawn = {.run = run_spawn_task};
+    sc_thread_pool_submit(&pool, &spawn);
+
+    sc_thread_pool_destroy(&pool);
+
+    // the other workers stole tasks from the deque of the first one
+    assert(atomic_load(&max_running) > 1);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_tasks();
+    test_submit_from_workers();
+    test_steal();
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "util/thread.h"
+#include "util/triple_buffer.h"
+
+#define COUNT 100000
+
+static void test_triple_buffer_empty(void) {
+    struct sc_triple_buffer tb;
+    sc_triple_buffer_init(&tb);
+
+    assert(!sc_triple_buffer_has_new(&tb));
+    unsigned index;
+    uint64_t seq;
+    assert(!sc_triple_buffer_acquire(&tb, &index, &seq));
+}
+
+static void test_triple_buffer_latest(void) {
+    struct sc_triple_buffer tb;
+    sc_triple_buffer_init(&tb);
+
+    int slots[3];
+
+    slots[sc_triple_buffer_back(&tb)] = 10;
+    uint64_t seq = sc_triple_buffer_publish(&tb);
+    assert(seq == 1);
+    assert(sc_triple_buffer_has_new(&tb));
+
+    unsigned index;
+    bool ok = sc_triple_buffer_acquire(&tb, &index, &seq);
+    assert(ok);
+    assert(seq == 1);
+    assert(slots[index] == 10);
+    assert(!sc_triple_buffer_has_new(&tb));
+    // acquired only once
+    assert(!sc_triple_buffer_acquire(&tb, &index, &seq));
+
+    // the front slot is never given to the producer
+    unsigned front = index;
+    for (int i = 0; i < 3; ++i) {
+        unsigned back = sc_triple_buffer_back(&tb);
+        assert(back != front);
+        slots[back] = 20 + i;
+        sc_triple_buffer_publish(&tb);
+    }
+    assert(slots[front] == 10);
+
+    // only the latest value is kept
+    ok = sc_triple_buffer_acquire(&tb, &index, &seq);
+    assert(ok);
+    assert(seq == 4);
+    assert(slots[index] == 22);
+
+    (void) ok;
+}
+
+struct shared {
+    struct sc_triple_buffer tb;
+    uint64_t slots[3];
+};
+
+static int
+run_producer(void *data) {
+    struct shared *shared = data;
+    for (uint64_t i = 1; i <= COUNT; ++i) {
+        shared->slots[sc_triple_buffer_back(&shared->tb)] = i;
+        uint64_t seq = sc_triple_buffer_publish(&shared->tb);
+        assert(seq == i);
+        (void) seq;
+    }
+    return 0;
+}
+
+static void test_triple_buffer_threads(void) {
+    struct shared shared;
+    sc_triple_buffer_init(&shared.tb);
+
+    sc_thread thread;
+    bool ok = sc_thread_create(&thread, run_producer, "test", &shared);
+    assert(ok);
+    (void) ok;
+
+    uint64_t last = 0;
+    while (last < COUNT) {
+        unsigned index;
+        uint64_t seq;
+        if (sc_triple_buffer_acquire(&shared.tb, &index, &seq)) {
+            // the slot is never written while it is read
+            assert(shared.slots[index] == seq);
+            assert(seq > last);
+            last = seq;
+        }
+    }
+
+    sc_thread_join(&thread, NULL);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_triple_buffer_empty();
+    test_triple_buffer_latest();
+    test_triple_buffer_threads();
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "v4l2_writer.h"
+
+#define W 8
+#define H 4
+
+static void test_write_regular_file(enum sc_yuv_format format) {
+    char path[] = "/tmp/scrcpy_test_v4l2_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    uint8_t y[W * H];
+    uint8_t u[W * H / 4];
+    uint8_t v[W * H / 4];
+    for (unsigned i = 0; i < sizeof(y); ++i) {
+        y[i] = i;
+    }
+    memset(u, 0x40, sizeof(u));
+    memset(v, 0xC0, sizeof(v));
+
+    struct sc_yuv_image image = {
+        .data = {y, u, v},
+        .linesize = {W, W / 2, W / 2},
+        .width = W,
+        .height = H,
+    };
+
+    // a regular file is not a device, no ioctl must be called
+    struct sc_v4l2_writer writer;
+    bool ok = sc_v4l2_writer_open(&writer, path, format, W, H);
+    assert(ok);
+    assert(!writer.device);
+
+    ok = sc_v4l2_writer_write(&writer, &image);
+    assert(ok);
+    ok = sc_v4l2_writer_write(&writer, &image);
+    assert(ok);
+
+    sc_v4l2_writer_close(&writer);
+
+    size_t frame_size = sc_yuv_image_size(format, W, H);
+    uint8_t expected[W * H * 2];
+    assert(frame_size <= sizeof(expected));
+    sc_yuv_convert(format, &image, expected);
+
+    // the file must contain the 2 frames, one after the other
+    uint8_t content[2 * W * H * 2 + 1];
+    FILE *file = fopen(path, "rb");
+    assert(file);
+    size_t r = fread(content, 1, sizeof(content), file);
+    fclose(file);
+    unlink(path);
+
+    assert(r == 2 * frame_size);
+    assert(!memcmp(content, expected, frame_size));
+    assert(!memcmp(content + frame_size, expected, frame_size));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_write_regular_file(SC_YUV_FORMAT_I420);
+    test_write_regular_file(SC_YUV_FORMAT_NV12);
+    test_write_regular_file(SC_YUV_FORMAT_YUYV);
+    return 0;
+}
@@ -0,0 +1,257 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util/yuv.h"
+
+// width not multiple of 16 to test the tail of the vectorized loops
+#define W 36
+#define H 6
+// padded lines, like in an AVFrame
+#define LINESIZE_Y 64
+#define LINESIZE_C 32
+
+static uint8_t y_plane[LINESIZE_Y * H];
+static uint8_t u_plane[LINESIZE_C * H / 2];
+static uint8_t v_plane[LINESIZE_C * H / 2];
+
+static struct sc_yuv_image init_image(void) {
+    memset(y_plane, 0xFF, sizeof(y_plane));
+    memset(u_plane, 0xFF, sizeof(u_plane));
+    memset(v_plane, 0xFF, sizeof(v_plane));
+
+    for (unsigned i = 0; i < H; ++i) {
+        for (unsigned j = 0; j < W; ++j) {
+            y_plane[i * LINESIZE_Y + j] = i * W + j;
+        }
+    }
+    for (unsigned i = 0; i < H / 2; ++i) {
+        for (unsigned j = 0; j < W / 2; ++j) {
+            u_plane[i * LINESIZE_C + j] = 0x80 + i * W / 2 + j;
+            v_plane[i * LINESIZE_C + j] = 0xC0 - i * W / 2 - j;
+        }
+    }
+
+    struct sc_yuv_image image = {
+        .data = {y_plane, u_plane, v_plane},
+        .linesize = {LINESIZE_Y, LINESIZE_C, LINESIZE_C},
+        .width = W,
+        .height = H,
+    };
+    return image;
+}
+
+static uint8_t get_y(unsigned x, unsigned y) {
+    return y_plane[y * LINESIZE_Y + x];
+}
+
+static uint8_t get_u(unsigned x, unsigned y) {
+    return u_plane[(y / 2) * LINESIZE_C + x / 2];
+}
+
+static uint8_t get_v(unsigned x, unsigned y) {
+    return v_plane[(y / 2) * LINESIZE_C + x / 2];
+}
+
+static void test_image_size(void) {
+    assert(sc_yuv_image_size(SC_YUV_FORMAT_I420, 1920, 1080) == 3110400);
+    assert(sc_yuv_image_size(SC_YUV_FORMAT_NV12, 1920, 1080) == 3110400);
+    assert(sc_yuv_image_size(SC_YUV_FORMAT_YUYV, 1920, 1080) == 4147200);
+}
+
+static void test_convert_i420(void) {
+    struct sc_yuv_image image = init_image();
+    uint8_t out[W * H * 3 / 2];
+    sc_yuv_convert(SC_YUV_FORMAT_I420, &image, out);
+
+    const uint8_t *u_out = &out[W * H];
+    const uint8_t *v_out = &out[W * H + W * H / 4];
+    for (unsigned i = 0; i < H; ++i) {
+        for (unsigned j = 0; j < W; ++j) {
+            assert(out[i * W + j] == get_y(j, i));
+        }
+    }
+    for (unsigned i = 0; i < H / 2; ++i) {
+        for (unsigned j = 0; j < W / 2; ++j) {
+            assert(u_out[i * W / 2 + j] == get_u(2 * j, 2 * i));
+            assert(v_out[i * W / 2 + j] == get_v(2 * j, 2 * i));
+        }
+    }
+}
+
+static void test_convert_nv12(void) {
+    struct sc_yuv_image image = init_image();
+    uint8_t out[W * H * 3 / 2];
+    sc_yuv_convert(SC_YUV_FORMAT_NV12, &image, out);
+
+    const uint8_t *uv_out = &out[W * H];
+    for (unsigned i = 0; i < H; ++i) {
+        for (unsigned j = 0; j < W; ++j) {
+            assert(out[i * W + j] == get_y(j, i));
+        }
+    }
+    for (unsigned i = 0; i < H / 2; ++i) {
+        for (unsigned j = 0; j < W / 2; ++j) {
+            assert(uv_out[i * W + 2 * j] == get_u(2 * j, 2 * i));
+            assert(uv_out[i * W + 2 * j + 1] == get_v(2 * j, 2 * i));
+        }
+    }
+}
+
+static void test_convert_yuyv(void) {
+    struct sc_yuv_image image = init_image();
+    uint8_t out[W * H * 2];
+    sc_yuv_convert(SC_YUV_FORMAT_YUYV, &image, out);
+
+    for (unsigned i = 0; i < H; ++i) {
+        const uint8_t *line = &out[i * W * 2];
+        for (unsigned j = 0; j < W; j += 2) {
+            assert(line[2 * j] == get_y(j, i));
+            assert(line[2 * j + 1] == get_u(j, i));
+            assert(line[2 * j + 2] == get_y(j + 1, i));
+            assert(line[2 * j + 3] == get_v(j, i));
+        }
+    }
+}
+
+static uint8_t clamp(int value) {
+    value >>= 6;
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// BT.601 limited range, in 10.6 fixed point
+static void to_rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t rgb[3]) {
+    int yy = 74 * (y - 16) + ((y - 16) >> 1) + 32;
+    rgb[0] = clamp(yy + 102 * (v - 128));
+    rgb[1] = clamp(yy - 25 * (u - 128) - 52 * (v - 128));
+    rgb[2] = clamp(yy + 129 * (u - 128));
+}
+
+static void test_rgb_line_limits(void) {
+    // black, white and saturated colors
+    uint8_t y[16] = {16, 235, 0, 255, 82, 145, 41, 81, 16, 235, 0, 255, 82,
+                     145, 41, 81};
+    uint8_t u[8] = {128, 0, 255, 90, 128, 0, 255, 90};
+    uint8_t v[8] = {128, 255, 0, 240, 128, 255, 0, 240};
+    uint8_t out[16 * 3];
+    sc_yuv_to_rgb_line(SC_RGB_FORMAT_BGR24, y, u, v, out, 16);
+
+    // black
+    assert(out[0] == 0 && out[1] == 0 && out[2] == 0);
+    // white
+    assert(out[3] == 255 && out[4] == 255 && out[5] == 255);
+
+    for (unsigned i = 0; i < 16; ++i) {
+        uint8_t rgb[3];
+        to_rgb(y[i], u[i / 2], v[i / 2], rgb);
+        assert(out[3 * i] == rgb[2]);
+        assert(out[3 * i + 1] == rgb[1]);
+        assert(out[3 * i + 2] == rgb[0]);
+    }
+}
+
+static void test_rgb_formats(void) {
+    struct sc_yuv_image image = init_image();
+    for (unsigned i = 0; i < H; ++i) {
+        const uint8_t *y = &y_plane[i * LINESIZE_Y];
+        const uint8_t *u = &u_plane[(i / 2) * LINESIZE_C];
+        const uint8_t *v = &v_plane[(i / 2) * LINESIZE_C];
+
+        uint8_t bgr[W * 3];
+        uint8_t rgba[W * 4];
+        uint8_t bgra[W * 4];
+        sc_yuv_to_rgb_line(SC_RGB_FORMAT_BGR24, y, u, v, bgr, W);
+        sc_yuv_to_rgb_line(SC_RGB_FORMAT_RGBA, y, u, v, rgba, W);
+        sc_yuv_to_rgb_line(SC_RGB_FORMAT_BGRA, y, u, v, bgra, W);
+
+        // the vectorized loops and the tail must give the same results
+        for (unsigned j = 0; j < W; ++j) {
+            uint8_t rgb[3];
+            to_rgb(get_y(j, i), get_u(j, i), get_v(j, i), rgb);
+            assert(bgr[3 * j] == rgb[2]);
+            assert(bgr[3 * j + 1] == rgb[1]);
+            assert(bgr[3 * j + 2] == rgb[0]);
+            assert(rgba[4 * j] == rgb[0]);
+            assert(rgba[4 * j + 1] == rgb[1]);
+            assert(rgba[4 * j + 2] == rgb[2]);
+            assert(rgba[4 * j + 3] == 0xFF);
+            assert(bgra[4 * j] == rgb[2]);
+            assert(bgra[4 * j + 1] == rgb[1]);
+            assert(bgra[4 * j + 2] == rgb[0]);
+            assert(bgra[4 * j + 3] == 0xFF);
+        }
+    }
+    (void) image;
+}
+
+static void test_scale_same_size(void) {
+    struct sc_yuv_image image = init_image();
+    struct sc_yuv_scaler scaler;
+    bool ok = sc_yuv_scaler_init(&scaler, SC_RGB_FORMAT_RGBA, W, H);
+    assert(ok);
+    (void) ok;
+
+    // padded destination lines
+    size_t stride = W * 4 + 8;
+    uint8_t out[(W * 4 + 8) * H];
+    sc_yuv_scale_to_rgb(&scaler, &image, out, stride);
+
+    for (unsigned i = 0; i < H; ++i) {
+        for (unsigned j = 0; j < W; ++j) {
+            uint8_t rgb[3];
+            to_rgb(get_y(j, i), get_u(j, i), get_v(j, i), rgb);
+            assert(!memcmp(&out[i * stride + 4 * j], rgb, 3));
+        }
+    }
+
+    sc_yuv_scaler_destroy(&scaler);
+}
+
+static void test_scale(void) {
+    struct sc_yuv_image image = init_image();
+
+    // downscale by 2 horizontally, upscale by 2 vertically
+    const unsigned w = W / 2;
+    const unsigned h = H * 2;
+    struct sc_yuv_scaler scaler;
+    bool ok = sc_yuv_scaler_init(&scaler, SC_RGB_FORMAT_BGR24, w, h);
+    assert(ok);
+    (void) ok;
+
+    uint8_t out[W / 2 * 3 * H * 2];
+    sc_yuv_scale_to_rgb(&scaler, &image, out, w * 3);
+
+    for (unsigned i = 0; i < h; ++i) {
+        unsigned sy = i / 2;
+        for (unsigned j = 0; j < w; ++j) {
+            // the center of the destination pixel
+            unsigned sx = 2 * j + 1;
+            // the pixels of a pair share the chroma of the first one
+            unsigned cx = 2 * (j & ~1u) + 1;
+            uint8_t rgb[3];
+            to_rgb(get_y(sx, sy), get_u(cx, sy), get_v(cx, sy), rgb);
+            const uint8_t *px = &out[(i * w + j) * 3];
+            assert(px[0] == rgb[2]);
+            assert(px[1] == rgb[1]);
+            assert(px[2] == rgb[0]);
+        }
+    }
+
+    sc_yuv_scaler_destroy(&scaler);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_image_size();
+    test_convert_i420();
+    test_convert_nv12();
+    test_convert_yuyv();
+    test_rgb_line_limits();
+    test_rgb_formats();
+    test_scale_same_size();
+    test_scale();
+    return 0;
+}
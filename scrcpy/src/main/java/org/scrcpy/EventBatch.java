@@ -0,0 +1,132 @@
+package org.scrcpy;
+
+import org.bytedeco.javacpp.Pointer;
+import org.scrcpy.platform.ScrcpyLibrary;
+
+import java.awt.*;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import static org.scrcpy.platform.ScrcpyLibrary.*;
+
+/**
+ * Batch of input events, pushed at once with {@code scrcpy_push_events()}.
+ * <p>
+ * The events are written directly into a reusable direct buffer (with the layout of
+ * {@code struct scrcpy_event}), so adding an event neither allocates nor crosses JNI: a whole
+ * gesture costs a single native call and a single wakeup of the controller.
+ * <p>
+ * Not thread-safe.
+ */
+public class EventBatch {
+    // offsets in struct scrcpy_event (see scrcpy.h)
+    private static final int TYPE = 0;
+    private static final int ACTION = 4;
+    private static final int POINTER_ID = 8;
+    private static final int X = 16;
+    private static final int Y = 20;
+    private static final int SCREEN_WIDTH = 24;
+    private static final int SCREEN_HEIGHT = 26;
+    private static final int PRESSURE = 28;
+    private static final int BUTTONS = 32;
+    private static final int KEYCODE = 36;
+    private static final int METASTATE = 40;
+    private static final int REPEAT = 44;
+    private static final int HSCROLL = 48;
+    private static final int VSCROLL = 52;
+
+    private final ScrcpyLibrary.scrcpy_process process;
+    private final ByteBuffer buffer;
+    private final scrcpy_event events;
+    private final int capacity;
+    private int count;
+
+    EventBatch(ScrcpyLibrary.scrcpy_process process, int capacity) {
+        if (capacity <= 0 || capacity > SCRCPY_MAX_EVENTS) {
+            throw new IllegalArgumentException("Invalid capacity: " + capacity);
+        }
+        this.process = process;
+        this.capacity = capacity;
+        buffer = ByteBuffer.allocateDirect(capacity * SCRCPY_EVENT_SIZE).order(ByteOrder.nativeOrder());
+        events = new scrcpy_event(new Pointer(buffer));
+    }
+
+    private int next(int type) {
+        if (count == capacity) {
+            throw new IllegalStateException("Event batch is full (" + capacity + " events)");
+        }
+        int offset = count++ * SCRCPY_EVENT_SIZE;
+        // reset the previous content of the slot
+        for (int i = 0; i < SCRCPY_EVENT_SIZE; i += 8) {
+            buffer.putLong(offset + i, 0);
+        }
+        buffer.putInt(offset + TYPE, type);
+        return offset;
+    }
+
+    private void putPosition(int offset, Point p, Dimension screenSize) {
+        buffer.putInt(offset + X, p.x);
+        buffer.putInt(offset + Y, p.y);
+        buffer.putShort(offset + SCREEN_WIDTH, (short) screenSize.width);
+        buffer.putShort(offset + SCREEN_HEIGHT, (short) screenSize.height);
+    }
+
+    public EventBatch touch(int action, long pointerId, Point p, Dimension screenSize, float pressure, int buttons) {
+        int offset = next(CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+        buffer.putInt(offset + ACTION, action);
+        buffer.putLong(offset + POINTER_ID, pointerId);
+        putPosition(offset, p, screenSize);
+        buffer.putFloat(offset + PRESSURE, pressure);
+        buffer.putInt(offset + BUTTONS, buttons);
+        return this;
+    }
+
+    public EventBatch key(int action, int keycode, int repeat, int metastate) {
+        int offset = next(CONTROL_MSG_TYPE_INJECT_KEYCODE);
+        buffer.putInt(offset + ACTION, action);
+        buffer.putInt(offset + KEYCODE, keycode);
+        buffer.putInt(offset + REPEAT, repeat);
+        buffer.putInt(offset + METASTATE, metastate);
+        return this;
+    }
+
+    public EventBatch scroll(Point p, Dimension screenSize, int hscroll, int vscroll) {
+        int offset = next(CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT);
+        putPosition(offset, p, screenSize);
+        buffer.putInt(offset + HSCROLL, hscroll);
+        buffer.putInt(offset + VSCROLL, vscroll);
+        return this;
+    }
+
+    /**
+     * Add an event without payload (e.g. {@code CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL}), or with only an action
+     * (e.g. {@code CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON}).
+     */
+    public EventBatch command(int type, int action) {
+        int offset = next(type);
+        buffer.putInt(offset + ACTION, action);
+        return this;
+    }
+
+    public int size() {
+        return count;
+    }
+
+    public void clear() {
+        count = 0;
+    }
+
+    /**
+     * Push all the events of the batch, then clear it.
+     *
+     * @return false if the events could not be pushed (the controller queue is full or stopped)
+     */
+    public boolean flush() {
+        if (count == 0) {
+            return true;
+        }
+        boolean ok = scrcpy_push_events(process, events, count);
+        count = 0;
+        return ok;
+    }
+}
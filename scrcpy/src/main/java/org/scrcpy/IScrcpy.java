@@ -29,6 +29,7 @@ public interface IScrcpy {
         opt.max_size((short) 0);
         opt.bit_rate(DEFAULT_BIT_RATE);
         opt.max_fps((short) 0);
+        opt.gesture_rate((short) DEFAULT_GESTURE_RATE);
         opt.lock_video_orientation(SC_LOCK_VIDEO_ORIENTATION_UNLOCKED);
         opt.rotation((byte) 0);
         opt.window_x((short) SC_WINDOW_POSITION_UNDEFINED);
@@ -52,6 +53,7 @@ public interface IScrcpy {
         opt.forward_all_clicks(false);
         opt.legacy_paste(false);
         opt.power_off_on_close(false);
+        opt.coalesce_moves(false);
         // changes from default
         opt.force_decoder(true);
         opt.display(false);
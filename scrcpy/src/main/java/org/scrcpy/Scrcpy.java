@@ -1,9 +1,7 @@
 package org.scrcpy;
 
 import org.bytedeco.ffmpeg.avutil.AVFrame;
-import org.bytedeco.ffmpeg.global.swscale;
-import org.bytedeco.ffmpeg.swscale.SwsContext;
-import org.bytedeco.javacpp.DoublePointer;
+import org.bytedeco.javacpp.BytePointer;
 import org.bytedeco.javacpp.Pointer;
 import org.scrcpy.platform.ScrcpyLibrary;
 
@@ -11,12 +9,13 @@ import java.awt.*;
 import java.awt.event.MouseEvent;
 import java.awt.image.BufferedImage;
 import java.awt.image.DataBufferByte;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
 import java.util.HashMap;
+import java.util.List;
 import java.util.Map;
 import java.util.function.Consumer;
 
-import static org.bytedeco.ffmpeg.global.avutil.*;
-import static org.bytedeco.ffmpeg.global.swscale.sws_scale;
 import static org.scrcpy.platform.ScrcpyLibrary.*;
 
 /**
@@ -24,23 +23,359 @@ import static org.scrcpy.platform.ScrcpyLibrary.*;
  */
 public class Scrcpy implements IScrcpy {
     private final ScrcpyLibrary.scrcpy_options options;
-    private ScrcpyLibrary.scrcpy_process process = null;
+    // reset on stop()
+    private volatile ScrcpyLibrary.scrcpy_process process = null;
+    private volatile boolean stopped; // set under gestureLock
+    // reused for mouseDown()/mouseUp()
+    private EventBatch mouseEvents;
+    // referenced so that it is not garbage collected while registered
+    private ClipboardListener clipboardListener;
+    // protects the screen listeners, each delivering its frames from its own thread
+    private final Object deliveryLock = new Object();
+    private boolean deliveryStopped; // protected by deliveryLock
+    // a gesture may wait for the previous one, without blocking the other events
+    private final Object gestureLock = new Object();
+    // held while a latest frame is acquired or released, so that stop() can wait for them
+    private final Object latestFrameLock = new Object();
+    private boolean latestFrameStopped; // protected by latestFrameLock
+    private LatestFrame acquiredFrame; // protected by latestFrameLock
 
     public Scrcpy(ScrcpyLibrary.scrcpy_options options) {
         this.options = options;
 
     }
 
+    /**
+     * Wrap a session started by a {@link ScrcpyFleet} (which stops it).
+     */
+    Scrcpy(ScrcpyLibrary.scrcpy_process process) {
+        this.options = null;
+        this.process = process;
+        mouseEvents = new EventBatch(process, 1);
+    }
+
     public boolean start() {
         this.process = ScrcpyLibrary.scrcpy_start(this.options);
-        return process != null;
+        if (process == null) {
+            return false;
+        }
+        mouseEvents = new EventBatch(process, 1);
+        return true;
     }
 
     public void stop() {
         if (process == null) {
             return;
         }
-        ScrcpyLibrary.scrcpy_stop(this.process);
+        if (options == null) {
+            throw new IllegalStateException("The session is stopped by its fleet");
+        }
+        // wait for the gesture being started, if any, so that it does not race with the stop,
+        // and make the next calls fail
+        synchronized (gestureLock) {
+            if (stopped) {
+                return;
+            }
+            stopped = true;
+        }
+        stopDelivery();
+        stopLatestFrame();
+        ScrcpyLibrary.scrcpy_process process = this.process;
+        this.process = null;
+        ScrcpyLibrary.scrcpy_stop(process);
+    }
+
+    /**
+     * Create a batch of events, to push many events (e.g. a whole gesture) at once.
+     *
+     * @param capacity the maximum number of events in the batch (at most {@code SCRCPY_MAX_EVENTS})
+     */
+    public EventBatch createEventBatch(int capacity) {
+        if (process == null) {
+            throw new IllegalStateException("Scrcpy Process is not started");
+        }
+        return new EventBatch(process, capacity);
+    }
+
+    private void checkStarted() {
+        if (stopped) {
+            throw new IllegalStateException("Scrcpy Process is stopped");
+        }
+        if (process == null) {
+            throw new IllegalStateException("Scrcpy Process is not started");
+        }
+    }
+
+    /**
+     * Receive the device clipboard changes (instead of copying them to the computer clipboard).
+     * <p>
+     * The listener is called from the native receiver thread. Pass {@code null} to restore the
+     * default behavior.
+     */
+    public synchronized void setClipboardListener(Consumer<String> listener) {
+        checkStarted();
+        ClipboardListener callback = listener == null ? null : new ClipboardListener(listener);
+        ScrcpyLibrary.scrcpy_set_clipboard_listener(process, callback, null);
+        // the previous listener may only be released once unregistered
+        clipboardListener = callback;
+    }
+
+    private static class ClipboardListener extends On_clipboard_Pointer_BytePointer {
+        final Consumer<String> listener;
+
+        ClipboardListener(Consumer<String> listener) {
+            this.listener = listener;
+        }
+
+        @Override
+        public void call(Pointer userdata, BytePointer text) {
+            listener.accept(text.getString(StandardCharsets.UTF_8));
+        }
+    }
+
+    // referenced so that it is not garbage collected while registered
+    private static LogListener logListener;
+
+    /**
+     * Receive the native log messages of all the sessions (instead of writing them to stderr).
+     * <p>
+     * The listener is called from a single native background thread, with the timestamp in
+     * microseconds (monotonic clock) and the {@code sc_log_level}. Pass {@code null} to restore
+     * the default output.
+     */
+    public static synchronized void setLogListener(LogListenerCallback listener) {
+        LogListener callback = listener == null ? null : new LogListener(listener);
+        ScrcpyLibrary.scrcpy_set_log_callback(callback, null);
+        // the previous listener may only be released once unregistered
+        logListener = callback;
+    }
+
+    public interface LogListenerCallback {
+        void onLog(long timestamp, int level, String message);
+    }
+
+    private static class LogListener extends Callback_Pointer_long_int_BytePointer {
+        final LogListenerCallback listener;
+
+        LogListener(LogListenerCallback listener) {
+            this.listener = listener;
+        }
+
+        @Override
+        public void call(Pointer userdata, long timestamp, int level, BytePointer message) {
+            listener.onLog(timestamp, level, message.getString(StandardCharsets.UTF_8));
+        }
+    }
+
+    /**
+     * Swipe from {@code from} to {@code to}, generated and timed natively.
+     * <p>
+     * Gestures never overlap: if a gesture is in progress, wait for it to complete first. Only the
+     * other gestures wait, the other events (e.g. {@link #mouseDown(Point, int)}) are not blocked.
+     *
+     * @return false if the gesture could not be started
+     */
+    public boolean swipe(Point from, Point to, int durationMs) {
+        synchronized (gestureLock) {
+            checkStarted();
+            return ScrcpyLibrary.scrcpy_swipe(process, from.x, from.y, to.x, to.y, durationMs);
+        }
+    }
+
+    /**
+     * Swipe along a cubic Bézier curve, with control points {@code c1} and {@code c2}.
+     */
+    public boolean swipe(Point from, Point c1, Point c2, Point to, int durationMs) {
+        synchronized (gestureLock) {
+            checkStarted();
+            return ScrcpyLibrary.scrcpy_swipe_bezier(process, from.x, from.y, c1.x, c1.y, c2.x,
+                    c2.y, to.x, to.y, durationMs);
+        }
+    }
+
+    /**
+     * Two-finger pinch around {@code center}: the distance between the fingers goes from
+     * {@code startSpan} to {@code endSpan}, and their angle (in degrees) from {@code startAngle} to
+     * {@code endAngle}.
+     */
+    public boolean pinch(Point center, int startSpan, int endSpan, float startAngle,
+                         float endAngle, int durationMs) {
+        synchronized (gestureLock) {
+            checkStarted();
+            return ScrcpyLibrary.scrcpy_pinch(process, center.x, center.y, (short) startSpan,
+                    (short) endSpan, startAngle, endAngle, durationMs);
+        }
+    }
+
+    /**
+     * Fling from {@code from} to {@code to}, released at {@code velocity} pixels per second.
+     */
+    public boolean fling(Point from, Point to, float velocity) {
+        synchronized (gestureLock) {
+            checkStarted();
+            return ScrcpyLibrary.scrcpy_fling(process, from.x, from.y, to.x, to.y, velocity);
+        }
+    }
+
+    /**
+     * Request a round-trip time measurement of the control channel.
+     */
+    public boolean ping() {
+        checkStarted();
+        return ScrcpyLibrary.scrcpy_ping(process);
+    }
+
+    /**
+     * Get the round-trip times of the control channel measured so far, in microseconds.
+     */
+    public ScrcpyLibrary.scrcpy_rtt_stats getRttStats() {
+        checkStarted();
+        ScrcpyLibrary.scrcpy_rtt_stats stats = new ScrcpyLibrary.scrcpy_rtt_stats();
+        if (!ScrcpyLibrary.scrcpy_get_rtt_stats(process, stats)) {
+            return null;
+        }
+        return stats;
+    }
+
+    /**
+     * Get the number of reconnections after a disconnection of the device, and the total downtime (in
+     * microseconds).
+     */
+    public ScrcpyLibrary.scrcpy_reconnect_stats getReconnectStats() {
+        checkStarted();
+        ScrcpyLibrary.scrcpy_reconnect_stats stats = new ScrcpyLibrary.scrcpy_reconnect_stats();
+        ScrcpyLibrary.scrcpy_get_reconnect_stats(process, stats);
+        return stats;
+    }
+
+    /**
+     * Get a snapshot of the metrics of the session (cumulative counters, queue depths and decode
+     * times in microseconds).
+     */
+    public ScrcpyLibrary.scrcpy_metrics getMetrics() {
+        checkStarted();
+        ScrcpyLibrary.scrcpy_metrics metrics = new ScrcpyLibrary.scrcpy_metrics();
+        ScrcpyLibrary.scrcpy_get_metrics(process, metrics);
+        return metrics;
+    }
+
+    /**
+     * Get the statistics of the frames rendered during the last {@code windowUs} microseconds (0 for
+     * one second), or {@code null} if the session has no display.
+     */
+    public ScrcpyLibrary.scrcpy_fps_stats getFpsStats(long windowUs) {
+        checkStarted();
+        ScrcpyLibrary.scrcpy_fps_stats stats = new ScrcpyLibrary.scrcpy_fps_stats();
+        if (!ScrcpyLibrary.scrcpy_get_fps_stats(process, windowUs, stats)) {
+            return null;
+        }
+        return stats;
+    }
+
+    /**
+     * A decoded frame acquired by {@link #acquireLatestFrame(long)}, valid until closed.
+     */
+    public final class LatestFrame implements AutoCloseable {
+        private final AVFrame frame;
+        private final long seq;
+
+        private LatestFrame(AVFrame frame, long seq) {
+            this.frame = frame;
+            this.seq = seq;
+        }
+
+        public AVFrame frame() {
+            return frame;
+        }
+
+        /**
+         * The sequence number of the frame (consecutive, starting at 1): a gap between two acquired
+         * frames is the number of frames skipped.
+         */
+        public long seq() {
+            return seq;
+        }
+
+        /**
+         * Release the frame (closing it again has no effect). The frames are released anyway when
+         * the session is stopped.
+         */
+        @Override
+        public void close() {
+            synchronized (latestFrameLock) {
+                if (acquiredFrame != this) {
+                    // already closed
+                    return;
+                }
+                acquiredFrame = null;
+                if (!latestFrameStopped) {
+                    ScrcpyLibrary.scrcpy_release_frame(process);
+                }
+            }
+        }
+    }
+
+    /**
+     * Poll the latest decoded frame, without any callback from the decoder thread (requires the
+     * option {@code latest_frame}).
+     *
+     * <p>If no new frame has been decoded since the last call, wait at most {@code timeoutUs}
+     * microseconds (0 to return immediately, negative to wait until a frame is decoded or the stream
+     * ends). The returned frame must be closed before acquiring another one.
+     *
+     * <p>A call in progress is woken up when the session is stopped.
+     *
+     * @return the latest frame, or {@code null} if there is no new frame (or the session is
+     * stopped)
+     */
+    public LatestFrame acquireLatestFrame(long timeoutUs) {
+        checkStarted();
+        synchronized (latestFrameLock) {
+            if (latestFrameStopped) {
+                return null;
+            }
+            if (acquiredFrame != null) {
+                throw new IllegalStateException("The previous frame is not closed");
+            }
+            long[] seq = new long[1];
+            Pointer frame = ScrcpyLibrary.scrcpy_acquire_latest_frame(process, timeoutUs, seq);
+            if (frame == null) {
+                return null;
+            }
+            acquiredFrame = new LatestFrame(new AVFrame(frame), seq[0]);
+            return acquiredFrame;
+        }
+    }
+
+    /**
+     * Wake up an {@link #acquireLatestFrame(long)} in progress and wait for it to return, so that
+     * no frame is accessed anymore. Must be called before the native session is stopped.
+     */
+    void stopLatestFrame() {
+        // not under the lock, which may be held by a waiting acquisition
+        ScrcpyLibrary.scrcpy_interrupt_latest_frame(process);
+        synchronized (latestFrameLock) {
+            latestFrameStopped = true;
+            // an acquired frame is freed by the session
+            acquiredFrame = null;
+        }
+    }
+
+    /**
+     * Format the metrics of all the running sessions in the Prometheus text format.
+     */
+    public static String formatMetrics() {
+        long len = ScrcpyLibrary.scrcpy_format_metrics((BytePointer) null, 0);
+        for (;;) {
+            // a session may start meanwhile
+            try (BytePointer buf = new BytePointer(len + 1024)) {
+                long r = ScrcpyLibrary.scrcpy_format_metrics(buf, buf.capacity());
+                if (r < buf.capacity()) {
+                    return buf.getString(StandardCharsets.UTF_8);
+                }
+                len = r;
+            }
+        }
     }
 
     @Override
@@ -53,97 +388,130 @@ public class Scrcpy implements IScrcpy {
 
 
     // TODO: some way to unregister?
+    // protected by deliveryLock
     private final Map<Consumer<BufferedImage>, ScreenListener> listeners = new HashMap<>();
 
+    /**
+     * Deliver the frames to {@code onScreenRefresh}, scaled to {@code size}, from a dedicated
+     * thread.
+     *
+     * @throws IllegalStateException if the session is stopped
+     */
     @Override
     public void registerScreenListener(Dimension size, Consumer<BufferedImage> onScreenRefresh) {
-        ScreenListener listener = new ScreenListener(originalSize(), size, onScreenRefresh);
-        listeners.put(onScreenRefresh, listener);
+        synchronized (deliveryLock) {
+            if (deliveryStopped) {
+                throw new IllegalStateException("The frame delivery is stopped");
+            }
+            ScreenListener listener = new ScreenListener(size, onScreenRefresh);
+            listeners.put(onScreenRefresh, listener);
+        }
     }
 
-    private static class DummyOpenFunction extends Open_Pointer {
-        @Override
-        public boolean call(Pointer sink) {
-            return true;
+    /**
+     * The number of frames of the listener which have been dropped because the previous one was
+     * still being delivered.
+     */
+    public long getDroppedFrames(Consumer<BufferedImage> onScreenRefresh) {
+        ScreenListener listener;
+        synchronized (deliveryLock) {
+            listener = listeners.get(onScreenRefresh);
         }
+        return listener != null ? listener.getDroppedFrames() : 0;
     }
 
-    private static class DummyCloseFunction extends Close_Pointer {
-        @Override
-        public void call(Pointer sink) {
+    /**
+     * Stop delivering the frames to the screen listeners, once the current deliveries (if any) are
+     * finished. Must be called before the native session is stopped.
+     */
+    void stopDelivery() {
+        List<ScreenListener> stopped;
+        synchronized (deliveryLock) {
+            deliveryStopped = true;
+            stopped = new ArrayList<>(listeners.values());
+        }
+        for (ScreenListener listener : stopped) {
+            listener.stop();
         }
     }
 
-    private static DummyOpenFunction DUMMY_OPEN = new DummyOpenFunction();
-    private static DummyCloseFunction DUMMY_CLOSE = new DummyCloseFunction();
-
-    private class ScreenListener extends Push_Pointer_Pointer {
-        final Dimension frameSize;
-        final Dimension targetSize;
+    private class ScreenListener implements Runnable {
         final Consumer<BufferedImage> onScreenRefresh;
-        final BufferedImage img;
-        final AVFrame rgbFrame;
-        final SwsContext swsContext;
-
-        public ScreenListener(Dimension frameSize, Dimension targetSize, Consumer<BufferedImage> onScreenRefresh) {
-            this.frameSize = frameSize;
-            this.targetSize = targetSize;
+        // Double buffering: the image last delivered is not written until the next one is
+        // delivered
+        final BufferedImage[] images = new BufferedImage[2];
+        int nextImage; // accessed only by the delivery thread
+        // written by the native sink, in the layout of the images
+        final BytePointer rgbBuffer;
+        final scrcpy_rgb_sink sink;
+        final Thread thread;
+
+        public ScreenListener(Dimension targetSize, Consumer<BufferedImage> onScreenRefresh) {
             this.onScreenRefresh = onScreenRefresh;
 
-            img = new BufferedImage(targetSize.width,
-                    targetSize.height, BufferedImage.TYPE_3BYTE_BGR);
-
-            rgbFrame = av_frame_alloc();
-            rgbFrame.format(AV_PIX_FMT_BGR24);
-            rgbFrame.width(targetSize.width);
-            rgbFrame.height(targetSize.height);
-            // align must be 1 for this to work, as Java aligns to 1
-            int ret = av_image_alloc(rgbFrame.data(),
-                    rgbFrame.linesize(),
-                    rgbFrame.width(),
-                    rgbFrame.height(),
-                    rgbFrame.format(),
-                    1);
-            if (ret < 0) {
-                throw new RuntimeException("could not allocate buffer!");
+            for (int i = 0; i < images.length; ++i) {
+                images[i] = new BufferedImage(targetSize.width,
+                        targetSize.height, BufferedImage.TYPE_3BYTE_BGR);
             }
 
-            // Use this to scale inside ffmpeg. Faster than doing it in Java
-            swsContext = swscale.sws_getContext(
-                    frameSize.width, frameSize.height, AV_PIX_FMT_YUV420P,
-                    rgbFrame.width(), rgbFrame.height(), rgbFrame.format(),
-                    0, null, null, (DoublePointer) null);
-
-            ScrcpyLibrary.scrcpy_add_sink(process, DUMMY_OPEN, DUMMY_CLOSE, this);
-        }
+            // Java aligns the lines to 1
+            long stride = 3L * targetSize.width;
+            rgbBuffer = new BytePointer(stride * targetSize.height);
 
-        @Override
-        public boolean call(Pointer sink, Pointer avframe_ptr) {
-            AVFrame yuv420Frame = new AVFrame(avframe_ptr);
-            sws_scale(swsContext, yuv420Frame.data(), yuv420Frame.linesize(), 0,
-                    yuv420Frame.height(), rgbFrame.data(), rgbFrame.linesize());
-            DataBufferByte buffer = (DataBufferByte) img.getRaster().getDataBuffer();
-            rgbFrame.data(0).get(buffer.getData());
+            // The decoder thread only keeps the latest frame: it is converted and scaled natively
+            // on the delivery thread, without intermediate frame
+            sink = ScrcpyLibrary.scrcpy_add_rgb_sink(process, SCRCPY_RGB_FORMAT_BGR24,
+                    targetSize.width, targetSize.height, rgbBuffer, stride);
+            if (sink == null) {
+                throw new RuntimeException("could not add RGB sink!");
+            }
 
-            onScreenRefresh.accept(img);
-            return true;
+            thread = new Thread(this, "scrcpy-delivery");
+            thread.setDaemon(true);
+            thread.start();
         }
-    }
-
-    private _position toPosition(Point p) {
-        point point = new point();
-        point.x(p.x);
-        point.y(p.y);
 
-        size sz = new size();
-        sz.width(process.frame_size().width());
-        sz.height(process.frame_size().height());
+        long getDroppedFrames() {
+            return ScrcpyLibrary.scrcpy_rgb_sink_get_skipped(sink);
+        }
 
-        _position pos = new _position();
-        pos.point(point);
-        pos.screen_size(sz);
+        void stop() {
+            // wake up the delivery thread if it is waiting for a frame
+            ScrcpyLibrary.scrcpy_rgb_sink_interrupt(sink);
+            if (Thread.currentThread() == thread) {
+                // called by the listener, the delivery in progress is this one
+                return;
+            }
+            boolean interrupted = false;
+            for (;;) {
+                try {
+                    thread.join();
+                    break;
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+            if (interrupted) {
+                Thread.currentThread().interrupt();
+            }
+        }
 
-        return pos;
+        @Override
+        public void run() {
+            // wait for a new frame, until the sink is interrupted or the stream ends
+            while (ScrcpyLibrary.scrcpy_rgb_sink_convert(sink, -1)) {
+                BufferedImage img = images[nextImage];
+                nextImage = (nextImage + 1) % images.length;
+
+                // The pixels of a BufferedImage are in a Java array, which native code can not
+                // write outside of a JNI call: the frame is converted into native memory, then
+                // copied once
+                DataBufferByte buffer = (DataBufferByte) img.getRaster().getDataBuffer();
+                rgbBuffer.position(0).get(buffer.getData());
+
+                onScreenRefresh.accept(img);
+            }
+        }
     }
 
     public static int convertButtons(int javaButton) {
@@ -160,36 +528,22 @@ public class Scrcpy implements IScrcpy {
         return androidButton;
     }
 
+    private synchronized void pushMouseEvent(int action, Point p, int buttons, float pressure) {
+        Dimension screenSize = originalSize();
+        mouseEvents.touch(action, POINTER_ID_MOUSE, p, screenSize, pressure, convertButtons(buttons));
+        mouseEvents.flush();
+    }
+
     @Override
     public void mouseDown(Point p, int buttons) {
-        control_msg msg = new control_msg();
-        msg.type(CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
-
-        msg.inject_touch_event_pointer_id(POINTER_ID_MOUSE);
-        msg.inject_touch_event_position(toPosition(p));
         // 1.0 => down
-        // 0.0 => up
-        msg.inject_touch_event_pressure(1.0f);
-        msg.inject_touch_event_buttons(convertButtons(buttons));
-        msg.inject_touch_event_action(AMOTION_EVENT_ACTION_DOWN);
-        System.out.format("Mouse Pressed Scrcpy action=%d %d %d  press=%.1f btn=%d\n", msg.inject_touch_event_action(), p.x, p.y, msg.inject_touch_event_pressure(), msg.inject_touch_event_buttons());
-        scrcpy_push_event(process, msg);
+        pushMouseEvent(AMOTION_EVENT_ACTION_DOWN, p, buttons, 1.0f);
     }
 
     @Override
     public void mouseUp(Point p, int buttons) {
-        control_msg msg = new control_msg();
-        msg.type(CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
-
-        msg.inject_touch_event_pointer_id(POINTER_ID_MOUSE);
-        msg.inject_touch_event_position(toPosition(p));
-        // 1.0 => down
         // 0.0 => up
-        msg.inject_touch_event_pressure(0.0f);
-        msg.inject_touch_event_buttons(convertButtons(buttons));
-        msg.inject_keycode_action(AMOTION_EVENT_ACTION_UP);
-        System.out.format("Mouse Up Scrcpy action=%d %d %d  press=%.1f btn=%d\n", msg.inject_touch_event_action(), p.x, p.y, msg.inject_touch_event_pressure(), msg.inject_touch_event_buttons());
-        scrcpy_push_event(process, msg);
+        pushMouseEvent(AMOTION_EVENT_ACTION_UP, p, buttons, 0.0f);
     }
 
 }
@@ -0,0 +1,92 @@
+package org.scrcpy;
+
+import org.bytedeco.javacpp.BytePointer;
+import org.bytedeco.javacpp.Pointer;
+import org.scrcpy.platform.ScrcpyLibrary;
+
+import java.nio.charset.StandardCharsets;
+import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+
+import static org.scrcpy.platform.ScrcpyLibrary.*;
+
+/**
+ * One scrcpy session per connected device, started and stopped automatically when devices are
+ * plugged or unplugged.
+ * <p>
+ * The record filenames of the options must contain {@code "%s"}, replaced by the serial of each
+ * device. The recordings of all the sessions share a pool of native threads (one per CPU core).
+ * The sessions have no display: the option {@code display} must be false.
+ */
+public class ScrcpyFleet {
+    private final ScrcpyLibrary.scrcpy_options options;
+    private final Map<String, Scrcpy> sessions = new ConcurrentHashMap<>();
+    // referenced so that it is not garbage collected while the fleet is running
+    private SessionListener sessionListener;
+    private ScrcpyLibrary.scrcpy_fleet fleet = null;
+
+    public ScrcpyFleet(ScrcpyLibrary.scrcpy_options options) {
+        this.options = options;
+    }
+
+    /**
+     * Start tracking the devices.
+     * <p>
+     * The listener is called from native threads, with {@code true} after a session is started,
+     * and with {@code false} before it is stopped. The sessions of different devices are started
+     * concurrently, so the listener may be called concurrently. A session which could not be
+     * started, or which died while its device is still connected, is started again on the next
+     * change of the device list.
+     */
+    public synchronized boolean start(SessionListenerCallback listener) {
+        sessionListener = new SessionListener(listener);
+        fleet = ScrcpyLibrary.scrcpy_fleet_start(options, sessionListener, null);
+        return fleet != null;
+    }
+
+    public synchronized void stop() {
+        if (fleet == null) {
+            return;
+        }
+        ScrcpyLibrary.scrcpy_fleet_stop(fleet);
+        fleet = null;
+    }
+
+    /**
+     * The running session of the device, or {@code null}.
+     */
+    public Scrcpy getSession(String serial) {
+        return sessions.get(serial);
+    }
+
+    public interface SessionListenerCallback {
+        void onSession(String serial, Scrcpy scrcpy, boolean started);
+    }
+
+    private class SessionListener extends On_session_Pointer_BytePointer_scrcpy_process_boolean {
+        final SessionListenerCallback listener;
+
+        SessionListener(SessionListenerCallback listener) {
+            this.listener = listener;
+        }
+
+        @Override
+        public void call(Pointer userdata, BytePointer serial, scrcpy_process process, boolean started) {
+            String s = serial.getString(StandardCharsets.UTF_8);
+            Scrcpy scrcpy = started ? new Scrcpy(process) : sessions.get(s);
+            if (started) {
+                sessions.put(s, scrcpy);
+            }
+            if (listener != null) {
+                listener.onSession(s, scrcpy, started);
+            }
+            if (!started) {
+                if (scrcpy != null) {
+                    scrcpy.stopDelivery();
+                    scrcpy.stopLatestFrame();
+                }
+                sessions.remove(s);
+            }
+        }
+    }
+}